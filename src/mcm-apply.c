@@ -31,6 +31,8 @@
 #include "mcm-utils.h"
 #include "mcm-client.h"
 #include "mcm-device-xrandr.h"
+#include "mcm-ramp-cache.h"
+#include "mcm-xserver.h"
 
 /**
  * main:
@@ -40,6 +42,9 @@ main (int argc, char **argv)
 {
 	gboolean ret;
 	gboolean login = FALSE;
+	gboolean stats = FALSE;
+	guint written;
+	guint skipped;
 	guint retval = 0;
 	GError *error = NULL;
 	GOptionContext *context;
@@ -47,11 +52,18 @@ main (int argc, char **argv)
 	guint i;
 	McmClient *client = NULL;
 	McmDevice *device;
+	McmXserver *xserver = NULL;
+	McmRampCache *cache = NULL;
+	gchar *cache_filename = NULL;
+	gboolean from_cache = FALSE;
 
 	const GOptionEntry options[] = {
 		{ "login", 'l', 0, G_OPTION_ARG_NONE, &login,
 		  /* TRANSLATORS: we use this mode at login as we're sure there are no previous settings to clear */
 		  _("Do not attempt to clear previously applied settings"), NULL },
+		{ "stats", 's', 0, G_OPTION_ARG_NONE, &stats,
+		  /* TRANSLATORS: show how many gamma ramps and profiles were already set */
+		  _("Show what was changed and what was already set"), NULL },
 		{ NULL}
 	};
 
@@ -70,34 +82,76 @@ main (int argc, char **argv)
 	g_option_context_parse (context, &argc, &argv, NULL);
 	g_option_context_free (context);
 
-	/* get devices */
-	client = mcm_client_new ();
-	ret = mcm_client_coldplug (client, MCM_CLIENT_COLDPLUG_XRANDR, &error);
-	if (!ret) {
-		egg_warning ("failed to get devices: %s", error->message);
-		g_error_free (error);
-		goto out;
+	/* use the ramps from last time if nothing has changed, which
+	 * avoids parsing the config, the EDIDs and the profiles */
+	cache_filename = mcm_ramp_cache_get_default_filename ();
+	cache = mcm_ramp_cache_new ();
+	ret = mcm_ramp_cache_load (cache, cache_filename, &error);
+	if (ret)
+		ret = mcm_device_xrandr_apply_cached (cache, !login, &error);
+	if (ret) {
+		egg_debug ("set all outputs from %s", cache_filename);
+		from_cache = TRUE;
+	} else {
+		egg_debug ("not using the ramp cache: %s", error->message);
+		g_clear_error (&error);
 	}
 
-	/* set for each output */
-	array = mcm_client_get_devices (client);
-	for (i=0; i<array->len; i++) {
-		device = g_ptr_array_index (array, i);
+	/* get devices */
+	if (!from_cache) {
+		client = mcm_client_new ();
+		ret = mcm_client_coldplug (client, MCM_CLIENT_COLDPLUG_XRANDR, &error);
+		if (!ret) {
+			egg_warning ("failed to get devices: %s", error->message);
+			g_error_free (error);
+			goto out;
+		}
 
 		/* optimize for login to save a few hundred ms */
-		mcm_device_xrandr_set_remove_atom (MCM_DEVICE_XRANDR (device), !login);
+		array = mcm_client_get_devices (client);
+		for (i=0; i<array->len; i++) {
+			device = g_ptr_array_index (array, i);
+			mcm_device_xrandr_set_remove_atom (MCM_DEVICE_XRANDR (device), !login);
+		}
 
-		/* set gamma for device */
-		egg_debug ("setting profiles on device: %s", mcm_device_get_id (device));
-		ret = mcm_device_apply (device, &error);
+		/* set gamma for all the outputs at once */
+		egg_debug ("setting profiles on %i devices", array->len);
+		ret = mcm_client_apply_displays (client, cache, &error);
 		if (!ret) {
 			retval = 1;
 			egg_warning ("failed to set gamma: %s", error->message);
 			g_error_free (error);
-			break;
+			error = NULL;
 		}
+
+		/* save whatever was set for next time */
+		ret = mcm_ramp_cache_save (cache, cache_filename, &error);
+		if (!ret) {
+			egg_warning ("failed to save ramp cache: %s", error->message);
+			g_error_free (error);
+		}
+	}
+
+	/* show what we skipped */
+	if (stats) {
+		/* TRANSLATORS: if the gamma ramps saved at the last login could be used */
+		g_print (_("Gamma ramp cache: %s"), from_cache ? _("used") : _("not used"));
+		g_print ("\n");
+		mcm_device_xrandr_get_stats (&written, &skipped);
+		/* TRANSLATORS: the number of gamma ramps sent to the X server, and the number that were already set */
+		g_print (_("Gamma ramps: %i written, %i unchanged"), written, skipped);
+		g_print ("\n");
+		xserver = mcm_xserver_new ();
+		mcm_xserver_get_stats (xserver, &written, &skipped);
+		/* TRANSLATORS: the number of ICC profile atoms sent to the X server, and the number that were already set */
+		g_print (_("Profile atoms: %i written, %i unchanged"), written, skipped);
+		g_print ("\n");
 	}
 out:
+	g_free (cache_filename);
+	mcm_ramp_cache_free (cache);
+	if (xserver != NULL)
+		g_object_unref (xserver);
 	if (array != NULL)
 		g_ptr_array_unref (array);
 	if (client != NULL)
@@ -45,6 +45,8 @@
 
 static void     mcm_calibrate_manual_finalize	(GObject     *object);
 
+#define MCM_CALIBRATE_MANUAL_SLIDER_FRAME_BUDGET	40 /* ms */
+
 #define MCM_CALIBRATE_MANUAL_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), MCM_TYPE_CALIBRATE_MANUAL, McmCalibrateManualPrivate))
 
 /**
@@ -68,6 +70,7 @@ struct _McmCalibrateManualPrivate
 	gdouble				*profile_blue;
 	GError				**error;
 	gboolean			 ret;
+	guint				 redraw_id;
 };
 
 enum {
@@ -125,6 +128,25 @@ mcm_calibrate_manual_help_cb (GtkWidget *widget, McmCalibrateManual *calibrate)
 	mcm_mate_help ("calibrate-manual");
 }
 
+/**
+ * mcm_calibrate_manual_redraw_cb:
+ *
+ * Updates the sample with the latest color, at most once per frame.
+ **/
+static gboolean
+mcm_calibrate_manual_redraw_cb (McmCalibrateManual *calibrate)
+{
+	McmCalibrateManualPrivate *priv = calibrate->priv;
+
+	priv->redraw_id = 0;
+	g_object_set (priv->gamma_widget,
+		      "color-red", priv->profile_red[priv->current_gamma],
+		      "color-green", priv->profile_green[priv->current_gamma],
+		      "color-blue", priv->profile_blue[priv->current_gamma],
+		      NULL);
+	return FALSE;
+}
+
 /**
  * mcm_calibrate_manual_slider_changed_cb:
  **/
@@ -162,17 +184,16 @@ mcm_calibrate_manual_slider_changed_cb (GtkRange *range, McmCalibrateManual *cal
 	green = CLAMP (green, 0.0f, 1.0f);
 	blue = CLAMP (blue, 0.0f, 1.0f);
 
-	g_object_set (priv->gamma_widget,
-		      "color-red", red,
-		      "color-green", green,
-		      "color-blue", blue,
-		      NULL);
-
 	/* save in array */
 	priv->profile_red[priv->current_gamma] = red;
 	priv->profile_green[priv->current_gamma] = green;
 	priv->profile_blue[priv->current_gamma] = blue;
 
+	/* dragging emits far more changes than can be drawn */
+	if (priv->redraw_id == 0)
+		priv->redraw_id = g_timeout_add (MCM_CALIBRATE_MANUAL_SLIDER_FRAME_BUDGET,
+						 (GSourceFunc) mcm_calibrate_manual_redraw_cb, calibrate);
+
 	egg_debug ("@%i, (%f,%f,%f)", priv->current_gamma, red, green, blue);
 out:
 	return;
@@ -194,6 +215,12 @@ mcm_calibrate_manual_setup_page (McmCalibrateManual *calibrate, guint page)
 	GString *string_msg = NULL;
 	McmCalibrateManualPrivate *priv = calibrate->priv;
 
+	/* the new page sets up the sample itself */
+	if (priv->redraw_id != 0) {
+		g_source_remove (priv->redraw_id);
+		priv->redraw_id = 0;
+	}
+
 	if (page == MCM_CALIBRATE_MANUAL_PAGE_INTRO) {
 		widget = GTK_WIDGET (gtk_builder_get_object (priv->builder, "label_title"));
 		/* TRANSLATORS: dialog title */
@@ -333,39 +360,30 @@ mcm_calibrate_manual_setup_page (McmCalibrateManual *calibrate, guint page)
 	if (page == MCM_CALIBRATE_MANUAL_PAGE_LAST) {
 
 		McmClut *clut;
-		GPtrArray *array;
-		McmClutData *data;
+		guint16 *ramps;
+		guint size;
 		guint i;
 
-		array = g_ptr_array_new_with_free_func (g_free);
-
-		/* add the zero point */
-		data = g_new0 (McmClutData, 1);
-		g_ptr_array_add (array, data);
+		/* the zero point, each step and the last point */
+		size = priv->calibration_steps + 1;
+		clut = mcm_clut_new ();
+		ramps = mcm_clut_get_source_buffer (clut, size);
 
 		/* do each */
 		for (i=1; i<priv->calibration_steps; i++) {
-			data = g_new0 (McmClutData, 1);
-			data->red = ((priv->profile_red[i-1] + priv->profile_red[i]) / 2.0f) * (gdouble) 0xffff;
-			data->green = ((priv->profile_green[i-1] + priv->profile_green[i]) / 2.0f) * (gdouble) 0xffff;
-			data->blue = ((priv->profile_blue[i-1] + priv->profile_blue[i]) / 2.0f) * (gdouble) 0xffff;
-			g_ptr_array_add (array, data);
+			ramps[i] = ((priv->profile_red[i-1] + priv->profile_red[i]) / 2.0f) * (gdouble) 0xffff;
+			ramps[size + i] = ((priv->profile_green[i-1] + priv->profile_green[i]) / 2.0f) * (gdouble) 0xffff;
+			ramps[size * 2 + i] = ((priv->profile_blue[i-1] + priv->profile_blue[i]) / 2.0f) * (gdouble) 0xffff;
 		}
 
 		/* add the last point */
-		data = g_new0 (McmClutData, 1);
-		data->red = 0xffff;
-		data->green = 0xffff;
-		data->blue = 0xffff;
-		g_ptr_array_add (array, data);
-
-		clut = mcm_clut_new ();
-		mcm_clut_set_source_array (clut, array);
+		ramps[size - 1] = 0xffff;
+		ramps[size * 2 - 1] = 0xffff;
+		ramps[size * 3 - 1] = 0xffff;
 		mcm_clut_print (clut);
 
 		g_object_set (priv->trc_widget, "clut", clut, NULL);
 		g_object_unref (clut);
-		g_ptr_array_unref (array);
 
 		widget = GTK_WIDGET (gtk_builder_get_object (priv->builder, "label_title"));
 		/* TRANSLATORS: dialog title */
@@ -679,6 +697,8 @@ mcm_calibrate_manual_finalize (GObject *object)
 	McmCalibrateManual *calibrate = MCM_CALIBRATE_MANUAL (object);
 	McmCalibrateManualPrivate *priv = calibrate->priv;
 
+	if (priv->redraw_id != 0)
+		g_source_remove (priv->redraw_id);
 	g_free (priv->profile_red);
 	g_free (priv->profile_green);
 	g_free (priv->profile_blue);
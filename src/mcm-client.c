@@ -47,6 +47,8 @@
  #include "mcm-device-sane.h"
 #endif
 #include "mcm-device-virtual.h"
+#include "mcm-output-index.h"
+#include "mcm-output-state.h"
 #include "mcm-screen.h"
 #include "mcm-utils.h"
 
@@ -56,7 +58,7 @@ static void     mcm_client_finalize	(GObject     *object);
 
 #define MCM_CLIENT_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), MCM_TYPE_CLIENT, McmClientPrivate))
 
-static void mcm_client_xrandr_add (McmClient *client, MateRROutput *output);
+static McmDevice *mcm_client_xrandr_add (McmClient *client, MateRROutput *output);
 #ifdef HAVE_SANE
 static gboolean mcm_client_coldplug_devices_sane (McmClient *client, GError **error);
 static gpointer mcm_client_coldplug_devices_sane_thrd (McmClient *client);
@@ -80,6 +82,11 @@ struct _McmClientPrivate
 	gboolean			 init_cups;
 	gboolean			 init_sane;
 	guint				 refresh_id;
+	GHashTable			*output_states;
+	guint				 outputs_changed;
+	guint				 outputs_unchanged;
+	McmOutputIndex			*output_index;
+	gboolean			 output_index_valid;
 };
 
 enum {
@@ -94,6 +101,7 @@ enum {
 	SIGNAL_ADDED,
 	SIGNAL_REMOVED,
 	SIGNAL_CHANGED,
+	SIGNAL_OUTPUTS_CHANGED,
 	SIGNAL_LAST
 };
 
@@ -230,6 +238,10 @@ mcm_client_get_device_by_id (McmClient *client, const gchar *id)
 static void
 mcm_client_device_changed_cb (McmDevice *device, McmClient *client)
 {
+	/* the display may have been unplugged, so don't use it for windows */
+	if (MCM_IS_DEVICE_XRANDR (device))
+		client->priv->output_index_valid = FALSE;
+
 	/* emit a signal */
 	egg_debug ("emit changed: %s", mcm_device_get_id (device));
 	g_signal_emit (client, signals[SIGNAL_CHANGED], 0, device);
@@ -274,6 +286,7 @@ mcm_client_remove_device_internal (McmClient *client, McmDevice *device, gboolea
 
 	/* try to remove from array */
 	ret = g_ptr_array_remove (client->priv->array, device);
+	client->priv->output_index_valid = FALSE;
 	if (!ret) {
 		g_set_error_literal (error, 1, 0, "not found in device array");
 		goto out;
@@ -531,128 +544,156 @@ mcm_client_coldplug_devices_udev_thrd (McmClient *client)
 }
 
 /**
- * mcm_client_get_device_by_window_covered:
+ * mcm_client_get_device_by_output_name:
+ *
+ * @client: a valid %McmClient instance
+ * @output_name: the XRandR output name, e.g. "LVDS1"
+ *
+ * Gets the display that is plugged into an output. Displays that have been
+ * unplugged are kept, so these are skipped; otherwise the old monitor
+ * would be returned after a monitor was swapped on the same output.
+ *
+ * Return value: a valid %McmDevice or %NULL. Free with g_object_unref()
  **/
-static gfloat
-mcm_client_get_device_by_window_covered (gint x, gint y, gint width, gint height,
-				         gint window_x, gint window_y, gint window_width, gint window_height)
+McmDevice *
+mcm_client_get_device_by_output_name (McmClient *client, const gchar *output_name)
 {
-	gfloat covered = 0.0f;
-	gint overlap_x;
-	gint overlap_y;
-
-	/* to the right of the window */
-	if (window_x > x + width)
-		goto out;
-	if (window_y > y + height)
-		goto out;
-
-	/* to the left of the window */
-	if (window_x + window_width < x)
-		goto out;
-	if (window_y + window_height < y)
-		goto out;
-
-	/* get the overlaps */
-	overlap_x = MIN((window_x + window_width - x), width) - MAX(window_x - x, 0);
-	overlap_y = MIN((window_y + window_height - y), height) - MAX(window_y - y, 0);
+	guint i;
+	McmDevice *device_tmp;
+	McmClientPrivate *priv = client->priv;
 
-	/* not in this window */
-	if (overlap_x <= 0)
-		goto out;
-	if (overlap_y <= 0)
-		goto out;
+	g_return_val_if_fail (MCM_IS_CLIENT (client), NULL);
+	g_return_val_if_fail (output_name != NULL, NULL);
 
-	/* get the coverage */
-	covered = (gfloat) (overlap_x * overlap_y) / (gfloat) (window_width * window_height);
-	egg_debug ("overlap_x=%i,overlap_y=%i,covered=%f", overlap_x, overlap_y, covered);
-out:
-	return covered;
+	for (i=0; i<priv->array->len; i++) {
+		device_tmp = g_ptr_array_index (priv->array, i);
+		if (!MCM_IS_DEVICE_XRANDR (device_tmp))
+			continue;
+		if (!mcm_device_get_connected (device_tmp))
+			continue;
+		if (g_strcmp0 (mcm_device_xrandr_get_native_device (MCM_DEVICE_XRANDR (device_tmp)), output_name) == 0)
+			return g_object_ref (device_tmp);
+	}
+	return NULL;
 }
 
 /**
- * mcm_client_get_device_by_window:
+ * mcm_client_update_output_index:
  **/
-McmDevice *
-mcm_client_get_device_by_window (McmClient *client, GdkWindow *window)
+static void
+mcm_client_update_output_index (McmClient *client)
 {
-	gfloat covered;
-	gfloat covered_max = 0.0f;
-	gint window_width, window_height;
-	gint window_x, window_y;
-	gint x, y;
 	guint i;
-	guint len = 0;
-	guint width, height;
+	gint x, y;
 	MateRRMode *mode;
-	MateRROutput *output_best = NULL;
 	MateRROutput **outputs;
-	McmDevice *device = NULL;
+	McmDevice *device;
+	McmClientPrivate *priv = client->priv;
 
-	/* get the window parameters, in root co-ordinates */
-	gdk_window_get_origin (window, &window_x, &window_y);
-	gdk_drawable_get_size (GDK_DRAWABLE(window), &window_width, &window_height);
+	mcm_output_index_clear (priv->output_index);
+	priv->output_index_valid = TRUE;
 
 	/* get list of updates */
-	outputs = mcm_screen_get_outputs (client->priv->screen, NULL);
+	outputs = mcm_screen_get_outputs (priv->screen, NULL);
 	if (outputs == NULL)
-		goto out;
+		return;
 
-	/* find length */
-	for (i=0; outputs[i] != NULL; i++)
-		len++;
-
-	/* go through each option */
-	for (i=0; i<len; i++) {
+	for (i=0; outputs[i] != NULL; i++) {
 
 		/* not interesting */
 		if (!mate_rr_output_is_connected (outputs[i]))
 			continue;
+		mode = mate_rr_output_get_current_mode (outputs[i]);
+		if (mode == NULL)
+			continue;
+		device = mcm_client_get_device_by_output_name (client, mate_rr_output_get_name (outputs[i]));
+		if (device == NULL)
+			continue;
 
 		/* get details about the output */
 		mate_rr_output_get_position (outputs[i], &x, &y);
-		mode = mate_rr_output_get_current_mode (outputs[i]);
-		width = mate_rr_mode_get_width (mode);
-		height = mate_rr_mode_get_height (mode);
-		egg_debug ("%s: %ix%i -> %ix%i (%ix%i -> %ix%i)", mate_rr_output_get_name (outputs[i]),
-			   x, y, x+width, y+height,
-			   window_x, window_y, window_x+window_width, window_y+window_height);
-
-		/* get the fraction of how much the window is covered */
-		covered = mcm_client_get_device_by_window_covered (x, y, width, height,
-								   window_x, window_y, window_width, window_height);
-
-		/* keep a running total of which one is best */
-		if (covered > 0.01f && covered > covered_max) {
-			output_best = outputs[i];
-
-			/* optimize */
-			if (covered > 0.99) {
-				egg_debug ("all in one window, no need to search other windows");
-				goto out;
-			}
-
-			/* keep looking */
-			covered_max = covered;
-			egg_debug ("personal best of %f for %s", covered, mate_rr_output_get_name (output_best));
-		}
-	}
-out:
-	/* if we found an output, get the device */
-	if (output_best != NULL) {
-		McmDevice *device_tmp;
-		device_tmp = mcm_device_xrandr_new ();
-		mcm_device_xrandr_set_from_output (device_tmp, output_best, NULL);
-		device = mcm_client_get_device_by_id (client, mcm_device_get_id (device_tmp));
-		g_object_unref (device_tmp);
+		egg_debug ("%s: %ix%i -> %ix%i", mate_rr_output_get_name (outputs[i]),
+			   x, y, x + mate_rr_mode_get_width (mode), y + mate_rr_mode_get_height (mode));
+		mcm_output_index_add (priv->output_index, x, y,
+				      mate_rr_mode_get_width (mode),
+				      mate_rr_mode_get_height (mode),
+				      device);
+
+		/* the device is still held by the device array */
+		g_object_unref (device);
 	}
-	return device;
+}
+
+/**
+ * mcm_client_get_device_by_window:
+ *
+ * The output rectangles are cached and only rebuilt after a RandR event or
+ * when a device is added or removed.
+ **/
+McmDevice *
+mcm_client_get_device_by_window (McmClient *client, GdkWindow *window)
+{
+	gint window_width, window_height;
+	gint window_x, window_y;
+	McmClientPrivate *priv = client->priv;
+
+	/* get the window parameters, in root co-ordinates */
+	gdk_window_get_origin (window, &window_x, &window_y);
+	gdk_drawable_get_size (GDK_DRAWABLE(window), &window_width, &window_height);
+
+	/* the outputs have changed since the last lookup */
+	if (!priv->output_index_valid)
+		mcm_client_update_output_index (client);
+
+	return mcm_output_index_lookup (priv->output_index, window_x, window_y, window_width, window_height);
+}
+
+/**
+ * mcm_client_output_state_new:
+ **/
+static McmOutputState *
+mcm_client_output_state_new (MateRROutput *output)
+{
+	gint x = 0;
+	gint y = 0;
+	guint32 crtc_id = 0;
+	MateRRCrtc *crtc;
+
+	if (!mate_rr_output_is_connected (output))
+		return mcm_output_state_new (FALSE, NULL, 0, 0, 0);
+	crtc = mate_rr_output_get_crtc (output);
+	if (crtc != NULL)
+		crtc_id = mate_rr_crtc_get_id (crtc);
+	mate_rr_output_get_position (output, &x, &y);
+	return mcm_output_state_new (TRUE, mate_rr_output_get_edid_data (output), crtc_id, x, y);
+}
+
+/**
+ * mcm_client_get_output_stats:
+ *
+ * @client: a valid %McmClient instance
+ * @changed: the number of outputs that had to be rescanned or reapplied, or %NULL
+ * @unchanged: the number of outputs that were left alone, or %NULL
+ *
+ * Gets how many outputs the RandR event handler has had to process, which
+ * should be proportional to what was replugged, not to the number of monitors.
+ **/
+void
+mcm_client_get_output_stats (McmClient *client, guint *changed, guint *unchanged)
+{
+	g_return_if_fail (MCM_IS_CLIENT (client));
+	if (changed != NULL)
+		*changed = client->priv->outputs_changed;
+	if (unchanged != NULL)
+		*unchanged = client->priv->outputs_unchanged;
 }
 
 /**
  * mcm_client_xrandr_add:
+ *
+ * Return value: the device that was added, or %NULL. Free with g_object_unref()
  **/
-static void
+static McmDevice *
 mcm_client_xrandr_add (McmClient *client, MateRROutput *output)
 {
 	gboolean ret;
@@ -672,6 +713,8 @@ mcm_client_xrandr_add (McmClient *client, MateRROutput *output)
 	if (!ret) {
 		egg_debug ("failed to set for output: %s", error->message);
 		g_error_free (error);
+		g_object_unref (device);
+		device = NULL;
 		goto out;
 	}
 
@@ -680,11 +723,12 @@ mcm_client_xrandr_add (McmClient *client, MateRROutput *output)
 	if (!ret) {
 		egg_debug ("failed to set for device: %s", error->message);
 		g_error_free (error);
+		g_object_unref (device);
+		device = NULL;
 		goto out;
 	}
 out:
-	if (device != NULL)
-		g_object_unref (device);
+	return device;
 }
 
 /**
@@ -695,13 +739,22 @@ mcm_client_coldplug_devices_xrandr (McmClient *client, GError **error)
 {
 	MateRROutput **outputs;
 	guint i;
+	McmDevice *device;
 	McmClientPrivate *priv = client->priv;
 
 	outputs = mcm_screen_get_outputs (priv->screen, error);
 	if (outputs == NULL)
 		return FALSE;
-	for (i=0; outputs[i] != NULL; i++)
-		mcm_client_xrandr_add (client, outputs[i]);
+	for (i=0; outputs[i] != NULL; i++) {
+		device = mcm_client_xrandr_add (client, outputs[i]);
+		if (device != NULL)
+			g_object_unref (device);
+
+		/* save what we saw for the next RandR event */
+		g_hash_table_insert (priv->output_states,
+				     g_strdup (mate_rr_output_get_name (outputs[i])),
+				     mcm_client_output_state_new (outputs[i]));
+	}
 
 	/* inform the UI */
 	mcm_client_done_loading (client);
@@ -1195,6 +1248,7 @@ mcm_client_add_device (McmClient *client, McmDevice *device, GError **error)
 
 	/* add to the array */
 	g_ptr_array_add (client->priv->array, g_object_ref (device));
+	client->priv->output_index_valid = FALSE;
 
 	/* emit a signal */
 	egg_debug ("emit added: %s", device_id);
@@ -1211,6 +1265,52 @@ out:
 	return ret;
 }
 
+/**
+ * mcm_client_apply_displays:
+ *
+ * @client: a valid %McmClient instance
+ * @cache: a #McmRampCache to save the final ramps in, or %NULL
+ * @error: a %GError that is set in the result of an error, or %NULL
+ *
+ * Sets the gamma ramps and profile atoms for every connected display,
+ * sending all the ramps to the X server in one go.
+ *
+ * Return value: %TRUE if every display was set
+ **/
+gboolean
+mcm_client_apply_displays (McmClient *client, McmRampCache *cache, GError **error)
+{
+	guint i;
+	gboolean ret;
+	McmDevice *device;
+	GPtrArray *devices;
+	McmClientPrivate *priv = client->priv;
+
+	g_return_val_if_fail (MCM_IS_CLIENT (client), FALSE);
+
+	/* only connected displays have a crtc */
+	devices = g_ptr_array_new ();
+	for (i=0; i<priv->array->len; i++) {
+		device = g_ptr_array_index (priv->array, i);
+		if (!MCM_IS_DEVICE_XRANDR (device))
+			continue;
+		if (!mcm_device_get_connected (device))
+			continue;
+		g_ptr_array_add (devices, device);
+	}
+
+	/* nothing to do */
+	if (devices->len == 0) {
+		ret = TRUE;
+		goto out;
+	}
+
+	ret = mcm_device_xrandr_apply_array (devices, cache, error);
+out:
+	g_ptr_array_unref (devices);
+	return ret;
+}
+
 /**
  * mcm_client_remove_device:
  **/
@@ -1332,19 +1432,79 @@ mcm_client_set_property (GObject *object, guint prop_id, const GValue *value, GP
 
 /**
  * mcm_client_randr_event_cb:
+ *
+ * Only the outputs that differ from last time are looked at. The displays
+ * that need their gamma setting again are sent in one "outputs-changed"
+ * signal; this object does not set them itself, as every process has one.
  **/
 static void
 mcm_client_randr_event_cb (McmScreen *screen, McmClient *client)
 {
 	MateRROutput **outputs;
 	guint i;
+	const gchar *output_name;
+	McmDevice *device;
+	McmOutputState *state;
+	McmOutputStateChange change;
+	GPtrArray *reapply = NULL;
+	GError *error = NULL;
+	McmClientPrivate *priv = client->priv;
 
 	egg_debug ("screens may have changed");
+	priv->output_index_valid = FALSE;
 
-	/* replug devices */
-	outputs = mcm_screen_get_outputs (screen, NULL);
-	for (i=0; outputs[i] != NULL; i++)
-		mcm_client_xrandr_add (client, outputs[i]);
+	outputs = mcm_screen_get_outputs (screen, &error);
+	if (outputs == NULL) {
+		egg_warning ("failed to get outputs: %s", error->message);
+		g_error_free (error);
+		goto out;
+	}
+
+	reapply = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	for (i=0; outputs[i] != NULL; i++) {
+		output_name = mate_rr_output_get_name (outputs[i]);
+		state = mcm_client_output_state_new (outputs[i]);
+		change = mcm_output_state_compare (g_hash_table_lookup (priv->output_states, output_name), state);
+		if (change == MCM_OUTPUT_STATE_CHANGE_NONE) {
+			mcm_output_state_free (state);
+			priv->outputs_unchanged++;
+			continue;
+		}
+		priv->outputs_changed++;
+		device = mcm_client_get_device_by_output_name (client, output_name);
+
+		/* a different monitor, so the old one is no longer connected */
+		if (device != NULL && change != MCM_OUTPUT_STATE_CHANGE_MOVED) {
+			egg_debug ("%s disconnected from %s", mcm_device_get_id (device), output_name);
+			mcm_device_set_connected (device, FALSE);
+			g_object_unref (device);
+			device = NULL;
+		}
+
+		/* parse the EDID of the new monitor */
+		if (change == MCM_OUTPUT_STATE_CHANGE_REPLUGGED ||
+		    (change == MCM_OUTPUT_STATE_CHANGE_MOVED && device == NULL)) {
+			egg_debug ("%s connected, rescanning", output_name);
+			device = mcm_client_xrandr_add (client, outputs[i]);
+		} else if (change == MCM_OUTPUT_STATE_CHANGE_MOVED) {
+			egg_debug ("%s moved, only reapplying", output_name);
+		}
+
+		/* the X server resets the gamma when the crtc changes */
+		if (device != NULL)
+			g_ptr_array_add (reapply, device);
+		g_hash_table_insert (priv->output_states, g_strdup (output_name), state);
+	}
+	egg_debug ("outputs changed %i, unchanged %i", priv->outputs_changed, priv->outputs_unchanged);
+
+	/* let the session set all the changed outputs in one go */
+	if (reapply->len > 0) {
+		egg_debug ("emit outputs-changed: %i", reapply->len);
+		g_signal_emit (client, signals[SIGNAL_OUTPUTS_CHANGED], 0, reapply);
+	}
+out:
+	if (reapply != NULL)
+		g_ptr_array_unref (reapply);
 }
 
 /**
@@ -1413,6 +1573,19 @@ mcm_client_class_init (McmClientClass *klass)
 			      NULL, NULL, g_cclosure_marshal_VOID__OBJECT,
 			      G_TYPE_NONE, 1, G_TYPE_OBJECT);
 
+	/**
+	 * McmClient::outputs-changed
+	 *
+	 * The displays whose outputs were replugged or moved, and so need
+	 * the profile setting again.
+	 **/
+	signals[SIGNAL_OUTPUTS_CHANGED] =
+		g_signal_new ("outputs-changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (McmClientClass, outputs_changed),
+			      NULL, NULL, g_cclosure_marshal_VOID__BOXED,
+			      G_TYPE_NONE, 1, G_TYPE_PTR_ARRAY);
+
 	g_type_class_add_private (klass, sizeof (McmClientPrivate));
 }
 
@@ -1430,6 +1603,12 @@ mcm_client_init (McmClient *client)
 	client->priv->use_threads = FALSE;
 	client->priv->init_cups = FALSE;
 	client->priv->init_sane = FALSE;
+	client->priv->outputs_changed = 0;
+	client->priv->outputs_unchanged = 0;
+	client->priv->output_index = mcm_output_index_new ();
+	client->priv->output_index_valid = FALSE;
+	client->priv->output_states = g_hash_table_new_full (g_str_hash, g_str_equal,
+							     g_free, (GDestroyNotify) mcm_output_state_free);
 	client->priv->settings = g_settings_new (MCM_SETTINGS_SCHEMA);
 	client->priv->array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	client->priv->screen = mcm_screen_new ();
@@ -1465,6 +1644,8 @@ mcm_client_finalize (GObject *object)
 
 	g_free (priv->display_name);
 	g_ptr_array_unref (priv->array);
+	g_hash_table_destroy (priv->output_states);
+	mcm_output_index_free (priv->output_index);
 	g_object_unref (priv->gudev_client);
 	g_object_unref (priv->screen);
 	g_object_unref (priv->settings);
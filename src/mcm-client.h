@@ -26,6 +26,7 @@
 #include <gdk/gdk.h>
 
 #include "mcm-device.h"
+#include "mcm-ramp-cache.h"
 
 G_BEGIN_DECLS
 
@@ -52,8 +53,8 @@ struct _McmClientClass
 	void		(* added)				(McmDevice	*device);
 	void		(* removed)				(McmDevice	*device);
 	void		(* changed)				(McmDevice	*device);
+	void		(* outputs_changed)			(GPtrArray	*devices);
 	/* padding for future expansion */
-	void (*_mcm_reserved1) (void);
 	void (*_mcm_reserved2) (void);
 	void (*_mcm_reserved3) (void);
 	void (*_mcm_reserved4) (void);
@@ -77,6 +78,8 @@ McmDevice	*mcm_client_get_device_by_id			(McmClient		*client,
 								 const gchar		*id);
 McmDevice	*mcm_client_get_device_by_window		(McmClient		*client,
 								 GdkWindow		*window);
+McmDevice	*mcm_client_get_device_by_output_name		(McmClient		*client,
+								 const gchar		*output_name);
 gboolean	 mcm_client_add_device				(McmClient		*client,
 								 McmDevice		*device,
 								 GError			**error);
@@ -89,10 +92,16 @@ gboolean	 mcm_client_delete_device			(McmClient		*client,
 gboolean	 mcm_client_coldplug				(McmClient		*client,
 								 McmClientColdplug	 coldplug,
 								 GError			**error);
+gboolean	 mcm_client_apply_displays			(McmClient		*client,
+								 McmRampCache		*cache,
+								 GError			**error);
 GPtrArray	*mcm_client_get_devices				(McmClient		*client);
 void		 mcm_client_set_use_threads			(McmClient		*client,
 								 gboolean		 use_threads);
 gboolean	 mcm_client_get_loading				(McmClient		*client);
+void		 mcm_client_get_output_stats			(McmClient		*client,
+								 guint			*changed,
+								 guint			*unchanged);
 
 G_END_DECLS
 
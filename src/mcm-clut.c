@@ -31,9 +31,11 @@
 
 #include <glib-object.h>
 #include <math.h>
+#include <string.h>
 #include <gio/gio.h>
 
 #include "mcm-clut.h"
+#include "mcm-ramp.h"
 #include "mcm-utils.h"
 
 #include "egg-debug.h"
@@ -46,10 +48,16 @@ static void     mcm_clut_finalize	(GObject     *object);
  * McmClutPrivate:
  *
  * Private #McmClut data
+ *
+ * The ramps are stored planar in one block, with the red entries first,
+ * then green, then blue. The adjusted ramps are kept until the source or
+ * one of the adjustments changes.
  **/
 struct _McmClutPrivate
 {
-	GPtrArray 			*array;
+	guint16				*source;
+	guint16				*data;
+	gboolean			 data_valid;
 	guint				 size;
 	gdouble				 gamma;
 	gdouble				 brightness;
@@ -71,48 +79,88 @@ enum {
 
 G_DEFINE_TYPE (McmClut, mcm_clut, G_TYPE_OBJECT)
 
-#if 0
 /**
- * mcm_clut_set_source_data:
+ * mcm_clut_set_size_internal:
  **/
-static gboolean
-mcm_clut_set_source_data (McmClut *clut, const McmClutData *data, guint size)
+static void
+mcm_clut_set_size_internal (McmClut *clut, guint size)
 {
-	guint i;
-	McmClutData *tmp;
+	McmClutPrivate *priv = clut->priv;
 
-	g_return_val_if_fail (MCM_IS_CLUT (clut), FALSE);
-	g_return_val_if_fail (data != NULL, FALSE);
+	if (priv->size == size)
+		return;
 
-	/* copy each element into the array */
-	for (i=0; i<size; i++) {
-		tmp = g_new0 (McmClutData, 1);
-		tmp->red = data[i].red;
-		tmp->green = data[i].green;
-		tmp->blue = data[i].blue;
-		g_ptr_array_add (clut->priv->array, tmp);
+	/* the source data no longer matches */
+	if (priv->source != NULL) {
+		egg_warning ("resizing CLUT from %i to %i, discarding source data", priv->size, size);
+		g_free (priv->source);
+		priv->source = NULL;
 	}
+	g_free (priv->data);
+	priv->data = NULL;
+	priv->data_valid = FALSE;
+	priv->size = size;
+}
 
-	return TRUE;
+/**
+ * mcm_clut_get_source_buffer:
+ * @clut: a valid #McmClut instance
+ * @size: the number of entries in each ramp
+ *
+ * Gets the source ramps so they can be written in place, resizing them
+ * to @size entries if required. Red is at offset 0, green at @size and
+ * blue at twice @size. The ramps have to be written before the adjusted
+ * data is next read.
+ *
+ * Return value: the source ramps, owned by @clut
+ **/
+guint16 *
+mcm_clut_get_source_buffer (McmClut *clut, guint size)
+{
+	McmClutPrivate *priv;
+
+	g_return_val_if_fail (MCM_IS_CLUT (clut), NULL);
+	g_return_val_if_fail (size != 0, NULL);
+
+	priv = clut->priv;
+	mcm_clut_set_size_internal (clut, size);
+	if (priv->source == NULL)
+		priv->source = g_new0 (guint16, size * 3);
+	priv->data_valid = FALSE;
+	return priv->source;
 }
-#endif
 
 /**
  * mcm_clut_set_source_array:
+ *
+ * This copies the #McmClutData values, and is only kept for compatibility.
+ * Use mcm_clut_get_source_buffer() in new code.
  **/
 gboolean
 mcm_clut_set_source_array (McmClut *clut, GPtrArray *array)
 {
+	guint i;
+	guint16 *source;
+	const McmClutData *tmp;
+
 	g_return_val_if_fail (MCM_IS_CLUT (clut), FALSE);
 	g_return_val_if_fail (array != NULL, FALSE);
 
-	/* just take a reference */
-	if (clut->priv->array != NULL)
-		g_ptr_array_unref (clut->priv->array);
-	clut->priv->array = g_ptr_array_ref (array);
+	/* nothing to copy */
+	if (array->len == 0) {
+		mcm_clut_reset (clut);
+		mcm_clut_set_size_internal (clut, 0);
+		return TRUE;
+	}
 
 	/* set size from input array */
-	clut->priv->size = array->len;
+	source = mcm_clut_get_source_buffer (clut, array->len);
+	for (i=0; i<array->len; i++) {
+		tmp = g_ptr_array_index (array, i);
+		source[i] = MIN (tmp->red, 0xffff);
+		source[array->len + i] = MIN (tmp->green, 0xffff);
+		source[array->len * 2 + i] = MIN (tmp->blue, 0xffff);
+	}
 
 	/* all okay */
 	return TRUE;
@@ -127,23 +175,44 @@ mcm_clut_reset (McmClut *clut)
 	g_return_val_if_fail (MCM_IS_CLUT (clut), FALSE);
 
 	/* setup nothing */
-	g_ptr_array_set_size (clut->priv->array, 0);
+	g_free (clut->priv->source);
+	clut->priv->source = NULL;
+	clut->priv->data_valid = FALSE;
 	return TRUE;
 }
 
 /**
- * mcm_clut_get_adjusted_value:
+ * mcm_clut_adjust:
+ *
+ * Writes the ramps with the gamma, brightness and contrast applied.
  **/
-static guint
-mcm_clut_get_adjusted_value (guint value, gdouble min, gdouble max, gdouble custom_gamma)
+static void
+mcm_clut_adjust (McmClut *clut, guint16 *red, guint16 *green, guint16 *blue)
 {
-	guint retval;
+	guint i;
+	gdouble min;
+	gdouble max;
+	McmClutPrivate *priv = clut->priv;
+
+	min = priv->brightness / 100.0f;
+	max = (1.0f - min) * (priv->contrast / 100.0f) + min;
+	egg_debug ("min=%f,max=%f", min, max);
 
-	/* optimise for the common case */
-	if (min < 0.01f && max > 0.99f && custom_gamma > 0.99 && custom_gamma < 1.01)
-		return value;
-	retval = 65536.0f * ((powf (((gdouble)value/65536.0f), custom_gamma) * (max - min)) + min);
-	return retval;
+	if (priv->source == NULL) {
+		/* generate a dummy gamma */
+		egg_debug ("falling back to dummy gamma");
+		for (i=0; i<priv->size; i++)
+			red[i] = (priv->size > 1) ? (i * 0xffff) / (priv->size - 1) : 0;
+		mcm_ramp_adjust (red, red, priv->size, priv->gamma, min, max);
+		memcpy (green, red, priv->size * sizeof (guint16));
+		memcpy (blue, red, priv->size * sizeof (guint16));
+		return;
+	}
+
+	/* each ramp is contiguous */
+	mcm_ramp_adjust (priv->source, red, priv->size, priv->gamma, min, max);
+	mcm_ramp_adjust (priv->source + priv->size, green, priv->size, priv->gamma, min, max);
+	mcm_ramp_adjust (priv->source + priv->size * 2, blue, priv->size, priv->gamma, min, max);
 }
 
 /**
@@ -155,51 +224,101 @@ mcm_clut_get_size (McmClut *clut)
 	return clut->priv->size;
 }
 
+/**
+ * mcm_clut_get_data:
+ * @clut: a valid #McmClut instance
+ *
+ * Gets the adjusted ramps, laid out like the source buffer with
+ * mcm_clut_get_size() entries for each of red, green and blue.
+ *
+ * The ramps are only recalculated when the source data or one of the
+ * adjustments has changed since the last call.
+ *
+ * Return value: the ramps, which are only valid until @clut is next changed
+ **/
+const guint16 *
+mcm_clut_get_data (McmClut *clut)
+{
+	McmClutPrivate *priv;
+
+	g_return_val_if_fail (MCM_IS_CLUT (clut), NULL);
+	g_return_val_if_fail (clut->priv->gamma != 0, NULL);
+
+	priv = clut->priv;
+	if (priv->size == 0)
+		return NULL;
+	if (priv->data_valid)
+		return priv->data;
+	if (priv->data == NULL)
+		priv->data = g_new (guint16, priv->size * 3);
+	mcm_clut_adjust (clut, priv->data, priv->data + priv->size, priv->data + priv->size * 2);
+	priv->data_valid = TRUE;
+	return priv->data;
+}
+
+/**
+ * mcm_clut_fill_ramp:
+ * @clut: a valid #McmClut instance
+ * @red: the red ramp to write, e.g. from a #XRRCrtcGamma
+ * @green: the green ramp to write
+ * @blue: the blue ramp to write
+ * @size: the number of entries in each ramp, which has to match @clut
+ *
+ * Writes the adjusted ramps straight into caller owned storage.
+ *
+ * Return value: %TRUE if the ramps were written
+ **/
+gboolean
+mcm_clut_fill_ramp (McmClut *clut, guint16 *red, guint16 *green, guint16 *blue, guint size)
+{
+	const guint16 *data;
+
+	g_return_val_if_fail (MCM_IS_CLUT (clut), FALSE);
+	g_return_val_if_fail (red != NULL && green != NULL && blue != NULL, FALSE);
+	g_return_val_if_fail (clut->priv->gamma != 0, FALSE);
+
+	if (size == 0 || size != clut->priv->size) {
+		egg_warning ("cannot fill ramp of size %i from CLUT of size %i", size, clut->priv->size);
+		return FALSE;
+	}
+
+	/* copy the cached ramps, which are usually already valid */
+	data = mcm_clut_get_data (clut);
+	memcpy (red, data, size * sizeof (guint16));
+	memcpy (green, data + size, size * sizeof (guint16));
+	memcpy (blue, data + size * 2, size * sizeof (guint16));
+	return TRUE;
+}
+
 /**
  * mcm_clut_get_array:
+ *
+ * This makes a copy of the adjusted ramps, and is only kept for
+ * compatibility. Use mcm_clut_get_data() in new code.
  **/
 GPtrArray *
 mcm_clut_get_array (McmClut *clut)
 {
 	GPtrArray *array;
 	guint i;
-	guint value;
-	const McmClutData *tmp;
+	guint size;
+	const guint16 *ramp;
 	McmClutData *data;
-	gdouble min;
-	gdouble max;
-	gdouble custom_gamma;
-
-	g_return_val_if_fail (MCM_IS_CLUT (clut), FALSE);
-	g_return_val_if_fail (clut->priv->gamma != 0, FALSE);
 
-	min = clut->priv->brightness / 100.0f;
-	max = (1.0f - min) * (clut->priv->contrast / 100.0f) + min;
-	egg_debug ("min=%f,max=%f", min, max);
-	custom_gamma = clut->priv->gamma;
+	g_return_val_if_fail (MCM_IS_CLUT (clut), NULL);
+	g_return_val_if_fail (clut->priv->gamma != 0, NULL);
 
+	size = clut->priv->size;
 	array = g_ptr_array_new_with_free_func (g_free);
-	if (clut->priv->array->len == 0) {
-		/* generate a dummy gamma */
-		egg_debug ("falling back to dummy gamma");
-		for (i=0; i<clut->priv->size; i++) {
-			value = (i * 0xffff) / (clut->priv->size - 1);
-			data = g_new0 (McmClutData, 1);
-			data->red = mcm_clut_get_adjusted_value (value, min, max, custom_gamma);
-			data->green = mcm_clut_get_adjusted_value (value, min, max, custom_gamma);
-			data->blue = mcm_clut_get_adjusted_value (value, min, max, custom_gamma);
-			g_ptr_array_add (array, data);
-		}
-	} else {
-		/* just make a 1:1 copy */
-		for (i=0; i<clut->priv->size; i++) {
-			tmp = g_ptr_array_index (clut->priv->array, i);
-			data = g_new0 (McmClutData, 1);
-			data->red = mcm_clut_get_adjusted_value (tmp->red, min, max, custom_gamma);
-			data->green = mcm_clut_get_adjusted_value (tmp->green, min, max, custom_gamma);
-			data->blue = mcm_clut_get_adjusted_value (tmp->blue, min, max, custom_gamma);
-			g_ptr_array_add (array, data);
-		}
+	ramp = mcm_clut_get_data (clut);
+	if (ramp == NULL)
+		return array;
+	for (i=0; i<size; i++) {
+		data = g_new0 (McmClutData, 1);
+		data->red = ramp[i];
+		data->green = ramp[size + i];
+		data->blue = ramp[size * 2 + i];
+		g_ptr_array_add (array, data);
 	}
 	return array;
 }
@@ -210,16 +329,15 @@ mcm_clut_get_array (McmClut *clut)
 void
 mcm_clut_print (McmClut *clut)
 {
-	GPtrArray *array;
 	guint i;
-	McmClutData *tmp;
+	McmClutPrivate *priv;
 
 	g_return_if_fail (MCM_IS_CLUT (clut));
-	array = clut->priv->array;
-	for (i=0; i<array->len; i++) {
-		tmp = g_ptr_array_index (array, i);
-		g_print ("%x %x %x\n", tmp->red, tmp->green, tmp->blue);
-	}
+	priv = clut->priv;
+	if (priv->source == NULL)
+		return;
+	for (i=0; i<priv->size; i++)
+		g_print ("%x %x %x\n", priv->source[i], priv->source[priv->size + i], priv->source[priv->size * 2 + i]);
 }
 
 /**
@@ -261,15 +379,21 @@ mcm_clut_set_property (GObject *object, guint prop_id, const GValue *value, GPar
 
 	switch (prop_id) {
 	case PROP_SIZE:
-		priv->size = g_value_get_uint (value);
+		mcm_clut_set_size_internal (clut, g_value_get_uint (value));
 		break;
 	case PROP_GAMMA:
+		if (priv->gamma != g_value_get_double (value))
+			priv->data_valid = FALSE;
 		priv->gamma = g_value_get_double (value);
 		break;
 	case PROP_BRIGHTNESS:
+		if (priv->brightness != g_value_get_double (value))
+			priv->data_valid = FALSE;
 		priv->brightness = g_value_get_double (value);
 		break;
 	case PROP_CONTRAST:
+		if (priv->contrast != g_value_get_double (value))
+			priv->data_valid = FALSE;
 		priv->contrast = g_value_get_double (value);
 		break;
 	default:
@@ -332,7 +456,6 @@ static void
 mcm_clut_init (McmClut *clut)
 {
 	clut->priv = MCM_CLUT_GET_PRIVATE (clut);
-	clut->priv->array = g_ptr_array_new_with_free_func (g_free);
 	clut->priv->settings = g_settings_new (MCM_SETTINGS_SCHEMA);
         clut->priv->gamma = g_settings_get_double (clut->priv->settings, MCM_SETTINGS_DEFAULT_GAMMA);
 	if (clut->priv->gamma < 0.01)
@@ -350,7 +473,8 @@ mcm_clut_finalize (GObject *object)
 	McmClut *clut = MCM_CLUT (object);
 	McmClutPrivate *priv = clut->priv;
 
-	g_ptr_array_unref (priv->array);
+	g_free (priv->source);
+	g_free (priv->data);
 	g_object_unref (clut->priv->settings);
 
 	G_OBJECT_CLASS (mcm_clut_parent_class)->finalize (object);
@@ -62,6 +62,14 @@ typedef struct {
 
 GType		 mcm_clut_get_type		  	(void);
 McmClut		*mcm_clut_new				(void);
+guint16		*mcm_clut_get_source_buffer		(McmClut		*clut,
+							 guint			 size);
+const guint16	*mcm_clut_get_data			(McmClut		*clut);
+gboolean	 mcm_clut_fill_ramp			(McmClut		*clut,
+							 guint16		*red,
+							 guint16		*green,
+							 guint16		*blue,
+							 guint			 size);
 GPtrArray	*mcm_clut_get_array			(McmClut		*clut);
 gboolean	 mcm_clut_set_source_array		(McmClut		*clut,
 							 GPtrArray		*array);
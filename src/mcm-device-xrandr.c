@@ -23,6 +23,9 @@
 
 #include <glib-object.h>
 #include <math.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
 #include <libmateui/mate-rr.h>
 #include <X11/extensions/Xrandr.h>
 #include <X11/extensions/xf86vmode.h>
@@ -35,6 +38,7 @@
 #include "mcm-xserver.h"
 #include "mcm-screen.h"
 #include "mcm-clut.h"
+#include "mcm-ramp-cache.h"
 
 #include "egg-debug.h"
 
@@ -371,95 +375,188 @@ mcm_device_xrandr_apply_fallback (XRRCrtcGamma *crtc_gamma, guint size)
 }
 
 /**
- * mcm_device_xrandr_apply_for_crtc:
+ * McmDeviceXrandrCrtc:
  *
- * Return value: %TRUE for success;
+ * The state of one output while a set of devices is being applied
  **/
-static gboolean
-mcm_device_xrandr_apply_for_crtc (McmDeviceXrandr *device_xrandr, MateRRCrtc *crtc, McmClut *clut, GError **error)
-{
-	guint id;
-	gboolean ret = TRUE;
-	GPtrArray *array = NULL;
-	XRRCrtcGamma *crtc_gamma = NULL;
-	guint i;
-	McmClutData *data;
+typedef struct {
+	McmDeviceXrandr		*device_xrandr;		/* %NULL when applied from the cache */
+	MateRROutput		*output;
+	gchar			*filename;
+	XRRCrtcGamma		*crtc_gamma;
+	RRCrtc			 id;
+	guint			 size;
+	gboolean		 fallback;
+	gboolean		 use_global;
+	gboolean		 use_atom;
+	gboolean		 remove_atom;
+	gulong			 serial_start;
+	gulong			 serial_end;
+	guchar			 error_code;
+	gboolean		 unchanged;
+	GError			*error;
+} McmDeviceXrandrCrtc;
+
+/* the handler has no user data, and X only calls it from XSync() below */
+static GPtrArray *mcm_device_xrandr_pending = NULL;
+
+static guint mcm_device_xrandr_gamma_written = 0;
+static guint mcm_device_xrandr_gamma_skipped = 0;
 
-	/* get data */
-	array = mcm_clut_get_array (clut);
-	if (array == NULL) {
-		ret = FALSE;
-		g_set_error_literal (error, 1, 0, "failed to get CLUT data");
-		goto out;
-	}
+/**
+ * mcm_device_xrandr_get_stats:
+ * @written: the number of gamma ramps that were sent to the X server, or %NULL
+ * @skipped: the number of gamma ramps that were already set, or %NULL
+ *
+ * Gets how many gamma ramps were written and skipped by this process.
+ **/
+void
+mcm_device_xrandr_get_stats (guint *written, guint *skipped)
+{
+	if (written != NULL)
+		*written = mcm_device_xrandr_gamma_written;
+	if (skipped != NULL)
+		*skipped = mcm_device_xrandr_gamma_skipped;
+}
 
-	/* no length? */
-	if (array->len == 0) {
-		ret = FALSE;
-		g_set_error_literal (error, 1, 0, "no data in the CLUT array");
-		goto out;
-	}
+/**
+ * mcm_device_xrandr_crtc_free:
+ **/
+static void
+mcm_device_xrandr_crtc_free (McmDeviceXrandrCrtc *item)
+{
+	g_free (item->filename);
+	if (item->crtc_gamma != NULL)
+		XRRFreeGamma (item->crtc_gamma);
+	if (item->error != NULL)
+		g_error_free (item->error);
+	if (item->device_xrandr != NULL)
+		g_object_unref (item->device_xrandr);
+	g_free (item);
+}
 
-	/* convert to a type X understands */
-	crtc_gamma = XRRAllocGamma (array->len);
-	for (i=0; i<array->len; i++) {
-		data = g_ptr_array_index (array, i);
-		crtc_gamma->red[i] = data->red;
-		crtc_gamma->green[i] = data->green;
-		crtc_gamma->blue[i] = data->blue;
+/**
+ * mcm_device_xrandr_error_handler_cb:
+ *
+ * Attributes an error to the CRTC whose requests contain the serial.
+ **/
+static int
+mcm_device_xrandr_error_handler_cb (Display *display, XErrorEvent *event)
+{
+	guint i;
+	McmDeviceXrandrCrtc *item;
+
+	for (i=0; i<mcm_device_xrandr_pending->len; i++) {
+		item = g_ptr_array_index (mcm_device_xrandr_pending, i);
+		if (event->serial >= item->serial_start &&
+		    event->serial < item->serial_end) {
+			item->error_code = event->error_code;
+			return 0;
+		}
 	}
+	egg_warning ("unexpected X error %i for serial %lu", event->error_code, event->serial);
+	return 0;
+}
 
-	/* get id that X recognizes */
-	id = mate_rr_crtc_get_id (crtc);
+/**
+ * mcm_device_xrandr_crtc_is_unchanged:
+ *
+ * Return value: %TRUE if the hardware already has the ramp we want to set
+ **/
+static gboolean
+mcm_device_xrandr_crtc_is_unchanged (Display *display, McmDeviceXrandrCrtc *item)
+{
+	gboolean ret = FALSE;
+	gsize length = item->size * sizeof (guint16);
+	guint16 *ramp = NULL;
+	XRRCrtcGamma *current = NULL;
 
-	/* get the value, and catch errors */
 	gdk_error_trap_push ();
-	XRRSetCrtcGamma (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()), id, crtc_gamma);
-	gdk_flush ();
-	if (gdk_error_trap_pop ()) {
-		/* some drivers support Xrandr 1.2, not 1.3 */
-		ret = mcm_device_xrandr_apply_fallback (crtc_gamma, array->len);
-		if (!ret) {
-			g_set_error (error, 1, 0, "failed to set crtc gamma %p (%i) on %i", crtc_gamma, array->len, id);
-			goto out;
+	if (item->fallback) {
+		ramp = g_new (guint16, item->size * 3);
+		if (XF86VidModeGetGammaRamp (display, gdk_x11_get_default_screen (), item->size,
+					     ramp, ramp + item->size, ramp + item->size * 2)) {
+			ret = (memcmp (ramp, item->crtc_gamma->red, length) == 0 &&
+			       memcmp (ramp + item->size, item->crtc_gamma->green, length) == 0 &&
+			       memcmp (ramp + item->size * 2, item->crtc_gamma->blue, length) == 0);
+		}
+	} else {
+		current = XRRGetCrtcGamma (display, item->id);
+		if (current != NULL && current->size == (gint) item->size) {
+			ret = (memcmp (current->red, item->crtc_gamma->red, length) == 0 &&
+			       memcmp (current->green, item->crtc_gamma->green, length) == 0 &&
+			       memcmp (current->blue, item->crtc_gamma->blue, length) == 0);
 		}
 	}
-out:
-	if (crtc_gamma != NULL)
-		XRRFreeGamma (crtc_gamma);
-	if (array != NULL)
-		g_ptr_array_unref (array);
+	gdk_error_trap_pop ();
+
+	g_free (ramp);
+	if (current != NULL)
+		XRRFreeGamma (current);
 	return ret;
 }
 
 /**
- * mcm_device_xrandr_set_remove_atom:
+ * mcm_device_xrandr_get_cache_key:
  *
- * This is set to FALSE at login time when we are sure there are going to be
- * no atoms previously set that have to be removed.
+ * Everything the final ramp of an output depends on, apart from the
+ * profile itself which is checked separately by the cache. The config
+ * file holds the profile and the fine tuning of every device, so any
+ * change to it makes a new key.
+ *
+ * Return value: the key, free with g_free()
  **/
-void
-mcm_device_xrandr_set_remove_atom (McmDeviceXrandr *device_xrandr, gboolean remove_atom)
+static gchar *
+mcm_device_xrandr_get_cache_key (MateRROutput *output, gboolean use_global, gboolean use_atom)
 {
-	g_return_if_fail (MCM_IS_DEVICE_XRANDR (device_xrandr));
-	device_xrandr->priv->remove_atom = remove_atom;
+	gchar *key;
+	gchar *filename;
+	gchar *state;
+	const gchar *output_name;
+	const guint8 *edid;
+	struct stat buf;
+	GChecksum *checksum;
+
+	checksum = g_checksum_new (G_CHECKSUM_MD5);
+	output_name = mate_rr_output_get_name (output);
+	g_checksum_update (checksum, (const guchar *) output_name, strlen (output_name) + 1);
+
+	/* a different monitor on the same output */
+	edid = mate_rr_output_get_edid_data (output);
+	if (edid != NULL)
+		g_checksum_update (checksum, edid, 128);
+
+	/* the device settings, and the global settings that affect the ramp */
+	filename = mcm_utils_get_default_config_location ();
+	if (g_stat (filename, &buf) != 0) {
+		buf.st_mtime = 0;
+		buf.st_size = 0;
+	}
+	state = g_strdup_printf ("%li:%li:%i:%i", (glong) buf.st_mtime, (glong) buf.st_size, use_global, use_atom);
+	g_checksum_update (checksum, (const guchar *) state, strlen (state));
+
+	key = g_strdup (g_checksum_get_string (checksum));
+	g_checksum_free (checksum);
+	g_free (filename);
+	g_free (state);
+	return key;
 }
 
 /**
- * mcm_device_xrandr_apply:
+ * mcm_device_xrandr_crtc_prepare:
+ *
+ * Works out the profile and output for the device, and builds the ramp
+ * that will be sent to the CRTC.
  *
  * Return value: %TRUE for success;
  **/
 static gboolean
-mcm_device_xrandr_apply (McmDevice *device, GError **error)
+mcm_device_xrandr_crtc_prepare (McmDeviceXrandrCrtc *item, GError **error)
 {
 	gboolean ret = FALSE;
 	McmClut *clut = NULL;
 	McmProfile *profile = NULL;
 	MateRRCrtc *crtc;
-	MateRROutput *output;
-	gint x, y;
-	const gchar *filename;
 	gchar *filename_systemwide = NULL;
 	gfloat gamma_adjust;
 	gfloat brightness;
@@ -468,13 +565,10 @@ mcm_device_xrandr_apply (McmDevice *device, GError **error)
 	const gchar *id;
 	guint size;
 	gboolean saved;
-	gboolean use_global;
-	gboolean use_atom;
-	gboolean leftmost_screen = FALSE;
 	GFile *file = NULL;
 	McmDeviceKind kind;
-	McmDeviceXrandr *device_xrandr = MCM_DEVICE_XRANDR (device);
-	McmDeviceXrandrPrivate *priv = device_xrandr->priv;
+	McmDevice *device = MCM_DEVICE (item->device_xrandr);
+	McmDeviceXrandrPrivate *priv = item->device_xrandr->priv;
 
 	/* do no set the gamma for non-display types */
 	id = mcm_device_get_id (device);
@@ -485,7 +579,7 @@ mcm_device_xrandr_apply (McmDevice *device, GError **error)
 	}
 
 	/* should be set for display types */
-	output_name = mcm_device_xrandr_get_native_device (device_xrandr);
+	output_name = mcm_device_xrandr_get_native_device (item->device_xrandr);
 	if (output_name == NULL || output_name[0] == '\0') {
 		g_set_error (error, 1, 0, "no output name for display: %s", id);
 		goto out;
@@ -511,25 +605,30 @@ mcm_device_xrandr_apply (McmDevice *device, GError **error)
 	}
 
 	/* check we have an output */
-	output = mcm_screen_get_output_by_name (priv->screen, output_name, error);
-	if (output == NULL)
+	item->output = mcm_screen_get_output_by_name (priv->screen, output_name, error);
+	if (item->output == NULL) {
+		ret = FALSE;
 		goto out;
+	}
 
 	/* get crtc size */
-	crtc = mate_rr_output_get_crtc (output);
+	crtc = mate_rr_output_get_crtc (item->output);
 	if (crtc == NULL) {
+		ret = FALSE;
 		g_set_error (error, 1, 0, "failed to get crtc for device: %s", id);
 		goto out;
 	}
 
 	/* get gamma table size */
-	size = mcm_device_xrandr_get_gamma_size (device_xrandr, crtc, error);
-	if (size == 0)
+	size = mcm_device_xrandr_get_gamma_size (item->device_xrandr, crtc, error);
+	if (size == 0) {
+		ret = FALSE;
 		goto out;
+	}
 
 	/* only set the CLUT if we're not seting the atom */
-	use_global = g_settings_get_boolean (priv->settings, MCM_SETTINGS_GLOBAL_DISPLAY_CORRECTION);
-	if (use_global && profile != NULL)
+	item->use_global = g_settings_get_boolean (priv->settings, MCM_SETTINGS_GLOBAL_DISPLAY_CORRECTION);
+	if (item->use_global && profile != NULL)
 		clut = mcm_profile_generate_vcgt (profile, size);
 
 	/* create dummy CLUT if we failed */
@@ -541,7 +640,7 @@ mcm_device_xrandr_apply (McmDevice *device, GError **error)
 	}
 
 	/* do fine adjustment */
-	if (use_global) {
+	if (item->use_global) {
 		gamma_adjust = mcm_device_get_gamma (device);
 		brightness = mcm_device_get_brightness (device);
 		contrast = mcm_device_get_contrast (device);
@@ -552,50 +651,82 @@ mcm_device_xrandr_apply (McmDevice *device, GError **error)
 			      NULL);
 	}
 
-	/* actually set the gamma */
-	ret = mcm_device_xrandr_apply_for_crtc (device_xrandr, crtc, clut, error);
-	if (!ret)
+	/* write the ramps straight into a type X understands */
+	item->crtc_gamma = XRRAllocGamma (size);
+	ret = mcm_clut_fill_ramp (clut, item->crtc_gamma->red, item->crtc_gamma->green, item->crtc_gamma->blue, size);
+	if (!ret) {
+		g_set_error_literal (error, 1, 0, "failed to get CLUT data");
 		goto out;
+	}
+
+	/* get id that X recognizes */
+	item->id = mate_rr_crtc_get_id (crtc);
+	item->size = size;
+	item->fallback = priv->xrandr_fallback;
+	item->use_atom = g_settings_get_boolean (priv->settings, MCM_SETTINGS_SET_ICC_PROFILE_ATOM);
+	item->remove_atom = priv->remove_atom;
+	if (profile != NULL)
+		item->filename = g_strdup (mcm_profile_get_filename (profile));
+out:
+	g_free (filename_systemwide);
+	if (clut != NULL)
+		g_object_unref (clut);
+	if (profile != NULL)
+		g_object_unref (profile);
+	return ret;
+}
+
+/**
+ * mcm_device_xrandr_crtc_set_atoms:
+ *
+ * Return value: %TRUE for success;
+ **/
+static gboolean
+mcm_device_xrandr_crtc_set_atoms (McmDeviceXrandrCrtc *item, McmXserver *xserver, GError **error)
+{
+	gboolean ret = TRUE;
+	gint x, y;
+	const gchar *output_name;
+	gboolean leftmost_screen = FALSE;
 
 	/* is the monitor our primary monitor */
-	mate_rr_output_get_position (output, &x, &y);
+	mate_rr_output_get_position (item->output, &x, &y);
 	leftmost_screen = (x == 0 && y == 0);
+	output_name = mate_rr_output_get_name (item->output);
 
 	/* either remove the atoms or set them */
-	use_atom = g_settings_get_boolean (priv->settings, MCM_SETTINGS_SET_ICC_PROFILE_ATOM);
-	if (!use_atom || profile == NULL) {
+	if (!item->use_atom || item->filename == NULL) {
 
 		/* at login we don't need to remove any previously set options */
-		if (!priv->remove_atom)
+		if (!item->remove_atom)
 			goto out;
 
 		/* remove the output atom if there's nothing to show */
-		ret = mcm_xserver_remove_output_profile (priv->xserver, output_name, error);
+		ret = mcm_xserver_remove_output_profile (xserver, output_name, error);
 		if (!ret)
 			goto out;
 
 		/* primary screen */
 		if (leftmost_screen) {
-			ret = mcm_xserver_remove_root_window_profile (priv->xserver, error);
+			ret = mcm_xserver_remove_root_window_profile (xserver, error);
 			if (!ret)
 				goto out;
-			ret = mcm_xserver_remove_protocol_version (priv->xserver, error);
+			ret = mcm_xserver_remove_protocol_version (xserver, error);
 			if (!ret)
 				goto out;
 		}
 	} else {
 		/* set the per-output and per screen profile atoms */
-		filename = mcm_profile_get_filename (profile);
-		ret = mcm_xserver_set_output_profile (priv->xserver, output_name, filename, error);
+		ret = mcm_xserver_set_output_profile (xserver, output_name, item->filename, error);
 		if (!ret)
 			goto out;
 
 		/* primary screen */
 		if (leftmost_screen) {
-			ret = mcm_xserver_set_root_window_profile (priv->xserver, filename, error);
+			ret = mcm_xserver_set_root_window_profile (xserver, item->filename, error);
 			if (!ret)
 				goto out;
-			ret = mcm_xserver_set_protocol_version (priv->xserver,
+			ret = mcm_xserver_set_protocol_version (xserver,
 								MCM_ICC_PROFILE_IN_X_VERSION_MAJOR,
 								MCM_ICC_PROFILE_IN_X_VERSION_MINOR,
 								error);
@@ -604,11 +735,311 @@ mcm_device_xrandr_apply (McmDevice *device, GError **error)
 		}
 	}
 out:
-	g_free (filename_systemwide);
-	if (clut != NULL)
-		g_object_unref (clut);
-	if (profile != NULL)
-		g_object_unref (profile);
+	return ret;
+}
+
+/**
+ * mcm_device_xrandr_send:
+ *
+ * Sends the prepared ramps and then sets the atoms. Any failure is
+ * stored in the item it belongs to.
+ **/
+static void
+mcm_device_xrandr_send (GPtrArray *pending)
+{
+	guint i;
+	gboolean ret;
+	Display *display;
+	XErrorHandler old_handler;
+	McmXserver *xserver;
+	McmDeviceXrandrCrtc *item;
+
+	/* don't upload ramps the hardware already has, e.g. when re-logging in */
+	display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+	for (i=0; i<pending->len; i++) {
+		item = g_ptr_array_index (pending, i);
+		if (item->error != NULL)
+			continue;
+		item->unchanged = mcm_device_xrandr_crtc_is_unchanged (display, item);
+		if (item->unchanged) {
+			egg_debug ("gamma unchanged on crtc %i", (gint) item->id);
+			mcm_device_xrandr_gamma_skipped++;
+		}
+	}
+
+	/* make sure any earlier errors go to the old handler */
+	XSync (display, False);
+
+	/* send all the gamma ramps in one burst */
+	mcm_device_xrandr_pending = pending;
+	old_handler = XSetErrorHandler (mcm_device_xrandr_error_handler_cb);
+	for (i=0; i<pending->len; i++) {
+		item = g_ptr_array_index (pending, i);
+		if (item->error != NULL || item->unchanged || item->fallback)
+			continue;
+		item->serial_start = NextRequest (display);
+		XRRSetCrtcGamma (display, item->id, item->crtc_gamma);
+		item->serial_end = NextRequest (display);
+	}
+	XSync (display, False);
+	XSetErrorHandler (old_handler);
+	mcm_device_xrandr_pending = NULL;
+
+	xserver = mcm_xserver_new ();
+	for (i=0; i<pending->len; i++) {
+		item = g_ptr_array_index (pending, i);
+		if (item->error != NULL)
+			continue;
+
+		/* some drivers support Xrandr 1.2, not 1.3 */
+		if (!item->unchanged &&
+		    (item->error_code != 0 || item->fallback)) {
+			ret = mcm_device_xrandr_apply_fallback (item->crtc_gamma, item->size);
+			if (!ret) {
+				g_set_error (&item->error, 1, 0, "failed to set crtc gamma %p (%i) on %i",
+					     item->crtc_gamma, item->size, (gint) item->id);
+				continue;
+			}
+		}
+		if (!item->unchanged)
+			mcm_device_xrandr_gamma_written++;
+
+		/* the gamma is set, so now do the atoms */
+		mcm_device_xrandr_crtc_set_atoms (item, xserver, &item->error);
+	}
+	g_object_unref (xserver);
+}
+
+/**
+ * mcm_device_xrandr_get_result:
+ *
+ * Return value: %TRUE if no item failed, otherwise the first error is returned
+ **/
+static gboolean
+mcm_device_xrandr_get_result (GPtrArray *pending, GError **error)
+{
+	guint i;
+	guint failed = 0;
+	McmDeviceXrandrCrtc *item;
+	GError *error_local = NULL;
+
+	/* report the first failure, and log the rest */
+	for (i=0; i<pending->len; i++) {
+		item = g_ptr_array_index (pending, i);
+		if (item->error == NULL)
+			continue;
+		if (failed++ == 0) {
+			error_local = item->error;
+			item->error = NULL;
+			continue;
+		}
+		egg_warning ("failed to apply %s: %s",
+			     item->output != NULL ? mate_rr_output_get_name (item->output) : "display",
+			     item->error->message);
+	}
+	if (error_local != NULL)
+		g_propagate_error (error, error_local);
+	return (failed == 0);
+}
+
+/**
+ * mcm_device_xrandr_apply_array:
+ * @devices: an array of #McmDeviceXrandr objects
+ * @cache: a #McmRampCache to add the final ramps to, or %NULL
+ * @error: a %GError that is set in the result of an error, or %NULL
+ *
+ * Sets the gamma ramps and profile atoms for several outputs at once.
+ *
+ * All the ramps are built before anything is sent to the X server, and
+ * then the XRandR requests are sent together with a single sync. Errors
+ * are matched to the CRTC that caused them using the request serial, and
+ * only those CRTCs are retried with the per-screen XF86VidMode fallback.
+ * CRTCs that already have the right ramp are not written at all.
+ *
+ * A failure on one output does not stop the others being applied.
+ *
+ * Return value: %TRUE if every output was set;
+ **/
+gboolean
+mcm_device_xrandr_apply_array (GPtrArray *devices, McmRampCache *cache, GError **error)
+{
+	guint i;
+	gboolean ret;
+	gchar *key;
+	McmDeviceXrandrCrtc *item;
+	GPtrArray *pending;
+
+	g_return_val_if_fail (devices != NULL, FALSE);
+
+	/* build every ramp before talking to X */
+	pending = g_ptr_array_new_with_free_func ((GDestroyNotify) mcm_device_xrandr_crtc_free);
+	for (i=0; i<devices->len; i++) {
+		item = g_new0 (McmDeviceXrandrCrtc, 1);
+		item->device_xrandr = g_object_ref (MCM_DEVICE_XRANDR (g_ptr_array_index (devices, i)));
+		g_ptr_array_add (pending, item);
+		ret = mcm_device_xrandr_crtc_prepare (item, &item->error);
+		if (!ret && item->error == NULL)
+			g_set_error_literal (&item->error, 1, 0, "failed to prepare gamma ramp");
+	}
+
+	mcm_device_xrandr_send (pending);
+
+	/* remember what was set for next time */
+	for (i=0; cache != NULL && i<pending->len; i++) {
+		item = g_ptr_array_index (pending, i);
+		if (item->error != NULL)
+			continue;
+		key = mcm_device_xrandr_get_cache_key (item->output, item->use_global, item->use_atom);
+		mcm_ramp_cache_add (cache, key, item->size, item->filename,
+				    item->crtc_gamma->red, item->crtc_gamma->green, item->crtc_gamma->blue);
+		g_free (key);
+	}
+
+	ret = mcm_device_xrandr_get_result (pending, error);
+	g_ptr_array_unref (pending);
+	return ret;
+}
+
+/**
+ * mcm_device_xrandr_apply_cached:
+ * @cache: a loaded #McmRampCache
+ * @remove_atom: if atoms that are not needed should be removed
+ * @error: a %GError that is set in the result of an error, or %NULL
+ *
+ * Sets every connected output from ramps saved by an earlier call to
+ * mcm_device_xrandr_apply_array(). Nothing is sent unless all the outputs
+ * are in the cache, so on failure the caller should apply the devices in
+ * the normal way.
+ *
+ * The config file, EDIDs and profiles are not parsed at all.
+ *
+ * Return value: %TRUE if every output was set from the cache;
+ **/
+gboolean
+mcm_device_xrandr_apply_cached (McmRampCache *cache, gboolean remove_atom, GError **error)
+{
+	guint i;
+	guint size;
+	gboolean ret = FALSE;
+	gboolean use_global;
+	gboolean use_atom;
+	gchar *key;
+	const gchar *filename;
+	const guint16 *ramp;
+	Display *display;
+	MateRRCrtc *crtc;
+	MateRROutput **outputs;
+	McmScreen *screen;
+	GSettings *settings;
+	McmDeviceXrandrCrtc *item;
+	GPtrArray *pending;
+
+	g_return_val_if_fail (cache != NULL, FALSE);
+
+	screen = mcm_screen_new ();
+	settings = g_settings_new (MCM_SETTINGS_SCHEMA);
+	pending = g_ptr_array_new_with_free_func ((GDestroyNotify) mcm_device_xrandr_crtc_free);
+	use_global = g_settings_get_boolean (settings, MCM_SETTINGS_GLOBAL_DISPLAY_CORRECTION);
+	use_atom = g_settings_get_boolean (settings, MCM_SETTINGS_SET_ICC_PROFILE_ATOM);
+
+	outputs = mcm_screen_get_outputs (screen, error);
+	if (outputs == NULL)
+		goto out;
+
+	/* find every connected output in the cache */
+	display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+	for (i=0; outputs[i] != NULL; i++) {
+		if (!mate_rr_output_is_connected (outputs[i]))
+			continue;
+		crtc = mate_rr_output_get_crtc (outputs[i]);
+		if (crtc == NULL)
+			continue;
+
+		item = g_new0 (McmDeviceXrandrCrtc, 1);
+		item->output = outputs[i];
+		item->id = mate_rr_crtc_get_id (crtc);
+		item->use_global = use_global;
+		item->use_atom = use_atom;
+		item->remove_atom = remove_atom;
+		g_ptr_array_add (pending, item);
+
+		/* some drivers support Xrandr 1.2, not 1.3 */
+		gdk_error_trap_push ();
+		size = XRRGetCrtcGammaSize (display, item->id);
+		if (gdk_error_trap_pop ())
+			size = 0;
+		if (size == 0) {
+			item->fallback = TRUE;
+			size = mcm_device_xrandr_get_gamma_size_fallback ();
+		}
+		if (size == 0) {
+			g_set_error_literal (error, 1, 0, "failed to get gamma size");
+			goto out;
+		}
+
+		/* everything has to be cached */
+		key = mcm_device_xrandr_get_cache_key (outputs[i], use_global, use_atom);
+		ramp = mcm_ramp_cache_lookup (cache, key, size, &filename);
+		g_free (key);
+		if (ramp == NULL) {
+			g_set_error (error, 1, 0, "no cached ramp for %s", mate_rr_output_get_name (outputs[i]));
+			goto out;
+		}
+
+		/* copy into a type X understands */
+		item->size = size;
+		item->filename = g_strdup (filename);
+		item->crtc_gamma = XRRAllocGamma (size);
+		memcpy (item->crtc_gamma->red, ramp, size * sizeof (guint16));
+		memcpy (item->crtc_gamma->green, ramp + size, size * sizeof (guint16));
+		memcpy (item->crtc_gamma->blue, ramp + size * 2, size * sizeof (guint16));
+	}
+
+	/* nothing connected, so let the normal path deal with it */
+	if (pending->len == 0) {
+		g_set_error_literal (error, 1, 0, "no outputs to set");
+		goto out;
+	}
+
+	egg_debug ("setting %i outputs from the cache", pending->len);
+	mcm_device_xrandr_send (pending);
+	ret = mcm_device_xrandr_get_result (pending, error);
+out:
+	g_ptr_array_unref (pending);
+	g_object_unref (settings);
+	g_object_unref (screen);
+	return ret;
+}
+
+/**
+ * mcm_device_xrandr_set_remove_atom:
+ *
+ * This is set to FALSE at login time when we are sure there are going to be
+ * no atoms previously set that have to be removed.
+ **/
+void
+mcm_device_xrandr_set_remove_atom (McmDeviceXrandr *device_xrandr, gboolean remove_atom)
+{
+	g_return_if_fail (MCM_IS_DEVICE_XRANDR (device_xrandr));
+	device_xrandr->priv->remove_atom = remove_atom;
+}
+
+/**
+ * mcm_device_xrandr_apply:
+ *
+ * Return value: %TRUE for success;
+ **/
+static gboolean
+mcm_device_xrandr_apply (McmDevice *device, GError **error)
+{
+	gboolean ret;
+	GPtrArray *devices;
+
+	/* a batch of one */
+	devices = g_ptr_array_new ();
+	g_ptr_array_add (devices, device);
+	ret = mcm_device_xrandr_apply_array (devices, NULL, error);
+	g_ptr_array_unref (devices);
 	return ret;
 }
 
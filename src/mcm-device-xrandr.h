@@ -26,6 +26,7 @@
 #include <libmateui/mate-rr.h>
 
 #include "mcm-device.h"
+#include "mcm-ramp-cache.h"
 
 G_BEGIN_DECLS
 
@@ -58,6 +59,14 @@ void		 mcm_device_xrandr_set_remove_atom	(McmDeviceXrandr	*device_xrandr,
 const gchar	*mcm_device_xrandr_get_native_device	(McmDeviceXrandr	*device_xrandr);
 const gchar	*mcm_device_xrandr_get_eisa_id		(McmDeviceXrandr	*device_xrandr);
 gboolean	 mcm_device_xrandr_get_fallback		(McmDeviceXrandr	*device_xrandr);
+gboolean	 mcm_device_xrandr_apply_array		(GPtrArray		*devices,
+							 McmRampCache		*cache,
+							 GError			**error);
+gboolean	 mcm_device_xrandr_apply_cached		(McmRampCache		*cache,
+							 gboolean		 remove_atom,
+							 GError			**error);
+void		 mcm_device_xrandr_get_stats		(guint			*written,
+							 guint			*skipped);
 
 G_END_DECLS
 
@@ -597,8 +597,8 @@ mcm_device_load (McmDevice *device, GError **error)
 	gchar *iso_date = NULL;
 	gchar **profile_filenames = NULL;
 	guint i;
-	McmProfile *profile;
-	GFile *file_tmp;
+	GPtrArray *files = NULL;
+	GPtrArray *profiles = NULL;
 	McmDevicePrivate *priv = device->priv;
 
 	g_return_val_if_fail (MCM_IS_DEVICE (device), FALSE);
@@ -641,21 +641,20 @@ mcm_device_load (McmDevice *device, GError **error)
 	/* load data */
 	g_ptr_array_set_size (priv->profiles, 0);
 
-	/* parse filenames to object, skipping entries that fail to parse */
+	/* parse filenames to object in parallel, skipping entries that fail to parse */
 	profile_filenames = g_key_file_get_string_list (file, priv->id, "profile", NULL, NULL);
 	if (profile_filenames != NULL) {
-		for (i=0; profile_filenames[i] != NULL; i++) {
-			file_tmp = g_file_new_for_path (profile_filenames[i]);
-			profile = mcm_profile_default_new ();
-			ret = mcm_profile_parse (profile, file_tmp, &error_local);
-			if (ret) {
-				g_ptr_array_add (priv->profiles, g_object_ref (profile));
-			} else {
-				egg_warning ("failed to parse %s: %s", profile_filenames[i], error_local->message);
-				g_clear_error (&error_local);
-			}
-			g_object_unref (profile);
-			g_object_unref (file_tmp);
+		files = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+		for (i=0; profile_filenames[i] != NULL; i++)
+			g_ptr_array_add (files, g_file_new_for_path (profile_filenames[i]));
+		profiles = mcm_profile_parse_many (files, FALSE, NULL, &error_local);
+		if (profiles == NULL) {
+			egg_warning ("failed to parse profiles: %s", error_local->message);
+			g_clear_error (&error_local);
+		} else {
+			/* keep the order, as the first profile is the default */
+			for (i=0; i<profiles->len; i++)
+				g_ptr_array_add (priv->profiles, g_object_ref (g_ptr_array_index (profiles, i)));
 		}
 	}
 
@@ -710,6 +709,10 @@ mcm_device_load (McmDevice *device, GError **error)
 		ret = TRUE;
 	}
 out:
+	if (files != NULL)
+		g_ptr_array_unref (files);
+	if (profiles != NULL)
+		g_ptr_array_unref (profiles);
 	g_strfreev (profile_filenames);
 	g_free (iso_date);
 	g_free (filename);
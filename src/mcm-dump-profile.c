@@ -31,14 +31,11 @@
 #include "mcm-profile.h"
 
 /**
- * mcm_dump_profile_filename:
+ * mcm_dump_profile:
  **/
-static gboolean
-mcm_dump_profile_filename (const gchar *filename)
+static void
+mcm_dump_profile (McmProfile *profile)
 {
-	gboolean ret;
-	GError *error = NULL;
-	McmProfile *profile;
 	guint profile_kind;
 	guint colorspace;
 	guint size;
@@ -48,19 +45,9 @@ mcm_dump_profile_filename (const gchar *filename)
 	const gchar *manufacturer;
 	const gchar *model;
 	const gchar *datetime;
-	GFile *file = NULL;
-
-	/* parse profile */
-	profile = mcm_profile_default_new ();
-	file = g_file_new_for_path (filename);
-	ret = mcm_profile_parse (profile, file, &error);
-	if (!ret) {
-		egg_warning ("failed to parse: %s", error->message);
-		g_error_free (error);
-		goto out;
-	}
 
 	/* print what we know */
+	g_print ("Filename:\t%s\n", mcm_profile_get_filename (profile));
 	profile_kind = mcm_profile_get_kind (profile);
 	g_print ("Kind:\t%s\n", mcm_profile_kind_to_string (profile_kind));
 	colorspace = mcm_profile_get_colorspace (profile);
@@ -84,11 +71,6 @@ mcm_dump_profile_filename (const gchar *filename)
 	datetime = mcm_profile_get_datetime (profile);
 	if (datetime != NULL)
 		g_print ("Created:\t%s\n", datetime);
-out:
-	if (file != NULL)
-		g_object_unref (file);
-	g_object_unref (profile);
-	return ret;
 }
 
 /**
@@ -101,6 +83,9 @@ main (int argc, char **argv)
 	guint retval = 0;
 	GOptionContext *context;
 	gchar **files = NULL;
+	GPtrArray *array = NULL;
+	GPtrArray *profiles = NULL;
+	GError *error = NULL;
 
 	const GOptionEntry options[] = {
 		{ G_OPTION_REMAINING, '\0', 0, G_OPTION_ARG_FILENAME_ARRAY, &files,
@@ -115,6 +100,8 @@ main (int argc, char **argv)
 	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
 	textdomain (GETTEXT_PACKAGE);
 
+	if (! g_thread_supported ())
+		g_thread_init (NULL);
 	gtk_init (&argc, &argv);
 
 	/* TRANSLATORS: this just dumps the profile to the screen */
@@ -129,10 +116,26 @@ main (int argc, char **argv)
 	if (files == NULL)
 		goto out;
 
-	/* show each profile */
+	/* parse all the profiles at once */
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	for (i=0; files[i] != NULL; i++)
-		mcm_dump_profile_filename (files[i]);
+		g_ptr_array_add (array, g_file_new_for_path (files[i]));
+	profiles = mcm_profile_parse_many (array, FALSE, NULL, &error);
+	if (profiles == NULL) {
+		egg_warning ("failed to parse: %s", error->message);
+		g_error_free (error);
+		retval = 1;
+		goto out;
+	}
+
+	/* show each profile */
+	for (i=0; i<profiles->len; i++)
+		mcm_dump_profile (g_ptr_array_index (profiles, i));
 out:
+	if (array != NULL)
+		g_ptr_array_unref (array);
+	if (profiles != NULL)
+		g_ptr_array_unref (profiles);
 	g_strfreev (files);
 	return retval;
 }
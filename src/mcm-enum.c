@@ -82,6 +82,29 @@ mcm_profile_kind_to_string (McmProfileKind kind)
 	return "unknown";
 }
 
+/**
+ * mcm_profile_kind_from_string:
+ **/
+McmProfileKind
+mcm_profile_kind_from_string (const gchar *profile_kind)
+{
+	if (g_strcmp0 (profile_kind, "input-device") == 0)
+		return MCM_PROFILE_KIND_INPUT_DEVICE;
+	if (g_strcmp0 (profile_kind, "display-device") == 0)
+		return MCM_PROFILE_KIND_DISPLAY_DEVICE;
+	if (g_strcmp0 (profile_kind, "output-device") == 0)
+		return MCM_PROFILE_KIND_OUTPUT_DEVICE;
+	if (g_strcmp0 (profile_kind, "devicelink") == 0)
+		return MCM_PROFILE_KIND_DEVICELINK;
+	if (g_strcmp0 (profile_kind, "colorspace-conversion") == 0)
+		return MCM_PROFILE_KIND_COLORSPACE_CONVERSION;
+	if (g_strcmp0 (profile_kind, "abstract") == 0)
+		return MCM_PROFILE_KIND_ABSTRACT;
+	if (g_strcmp0 (profile_kind, "named-color") == 0)
+		return MCM_PROFILE_KIND_NAMED_COLOR;
+	return MCM_PROFILE_KIND_UNKNOWN;
+}
+
 /**
  * mcm_colorspace_to_string:
  **/
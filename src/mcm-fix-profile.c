@@ -23,10 +23,40 @@
 
 #include <glib/gi18n.h>
 #include <locale.h>
-#include <lcms.h>
+#ifdef MCM_USE_LCMS2
+ #include <lcms2.h>
+#else
+ #include <lcms.h>
+#endif
 
 static gint lcms_error_code = 0;
 
+#ifdef MCM_USE_LCMS2
+#define icSigProfileDescriptionTag	cmsSigProfileDescriptionTag
+#define icSigCopyrightTag		cmsSigCopyrightTag
+#define icSigDeviceModelDescTag		cmsSigDeviceModelDescTag
+#define icSigDeviceMfgDescTag		cmsSigDeviceMfgDescTag
+
+/*
+ * _cmsAddTextTag:
+ *
+ * lcms2 does not have this helper, so add the text as a localized unicode tag
+ */
+static gboolean
+_cmsAddTextTag (cmsHPROFILE lcms_profile, cmsTagSignature sig, const gchar *text)
+{
+	gboolean ret;
+	cmsMLU *mlu;
+
+	mlu = cmsMLUalloc (NULL, 1);
+	ret = cmsMLUsetASCII (mlu, "en", "US", text);
+	if (ret)
+		ret = cmsWriteTag (lcms_profile, sig, mlu);
+	cmsMLUfree (mlu);
+	return ret;
+}
+#endif
+
 /*
  * mcm_fix_profile_filename:
  */
@@ -80,7 +110,11 @@ mcm_fix_profile_filename (const gchar *filename, const gchar *description, const
 			goto out;
 		}
 	}
+#ifdef MCM_USE_LCMS2
+	ret = cmsSaveProfileToFile (lcms_profile, filename);
+#else
 	_cmsSaveProfile (lcms_profile, filename);
+#endif
 out:
 	if (lcms_profile != NULL)
 		cmsCloseProfile (lcms_profile);
@@ -88,6 +122,19 @@ out:
 	return ret;
 }
 
+#ifdef MCM_USE_LCMS2
+/*
+ * mcm_fix_profile_lcms_error_cb:
+ */
+static void
+mcm_fix_profile_lcms_error_cb (cmsContext context_id, cmsUInt32Number ErrorCode, const char *ErrorText)
+{
+	g_warning ("LCMS error %u: %s", ErrorCode, ErrorText);
+
+	/* copy this sytemwide */
+	lcms_error_code = ErrorCode;
+}
+#else
 /*
  * mcm_fix_profile_lcms_error_cb:
  */
@@ -101,6 +148,7 @@ mcm_fix_profile_lcms_error_cb (int ErrorCode, const char *ErrorText)
 
 	return LCMS_ERRC_WARNING;
 }
+#endif
 
 /*
  * main:
@@ -154,9 +202,13 @@ main (int argc, char **argv)
 		goto out;
 
 	/* setup LCMS */
+#ifdef MCM_USE_LCMS2
+	cmsSetLogErrorHandler (mcm_fix_profile_lcms_error_cb);
+#else
 	cmsSetErrorHandler (mcm_fix_profile_lcms_error_cb);
 	cmsErrorAction (LCMS_ERROR_SHOW);
 	cmsSetLanguage ("en", "US");
+#endif
 
 	/* fix each profile */
 	for (i=0; files[i] != NULL; i++) {
@@ -29,11 +29,16 @@
 #include "config.h"
 
 #include <gtk/gtk.h>
-#include <lcms.h>
+#ifdef MCM_USE_LCMS2
+ #include <lcms2.h>
+#else
+ #include <lcms.h>
+#endif
 
 #include "egg-debug.h"
 
 #include "mcm-image.h"
+#include "mcm-transform-cache.h"
 
 static void     mcm_image_finalize	(GObject     *object);
 
@@ -64,79 +69,63 @@ enum {
 
 G_DEFINE_TYPE (McmImage, mcm_image, GTK_TYPE_IMAGE)
 
+/* a profile decoded from a pixbuf option or a property */
+typedef struct {
+	guchar				*data;
+	gsize				 size;
+	gchar				*id;
+} McmImageProfile;
+
 /**
- * mcm_image_get_profile_in:
+ * mcm_image_profile_decode:
+ *
+ * Decodes the profile, or uses sRGB if @icc_profile_base64 is %NULL.
+ *
+ * Return value: %FALSE if the profile could not be decoded
  **/
-static cmsHPROFILE
-mcm_image_get_profile_in (McmImage *image, const gchar *icc_profile_base64)
+static gboolean
+mcm_image_profile_decode (McmImageProfile *profile, const gchar *icc_profile_base64)
 {
-	cmsHPROFILE profile = NULL;
-	guchar *icc_profile = NULL;
-	gsize icc_profile_size;
-	McmImagePrivate *priv = image->priv;
+	profile->data = NULL;
+	profile->size = 0;
+	profile->id = NULL;
 
-	/* ignore built-in */
-	if (priv->use_embedded_icc_profile == FALSE) {
-		egg_debug ("ignoring embedded ICC profile, assume sRGB");
-		profile = cmsCreate_sRGBProfile ();
-		goto out;
+	/* use built-in */
+	if (icc_profile_base64 == NULL) {
+		profile->id = g_strdup (MCM_TRANSFORM_CACHE_ID_SRGB);
+		return TRUE;
 	}
 
 	/* decode */
-	icc_profile = g_base64_decode (icc_profile_base64, &icc_profile_size);
-	if (icc_profile == NULL) {
+	profile->data = g_base64_decode (icc_profile_base64, &profile->size);
+	if (profile->data == NULL) {
 		egg_warning ("failed to decode base64");
-		goto out;
+		return FALSE;
 	}
-
-	/* use embedded profile */
-	profile = cmsOpenProfileFromMem (icc_profile, icc_profile_size);
-out:
-	g_free (icc_profile);
-	return profile;
+	profile->id = mcm_transform_cache_get_data_id (profile->data, profile->size);
+	return TRUE;
 }
 
 /**
- * mcm_image_get_profile_out:
+ * mcm_image_profile_open_cb:
  **/
-static cmsHPROFILE
-mcm_image_get_profile_out (McmImage *image)
+static gpointer
+mcm_image_profile_open_cb (McmImageProfile *profile, gboolean *borrowed)
 {
-	cmsHPROFILE profile = NULL;
-	guchar *icc_profile = NULL;
-	gsize icc_profile_size;
-	McmImagePrivate *priv = image->priv;
-
-	/* not set */
-	if (priv->output_icc_profile == NULL) {
-		egg_debug ("no output ICC profile, assume sRGB");
-		profile = cmsCreate_sRGBProfile ();
-		goto out;
-	}
-
-	/* decode */
-	icc_profile = g_base64_decode (priv->output_icc_profile, &icc_profile_size);
-	if (icc_profile == NULL) {
-		egg_warning ("failed to decode base64");
-		goto out;
-	}
-
-	/* use embedded profile */
-	profile = cmsOpenProfileFromMem (icc_profile, icc_profile_size);
-out:
-	g_free (icc_profile);
-	return profile;
+	if (profile->data == NULL)
+		return mcm_transform_cache_open_builtin ((gpointer) MCM_TRANSFORM_CACHE_ID_SRGB, borrowed);
+	return cmsOpenProfileFromMem (profile->data, profile->size);
 }
 
 /**
  * mcm_image_get_format:
  **/
-static DWORD
+static guint32
 mcm_image_get_format (McmImage *image)
 {
 	guint bits;
 	guint has_alpha;
-	DWORD format = 0;
+	guint32 format = 0;
 	McmImagePrivate *priv = image->priv;
 
 	/* get data */
@@ -177,13 +166,13 @@ mcm_image_cms_convert_pixbuf (McmImage *image)
 {
 	const gchar *icc_profile_base64;
 	gint i;
-	DWORD format;
+	guint32 format;
 	gint width, height, rowstride;
 	guchar *p_in;
 	guchar *p_out;
-	cmsHPROFILE profile_in;
-	cmsHPROFILE profile_out;
-	cmsHTRANSFORM transform;
+	McmImageProfile profile_in = { NULL, 0, NULL };
+	McmImageProfile profile_out = { NULL, 0, NULL };
+	McmTransform *transform = NULL;
 	GdkPixbuf *pixbuf_cms;
 	McmImagePrivate *priv = image->priv;
 
@@ -219,12 +208,22 @@ mcm_image_cms_convert_pixbuf (McmImage *image)
 		goto out;
 	}
 
-	/* get profiles */
-	profile_in = mcm_image_get_profile_in (image, icc_profile_base64);
-	profile_out = mcm_image_get_profile_out (image);
+	/* get profiles, ignoring built-in if required */
+	if (priv->use_embedded_icc_profile == FALSE)
+		egg_debug ("ignoring embedded ICC profile, assume sRGB");
+	if (!mcm_image_profile_decode (&profile_in, priv->use_embedded_icc_profile ? icc_profile_base64 : NULL))
+		goto out;
+	if (priv->output_icc_profile == NULL)
+		egg_debug ("no output ICC profile, assume sRGB");
+	if (!mcm_image_profile_decode (&profile_out, priv->output_icc_profile))
+		goto out;
 
-	/* create transform */
-	transform = cmsCreateTransform (profile_in, format, profile_out, format, INTENT_PERCEPTUAL, 0);
+	/* get transform, which is normally already cached */
+	transform = mcm_transform_cache_get (profile_in.id, (McmTransformCacheOpenFunc) mcm_image_profile_open_cb, &profile_in,
+					     profile_out.id, (McmTransformCacheOpenFunc) mcm_image_profile_open_cb, &profile_out,
+					     format, format, INTENT_PERCEPTUAL, 0);
+	if (transform == NULL)
+		goto out;
 
 	/* process each row */
 	height = gdk_pixbuf_get_height (priv->original_pixbuf);
@@ -233,21 +232,21 @@ mcm_image_cms_convert_pixbuf (McmImage *image)
 	p_in = gdk_pixbuf_get_pixels (priv->original_pixbuf);
 	p_out = gdk_pixbuf_get_pixels (pixbuf_cms);
 	for (i=0; i<height; ++i) {
-		cmsDoTransform (transform, p_in, p_out, width);
+		mcm_transform_do_transform (transform, p_in, p_out, width);
 		p_in += rowstride;
 		p_out += rowstride;
 	}
 
-	/* destroy lcms state */
-	cmsDeleteTransform (transform);
-	cmsCloseProfile (profile_in);
-	cmsCloseProfile (profile_out);
-
 	/* refresh widget */
 	gtk_widget_set_visible (GTK_WIDGET(image), FALSE);
 	gtk_widget_set_visible (GTK_WIDGET(image), TRUE);
 out:
-	return;
+	if (transform != NULL)
+		mcm_transform_unref (transform);
+	g_free (profile_in.data);
+	g_free (profile_in.id);
+	g_free (profile_out.data);
+	g_free (profile_out.id);
 }
 
 /**
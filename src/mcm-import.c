@@ -109,9 +109,22 @@ main (int argc, char **argv)
 		goto out;
 	}
 
+	/* check the file is a profile before trying to parse it */
+	file = g_file_new_for_path (files[0]);
+	ret = mcm_utils_is_icc_profile (file);
+	if (!ret) {
+		/* TRANSLATORS: could not read file */
+		dialog = gtk_message_dialog_new (NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE, _("Failed to open ICC profile"));
+		gtk_window_set_icon_name (GTK_WINDOW (dialog), MCM_STOCK_ICON);
+		/* TRANSLATORS: the file does not have an ICC profile header */
+		gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (dialog), "%s", _("The file is not an ICC profile."));
+		gtk_dialog_run (GTK_DIALOG (dialog));
+		gtk_widget_destroy (dialog);
+		goto out;
+	}
+
 	/* load profile */
 	profile = mcm_profile_default_new ();
-	file = g_file_new_for_path (files[0]);
 	ret = mcm_profile_parse (profile, file, &error);
 	if (!ret) {
 		/* TRANSLATORS: could not read file */
@@ -73,8 +73,7 @@ static gboolean
 mcm_inspect_show_x11_atoms (void)
 {
 	gboolean ret;
-	guint8 *data = NULL;
-	guint8 *data_tmp;
+	const guint8 *data;
 	gsize length;
 	McmXserver *xserver = NULL;
 	MateRROutput **outputs;
@@ -129,7 +128,7 @@ mcm_inspect_show_x11_atoms (void)
 		title = g_strdup_printf (_("Output profile '%s':"), output_name);
 
 		/* get profile from XServer */
-		ret = mcm_xserver_get_output_profile_data (xserver, output_name, &data_tmp, &length, &error);
+		ret = mcm_xserver_get_output_profile_data (xserver, output_name, &data, &length, &error);
 		if (!ret) {
 			egg_warning ("failed to get output profile data: %s", error->message);
 			/* TRANSLATORS: this is when the profile has not been set */
@@ -139,13 +138,11 @@ mcm_inspect_show_x11_atoms (void)
 			error = NULL;
 		} else {
 			/* TRANSLATORS: the output, i.e. the flat panel */
-			mcm_inspect_print_data_info (title, data_tmp, length);
-			g_free (data_tmp);
+			mcm_inspect_print_data_info (title, data, length);
 		}
 		g_free (title);
 	}
 out:
-	g_free (data);
 	if (screen != NULL)
 		g_object_unref (screen);
 	if (xserver != NULL)
@@ -22,6 +22,9 @@
 #include "config.h"
 
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 #include <glib-object.h>
 #include <glib/gi18n.h>
@@ -93,6 +96,45 @@ egg_strtouint (const gchar *text, guint *value)
 	return TRUE;
 }
 
+/**
+ * mcm_install_system_wide_is_icc_profile:
+ *
+ * Checks the ICC header rather than trusting the shared-mime-info database.
+ **/
+static gboolean
+mcm_install_system_wide_is_icc_profile (const gchar *filename)
+{
+	gint fd;
+	guint32 size;
+	struct stat buf;
+	guint8 header[128];
+	gboolean ret = FALSE;
+
+	/* don't follow symlinks or block on a fifo */
+	fd = open (filename, O_RDONLY | O_NOFOLLOW | O_NONBLOCK);
+	if (fd < 0)
+		goto out;
+	if (fstat (fd, &buf) < 0 || !S_ISREG (buf.st_mode))
+		goto out;
+	if (pread (fd, header, sizeof (header), 0) != sizeof (header))
+		goto out;
+
+	/* 'acsp' file signature */
+	if (memcmp (&header[36], "acsp", 4) != 0)
+		goto out;
+
+	/* the declared size has to fit in the file */
+	memcpy (&size, header, sizeof (size));
+	size = GUINT32_FROM_BE (size);
+	if (size < sizeof (header) || size > (guint64) buf.st_size)
+		goto out;
+	ret = TRUE;
+out:
+	if (fd >= 0)
+		close (fd);
+	return ret;
+}
+
 /**
  * main:
  **/
@@ -110,7 +152,6 @@ main (gint argc, gchar *argv[])
 	GFile *file = NULL;
 	GFile *file_dest = NULL;
 	GFileInfo *info = NULL;
-	const gchar *type;
 	const gchar *pkexec_uid_str;
 	guint pkexec_uid;
 	guint file_uid;
@@ -187,27 +228,27 @@ main (gint argc, gchar *argv[])
 		goto out;
 	}
 
-	/* get content type for file */
+	/* check is correct type */
+	ret = mcm_install_system_wide_is_icc_profile (filenames[0]);
+	if (!ret) {
+		/* TRANSLATORS: the file does not have an ICC profile header */
+		g_print ("%s\n", _("The file is not an ICC profile."));
+		retval = MCM_INSTALL_SYSTEM_WIDE_EXIT_CODE_CONTENT_TYPE_INVALID;
+		goto out;
+	}
+
+	/* get owner of the file */
 	file = g_file_new_for_path (filenames[0]);
-	info = g_file_query_info (file, "standard::content-type,unix::uid",
+	info = g_file_query_info (file, G_FILE_ATTRIBUTE_UNIX_UID,
 				  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, &error);
 	if (info == NULL) {
 		/* TRANSLATORS: error details */
-		g_print ("%s %s\n", _("Failed to get content type:"), error->message);
+		g_print ("%s %s\n", _("Failed to get file owner:"), error->message);
 		g_error_free (error);
 		retval = MCM_INSTALL_SYSTEM_WIDE_EXIT_CODE_CONTENT_TYPE_INVALID;
 		goto out;
 	}
 
-	/* check is correct type */
-	type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
-	if (g_strcmp0 (type, "application/vnd.iccprofile") != 0) {
-		/* TRANSLATORS: the content type is the detected type of file */
-		g_print ("%s %s\n", _("Content type was incorrect:"), type);
-		retval = MCM_INSTALL_SYSTEM_WIDE_EXIT_CODE_CONTENT_TYPE_INVALID;
-		goto out;
-	}
-
 	/* only copy files that are really owned by the calling user */
 	pkexec_uid_str = g_getenv ("PKEXEC_UID");
 	if (pkexec_uid_str == NULL) {
@@ -0,0 +1,100 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "egg-debug.h"
+
+#include "mcm-output-index.h"
+
+#define MCM_OUTPUT_INDEX_BENCHMARK_QUERIES	(4 * 1024 * 1024)
+#define MCM_OUTPUT_INDEX_BENCHMARK_WINDOWS	1024
+
+/**
+ * mcm_output_index_benchmark_outputs:
+ **/
+static void
+mcm_output_index_benchmark_outputs (guint n_outputs)
+{
+	guint i;
+	guint hits = 0;
+	gint *windows;
+	gdouble elapsed;
+	GRand *rand;
+	GTimer *timer;
+	McmOutputIndex *output_index;
+
+	/* a row of 1920x1200 monitors */
+	output_index = mcm_output_index_new ();
+	for (i=0; i<n_outputs; i++)
+		mcm_output_index_add (output_index, i * 1920, 0, 1920, 1200, GUINT_TO_POINTER (i + 1));
+
+	/* windows anywhere on the desktop, some spanning two outputs */
+	rand = g_rand_new_with_seed (1);
+	windows = g_new (gint, MCM_OUTPUT_INDEX_BENCHMARK_WINDOWS * 4);
+	for (i=0; i<MCM_OUTPUT_INDEX_BENCHMARK_WINDOWS; i++) {
+		windows[i*4+0] = g_rand_int_range (rand, 0, n_outputs * 1920);
+		windows[i*4+1] = g_rand_int_range (rand, 0, 1200);
+		windows[i*4+2] = g_rand_int_range (rand, 100, 1600);
+		windows[i*4+3] = g_rand_int_range (rand, 100, 1000);
+	}
+
+	timer = g_timer_new ();
+	for (i=0; i<MCM_OUTPUT_INDEX_BENCHMARK_QUERIES; i++) {
+		const gint *w = &windows[(i % MCM_OUTPUT_INDEX_BENCHMARK_WINDOWS) * 4];
+		if (mcm_output_index_lookup (output_index, w[0], w[1], w[2], w[3]) != NULL)
+			hits++;
+	}
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	g_print ("%2i outputs: %7.2fns per query, %.1fM queries/s, %i%% on an output\n",
+		 n_outputs,
+		 elapsed * 1e9 / MCM_OUTPUT_INDEX_BENCHMARK_QUERIES,
+		 MCM_OUTPUT_INDEX_BENCHMARK_QUERIES / elapsed / 1e6,
+		 (gint) (100.0 * hits / MCM_OUTPUT_INDEX_BENCHMARK_QUERIES));
+
+	g_timer_destroy (timer);
+	g_rand_free (rand);
+	g_free (windows);
+	mcm_output_index_free (output_index);
+}
+
+/**
+ * main:
+ *
+ * Prints the cost of a query for 1 to 8 outputs. No reference figures are
+ * kept, as they depend on the machine, so run it before and after a change.
+ **/
+int
+main (int argc, char **argv)
+{
+	guint i;
+	const guint outputs[] = { 1, 2, 4, 8 };
+
+	egg_debug_init (&argc, &argv);
+
+	for (i=0; i<G_N_ELEMENTS (outputs); i++)
+		mcm_output_index_benchmark_outputs (outputs[i]);
+	return 0;
+}
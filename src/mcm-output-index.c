@@ -0,0 +1,209 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/**
+ * SECTION:mcm-output-index
+ * @short_description: Finds the output that shows most of a window
+ *
+ * The rectangle of every connected output is kept here together with the
+ * device that drives it, so working out which display a window is on does
+ * not need to ask XRandR or parse any EDIDs. There are only ever a few
+ * outputs, so a flat array is searched, and lookups do not allocate.
+ *
+ * The owner has to clear and refill the index when the outputs change.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "mcm-output-index.h"
+
+typedef struct {
+	gint			 x;
+	gint			 y;
+	gint			 width;
+	gint			 height;
+	gpointer		 data;
+} McmOutputIndexRect;
+
+struct _McmOutputIndex {
+	GArray			*rects;
+};
+
+/**
+ * mcm_output_index_get_covered:
+ *
+ * Return value: the fraction of the window that is shown on the output
+ **/
+static gfloat
+mcm_output_index_get_covered (const McmOutputIndexRect *rect,
+			      gint window_x, gint window_y, gint window_width, gint window_height)
+{
+	gint overlap_x;
+	gint overlap_y;
+
+	/* to the right of the window */
+	if (window_x > rect->x + rect->width)
+		return 0.0f;
+	if (window_y > rect->y + rect->height)
+		return 0.0f;
+
+	/* to the left of the window */
+	if (window_x + window_width < rect->x)
+		return 0.0f;
+	if (window_y + window_height < rect->y)
+		return 0.0f;
+
+	/* get the overlaps */
+	overlap_x = MIN((window_x + window_width - rect->x), rect->width) - MAX(window_x - rect->x, 0);
+	overlap_y = MIN((window_y + window_height - rect->y), rect->height) - MAX(window_y - rect->y, 0);
+
+	/* not in this window */
+	if (overlap_x <= 0 || overlap_y <= 0)
+		return 0.0f;
+
+	/* get the coverage */
+	return (gfloat) (overlap_x * overlap_y) / (gfloat) (window_width * window_height);
+}
+
+/**
+ * mcm_output_index_lookup:
+ * @output_index: a #McmOutputIndex
+ * @x: the window position, in root co-ordinates
+ * @y: the window position, in root co-ordinates
+ * @width: the window width
+ * @height: the window height
+ *
+ * Finds the output that covers most of the window.
+ *
+ * Return value: the data added with the output, or %NULL if the window is not on any output
+ **/
+gpointer
+mcm_output_index_lookup (McmOutputIndex *output_index, gint x, gint y, gint width, gint height)
+{
+	guint i;
+	gfloat covered;
+	gfloat covered_max = 0.0f;
+	gpointer data = NULL;
+	const McmOutputIndexRect *rect;
+
+	g_return_val_if_fail (output_index != NULL, NULL);
+
+	/* nothing to cover */
+	if (width <= 0 || height <= 0)
+		goto out;
+
+	for (i=0; i<output_index->rects->len; i++) {
+		rect = &g_array_index (output_index->rects, McmOutputIndexRect, i);
+		covered = mcm_output_index_get_covered (rect, x, y, width, height);
+
+		/* keep a running total of which one is best */
+		if (covered > 0.01f && covered > covered_max) {
+			data = rect->data;
+
+			/* all in one output, no need to search the others */
+			if (covered > 0.99f)
+				goto out;
+			covered_max = covered;
+		}
+	}
+out:
+	return data;
+}
+
+/**
+ * mcm_output_index_add:
+ * @output_index: a #McmOutputIndex
+ * @x: the output position, in root co-ordinates
+ * @y: the output position, in root co-ordinates
+ * @width: the width of the current mode
+ * @height: the height of the current mode
+ * @data: what to return from mcm_output_index_lookup(), which is not referenced
+ *
+ * Adds a connected output to the index.
+ **/
+void
+mcm_output_index_add (McmOutputIndex *output_index, gint x, gint y, gint width, gint height, gpointer data)
+{
+	McmOutputIndexRect rect;
+
+	g_return_if_fail (output_index != NULL);
+
+	rect.x = x;
+	rect.y = y;
+	rect.width = width;
+	rect.height = height;
+	rect.data = data;
+	g_array_append_val (output_index->rects, rect);
+}
+
+/**
+ * mcm_output_index_get_size:
+ *
+ * Return value: the number of outputs in the index
+ **/
+guint
+mcm_output_index_get_size (McmOutputIndex *output_index)
+{
+	g_return_val_if_fail (output_index != NULL, 0);
+	return output_index->rects->len;
+}
+
+/**
+ * mcm_output_index_clear:
+ * @output_index: a #McmOutputIndex
+ *
+ * Removes all the outputs from the index.
+ **/
+void
+mcm_output_index_clear (McmOutputIndex *output_index)
+{
+	g_return_if_fail (output_index != NULL);
+	g_array_set_size (output_index->rects, 0);
+}
+
+/**
+ * mcm_output_index_free:
+ **/
+void
+mcm_output_index_free (McmOutputIndex *output_index)
+{
+	if (output_index == NULL)
+		return;
+	g_array_free (output_index->rects, TRUE);
+	g_free (output_index);
+}
+
+/**
+ * mcm_output_index_new:
+ *
+ * Return value: a new, empty, #McmOutputIndex
+ **/
+McmOutputIndex *
+mcm_output_index_new (void)
+{
+	McmOutputIndex *output_index;
+	output_index = g_new0 (McmOutputIndex, 1);
+	output_index->rects = g_array_sized_new (FALSE, FALSE, sizeof (McmOutputIndexRect), 4);
+	return output_index;
+}
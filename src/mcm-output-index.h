@@ -0,0 +1,50 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __MCM_OUTPUT_INDEX_H
+#define __MCM_OUTPUT_INDEX_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _McmOutputIndex	McmOutputIndex;
+
+McmOutputIndex	*mcm_output_index_new			(void);
+void		 mcm_output_index_free			(McmOutputIndex		*output_index);
+void		 mcm_output_index_clear			(McmOutputIndex		*output_index);
+void		 mcm_output_index_add			(McmOutputIndex		*output_index,
+							 gint			 x,
+							 gint			 y,
+							 gint			 width,
+							 gint			 height,
+							 gpointer		 data);
+gpointer	 mcm_output_index_lookup		(McmOutputIndex		*output_index,
+							 gint			 x,
+							 gint			 y,
+							 gint			 width,
+							 gint			 height);
+guint		 mcm_output_index_get_size		(McmOutputIndex		*output_index);
+
+G_END_DECLS
+
+#endif /* __MCM_OUTPUT_INDEX_H */
@@ -0,0 +1,128 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/**
+ * SECTION:mcm-output-state
+ * @short_description: What was last seen of an output
+ *
+ * A RandR event does not say which outputs changed, so what we saw of each
+ * output is kept here and compared with what is seen now. Only the outputs
+ * that were actually replugged or moved then have to be touched. Nothing
+ * here talks to the X server.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <string.h>
+
+#include "mcm-output-state.h"
+
+/**
+ * mcm_output_state_new:
+ *
+ * @connected: if anything is plugged into the output
+ * @edid: the first %MCM_OUTPUT_STATE_EDID_SIZE bytes of the EDID, or %NULL
+ * @crtc_id: the crtc driving the output, or 0
+ * @x: the position of the output
+ * @y: the position of the output
+ *
+ * Return value: a new #McmOutputState, free with mcm_output_state_free()
+ **/
+McmOutputState *
+mcm_output_state_new (gboolean connected, const guint8 *edid, guint32 crtc_id, gint x, gint y)
+{
+	McmOutputState *state;
+
+	state = g_new0 (McmOutputState, 1);
+	state->connected = connected;
+	if (!connected)
+		goto out;
+
+	/* the base block is small enough to just keep */
+	if (edid != NULL) {
+		memcpy (state->edid, edid, MCM_OUTPUT_STATE_EDID_SIZE);
+		state->has_edid = TRUE;
+	}
+	state->crtc_id = crtc_id;
+	state->x = x;
+	state->y = y;
+out:
+	return state;
+}
+
+/**
+ * mcm_output_state_free:
+ **/
+void
+mcm_output_state_free (McmOutputState *state)
+{
+	g_free (state);
+}
+
+/**
+ * mcm_output_state_same_monitor:
+ **/
+static gboolean
+mcm_output_state_same_monitor (const McmOutputState *state_old, const McmOutputState *state)
+{
+	if (state_old->has_edid != state->has_edid)
+		return FALSE;
+	if (!state->has_edid)
+		return TRUE;
+	return memcmp (state_old->edid, state->edid, MCM_OUTPUT_STATE_EDID_SIZE) == 0;
+}
+
+/**
+ * mcm_output_state_compare:
+ *
+ * @state_old: what was seen last time, or %NULL if the output is new
+ * @state: what is seen now
+ *
+ * Return value: %MCM_OUTPUT_STATE_CHANGE_REPLUGGED if a different monitor
+ * is now connected, so its EDID has to be parsed again, or
+ * %MCM_OUTPUT_STATE_CHANGE_MOVED if only the crtc or position changed
+ **/
+McmOutputStateChange
+mcm_output_state_compare (const McmOutputState *state_old, const McmOutputState *state)
+{
+	g_return_val_if_fail (state != NULL, MCM_OUTPUT_STATE_CHANGE_NONE);
+
+	/* unplugged, or still unplugged */
+	if (!state->connected) {
+		if (state_old != NULL && !state_old->connected)
+			return MCM_OUTPUT_STATE_CHANGE_NONE;
+		return MCM_OUTPUT_STATE_CHANGE_DISCONNECTED;
+	}
+
+	/* plugged in, or a different monitor */
+	if (state_old == NULL || !state_old->connected ||
+	    !mcm_output_state_same_monitor (state_old, state))
+		return MCM_OUTPUT_STATE_CHANGE_REPLUGGED;
+
+	/* the same monitor somewhere else */
+	if (state_old->crtc_id != state->crtc_id ||
+	    state_old->x != state->x ||
+	    state_old->y != state->y)
+		return MCM_OUTPUT_STATE_CHANGE_MOVED;
+	return MCM_OUTPUT_STATE_CHANGE_NONE;
+}
@@ -0,0 +1,58 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __MCM_OUTPUT_STATE_H
+#define __MCM_OUTPUT_STATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define MCM_OUTPUT_STATE_EDID_SIZE	128
+
+typedef struct {
+	gboolean		 connected;
+	guint32			 crtc_id;
+	gint			 x;
+	gint			 y;
+	gboolean		 has_edid;
+	guint8			 edid[MCM_OUTPUT_STATE_EDID_SIZE];
+} McmOutputState;
+
+typedef enum {
+	MCM_OUTPUT_STATE_CHANGE_NONE,
+	MCM_OUTPUT_STATE_CHANGE_DISCONNECTED,
+	MCM_OUTPUT_STATE_CHANGE_REPLUGGED,
+	MCM_OUTPUT_STATE_CHANGE_MOVED
+} McmOutputStateChange;
+
+McmOutputState		*mcm_output_state_new		(gboolean		 connected,
+							 const guint8		*edid,
+							 guint32		 crtc_id,
+							 gint			 x,
+							 gint			 y);
+void			 mcm_output_state_free		(McmOutputState		*state);
+McmOutputStateChange	 mcm_output_state_compare	(const McmOutputState	*state_old,
+							 const McmOutputState	*state);
+
+G_END_DECLS
+
+#endif /* __MCM_OUTPUT_STATE_H */
@@ -29,13 +29,18 @@
 #include <locale.h>
 #include <gtk/gtk.h>
 #include <unique/unique.h>
-#include <lcms.h>
+#ifdef MCM_USE_LCMS2
+ #include <lcms2.h>
+#else
+ #include <lcms.h>
+#endif
 
 #include "egg-debug.h"
 
 #include "mcm-calibrate-argyll.h"
 #include "mcm-colorimeter.h"
 #include "mcm-profile-store.h"
+#include "mcm-transform-cache.h"
 #include "mcm-utils.h"
 #include "mcm-xyz.h"
 
@@ -104,6 +109,15 @@ mcm_picker_measure_cb (GtkWidget *widget, gpointer data)
 	}
 }
 
+/**
+ * mcm_picker_open_profile_cb:
+ **/
+static gpointer
+mcm_picker_open_profile_cb (const gchar *filename, gboolean *borrowed)
+{
+	return cmsOpenProfileFromFile (filename, "r");
+}
+
 /**
  * mcm_picker_refresh_results:
  **/
@@ -122,12 +136,10 @@ mcm_picker_refresh_results (void)
 	gchar *text_lab = NULL;
 	gchar *text_rgb = NULL;
 	gchar *text_error = NULL;
-	cmsHPROFILE profile_xyz;
-	cmsHPROFILE profile_rgb;
-	cmsHPROFILE profile_lab;
-	cmsHTRANSFORM transform_rgb;
-	cmsHTRANSFORM transform_lab;
-	cmsHTRANSFORM transform_error;
+	gchar *profile_id = NULL;
+	McmTransform *transform_rgb = NULL;
+	McmTransform *transform_lab = NULL;
+	McmTransform *transform_error = NULL;
 
 	/* nothing set yet */
 	if (profile_filename == NULL)
@@ -151,33 +163,27 @@ mcm_picker_refresh_results (void)
 	color_xyz[1] /= 100.0f;
 	color_xyz[2] /= 100.0f;
 
-	/* get profiles */
-	profile_xyz = cmsCreateXYZProfile ();
-	profile_rgb = cmsOpenProfileFromFile (profile_filename, "r");
-	profile_lab = cmsCreateLabProfile (cmsD50_xyY ());
-
-	/* create transforms */
-	transform_rgb = cmsCreateTransform (profile_xyz, TYPE_XYZ_DBL, profile_rgb, TYPE_RGB_8, INTENT_PERCEPTUAL, 0);
+	/* get transforms, which are only created for the first measurement */
+	profile_id = mcm_transform_cache_get_file_id (profile_filename);
+	transform_rgb = mcm_transform_cache_get (MCM_TRANSFORM_CACHE_ID_XYZ, mcm_transform_cache_open_builtin, (gpointer) MCM_TRANSFORM_CACHE_ID_XYZ,
+						 profile_id, (McmTransformCacheOpenFunc) mcm_picker_open_profile_cb, (gpointer) profile_filename,
+						 TYPE_XYZ_DBL, TYPE_RGB_8, INTENT_PERCEPTUAL, 0);
 	if (transform_rgb == NULL)
 		goto out;
-	transform_lab = cmsCreateTransform (profile_xyz, TYPE_XYZ_DBL, profile_lab, TYPE_Lab_DBL, INTENT_PERCEPTUAL, 0);
+	transform_lab = mcm_transform_cache_get (MCM_TRANSFORM_CACHE_ID_XYZ, mcm_transform_cache_open_builtin, (gpointer) MCM_TRANSFORM_CACHE_ID_XYZ,
+						 MCM_TRANSFORM_CACHE_ID_LAB, mcm_transform_cache_open_builtin, (gpointer) MCM_TRANSFORM_CACHE_ID_LAB,
+						 TYPE_XYZ_DBL, TYPE_Lab_DBL, INTENT_PERCEPTUAL, 0);
 	if (transform_lab == NULL)
 		goto out;
-	transform_error = cmsCreateTransform (profile_rgb, TYPE_RGB_8, profile_xyz, TYPE_XYZ_DBL, INTENT_PERCEPTUAL, 0);
+	transform_error = mcm_transform_cache_get (profile_id, (McmTransformCacheOpenFunc) mcm_picker_open_profile_cb, (gpointer) profile_filename,
+						   MCM_TRANSFORM_CACHE_ID_XYZ, mcm_transform_cache_open_builtin, (gpointer) MCM_TRANSFORM_CACHE_ID_XYZ,
+						   TYPE_RGB_8, TYPE_XYZ_DBL, INTENT_PERCEPTUAL, 0);
 	if (transform_error == NULL)
 		goto out;
 
-	cmsDoTransform (transform_rgb, color_xyz, color_rgb, 1);
-	cmsDoTransform (transform_lab, color_xyz, color_lab, 1);
-	cmsDoTransform (transform_error, color_rgb, color_error, 1);
-
-	/* destroy lcms state */
-	cmsDeleteTransform (transform_rgb);
-	cmsDeleteTransform (transform_lab);
-	cmsDeleteTransform (transform_error);
-	cmsCloseProfile (profile_xyz);
-	cmsCloseProfile (profile_rgb);
-	cmsCloseProfile (profile_lab);
+	mcm_transform_do_transform (transform_rgb, color_xyz, color_rgb, 1);
+	mcm_transform_do_transform (transform_lab, color_xyz, color_lab, 1);
+	mcm_transform_do_transform (transform_error, color_rgb, color_error, 1);
 
 	/* set XYZ */
 	label = GTK_LABEL (gtk_builder_get_object (builder, "label_xyz"));
@@ -209,6 +215,13 @@ mcm_picker_refresh_results (void)
 	image = GTK_IMAGE (gtk_builder_get_object (builder, "image_preview"));
 	gtk_image_set_from_pixbuf (image, pixbuf);
 out:
+	if (transform_rgb != NULL)
+		mcm_transform_unref (transform_rgb);
+	if (transform_lab != NULL)
+		mcm_transform_unref (transform_lab);
+	if (transform_error != NULL)
+		mcm_transform_unref (transform_error);
+	g_free (profile_id);
 	g_free (text_xyz);
 	g_free (text_lab);
 	g_free (text_rgb);
@@ -342,6 +355,16 @@ mcm_window_set_parent_xid (GtkWindow *window, guint32 xid)
 	gdk_window_set_transient_for (our_window, parent_window);
 }
 
+#ifdef MCM_USE_LCMS2
+/*
+ * mcm_picker_lcms_error_cb:
+ */
+static void
+mcm_picker_lcms_error_cb (cmsContext context_id, cmsUInt32Number error_code, const char *error_text)
+{
+	egg_warning ("LCMS error %u: %s", error_code, error_text);
+}
+#else
 /*
  * mcm_picker_lcms_error_cb:
  */
@@ -351,6 +374,7 @@ mcm_picker_lcms_error_cb (gint error_code, const gchar *error_text)
 	egg_warning ("LCMS error %i: %s", error_code, error_text);
 	return LCMS_ERRC_WARNING;
 }
+#endif
 
 
 /**
@@ -496,6 +520,7 @@ main (int argc, char *argv[])
 {
 	GOptionContext *context;
 	guint retval = 0;
+	gboolean ret;
 	GError *error = NULL;
 	GMainLoop *loop;
 	GtkWidget *main_window;
@@ -518,12 +543,18 @@ main (int argc, char *argv[])
 	textdomain (GETTEXT_PACKAGE);
 
 	/* setup type system */
+	if (! g_thread_supported ())
+		g_thread_init (NULL);
 	g_type_init ();
 
 	/* setup LCMS */
+#ifdef MCM_USE_LCMS2
+	cmsSetLogErrorHandler (mcm_picker_lcms_error_cb);
+#else
 	cmsSetErrorHandler (mcm_picker_lcms_error_cb);
 	cmsErrorAction (LCMS_ERROR_SHOW);
 	cmsSetLanguage ("en", "US");
+#endif
 
 	context = g_option_context_new (NULL);
 	/* TRANSLATORS: tool that is used to pick colors */
@@ -612,8 +643,14 @@ main (int argc, char *argv[])
 	/* disable some ui if no hardware */
 	mcm_picker_colorimeter_setup_ui (colorimeter);
 
-	/* maintain a list of profiles */
+	/* maintain a list of profiles, using the ones mcm-session has found if we can */
 	profile_store = mcm_profile_store_new ();
+	ret = mcm_profile_store_attach_session (profile_store, NULL, &error);
+	if (!ret) {
+		egg_debug ("failed to get profiles from session: %s", error->message);
+		g_clear_error (&error);
+		mcm_profile_store_search_default (profile_store);
+	}
 
 	/* default to AdobeRGB */
 	profile_filename = "/usr/share/color/icc/Argyll/ClayRGB1998.icm";
@@ -62,6 +62,7 @@ static GtkWidget *info_bar_profiles = NULL;
 static GtkWidget *cie_widget = NULL;
 static GtkWidget *trc_widget = NULL;
 static GSettings *settings = NULL;
+static guint slider_apply_id = 0;
 
 enum {
 	MCM_DEVICES_COLUMN_ID,
@@ -101,9 +102,11 @@ typedef enum {
 } McmPrefsEntryType;
 
 static void mcm_prefs_devices_treeview_clicked_cb (GtkTreeSelection *selection, gpointer userdata);
+static gboolean mcm_prefs_slider_apply_cb (gpointer user_data);
 
 #define MCM_PREFS_TREEVIEW_MAIN_WIDTH		350 /* px */
 #define MCM_PREFS_TREEVIEW_PROFILES_WIDTH	450 /* px */
+#define MCM_PREFS_SLIDER_FRAME_BUDGET		40 /* ms */
 
 /**
  * mcm_prefs_error_dialog:
@@ -1697,6 +1700,11 @@ mcm_prefs_devices_treeview_clicked_cb (GtkTreeSelection *selection, gpointer use
 	/* we have a new device */
 	egg_debug ("selected device is: %s", id);
 	if (current_device != NULL) {
+		/* the pending slider change is for the old device */
+		if (slider_apply_id != 0) {
+			g_source_remove (slider_apply_id);
+			mcm_prefs_slider_apply_cb (NULL);
+		}
 		g_object_unref (current_device);
 		current_device = NULL;
 	}
@@ -2405,10 +2413,12 @@ out:
 }
 
 /**
- * mcm_prefs_slider_changed_cb:
+ * mcm_prefs_slider_apply_cb:
+ *
+ * Saves and applies the latest slider values, at most once per frame.
  **/
-static void
-mcm_prefs_slider_changed_cb (GtkRange *range, gpointer *user_data)
+static gboolean
+mcm_prefs_slider_apply_cb (gpointer user_data)
 {
 	gfloat localgamma;
 	gfloat brightness;
@@ -2417,9 +2427,11 @@ mcm_prefs_slider_changed_cb (GtkRange *range, gpointer *user_data)
 	gboolean ret;
 	GError *error = NULL;
 
-	/* we're just setting up the device, not moving the slider */
-	if (setting_up_device)
-		return;
+	slider_apply_id = 0;
+
+	/* the device went away while we were waiting */
+	if (current_device == NULL)
+		goto out;
 
 	/* get values */
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "hscale_gamma"));
@@ -2449,7 +2461,26 @@ mcm_prefs_slider_changed_cb (GtkRange *range, gpointer *user_data)
 		goto out;
 	}
 out:
-	return;
+	return FALSE;
+}
+
+/**
+ * mcm_prefs_slider_changed_cb:
+ *
+ * Dragging a slider emits far more changes than the X server can apply,
+ * so only the last value in each frame is saved and applied.
+ **/
+static void
+mcm_prefs_slider_changed_cb (GtkRange *range, gpointer *user_data)
+{
+	/* we're just setting up the device, not moving the slider */
+	if (setting_up_device)
+		return;
+
+	/* already scheduled, which will pick up this value */
+	if (slider_apply_id != 0)
+		return;
+	slider_apply_id = g_timeout_add (MCM_PREFS_SLIDER_FRAME_BUDGET, mcm_prefs_slider_apply_cb, NULL);
 }
 
 /**
@@ -2843,38 +2874,111 @@ mcm_prefs_setup_rendering_combobox (GtkWidget *widget, const gchar *intent)
 }
 
 /**
- * mcm_prefs_startup_phase1_idle_cb:
+ * mcm_prefs_refresh_space_combobox:
  **/
-static gboolean
-mcm_prefs_startup_phase1_idle_cb (gpointer user_data)
+static void
+mcm_prefs_refresh_space_combobox (const gchar *name, McmColorspace colorspace, const gchar *key)
 {
 	GtkWidget *widget;
-	gboolean ret;
-	GError *error = NULL;
-	gchar *colorspace_rgb;
-	gchar *colorspace_cmyk;
-	gchar *intent_display;
-	gchar *intent_softproof;
+	GtkTreeModel *model;
+	gchar *profile_filename;
 
-	/* search the disk for profiles */
-	mcm_profile_store_search_default (profile_store);
+	widget = GTK_WIDGET (gtk_builder_get_object (builder, name));
+	model = gtk_combo_box_get_model (GTK_COMBO_BOX (widget));
+	if (model == NULL)
+		return;
+
+	/* choosing the saved profile again is not a change */
+	g_signal_handlers_block_matched (widget, G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+					 mcm_prefs_space_combo_changed_cb, NULL);
+	gtk_list_store_clear (GTK_LIST_STORE (model));
+	gtk_widget_set_sensitive (widget, TRUE);
+	profile_filename = g_settings_get_string (settings, key);
+	mcm_prefs_setup_space_combobox (widget, colorspace, profile_filename);
+	g_signal_handlers_unblock_matched (widget, G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
+					   mcm_prefs_space_combo_changed_cb, NULL);
+	g_free (profile_filename);
+}
+
+/**
+ * mcm_prefs_refresh_space_comboboxes:
+ *
+ * Called whenever the profile store changes, as the profiles can arrive
+ * some time after the window is shown.
+ **/
+static void
+mcm_prefs_refresh_space_comboboxes (void)
+{
+	mcm_prefs_refresh_space_combobox ("combobox_space_rgb", MCM_COLORSPACE_RGB, MCM_SETTINGS_COLORSPACE_RGB);
+	mcm_prefs_refresh_space_combobox ("combobox_space_cmyk", MCM_COLORSPACE_CMYK, MCM_SETTINGS_COLORSPACE_CMYK);
+}
+
+/**
+ * mcm_prefs_setup_space_comboboxes:
+ **/
+static void
+mcm_prefs_setup_space_comboboxes (void)
+{
+	GtkWidget *widget;
 
 	/* setup RGB combobox */
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "combobox_space_rgb"));
-	colorspace_rgb = g_settings_get_string (settings, MCM_SETTINGS_COLORSPACE_RGB);
 	mcm_prefs_set_combo_simple_text (widget);
-	mcm_prefs_setup_space_combobox (widget, MCM_COLORSPACE_RGB, colorspace_rgb);
 	g_signal_connect (G_OBJECT (widget), "changed",
 			  G_CALLBACK (mcm_prefs_space_combo_changed_cb), NULL);
 
 	/* setup CMYK combobox */
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "combobox_space_cmyk"));
-	colorspace_cmyk = g_settings_get_string (settings, MCM_SETTINGS_COLORSPACE_CMYK);
 	mcm_prefs_set_combo_simple_text (widget);
-	mcm_prefs_setup_space_combobox (widget, MCM_COLORSPACE_CMYK, colorspace_cmyk);
 	g_signal_connect (G_OBJECT (widget), "changed",
 			  G_CALLBACK (mcm_prefs_space_combo_changed_cb), (gpointer) "cmyk");
 
+	/* fill them with what we have so far */
+	mcm_prefs_refresh_space_comboboxes ();
+}
+
+/**
+ * mcm_prefs_search_default_cb:
+ **/
+static void
+mcm_prefs_search_default_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+
+	/* the profiles that were found are still usable */
+	mcm_profile_store_search_default_finish (profile_store, res, &error);
+	if (error != NULL) {
+		egg_warning ("failed to search for profiles: %s", error->message);
+		g_error_free (error);
+	}
+	mcm_prefs_refresh_space_comboboxes ();
+}
+
+/**
+ * mcm_prefs_startup_phase1_idle_cb:
+ **/
+static gboolean
+mcm_prefs_startup_phase1_idle_cb (gpointer user_data)
+{
+	GtkWidget *widget;
+	gboolean ret;
+	GError *error = NULL;
+	gchar *intent_display;
+	gchar *intent_softproof;
+
+	/* these are refilled as profiles are added */
+	mcm_prefs_setup_space_comboboxes ();
+
+	/* use the profiles mcm-session has already found */
+	ret = mcm_profile_store_attach_session (profile_store, NULL, &error);
+	if (!ret) {
+		egg_debug ("failed to get profiles from session: %s", error->message);
+		g_clear_error (&error);
+
+		/* search the disk for profiles without blocking the UI */
+		mcm_profile_store_search_default_async (profile_store, NULL, mcm_prefs_search_default_cb, NULL);
+	}
+
 	/* setup rendering lists */
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "combobox_rendering_display"));
 	mcm_prefs_set_combo_simple_text (widget);
@@ -2907,8 +3011,6 @@ mcm_prefs_startup_phase1_idle_cb (gpointer user_data)
 out:
 	g_free (intent_display);
 	g_free (intent_softproof);
-	g_free (colorspace_rgb);
-	g_free (colorspace_cmyk);
 	return FALSE;
 }
 
@@ -2979,6 +3081,7 @@ mcm_prefs_profile_store_changed_cb (McmProfileStore *_profile_store, gpointer us
 
 	/* clear and update the profile list */
 	mcm_prefs_update_profile_list ();
+	mcm_prefs_refresh_space_comboboxes ();
 
 	/* re-get all the profiles for this device */
 	widget = GTK_WIDGET (gtk_builder_get_object (builder, "treeview_devices"));
@@ -3143,6 +3246,8 @@ main (int argc, char **argv)
 	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
 	textdomain (GETTEXT_PACKAGE);
 
+	if (! g_thread_supported ())
+		g_thread_init (NULL);
 	gtk_init (&argc, &argv);
 
 	context = g_option_context_new ("mate-color-manager prefs program");
@@ -3503,6 +3608,12 @@ main (int argc, char **argv)
 	/* wait */
 	g_main_loop_run (loop);
 
+	/* don't lose the last slider change */
+	if (slider_apply_id != 0) {
+		g_source_remove (slider_apply_id);
+		mcm_prefs_slider_apply_cb (NULL);
+	}
+
 out:
 	g_object_unref (unique_app);
 	g_main_loop_unref (loop);
@@ -0,0 +1,398 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/**
+ * SECTION:mcm-profile-index
+ * @short_description: An on-disk index of profile metadata
+ *
+ * Every program that shows a list of profiles used to parse every profile
+ * on the system when it started. The metadata of each profile is saved
+ * here, keyed by the path, inode, size and modification time, so a file
+ * that has not changed since the last scan does not have to be opened.
+ *
+ * Profiles created from the index are lightweight, so the colorimetry
+ * and curves are read from the file only if they are asked for.
+ *
+ * Lookups are done in the thread that walks the directories, so the index
+ * is locked while it is read or changed.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "egg-debug.h"
+
+#include "mcm-profile-index.h"
+
+#define MCM_PROFILE_INDEX_GROUP		"McmProfileIndex"
+#define MCM_PROFILE_INDEX_VERSION	2
+
+struct _McmProfileIndex {
+	GStaticMutex		 mutex;
+	GKeyFile		*keyfile;
+	GHashTable		*used;
+	gboolean		 changed;
+	guint			 hits;
+	guint			 misses;
+};
+
+/**
+ * mcm_profile_index_filename_valid:
+ *
+ * Return value: %TRUE if the filename can be used as a group name
+ **/
+static gboolean
+mcm_profile_index_filename_valid (const gchar *filename)
+{
+	if (filename == NULL || filename[0] != '/')
+		return FALSE;
+	return strpbrk (filename, "[]\r\n") == NULL;
+}
+
+/**
+ * mcm_profile_index_set_string:
+ **/
+static void
+mcm_profile_index_set_string (GKeyFile *keyfile, const gchar *group, const gchar *key, const gchar *value)
+{
+	if (value != NULL)
+		g_key_file_set_string (keyfile, group, key, value);
+}
+
+/**
+ * mcm_profile_index_get_can_delete:
+ **/
+static gboolean
+mcm_profile_index_get_can_delete (const gchar *filename)
+{
+	gboolean can_delete = FALSE;
+	GFile *file;
+	GFileInfo *info;
+
+	file = g_file_new_for_path (filename);
+	info = g_file_query_info (file, G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE,
+				  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	if (info != NULL) {
+		can_delete = g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE);
+		g_object_unref (info);
+	}
+	g_object_unref (file);
+	return can_delete;
+}
+
+/**
+ * mcm_profile_index_lookup:
+ * @profile_index: a #McmProfileIndex
+ * @filename: the profile filename
+ *
+ * Creates a profile from the index, if the file has not changed since it
+ * was added. This can be called from any thread.
+ *
+ * Return value: a new #McmProfile, or %NULL if the file has to be parsed
+ **/
+McmProfile *
+mcm_profile_index_lookup (McmProfileIndex *profile_index, const gchar *filename)
+{
+	gboolean exists;
+	gchar *text;
+	struct stat buf;
+	McmProfile *profile = NULL;
+	GKeyFile *keyfile;
+
+	g_return_val_if_fail (profile_index != NULL, NULL);
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	/* stat before taking the lock, as it can block */
+	exists = mcm_profile_index_filename_valid (filename) && g_stat (filename, &buf) == 0;
+
+	g_static_mutex_lock (&profile_index->mutex);
+	if (!exists)
+		goto out;
+	keyfile = profile_index->keyfile;
+	if (!g_key_file_has_group (keyfile, filename))
+		goto out;
+
+	/* the file has to be exactly the same */
+	if ((guint64) buf.st_ino != g_key_file_get_uint64 (keyfile, filename, "Inode", NULL) ||
+	    (guint64) buf.st_size != g_key_file_get_uint64 (keyfile, filename, "Size", NULL) ||
+	    (guint64) buf.st_mtime != g_key_file_get_uint64 (keyfile, filename, "Mtime", NULL)) {
+		egg_debug ("%s has changed since it was indexed", filename);
+		goto out;
+	}
+
+	/* the colorimetry can still be loaded from the file later */
+	profile = mcm_profile_default_new ();
+	mcm_profile_set_lightweight (profile, TRUE);
+	mcm_profile_set_size (profile, buf.st_size);
+	text = g_key_file_get_string (keyfile, filename, "Kind", NULL);
+	mcm_profile_set_kind (profile, mcm_profile_kind_from_string (text));
+	g_free (text);
+	text = g_key_file_get_string (keyfile, filename, "Colorspace", NULL);
+	mcm_profile_set_colorspace (profile, mcm_colorspace_from_string (text));
+	g_free (text);
+	mcm_profile_set_has_vcgt (profile, g_key_file_get_boolean (keyfile, filename, "HasVcgt", NULL));
+
+	text = g_key_file_get_string (keyfile, filename, "Id", NULL);
+	mcm_profile_set_id (profile, text);
+	g_free (text);
+	text = g_key_file_get_string (keyfile, filename, "Description", NULL);
+	mcm_profile_set_description (profile, text);
+	g_free (text);
+	text = g_key_file_get_string (keyfile, filename, "Copyright", NULL);
+	mcm_profile_set_copyright (profile, text);
+	g_free (text);
+	text = g_key_file_get_string (keyfile, filename, "Model", NULL);
+	mcm_profile_set_model (profile, text);
+	g_free (text);
+	text = g_key_file_get_string (keyfile, filename, "Manufacturer", NULL);
+	mcm_profile_set_manufacturer (profile, text);
+	g_free (text);
+	text = g_key_file_get_string (keyfile, filename, "Datetime", NULL);
+	mcm_profile_set_datetime (profile, text);
+	g_free (text);
+	mcm_profile_set_filename (profile, filename);
+
+	/* keep this entry when saving */
+	g_hash_table_insert (profile_index->used, g_strdup (filename), GINT_TO_POINTER (1));
+out:
+	if (profile != NULL)
+		profile_index->hits++;
+	else
+		profile_index->misses++;
+	g_static_mutex_unlock (&profile_index->mutex);
+
+	/* this can block, so is done unlocked */
+	if (profile != NULL)
+		mcm_profile_set_can_delete (profile, mcm_profile_index_get_can_delete (filename));
+	return profile;
+}
+
+/**
+ * mcm_profile_index_add:
+ * @profile_index: a #McmProfileIndex
+ * @profile: a #McmProfile that has been parsed from a local file
+ *
+ * Saves the metadata of a profile so the file does not need to be parsed
+ * next time.
+ **/
+void
+mcm_profile_index_add (McmProfileIndex *profile_index, McmProfile *profile)
+{
+	const gchar *filename;
+	struct stat buf;
+	GKeyFile *keyfile;
+
+	g_return_if_fail (profile_index != NULL);
+	g_return_if_fail (MCM_IS_PROFILE (profile));
+
+	filename = mcm_profile_get_filename (profile);
+	if (!mcm_profile_index_filename_valid (filename))
+		return;
+	if (g_stat (filename, &buf) != 0)
+		return;
+
+	g_static_mutex_lock (&profile_index->mutex);
+	keyfile = profile_index->keyfile;
+	g_key_file_remove_group (keyfile, filename, NULL);
+	g_key_file_set_uint64 (keyfile, filename, "Inode", buf.st_ino);
+	g_key_file_set_uint64 (keyfile, filename, "Size", buf.st_size);
+	g_key_file_set_uint64 (keyfile, filename, "Mtime", buf.st_mtime);
+	g_key_file_set_string (keyfile, filename, "Kind", mcm_profile_kind_to_string (mcm_profile_get_kind (profile)));
+	g_key_file_set_string (keyfile, filename, "Colorspace", mcm_colorspace_to_string (mcm_profile_get_colorspace (profile)));
+	g_key_file_set_boolean (keyfile, filename, "HasVcgt", mcm_profile_get_has_vcgt (profile));
+	mcm_profile_index_set_string (keyfile, filename, "Id", mcm_profile_get_id (profile));
+	mcm_profile_index_set_string (keyfile, filename, "Description", mcm_profile_get_description (profile));
+	mcm_profile_index_set_string (keyfile, filename, "Copyright", mcm_profile_get_copyright (profile));
+	mcm_profile_index_set_string (keyfile, filename, "Model", mcm_profile_get_model (profile));
+	mcm_profile_index_set_string (keyfile, filename, "Manufacturer", mcm_profile_get_manufacturer (profile));
+	mcm_profile_index_set_string (keyfile, filename, "Datetime", mcm_profile_get_datetime (profile));
+
+	g_hash_table_insert (profile_index->used, g_strdup (filename), GINT_TO_POINTER (1));
+	profile_index->changed = TRUE;
+	g_static_mutex_unlock (&profile_index->mutex);
+}
+
+/**
+ * mcm_profile_index_load:
+ * @profile_index: a #McmProfileIndex
+ * @filename: the index file
+ * @error: a %GError that is set in the result of an error, or %NULL
+ *
+ * Loads a saved index. An index written by a different version is ignored.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+mcm_profile_index_load (McmProfileIndex *profile_index, const gchar *filename, GError **error)
+{
+	gboolean ret;
+	gint version;
+
+	g_return_val_if_fail (profile_index != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	g_static_mutex_lock (&profile_index->mutex);
+	ret = g_key_file_load_from_file (profile_index->keyfile, filename, G_KEY_FILE_NONE, error);
+	if (!ret)
+		goto out;
+
+	/* the format may have changed */
+	version = g_key_file_get_integer (profile_index->keyfile, MCM_PROFILE_INDEX_GROUP, "Version", NULL);
+	if (version != MCM_PROFILE_INDEX_VERSION) {
+		g_set_error (error, 1, 0, "index version %i, expected %i", version, MCM_PROFILE_INDEX_VERSION);
+		g_key_file_free (profile_index->keyfile);
+		profile_index->keyfile = g_key_file_new ();
+		ret = FALSE;
+		goto out;
+	}
+	egg_debug ("loaded profile index %s", filename);
+out:
+	g_static_mutex_unlock (&profile_index->mutex);
+	return ret;
+}
+
+/**
+ * mcm_profile_index_save:
+ * @profile_index: a #McmProfileIndex
+ * @filename: the index file
+ * @error: a %GError that is set in the result of an error, or %NULL
+ *
+ * Saves the entries that were added or looked up since the index was
+ * created, so profiles that have been deleted are dropped. The file is
+ * not written if nothing has changed.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+mcm_profile_index_save (McmProfileIndex *profile_index, const gchar *filename, GError **error)
+{
+	gboolean ret = TRUE;
+	guint i;
+	gchar **groups;
+	gchar *data = NULL;
+	gchar *dirname = NULL;
+	gsize length;
+
+	g_return_val_if_fail (profile_index != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	/* drop anything that was not seen in this scan */
+	g_static_mutex_lock (&profile_index->mutex);
+	groups = g_key_file_get_groups (profile_index->keyfile, NULL);
+	for (i=0; groups[i] != NULL; i++) {
+		if (g_strcmp0 (groups[i], MCM_PROFILE_INDEX_GROUP) == 0)
+			continue;
+		if (g_hash_table_lookup (profile_index->used, groups[i]) != NULL)
+			continue;
+		g_key_file_remove_group (profile_index->keyfile, groups[i], NULL);
+		profile_index->changed = TRUE;
+	}
+	g_strfreev (groups);
+
+	/* nothing to do */
+	if (!profile_index->changed)
+		goto out;
+
+	/* write it */
+	g_key_file_set_integer (profile_index->keyfile, MCM_PROFILE_INDEX_GROUP, "Version", MCM_PROFILE_INDEX_VERSION);
+	data = g_key_file_to_data (profile_index->keyfile, &length, error);
+	if (data == NULL) {
+		ret = FALSE;
+		goto out;
+	}
+	dirname = g_path_get_dirname (filename);
+	g_mkdir_with_parents (dirname, 0700);
+	ret = g_file_set_contents (filename, data, length, error);
+	if (!ret)
+		goto out;
+	egg_debug ("saved %i profiles to %s", g_hash_table_size (profile_index->used), filename);
+	profile_index->changed = FALSE;
+out:
+	g_static_mutex_unlock (&profile_index->mutex);
+	g_free (dirname);
+	g_free (data);
+	return ret;
+}
+
+/**
+ * mcm_profile_index_get_stats:
+ * @profile_index: a #McmProfileIndex
+ * @hits: the number of profiles created from the index, or %NULL
+ * @misses: the number of profiles that had to be parsed, or %NULL
+ **/
+void
+mcm_profile_index_get_stats (McmProfileIndex *profile_index, guint *hits, guint *misses)
+{
+	g_return_if_fail (profile_index != NULL);
+	g_static_mutex_lock (&profile_index->mutex);
+	if (hits != NULL)
+		*hits = profile_index->hits;
+	if (misses != NULL)
+		*misses = profile_index->misses;
+	g_static_mutex_unlock (&profile_index->mutex);
+}
+
+/**
+ * mcm_profile_index_get_default_filename:
+ *
+ * Return value: the per-user index file, free with g_free()
+ **/
+gchar *
+mcm_profile_index_get_default_filename (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "mate-color-manager", "profiles.index", NULL);
+}
+
+/**
+ * mcm_profile_index_free:
+ **/
+void
+mcm_profile_index_free (McmProfileIndex *profile_index)
+{
+	if (profile_index == NULL)
+		return;
+	g_key_file_free (profile_index->keyfile);
+	g_hash_table_destroy (profile_index->used);
+	g_static_mutex_free (&profile_index->mutex);
+	g_free (profile_index);
+}
+
+/**
+ * mcm_profile_index_new:
+ *
+ * Return value: a new empty index, free with mcm_profile_index_free()
+ **/
+McmProfileIndex *
+mcm_profile_index_new (void)
+{
+	McmProfileIndex *profile_index;
+	profile_index = g_new0 (McmProfileIndex, 1);
+	g_static_mutex_init (&profile_index->mutex);
+	profile_index->keyfile = g_key_file_new ();
+	profile_index->used = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	return profile_index;
+}
@@ -0,0 +1,53 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __MCM_PROFILE_INDEX_H
+#define __MCM_PROFILE_INDEX_H
+
+#include <glib.h>
+
+#include "mcm-profile.h"
+
+G_BEGIN_DECLS
+
+typedef struct _McmProfileIndex	McmProfileIndex;
+
+McmProfileIndex	*mcm_profile_index_new			(void);
+void		 mcm_profile_index_free			(McmProfileIndex	*profile_index);
+gboolean	 mcm_profile_index_load			(McmProfileIndex	*profile_index,
+							 const gchar		*filename,
+							 GError			**error);
+gboolean	 mcm_profile_index_save			(McmProfileIndex	*profile_index,
+							 const gchar		*filename,
+							 GError			**error);
+McmProfile	*mcm_profile_index_lookup		(McmProfileIndex	*profile_index,
+							 const gchar		*filename);
+void		 mcm_profile_index_add			(McmProfileIndex	*profile_index,
+							 McmProfile		*profile);
+void		 mcm_profile_index_get_stats		(McmProfileIndex	*profile_index,
+							 guint			*hits,
+							 guint			*misses);
+gchar		*mcm_profile_index_get_default_filename	(void);
+
+G_END_DECLS
+
+#endif /* __MCM_PROFILE_INDEX_H */
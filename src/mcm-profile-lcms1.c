@@ -32,11 +32,17 @@
 #include <glib-object.h>
 #include <glib/gi18n.h>
 #include <math.h>
+#include <string.h>
 #include <lcms.h>
 
 #include "egg-debug.h"
 
 #include "mcm-profile-lcms1.h"
+#include "mcm-ramp.h"
+#include "mcm-resample.h"
+#include "mcm-tag-index.h"
+#include "mcm-transform-cache.h"
+#include "mcm-trc.h"
 #include "mcm-utils.h"
 #include "mcm-xyz.h"
 
@@ -44,13 +50,12 @@ static void     mcm_profile_lcms1_finalize	(GObject     *object);
 
 #define MCM_PROFILE_LCMS1_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), MCM_TYPE_PROFILE_LCMS1, McmProfileLcms1Private))
 
-#define MCM_NUMTAGS			0x80
-#define MCM_BODY			0x84
+#define MCM_HEADER_CLASS		0x0c
+#define MCM_HEADER_COLORSPACE		0x10
+#define MCM_HEADER_DATETIME		0x18
+#define MCM_HEADER_MAGIC		0x24
 
-#define MCM_TAG_ID			0x00
-#define MCM_TAG_OFFSET			0x04
-#define MCM_TAG_SIZE			0x08
-#define MCM_TAG_WIDTH			0x0c
+#define MCM_BODY			0x84
 
 #define icSigVideoCartGammaTableTag	0x76636774
 #define icSigMachineLookUpTableTag	0x6d4c5554
@@ -58,6 +63,7 @@ static void     mcm_profile_lcms1_finalize	(GObject     *object);
 #define MCM_MLUT_RED			0x000
 #define MCM_MLUT_GREEN			0x200
 #define MCM_MLUT_BLUE			0x400
+#define MCM_MLUT_SIZE			0x600
 
 #define MCM_DESC_RECORD_SIZE		0x08
 #define MCM_DESC_RECORD_TEXT		0x0c
@@ -77,12 +83,16 @@ static void     mcm_profile_lcms1_finalize	(GObject     *object);
 #define MCM_VCGT_FORMULA_GAMMA_BLUE	0x18
 #define MCM_VCGT_FORMULA_MIN_BLUE	0x1c
 #define MCM_VCGT_FORMULA_MAX_BLUE	0x20
+#define MCM_VCGT_FORMULA_SIZE		0x24
 
 #define MCM_VCGT_TABLE_NUM_CHANNELS	0x00
 #define MCM_VCGT_TABLE_NUM_ENTRIES	0x02
 #define MCM_VCGT_TABLE_NUM_SIZE		0x04
 #define MCM_VCGT_TABLE_NUM_DATA		0x06
 
+#define MCM_XYZ_DATA			0x08
+#define MCM_XYZ_SIZE			0x14
+
 /**
  * McmProfileLcms1Private:
  *
@@ -91,19 +101,57 @@ static void     mcm_profile_lcms1_finalize	(GObject     *object);
 struct _McmProfileLcms1Private
 {
 	gboolean			 loaded;
+	gboolean			 has_colorimetry;
 	gboolean			 has_mlut;
 	gboolean			 has_vcgt_formula;
 	gboolean			 has_vcgt_table;
 	cmsHPROFILE			 lcms_profile;
 	McmClutData			*vcgt_data;
-	guint				 vcgt_data_size;
-	McmClutData			*mlut_data;
-	guint				 mlut_data_size;
+	guint16				*vcgt_table;
+	guint				 vcgt_table_size;
+	guint16				*mlut_data;
 	gboolean			 adobe_gamma_workaround;
+	McmTrc				*trc[3];
+	gdouble				 colorants[9];
 };
 
+/* the last lcms error on this thread, so it goes back to the right file */
+static GStaticPrivate mcm_profile_lcms1_error_text = G_STATIC_PRIVATE_INIT;
+
 G_DEFINE_TYPE (McmProfileLcms1, mcm_profile_lcms1, MCM_TYPE_PROFILE)
 
+/**
+ * mcm_profile_lcms1_lock:
+ *
+ * Takes the lcms lock and clears any old error on this thread.
+ **/
+static void
+mcm_profile_lcms1_lock (void)
+{
+	mcm_utils_lcms_lock ();
+	g_static_private_set (&mcm_profile_lcms1_error_text, NULL, NULL);
+}
+
+/**
+ * mcm_profile_lcms1_unlock:
+ **/
+static void
+mcm_profile_lcms1_unlock (void)
+{
+	mcm_utils_lcms_unlock ();
+}
+
+/**
+ * mcm_profile_lcms1_get_error_text:
+ *
+ * Return value: the last lcms error on this thread, or %NULL
+ **/
+static const gchar *
+mcm_profile_lcms1_get_error_text (void)
+{
+	return g_static_private_get (&mcm_profile_lcms1_error_text);
+}
+
 /**
  * mcm_parser_decode_32:
  **/
@@ -145,18 +193,20 @@ mcm_parser_load_icc_mlut (McmProfileLcms1 *profile_lcms1, const guint8 *data, gu
 {
 	gboolean ret = TRUE;
 	guint i;
-	McmClutData *mlut_data;
+	guint16 *mlut_data;
 
-	/* just load in data into a fixed size LUT */
-	profile_lcms1->priv->mlut_data = g_new0 (McmClutData, 256);
+	/* check the tag is big enough */
+	if (size < MCM_MLUT_SIZE) {
+		egg_warning ("mlut tag too small: %u bytes", size);
+		return FALSE;
+	}
+
+	/* just load in data into a fixed size planar LUT */
+	profile_lcms1->priv->mlut_data = g_new0 (guint16, 256 * 3);
 	mlut_data = profile_lcms1->priv->mlut_data;
 
-	for (i=0; i<256; i++)
-		mlut_data[i].red = mcm_parser_decode_16 (data + MCM_MLUT_RED + i*2);
-	for (i=0; i<256; i++)
-		mlut_data[i].green = mcm_parser_decode_16 (data + MCM_MLUT_GREEN + i*2);
-	for (i=0; i<256; i++)
-		mlut_data[i].blue = mcm_parser_decode_16 (data + MCM_MLUT_BLUE + i*2);
+	for (i=0; i<256 * 3; i++)
+		mlut_data[i] = mcm_parser_decode_16 (data + MCM_MLUT_RED + i*2);
 
 	/* save datatype */
 	profile_lcms1->priv->has_mlut = TRUE;
@@ -172,6 +222,12 @@ mcm_parser_load_icc_vcgt_formula (McmProfileLcms1 *profile_lcms1, const guint8 *
 	gboolean ret = FALSE;
 	McmClutData *vcgt_data;
 
+	/* check the tag is big enough */
+	if (size < MCM_VCGT_FORMULA_SIZE) {
+		egg_warning ("vcgt formula too small: %u bytes", size);
+		goto out;
+	}
+
 	/* just load in data into a temporary array */
 	profile_lcms1->priv->vcgt_data = g_new0 (McmClutData, 4);
 	vcgt_data = profile_lcms1->priv->vcgt_data;
@@ -205,7 +261,6 @@ mcm_parser_load_icc_vcgt_formula (McmProfileLcms1 *profile_lcms1, const guint8 *
 
 	/* save datatype */
 	profile_lcms1->priv->has_vcgt_formula = TRUE;
-	profile_lcms1->priv->vcgt_data_size = 3;
 	ret = TRUE;
 out:
 	return ret;
@@ -222,7 +277,14 @@ mcm_parser_load_icc_vcgt_table (McmProfileLcms1 *profile_lcms1, const guint8 *da
 	guint num_entries = 0;
 	guint entry_size = 0;
 	guint i;
-	McmClutData *vcgt_data;
+	guint16 *vcgt_table;
+
+	/* check the tag is big enough */
+	if (size < MCM_VCGT_TABLE_NUM_DATA) {
+		egg_warning ("vcgt table too small: %u bytes", size);
+		ret = FALSE;
+		goto out;
+	}
 
 	num_channels = mcm_parser_decode_16 (data + MCM_VCGT_TABLE_NUM_CHANNELS);
 	num_entries = mcm_parser_decode_16 (data + MCM_VCGT_TABLE_NUM_ENTRIES);
@@ -237,7 +299,7 @@ mcm_parser_load_icc_vcgt_table (McmProfileLcms1 *profile_lcms1, const guint8 *da
 	}
 
 	/* only able to parse RGB data */
-	if (num_channels != 3) {
+	if (num_channels != 3 || num_entries == 0) {
 		egg_warning ("cannot parse non RGB entries");
 		ret = FALSE;
 		goto out;
@@ -250,29 +312,29 @@ mcm_parser_load_icc_vcgt_table (McmProfileLcms1 *profile_lcms1, const guint8 *da
 		goto out;
 	}
 
-	/* allocate ramp, plus one entry for extrapolation */
-	profile_lcms1->priv->vcgt_data = g_new0 (McmClutData, num_entries + 1);
-	vcgt_data = profile_lcms1->priv->vcgt_data;
+	/* check all the entries are inside the tag */
+	if (MCM_VCGT_TABLE_NUM_DATA + (num_channels * num_entries * (entry_size == 1 ? 1 : 2)) > size) {
+		egg_warning ("vcgt table of %u entries does not fit in %u bytes", num_entries, size);
+		ret = FALSE;
+		goto out;
+	}
+
+	/* the channels are stored one after another, just like a planar ramp */
+	profile_lcms1->priv->vcgt_table = g_new0 (guint16, num_entries * 3);
+	vcgt_table = profile_lcms1->priv->vcgt_table;
 
 	if (entry_size == 1) {
-		for (i=0; i<num_entries; i++)
-			vcgt_data[i].red = mcm_parser_decode_8 (data + MCM_VCGT_TABLE_NUM_DATA + (num_entries * 0) + i);
-		for (i=0; i<num_entries; i++)
-			vcgt_data[i].green = mcm_parser_decode_8 (data + MCM_VCGT_TABLE_NUM_DATA + (num_entries * 1) + i);
-		for (i=0; i<num_entries; i++)
-			vcgt_data[i].blue = mcm_parser_decode_8 (data + MCM_VCGT_TABLE_NUM_DATA + (num_entries * 2) + i);
+		/* scale up to 16 bits */
+		for (i=0; i<num_entries * 3; i++)
+			vcgt_table[i] = mcm_parser_decode_8 (data + MCM_VCGT_TABLE_NUM_DATA + i) * 0x101;
 	} else {
-		for (i=0; i<num_entries; i++)
-			vcgt_data[i].red = mcm_parser_decode_16 (data + MCM_VCGT_TABLE_NUM_DATA + (num_entries * 0) + (i*2));
-		for (i=0; i<num_entries; i++)
-			vcgt_data[i].green = mcm_parser_decode_16 (data + MCM_VCGT_TABLE_NUM_DATA + (num_entries * 2) + (i*2));
-		for (i=0; i<num_entries; i++)
-			vcgt_data[i].blue = mcm_parser_decode_16 (data + MCM_VCGT_TABLE_NUM_DATA + (num_entries * 4) + (i*2));
+		for (i=0; i<num_entries * 3; i++)
+			vcgt_table[i] = mcm_parser_decode_16 (data + MCM_VCGT_TABLE_NUM_DATA + (i*2));
 	}
 
 	/* save datatype */
 	profile_lcms1->priv->has_vcgt_table = TRUE;
-	profile_lcms1->priv->vcgt_data_size = num_entries;
+	profile_lcms1->priv->vcgt_table_size = num_entries;
 out:
 	return ret;
 }
@@ -287,6 +349,12 @@ mcm_parser_load_icc_vcgt (McmProfileLcms1 *profile_lcms1, const guint8 *data, gu
 	guint tag_id;
 	guint gamma_type;
 
+	/* check we have the tag header */
+	if (size < MCM_VCGT_GAMMA_DATA) {
+		egg_warning ("vcgt tag too small: %u bytes", size);
+		goto out;
+	}
+
 	/* check we have a VCGT block */
 	tag_id = mcm_parser_decode_32 (data);
 	if (tag_id != icSigVideoCartGammaTableTag) {
@@ -297,11 +365,11 @@ mcm_parser_load_icc_vcgt (McmProfileLcms1 *profile_lcms1, const guint8 *data, gu
 	/* check what type of gamma encoding we have */
 	gamma_type = mcm_parser_decode_32 (data + MCM_VCGT_GAMMA_TYPE);
 	if (gamma_type == 0) {
-		ret = mcm_parser_load_icc_vcgt_table (profile_lcms1, data + MCM_VCGT_GAMMA_DATA, size);
+		ret = mcm_parser_load_icc_vcgt_table (profile_lcms1, data + MCM_VCGT_GAMMA_DATA, size - MCM_VCGT_GAMMA_DATA);
 		goto out;
 	}
 	if (gamma_type == 1) {
-		ret = mcm_parser_load_icc_vcgt_formula (profile_lcms1, data + MCM_VCGT_GAMMA_DATA, size);
+		ret = mcm_parser_load_icc_vcgt_formula (profile_lcms1, data + MCM_VCGT_GAMMA_DATA, size - MCM_VCGT_GAMMA_DATA);
 		goto out;
 	}
 
@@ -358,24 +426,42 @@ mcm_profile_lcms1_parse_multi_localized_unicode (McmProfileLcms1 *profile_lcms1,
 	guint offset_name;
 	guint32 type;
 
+	/* we need at least the type */
+	if (size < 4) {
+		egg_warning ("text tag too small: %u bytes", size);
+		goto out;
+	}
+
 	/* get type */
 	type = mcm_parser_decode_32 (data);
 
 	/* check we are not a localized tag */
 	if (type == icSigTextDescriptionType) {
+		if (size < MCM_DESC_RECORD_TEXT) {
+			egg_warning ("desc tag too small: %u bytes", size);
+			goto out;
+		}
 		record_size = mcm_parser_decode_32 (data + MCM_DESC_RECORD_SIZE);
-		text = g_strndup ((const gchar*)&data[MCM_DESC_RECORD_TEXT], record_size);
+		text = g_strndup ((const gchar*)&data[MCM_DESC_RECORD_TEXT], MIN (record_size, size - MCM_DESC_RECORD_TEXT));
 		goto out;
 	}
 
 	/* check we are not a localized tag */
 	if (type == icSigTextType) {
-		text = g_strdup ((const gchar*)&data[MCM_TEXT_RECORD_TEXT]);
+		if (size < MCM_TEXT_RECORD_TEXT) {
+			egg_warning ("text tag too small: %u bytes", size);
+			goto out;
+		}
+		text = g_strndup ((const gchar*)&data[MCM_TEXT_RECORD_TEXT], size - MCM_TEXT_RECORD_TEXT);
 		goto out;
 	}
 
 	/* check we are not a localized tag */
 	if (type == icSigMultiLocalizedUnicodeType) {
+		if (size < 28) {
+			egg_warning ("mluc tag too small: %u bytes", size);
+			goto out;
+		}
 		names_size = mcm_parser_decode_32 (data + 8);
 		if (names_size != 1) {
 			/* there is more than one language encoded */
@@ -383,12 +469,16 @@ mcm_profile_lcms1_parse_multi_localized_unicode (McmProfileLcms1 *profile_lcms1,
 		}
 		len = mcm_parser_decode_32 (data + 20);
 		offset_name = mcm_parser_decode_32 (data + 24);
+		if (offset_name > size || len > size - offset_name) {
+			egg_warning ("mluc string at 0x%x with size %u is outside the tag", offset_name, len);
+			goto out;
+		}
 		text = mcm_profile_lcms1_utf16be_to_locale (data + offset_name, len);
 		goto out;
 	}
 
 	/* an unrecognized tag */
-	for (i=0x0; i<0x1c; i++) {
+	for (i=0x0; i<MIN (size, 0x1c); i++) {
 		egg_warning ("unrecognized text tag");
 		if (data[i] >= 'A' && data[i] <= 'z')
 			egg_debug ("%i\t%c (%i)", i, data[i], data[i]);
@@ -399,6 +489,43 @@ out:
 	return text;
 }
 
+/**
+ * mcm_profile_lcms1_ensure_lcms_profile:
+ *
+ * Opens the lcms profile on demand, which is only needed for profiles
+ * that were parsed in lightweight mode.
+ **/
+static gboolean
+mcm_profile_lcms1_ensure_lcms_profile (McmProfileLcms1 *profile_lcms1)
+{
+	gboolean ret = TRUE;
+	const gchar *filename;
+	McmProfileLcms1Private *priv = profile_lcms1->priv;
+
+	/* already open */
+	mcm_profile_lcms1_lock ();
+	if (priv->lcms_profile != NULL)
+		goto out;
+
+	/* we don't keep the data around, so we have to go back to the file */
+	filename = mcm_profile_get_filename (MCM_PROFILE (profile_lcms1));
+	if (filename == NULL) {
+		egg_warning ("cannot open lcms profile, no filename");
+		ret = FALSE;
+		goto out;
+	}
+	priv->lcms_profile = cmsOpenProfileFromFile (filename, "r");
+	if (priv->lcms_profile == NULL) {
+		egg_warning ("failed to open %s with lcms", filename);
+		ret = FALSE;
+		goto out;
+	}
+	egg_debug ("opened %s with lcms on demand", filename);
+out:
+	mcm_profile_lcms1_unlock ();
+	return ret;
+}
+
 /**
  * mcm_profile_lcms1_save:
  **/
@@ -407,49 +534,45 @@ mcm_profile_lcms1_save (McmProfile *profile, const gchar *filename, GError **err
 {
 	McmProfileLcms1 *profile_lcms1 = MCM_PROFILE_LCMS1 (profile);
 	McmProfileLcms1Private *priv = profile_lcms1->priv;
+
+	if (!mcm_profile_lcms1_ensure_lcms_profile (profile_lcms1)) {
+		g_set_error_literal (error, 1, 0, "failed to open profile");
+		return FALSE;
+	}
+	mcm_profile_lcms1_lock ();
 	_cmsSaveProfile (priv->lcms_profile, filename);
+	mcm_profile_lcms1_unlock ();
 	return TRUE;
 }
 
 /**
- * mcm_profile_lcms1_parse_data:
+ * mcm_profile_lcms1_load_colorimetry:
+ *
+ * Gets the white point, black point and primaries, which need lcms.
  **/
 static gboolean
-mcm_profile_lcms1_parse_data (McmProfile *profile, const guint8 *data, gsize length, GError **error)
+mcm_profile_lcms1_load_colorimetry (McmProfile *profile)
 {
-	gboolean ret = FALSE;
-	guint num_tags;
-	guint i;
-	guint tag_id;
-	guint offset;
-	guint tag_size;
-	guint tag_offset;
-	icProfileClassSignature profile_class;
-	icColorSpaceSignature color_space;
-	McmColorspace colorspace;
-	McmProfileKind profile_kind;
+	gboolean ret;
 	cmsCIEXYZ cie_xyz;
 	cmsCIEXYZTRIPLE cie_illum;
-	struct tm created;
 	cmsHPROFILE xyz_profile_lcms1;
 	cmsHTRANSFORM transform;
-	gchar *text;
 	McmXyz *xyz;
 	McmProfileLcms1 *profile_lcms1 = MCM_PROFILE_LCMS1 (profile);
 	McmProfileLcms1Private *priv = profile_lcms1->priv;
 
-	g_return_val_if_fail (MCM_IS_PROFILE_LCMS1 (profile_lcms1), FALSE);
-	g_return_val_if_fail (data != NULL, FALSE);
-	g_return_val_if_fail (priv->loaded == FALSE, FALSE);
-
-	priv->loaded = TRUE;
-
-	/* load profile into lcms */
-	priv->lcms_profile = cmsOpenProfileFromMem ((LPVOID)data, length);
-	if (priv->lcms_profile == NULL) {
-		g_set_error_literal (error, 1, 0, "failed to load: not an ICC profile");
+	/* only try once, even if it failed */
+	mcm_profile_lcms1_lock ();
+	if (priv->has_colorimetry) {
+		ret = TRUE;
 		goto out;
 	}
+	priv->has_colorimetry = TRUE;
+
+	ret = mcm_profile_lcms1_ensure_lcms_profile (profile_lcms1);
+	if (!ret)
+		goto out;
 
 	/* get white point */
 	ret = cmsTakeMediaWhitePoint (&cie_xyz, priv->lcms_profile);
@@ -485,78 +608,11 @@ mcm_profile_lcms1_parse_data (McmProfile *profile, const guint8 *data, gsize len
 		egg_warning ("failed to get black point");
 	}
 
-	/* get the profile kind */
-	profile_class = cmsGetDeviceClass (priv->lcms_profile);
-	switch (profile_class) {
-	case icSigInputClass:
-		profile_kind = MCM_PROFILE_KIND_INPUT_DEVICE;
-		break;
-	case icSigDisplayClass:
-		profile_kind = MCM_PROFILE_KIND_DISPLAY_DEVICE;
-		break;
-	case icSigOutputClass:
-		profile_kind = MCM_PROFILE_KIND_OUTPUT_DEVICE;
-		break;
-	case icSigLinkClass:
-		profile_kind = MCM_PROFILE_KIND_DEVICELINK;
-		break;
-	case icSigColorSpaceClass:
-		profile_kind = MCM_PROFILE_KIND_COLORSPACE_CONVERSION;
-		break;
-	case icSigAbstractClass:
-		profile_kind = MCM_PROFILE_KIND_ABSTRACT;
-		break;
-	case icSigNamedColorClass:
-		profile_kind = MCM_PROFILE_KIND_NAMED_COLOR;
-		break;
-	default:
-		profile_kind = MCM_PROFILE_KIND_UNKNOWN;
-	}
-	mcm_profile_set_kind (profile, profile_kind);
-
-	/* get colorspace */
-	color_space = cmsGetColorSpace (priv->lcms_profile);
-	switch (color_space) {
-	case icSigXYZData:
-		colorspace = MCM_COLORSPACE_XYZ;
-		break;
-	case icSigLabData:
-		colorspace = MCM_COLORSPACE_LAB;
-		break;
-	case icSigLuvData:
-		colorspace = MCM_COLORSPACE_LUV;
-		break;
-	case icSigYCbCrData:
-		colorspace = MCM_COLORSPACE_YCBCR;
-		break;
-	case icSigYxyData:
-		colorspace = MCM_COLORSPACE_YXY;
-		break;
-	case icSigRgbData:
-		colorspace = MCM_COLORSPACE_RGB;
-		break;
-	case icSigGrayData:
-		colorspace = MCM_COLORSPACE_GRAY;
-		break;
-	case icSigHsvData:
-		colorspace = MCM_COLORSPACE_HSV;
-		break;
-	case icSigCmykData:
-		colorspace = MCM_COLORSPACE_CMYK;
-		break;
-	case icSigCmyData:
-		colorspace = MCM_COLORSPACE_CMY;
-		break;
-	default:
-		colorspace = MCM_COLORSPACE_UNKNOWN;
-	}
-	mcm_profile_set_colorspace (profile, colorspace);
-
 	/* get primary illuminants */
 	ret = cmsTakeColorants (&cie_illum, priv->lcms_profile);
 
 	/* geting the illuminants failed, try running it through the profile_lcms1 */
-	if (!ret && color_space == icSigRgbData) {
+	if (!ret && cmsGetColorSpace (priv->lcms_profile) == icSigRgbData) {
 		gdouble rgb_values[3];
 
 		/* create a transform from profile_lcms1 to XYZ */
@@ -631,62 +687,250 @@ mcm_profile_lcms1_parse_data (McmProfile *profile, const guint8 *data, gsize len
 	} else {
 		egg_debug ("failed to get luminance values");
 	}
+out:
+	mcm_profile_lcms1_unlock ();
+	return ret;
+}
 
-	/* get the profile_lcms1 created time and date */
-	ret = cmsTakeCreationDateTime (&created, priv->lcms_profile);
-	if (ret) {
-		text = mcm_utils_format_date_time (&created);
-		mcm_profile_set_datetime (profile, text);
-		g_free (text);
+/**
+ * mcm_profile_lcms1_class_to_kind:
+ **/
+static McmProfileKind
+mcm_profile_lcms1_class_to_kind (icProfileClassSignature profile_class)
+{
+	switch (profile_class) {
+	case icSigInputClass:
+		return MCM_PROFILE_KIND_INPUT_DEVICE;
+	case icSigDisplayClass:
+		return MCM_PROFILE_KIND_DISPLAY_DEVICE;
+	case icSigOutputClass:
+		return MCM_PROFILE_KIND_OUTPUT_DEVICE;
+	case icSigLinkClass:
+		return MCM_PROFILE_KIND_DEVICELINK;
+	case icSigColorSpaceClass:
+		return MCM_PROFILE_KIND_COLORSPACE_CONVERSION;
+	case icSigAbstractClass:
+		return MCM_PROFILE_KIND_ABSTRACT;
+	case icSigNamedColorClass:
+		return MCM_PROFILE_KIND_NAMED_COLOR;
+	default:
+		return MCM_PROFILE_KIND_UNKNOWN;
 	}
+}
 
-	/* get the number of tags in the file */
-	num_tags = mcm_parser_decode_32 (data + MCM_NUMTAGS);
+/**
+ * mcm_profile_lcms1_color_space_to_colorspace:
+ **/
+static McmColorspace
+mcm_profile_lcms1_color_space_to_colorspace (icColorSpaceSignature color_space)
+{
+	switch (color_space) {
+	case icSigXYZData:
+		return MCM_COLORSPACE_XYZ;
+	case icSigLabData:
+		return MCM_COLORSPACE_LAB;
+	case icSigLuvData:
+		return MCM_COLORSPACE_LUV;
+	case icSigYCbCrData:
+		return MCM_COLORSPACE_YCBCR;
+	case icSigYxyData:
+		return MCM_COLORSPACE_YXY;
+	case icSigRgbData:
+		return MCM_COLORSPACE_RGB;
+	case icSigGrayData:
+		return MCM_COLORSPACE_GRAY;
+	case icSigHsvData:
+		return MCM_COLORSPACE_HSV;
+	case icSigCmykData:
+		return MCM_COLORSPACE_CMYK;
+	case icSigCmyData:
+		return MCM_COLORSPACE_CMY;
+	default:
+		return MCM_COLORSPACE_UNKNOWN;
+	}
+}
 
-	for (i=0; i<num_tags; i++) {
-		offset = MCM_TAG_WIDTH * i;
-		tag_id = mcm_parser_decode_32 (data + MCM_BODY + offset + MCM_TAG_ID);
-		tag_offset = mcm_parser_decode_32 (data + MCM_BODY + offset + MCM_TAG_OFFSET);
-		tag_size = mcm_parser_decode_32 (data + MCM_BODY + offset + MCM_TAG_SIZE);
+/**
+ * mcm_profile_lcms1_decode_datetime:
+ *
+ * Decodes an ICC dateTimeNumber the same way lcms does.
+ **/
+static void
+mcm_profile_lcms1_decode_datetime (const guint8 *data, struct tm *created)
+{
+	memset (created, 0, sizeof (struct tm));
+	created->tm_year = mcm_parser_decode_16 (data + 0x00) - 1900;
+	created->tm_mon = mcm_parser_decode_16 (data + 0x02) - 1;
+	created->tm_mday = mcm_parser_decode_16 (data + 0x04);
+	created->tm_hour = mcm_parser_decode_16 (data + 0x06);
+	created->tm_min = mcm_parser_decode_16 (data + 0x08);
+	created->tm_sec = mcm_parser_decode_16 (data + 0x0a);
+	created->tm_wday = -1;
+	created->tm_yday = -1;
+	created->tm_isdst = 0;
+}
 
-		/* print tag */
-//		egg_debug ("tag %x is present at 0x%x with size %u", tag_id, tag_offset, tag_size);
+/**
+ * mcm_profile_lcms1_load_matrix_shaper:
+ *
+ * Decodes the TRC and colorant tags of a matrix/TRC RGB profile, so
+ * curves can be generated without lcms. LUT based profiles are skipped,
+ * as lcms would use the LUT rather than the matrix.
+ **/
+static void
+mcm_profile_lcms1_load_matrix_shaper (McmProfileLcms1 *profile_lcms1, McmTagIndex *tag_index)
+{
+	guint i;
+	guint j;
+	guint32 tag_size;
+	const guint8 *tag_data;
+	GError *error = NULL;
+	McmProfileLcms1Private *priv = profile_lcms1->priv;
+	const guint32 trc_tags[] = { icSigRedTRCTag, icSigGreenTRCTag, icSigBlueTRCTag };
+	const guint32 colorant_tags[] = { icSigRedColorantTag, icSigGreenColorantTag, icSigBlueColorantTag };
 
-		if (tag_id == icSigProfileDescriptionTag) {
-			text = mcm_profile_lcms1_parse_multi_localized_unicode (profile_lcms1, data + tag_offset, tag_size);
-			mcm_profile_set_description (profile, text);
-			g_free (text);
-		}
-		if (tag_id == icSigCopyrightTag) {
-			text = mcm_profile_lcms1_parse_multi_localized_unicode (profile_lcms1, data + tag_offset, tag_size);
-			mcm_profile_set_copyright (profile, text);
-			g_free (text);
-		}
-		if (tag_id == icSigDeviceMfgDescTag) {
-			text = mcm_profile_lcms1_parse_multi_localized_unicode (profile_lcms1, data + tag_offset, tag_size);
-			mcm_profile_set_manufacturer (profile, text);
-			g_free (text);
+	if (mcm_tag_index_get_entry (tag_index, icSigAToB0Tag) != NULL)
+		return;
+
+	for (i=0; i<3; i++) {
+		tag_data = mcm_tag_index_get_data (tag_index, colorant_tags[i], &tag_size);
+		if (tag_data == NULL || tag_size < MCM_XYZ_SIZE)
+			goto out;
+		for (j=0; j<3; j++)
+			priv->colorants[i*3 + j] = (gint32) mcm_parser_decode_32 (tag_data + MCM_XYZ_DATA + j*4) / 65536.0;
+
+		tag_data = mcm_tag_index_get_data (tag_index, trc_tags[i], &tag_size);
+		if (tag_data == NULL)
+			goto out;
+		priv->trc[i] = mcm_trc_new_from_data (tag_data, tag_size, &error);
+		if (priv->trc[i] == NULL) {
+			egg_debug ("failed to load TRC: %s", error->message);
+			g_error_free (error);
+			goto out;
 		}
-		if (tag_id == icSigDeviceModelDescTag) {
-			text = mcm_profile_lcms1_parse_multi_localized_unicode (profile_lcms1, data + tag_offset, tag_size);
-			mcm_profile_set_model (profile, text);
-			g_free (text);
+	}
+	return;
+out:
+	/* we need all three or nothing */
+	for (i=0; i<3; i++) {
+		mcm_trc_free (priv->trc[i]);
+		priv->trc[i] = NULL;
+	}
+}
+
+/**
+ * mcm_profile_lcms1_parse_data:
+ *
+ * In lightweight mode only the header and the tags we need for the metadata
+ * and the VCGT are decoded, and lcms is not used until the colorimetry or a
+ * curve is requested.
+ **/
+static gboolean
+mcm_profile_lcms1_parse_data (McmProfile *profile, const guint8 *data, gsize length, GError **error)
+{
+	gboolean ret = FALSE;
+	guint32 tag_size;
+	const guint8 *tag_data;
+	McmTagIndex *tag_index = NULL;
+	struct tm created;
+	gchar *text;
+	const gchar *error_text;
+	McmProfileLcms1 *profile_lcms1 = MCM_PROFILE_LCMS1 (profile);
+	McmProfileLcms1Private *priv = profile_lcms1->priv;
+
+	g_return_val_if_fail (MCM_IS_PROFILE_LCMS1 (profile_lcms1), FALSE);
+	g_return_val_if_fail (data != NULL, FALSE);
+	g_return_val_if_fail (priv->loaded == FALSE, FALSE);
+
+	priv->loaded = TRUE;
+
+	/* check the header and the tag table before we decode anything */
+	if (length < MCM_BODY || mcm_parser_decode_32 (data + MCM_HEADER_MAGIC) != icMagicNumber) {
+		g_set_error_literal (error, 1, 0, "failed to load: not an ICC profile");
+		goto out;
+	}
+	tag_index = mcm_tag_index_new (data, length, error);
+	if (tag_index == NULL)
+		goto out;
+
+	if (!mcm_profile_get_lightweight (profile)) {
+
+		/* load profile into lcms */
+		mcm_profile_lcms1_lock ();
+		priv->lcms_profile = cmsOpenProfileFromMem ((LPVOID)data, length);
+		if (priv->lcms_profile == NULL) {
+			error_text = mcm_profile_lcms1_get_error_text ();
+			g_set_error (error, 1, 0, "failed to load: %s",
+				     error_text != NULL ? error_text : "not an ICC profile");
+			mcm_profile_lcms1_unlock ();
+			goto out;
 		}
-		if (tag_id == icSigMachineLookUpTableTag) {
-			ret = mcm_parser_load_icc_mlut (profile_lcms1, data + tag_offset, tag_size);
-			if (!ret) {
-				g_set_error_literal (error, 1, 0, "failed to load mlut");
-				goto out;
-			}
+		mcm_profile_lcms1_unlock ();
+
+		/* lcms1 keeps its own private copy of the memory block */
+		egg_debug ("lcms copied %" G_GSIZE_FORMAT " bytes", length);
+
+		/* get the white point, black point and primaries now */
+		mcm_profile_lcms1_load_colorimetry (profile);
+	}
+
+	/* get the profile kind and colorspace */
+	mcm_profile_set_kind (profile, mcm_profile_lcms1_class_to_kind (mcm_parser_decode_32 (data + MCM_HEADER_CLASS)));
+	mcm_profile_set_colorspace (profile, mcm_profile_lcms1_color_space_to_colorspace (mcm_parser_decode_32 (data + MCM_HEADER_COLORSPACE)));
+
+	/* get the profile_lcms1 created time and date */
+	mcm_profile_lcms1_decode_datetime (data + MCM_HEADER_DATETIME, &created);
+	text = mcm_utils_format_date_time (&created);
+	mcm_profile_set_datetime (profile, text);
+	g_free (text);
+
+	/* get the curves for a matrix/TRC profile */
+	if (mcm_profile_get_colorspace (profile) == MCM_COLORSPACE_RGB)
+		mcm_profile_lcms1_load_matrix_shaper (profile_lcms1, tag_index);
+
+	/* get the metadata */
+	tag_data = mcm_tag_index_get_data (tag_index, icSigProfileDescriptionTag, &tag_size);
+	if (tag_data != NULL) {
+		text = mcm_profile_lcms1_parse_multi_localized_unicode (profile_lcms1, tag_data, tag_size);
+		mcm_profile_set_description (profile, text);
+		g_free (text);
+	}
+	tag_data = mcm_tag_index_get_data (tag_index, icSigCopyrightTag, &tag_size);
+	if (tag_data != NULL) {
+		text = mcm_profile_lcms1_parse_multi_localized_unicode (profile_lcms1, tag_data, tag_size);
+		mcm_profile_set_copyright (profile, text);
+		g_free (text);
+	}
+	tag_data = mcm_tag_index_get_data (tag_index, icSigDeviceMfgDescTag, &tag_size);
+	if (tag_data != NULL) {
+		text = mcm_profile_lcms1_parse_multi_localized_unicode (profile_lcms1, tag_data, tag_size);
+		mcm_profile_set_manufacturer (profile, text);
+		g_free (text);
+	}
+	tag_data = mcm_tag_index_get_data (tag_index, icSigDeviceModelDescTag, &tag_size);
+	if (tag_data != NULL) {
+		text = mcm_profile_lcms1_parse_multi_localized_unicode (profile_lcms1, tag_data, tag_size);
+		mcm_profile_set_model (profile, text);
+		g_free (text);
+	}
+
+	/* get the gamma tables */
+	tag_data = mcm_tag_index_get_data (tag_index, icSigMachineLookUpTableTag, &tag_size);
+	if (tag_data != NULL) {
+		ret = mcm_parser_load_icc_mlut (profile_lcms1, tag_data, tag_size);
+		if (!ret) {
+			g_set_error_literal (error, 1, 0, "failed to load mlut");
+			goto out;
 		}
-		if (tag_id == icSigVideoCartGammaTableTag) {
-			if (tag_size == 1584)
-				priv->adobe_gamma_workaround = TRUE;
-			ret = mcm_parser_load_icc_vcgt (profile_lcms1, data + tag_offset, tag_size);
-			if (!ret) {
-				g_set_error_literal (error, 1, 0, "failed to load vcgt");
-				goto out;
-			}
+	}
+	tag_data = mcm_tag_index_get_data (tag_index, icSigVideoCartGammaTableTag, &tag_size);
+	if (tag_data != NULL) {
+		if (tag_size == 1584)
+			priv->adobe_gamma_workaround = TRUE;
+		ret = mcm_parser_load_icc_vcgt (profile_lcms1, tag_data, tag_size);
+		if (!ret) {
+			g_set_error_literal (error, 1, 0, "failed to load vcgt");
+			goto out;
 		}
 	}
 
@@ -696,6 +940,7 @@ mcm_profile_lcms1_parse_data (McmProfile *profile, const guint8 *data, gsize len
 	/* set properties */
 	mcm_profile_set_has_vcgt (profile, priv->has_vcgt_formula || priv->has_vcgt_table);
 out:
+	mcm_tag_index_free (tag_index);
 	return ret;
 }
 
@@ -708,19 +953,14 @@ static McmClut *
 mcm_profile_lcms1_generate_vcgt (McmProfile *profile, guint size)
 {
 	guint i;
-	guint ratio;
-	McmClutData *tmp;
+	guint16 *ramps;
+	const guint16 *table = NULL;
+	guint table_size = 0;
 	McmClutData *vcgt_data;
-	McmClutData *mlut_data;
 	gfloat gamma_red, min_red, max_red;
 	gfloat gamma_green, min_green, max_green;
 	gfloat gamma_blue, min_blue, max_blue;
-	guint num_entries;
 	McmClut *clut = NULL;
-	GPtrArray *array = NULL;
-	gfloat inverse_ratio;
-	guint idx;
-	gfloat frac;
 	McmProfileLcms1 *profile_lcms1 = MCM_PROFILE_LCMS1 (profile);
 
 	g_return_val_if_fail (MCM_IS_PROFILE_LCMS1 (profile_lcms1), NULL);
@@ -728,51 +968,12 @@ mcm_profile_lcms1_generate_vcgt (McmProfile *profile, guint size)
 
 	/* reduce dereferences */
 	vcgt_data = profile_lcms1->priv->vcgt_data;
-	mlut_data = profile_lcms1->priv->mlut_data;
-
-	if (profile_lcms1->priv->has_vcgt_table) {
-
-		/* create array */
-		array = g_ptr_array_new_with_free_func (g_free);
-
-		/* simply subsample if the LUT is smaller than the number of entries in the file */
-		num_entries = profile_lcms1->priv->vcgt_data_size;
-		if (num_entries >= size) {
-			ratio = (guint) (num_entries / size);
-			for (i=0; i<size; i++) {
-				/* add a point */
-				tmp = g_new0 (McmClutData, 1);
-				tmp->red = vcgt_data[ratio*i].red;
-				tmp->green = vcgt_data[ratio*i].green;
-				tmp->blue = vcgt_data[ratio*i].blue;
-				g_ptr_array_add (array, tmp);
-			}
-			goto out;
-		}
-
-		/* LUT is bigger than number of entries, so interpolate */
-		inverse_ratio = (gfloat) num_entries / size;
-		vcgt_data[num_entries].red = 0xffff;
-		vcgt_data[num_entries].green = 0xffff;
-		vcgt_data[num_entries].blue = 0xffff;
-
-		/* interpolate */
-		for (i=0; i<size; i++) {
-			idx = floor(i*inverse_ratio);
-			frac = (i*inverse_ratio) - idx;
-			tmp = g_new0 (McmClutData, 1);
-			tmp->red = vcgt_data[idx].red * (1.0f-frac) + vcgt_data[idx + 1].red * frac;
-			tmp->green = vcgt_data[idx].green * (1.0f-frac) + vcgt_data[idx + 1].green * frac;
-			tmp->blue = vcgt_data[idx].blue * (1.0f-frac) + vcgt_data[idx + 1].blue * frac;
-			g_ptr_array_add (array, tmp);
-		}
-		goto out;
-	}
 
 	if (profile_lcms1->priv->has_vcgt_formula) {
 
-		/* create array */
-		array = g_ptr_array_new_with_free_func (g_free);
+		/* create the ramps */
+		clut = mcm_clut_new ();
+		ramps = mcm_clut_get_source_buffer (clut, size);
 
 		gamma_red = (gfloat) vcgt_data[0].red / 65536.0;
 		gamma_green = (gfloat) vcgt_data[0].green / 65536.0;
@@ -785,47 +986,52 @@ mcm_profile_lcms1_generate_vcgt (McmProfile *profile, guint size)
 		max_blue = (gfloat) vcgt_data[2].blue / 65536.0;
 
 		/* create mapping of desired size */
-		for (i=0; i<size; i++) {
-			/* add a point */
-			tmp = g_new0 (McmClutData, 1);
-			tmp->red = 65536.0 * ((gdouble) pow ((gdouble) i / (gdouble) size, gamma_red) * (max_red - min_red) + min_red);
-			tmp->green = 65536.0 * ((gdouble) pow ((gdouble) i / (gdouble) size, gamma_green) * (max_green - min_green) + min_green);
-			tmp->blue = 65536.0 * ((gdouble) pow ((gdouble) i / (gdouble) size, gamma_blue) * (max_blue - min_blue) + min_blue);
-			g_ptr_array_add (array, tmp);
-		}
+		mcm_ramp_formula (ramps, size, gamma_red, min_red, max_red);
+		mcm_ramp_formula (ramps + size, size, gamma_green, min_green, max_green);
+		mcm_ramp_formula (ramps + size * 2, size, gamma_blue, min_blue, max_blue);
 		goto out;
 	}
 
-	if (profile_lcms1->priv->has_mlut) {
+	/* both tables are planar, so they can be resampled a channel at a time */
+	if (profile_lcms1->priv->has_vcgt_table) {
+		table = profile_lcms1->priv->vcgt_table;
+		table_size = profile_lcms1->priv->vcgt_table_size;
+	} else if (profile_lcms1->priv->has_mlut) {
+		table = profile_lcms1->priv->mlut_data;
+		table_size = 256;
+	}
+	if (table != NULL) {
 
-		/* create array */
-		array = g_ptr_array_new_with_free_func (g_free);
+		/* create the ramps */
+		clut = mcm_clut_new ();
+		ramps = mcm_clut_get_source_buffer (clut, size);
 
-		/* roughly interpolate table */
-		ratio = (guint) (256 / (size));
-		for (i=0; i<size; i++) {
-			/* add a point */
-			tmp = g_new0 (McmClutData, 1);
-			tmp->red = mlut_data[ratio*i].red;
-			tmp->green = mlut_data[ratio*i].green;
-			tmp->blue = mlut_data[ratio*i].blue;
-			g_ptr_array_add (array, tmp);
-		}
+		/* resample each channel to the size of the device LUT */
+		for (i=0; i<3; i++)
+			mcm_resample_ramp (MCM_RESAMPLE_KIND_CUBIC, table + i * table_size, table_size, ramps + i * size, size);
 		goto out;
 	}
 
 	/* bugger */
 	egg_debug ("no LUT to generate");
 out:
-	if (array != NULL) {
-		/* create new output array */
-		clut = mcm_clut_new ();
-		mcm_clut_set_source_array (clut, array);
-		g_ptr_array_unref (array);
-	}
 	return clut;
 }
 
+/**
+ * mcm_profile_lcms1_open_cb:
+ *
+ * Lends our own lcms profile to the transform cache.
+ **/
+static gpointer
+mcm_profile_lcms1_open_cb (McmProfileLcms1 *profile_lcms1, gboolean *borrowed)
+{
+	if (!mcm_profile_lcms1_ensure_lcms_profile (profile_lcms1))
+		return NULL;
+	*borrowed = TRUE;
+	return profile_lcms1->priv->lcms_profile;
+}
+
 /**
  * mcm_profile_lcms1_generate_curve:
  *
@@ -838,17 +1044,20 @@ mcm_profile_lcms1_generate_curve (McmProfile *profile, guint size)
 	gdouble *values_in = NULL;
 	gdouble *values_out = NULL;
 	guint i;
-	McmClutData *data;
-	GPtrArray *array = NULL;
+	guint16 *ramps;
 	gfloat divamount;
 	gfloat divadd;
 	guint component_width;
-	cmsHPROFILE srgb_profile_lcms1 = NULL;
-	cmsHTRANSFORM transform = NULL;
+	McmTransform *transform = NULL;
 	guint type;
 	McmColorspace colorspace;
 	McmProfileLcms1 *profile_lcms1 = MCM_PROFILE_LCMS1 (profile);
-	McmProfileLcms1Private *priv = profile_lcms1->priv;
+
+	/* matrix/TRC profiles do not need lcms at all */
+	if (profile_lcms1->priv->trc[0] != NULL && size > 1) {
+		clut = mcm_trc_generate_curve (profile_lcms1->priv->trc, profile_lcms1->priv->colorants, size);
+		goto out;
+	}
 
 	/* run through the profile */
 	colorspace = mcm_profile_get_colorspace (profile);
@@ -886,39 +1095,33 @@ mcm_profile_lcms1_generate_curve (McmProfile *profile, guint size)
 		/* create output array */
 		values_out = g_new0 (gdouble, size * 3 * component_width);
 
-		/* create a transform from profile_lcms1 to sRGB */
-		srgb_profile_lcms1 = cmsCreate_sRGBProfile ();
-		transform = cmsCreateTransform (priv->lcms_profile, type, srgb_profile_lcms1, TYPE_RGB_DBL, INTENT_PERCEPTUAL, 0);
+		/* get a transform from profile_lcms1 to sRGB, which we only open lcms for if not cached */
+		mcm_profile_lcms1_lock ();
+		transform = mcm_transform_cache_get (mcm_profile_get_id (profile),
+						     (McmTransformCacheOpenFunc) mcm_profile_lcms1_open_cb, profile_lcms1,
+						     MCM_TRANSFORM_CACHE_ID_SRGB, mcm_transform_cache_open_builtin, (gpointer) MCM_TRANSFORM_CACHE_ID_SRGB,
+						     type, TYPE_RGB_DBL, INTENT_PERCEPTUAL, 0);
+		if (transform != NULL)
+			mcm_transform_do_transform (transform, values_in, values_out, size * 3);
+		mcm_profile_lcms1_unlock ();
 		if (transform == NULL)
 			goto out;
 
-		/* do transform */
-		cmsDoTransform (transform, values_in, values_out, size * 3);
-
-		/* create output array */
-		array = g_ptr_array_new_with_free_func (g_free);
-
+		/* write straight into the planar ramps */
+		clut = mcm_clut_new ();
+		ramps = mcm_clut_get_source_buffer (clut, size);
 		for (i=0; i<size; i++) {
-			data = g_new0 (McmClutData, 1);
-
-			data->red = values_out[(i * 3 * component_width)+0] * (gfloat) 0xffff;
-			data->green = values_out[(i * 3 * component_width)+4] * (gfloat) 0xffff;
-			data->blue = values_out[(i * 3 * component_width)+8] * (gfloat) 0xffff;
-			g_ptr_array_add (array, data);
+			ramps[i] = CLAMP (values_out[(i * 3 * component_width)+0], 0.0, 1.0) * (gfloat) 0xffff;
+			ramps[size + i] = CLAMP (values_out[(i * 3 * component_width)+4], 0.0, 1.0) * (gfloat) 0xffff;
+			ramps[size * 2 + i] = CLAMP (values_out[(i * 3 * component_width)+8], 0.0, 1.0) * (gfloat) 0xffff;
 		}
-		clut = mcm_clut_new ();
-		mcm_clut_set_source_array (clut, array);
 	}
 
 out:
 	g_free (values_in);
 	g_free (values_out);
-	if (array != NULL)
-		g_ptr_array_unref (array);
 	if (transform != NULL)
-		cmsDeleteTransform (transform);
-	if (srgb_profile_lcms1 != NULL)
-		cmsCloseProfile (srgb_profile_lcms1);
+		mcm_transform_unref (transform);
 	return clut;
 }
 
@@ -929,6 +1132,9 @@ static int
 mcm_profile_lcms1_lcms_error_cb (int ErrorCode, const char *ErrorText)
 {
 	egg_warning ("LCMS error %i: %s", ErrorCode, ErrorText);
+
+	/* save for the caller on this thread */
+	g_static_private_set (&mcm_profile_lcms1_error_text, g_strdup (ErrorText), g_free);
 	return LCMS_ERRC_WARNING;
 }
 
@@ -946,8 +1152,14 @@ mcm_profile_lcms1_class_init (McmProfileLcms1Class *klass)
 	parent_class->save = mcm_profile_lcms1_save;
 	parent_class->generate_vcgt = mcm_profile_lcms1_generate_vcgt;
 	parent_class->generate_curve = mcm_profile_lcms1_generate_curve;
+	parent_class->load_colorimetry = mcm_profile_lcms1_load_colorimetry;
 
 	g_type_class_add_private (klass, sizeof (McmProfileLcms1Private));
+
+	/* setup LCMS once, as this is global state */
+	cmsSetErrorHandler (mcm_profile_lcms1_lcms_error_cb);
+	cmsErrorAction (LCMS_ERROR_SHOW);
+	cmsSetLanguage ("en", "US");
 }
 
 /**
@@ -958,13 +1170,9 @@ mcm_profile_lcms1_init (McmProfileLcms1 *profile_lcms1)
 {
 	profile_lcms1->priv = MCM_PROFILE_LCMS1_GET_PRIVATE (profile_lcms1);
 	profile_lcms1->priv->vcgt_data = NULL;
+	profile_lcms1->priv->vcgt_table = NULL;
 	profile_lcms1->priv->mlut_data = NULL;
 	profile_lcms1->priv->adobe_gamma_workaround = FALSE;
-
-	/* setup LCMS */
-	cmsSetErrorHandler (mcm_profile_lcms1_lcms_error_cb);
-	cmsErrorAction (LCMS_ERROR_SHOW);
-	cmsSetLanguage ("en", "US");
 }
 
 /**
@@ -975,12 +1183,19 @@ mcm_profile_lcms1_finalize (GObject *object)
 {
 	McmProfileLcms1 *profile_lcms1 = MCM_PROFILE_LCMS1 (object);
 	McmProfileLcms1Private *priv = profile_lcms1->priv;
+	guint i;
 
-	if (priv->lcms_profile != NULL)
+	if (priv->lcms_profile != NULL) {
+		mcm_profile_lcms1_lock ();
 		cmsCloseProfile (priv->lcms_profile);
+		mcm_profile_lcms1_unlock ();
+	}
 
 	g_free (priv->vcgt_data);
+	g_free (priv->vcgt_table);
 	g_free (priv->mlut_data);
+	for (i=0; i<3; i++)
+		mcm_trc_free (priv->trc[i]);
 
 	G_OBJECT_CLASS (mcm_profile_lcms1_parent_class)->finalize (object);
 }
@@ -0,0 +1,720 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * SECTION:mcm-profile-lcms2
+ * @short_description: A parser object that uses lcms2 to read ICC profiles.
+ *
+ * Each object has its own lcms2 context, so profiles can be parsed and
+ * transforms created on different threads at the same time.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+#include <glib/gi18n.h>
+#include <string.h>
+#include <lcms2.h>
+
+#include "egg-debug.h"
+
+#include "mcm-profile-lcms2.h"
+#include "mcm-resample.h"
+#include "mcm-transform-cache.h"
+#include "mcm-trc.h"
+#include "mcm-utils.h"
+#include "mcm-xyz.h"
+
+static void     mcm_profile_lcms2_finalize	(GObject     *object);
+
+#define MCM_PROFILE_LCMS2_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), MCM_TYPE_PROFILE_LCMS2, McmProfileLcms2Private))
+
+#define cmsSigMachineLookUpTableTag	((cmsTagSignature) 0x6d4c5554)
+
+#define MCM_MLUT_RED			0x000
+#define MCM_MLUT_GREEN			0x200
+#define MCM_MLUT_BLUE			0x400
+#define MCM_MLUT_SIZE			0x600
+
+/**
+ * McmProfileLcms2Private:
+ *
+ * Private #McmProfileLcms2 data
+ **/
+struct _McmProfileLcms2Private
+{
+	gboolean			 loaded;
+	gboolean			 has_colorimetry;
+	cmsContext			 context;
+	cmsHPROFILE			 lcms_profile;
+	cmsToneCurve			*vcgt[3];
+	guint16				*mlut_data;
+	McmTrc				*trc[3];
+	gdouble				 colorants[9];
+	gchar				*error_text;
+};
+
+G_DEFINE_TYPE (McmProfileLcms2, mcm_profile_lcms2, MCM_TYPE_PROFILE)
+
+/**
+ * mcm_profile_lcms2_ensure_lcms_profile:
+ *
+ * Opens the lcms profile on demand, which is only needed for profiles
+ * that were parsed in lightweight mode.
+ **/
+static gboolean
+mcm_profile_lcms2_ensure_lcms_profile (McmProfileLcms2 *profile_lcms2)
+{
+	const gchar *filename;
+	McmProfileLcms2Private *priv = profile_lcms2->priv;
+
+	/* already open */
+	if (priv->lcms_profile != NULL)
+		return TRUE;
+
+	/* we don't keep the data around, so we have to go back to the file */
+	filename = mcm_profile_get_filename (MCM_PROFILE (profile_lcms2));
+	if (filename == NULL) {
+		egg_warning ("cannot open lcms profile, no filename");
+		return FALSE;
+	}
+	priv->lcms_profile = cmsOpenProfileFromFileTHR (priv->context, filename, "r");
+	if (priv->lcms_profile == NULL) {
+		egg_warning ("failed to open %s with lcms", filename);
+		return FALSE;
+	}
+	egg_debug ("opened %s with lcms on demand", filename);
+	return TRUE;
+}
+
+/**
+ * mcm_profile_lcms2_save:
+ **/
+static gboolean
+mcm_profile_lcms2_save (McmProfile *profile, const gchar *filename, GError **error)
+{
+	McmProfileLcms2 *profile_lcms2 = MCM_PROFILE_LCMS2 (profile);
+	McmProfileLcms2Private *priv = profile_lcms2->priv;
+
+	if (!mcm_profile_lcms2_ensure_lcms_profile (profile_lcms2)) {
+		g_set_error_literal (error, 1, 0, "failed to open profile");
+		return FALSE;
+	}
+	if (!cmsSaveProfileToFile (priv->lcms_profile, filename)) {
+		g_set_error (error, 1, 0, "failed to save profile: %s",
+			     priv->error_text != NULL ? priv->error_text : "unknown error");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * mcm_profile_lcms2_set_xyz:
+ **/
+static void
+mcm_profile_lcms2_set_xyz (McmProfile *profile, const gchar *property, const cmsCIEXYZ *cie_xyz)
+{
+	McmXyz *xyz;
+
+	xyz = mcm_xyz_new ();
+	g_object_set (xyz,
+		      "cie-x", cie_xyz->X,
+		      "cie-y", cie_xyz->Y,
+		      "cie-z", cie_xyz->Z,
+		      NULL);
+	g_object_set (profile,
+		      property, xyz,
+		      NULL);
+	g_object_unref (xyz);
+}
+
+/**
+ * mcm_profile_lcms2_load_colorimetry:
+ *
+ * Gets the white point, black point and primaries, which need lcms.
+ **/
+static gboolean
+mcm_profile_lcms2_load_colorimetry (McmProfile *profile)
+{
+	gboolean ret;
+	const cmsCIEXYZ *tag;
+	cmsCIEXYZ cie_xyz;
+	cmsCIEXYZ cie_illum[3];
+	cmsHPROFILE xyz_profile_lcms2;
+	cmsHTRANSFORM transform;
+	gdouble rgb_values[3];
+	guint i;
+	McmProfileLcms2 *profile_lcms2 = MCM_PROFILE_LCMS2 (profile);
+	McmProfileLcms2Private *priv = profile_lcms2->priv;
+
+	/* only try once, even if it failed */
+	if (priv->has_colorimetry)
+		return TRUE;
+	priv->has_colorimetry = TRUE;
+
+	ret = mcm_profile_lcms2_ensure_lcms_profile (profile_lcms2);
+	if (!ret)
+		goto out;
+
+	/* get white point */
+	tag = cmsReadTag (priv->lcms_profile, cmsSigMediaWhitePointTag);
+	if (tag != NULL)
+		mcm_profile_lcms2_set_xyz (profile, "white", tag);
+	else
+		egg_warning ("failed to get white point");
+
+	/* get black point */
+	tag = cmsReadTag (priv->lcms_profile, cmsSigMediaBlackPointTag);
+	if (tag != NULL) {
+		mcm_profile_lcms2_set_xyz (profile, "black", tag);
+	} else if (cmsDetectBlackPoint (&cie_xyz, priv->lcms_profile, INTENT_PERCEPTUAL, 0)) {
+		mcm_profile_lcms2_set_xyz (profile, "black", &cie_xyz);
+	} else {
+		egg_warning ("failed to get black point");
+	}
+
+	/* get primary illuminants */
+	ret = FALSE;
+	tag = cmsReadTag (priv->lcms_profile, cmsSigRedColorantTag);
+	if (tag != NULL) {
+		cie_illum[0] = *tag;
+		tag = cmsReadTag (priv->lcms_profile, cmsSigGreenColorantTag);
+	}
+	if (tag != NULL) {
+		cie_illum[1] = *tag;
+		tag = cmsReadTag (priv->lcms_profile, cmsSigBlueColorantTag);
+	}
+	if (tag != NULL) {
+		cie_illum[2] = *tag;
+		ret = TRUE;
+	}
+
+	/* geting the illuminants failed, try running it through the profile */
+	if (!ret && cmsGetColorSpace (priv->lcms_profile) == cmsSigRgbData) {
+
+		/* create a transform from profile to XYZ */
+		xyz_profile_lcms2 = cmsCreateXYZProfileTHR (priv->context);
+		transform = cmsCreateTransformTHR (priv->context, priv->lcms_profile, TYPE_RGB_DBL,
+						   xyz_profile_lcms2, TYPE_XYZ_DBL, INTENT_PERCEPTUAL, 0);
+		if (transform != NULL) {
+			for (i=0; i<3; i++) {
+				rgb_values[0] = (i == 0) ? 1.0 : 0.0;
+				rgb_values[1] = (i == 1) ? 1.0 : 0.0;
+				rgb_values[2] = (i == 2) ? 1.0 : 0.0;
+				cmsDoTransform (transform, rgb_values, &cie_illum[i], 1);
+			}
+
+			/* we're done */
+			cmsDeleteTransform (transform);
+			ret = TRUE;
+		}
+
+		/* no more need for the output profile */
+		cmsCloseProfile (xyz_profile_lcms2);
+	}
+
+	/* we've got valid values */
+	if (ret) {
+		mcm_profile_lcms2_set_xyz (profile, "red", &cie_illum[0]);
+		mcm_profile_lcms2_set_xyz (profile, "green", &cie_illum[1]);
+		mcm_profile_lcms2_set_xyz (profile, "blue", &cie_illum[2]);
+	} else {
+		egg_debug ("failed to get luminance values");
+	}
+out:
+	return ret;
+}
+
+/**
+ * mcm_profile_lcms2_class_to_kind:
+ **/
+static McmProfileKind
+mcm_profile_lcms2_class_to_kind (cmsProfileClassSignature profile_class)
+{
+	switch (profile_class) {
+	case cmsSigInputClass:
+		return MCM_PROFILE_KIND_INPUT_DEVICE;
+	case cmsSigDisplayClass:
+		return MCM_PROFILE_KIND_DISPLAY_DEVICE;
+	case cmsSigOutputClass:
+		return MCM_PROFILE_KIND_OUTPUT_DEVICE;
+	case cmsSigLinkClass:
+		return MCM_PROFILE_KIND_DEVICELINK;
+	case cmsSigColorSpaceClass:
+		return MCM_PROFILE_KIND_COLORSPACE_CONVERSION;
+	case cmsSigAbstractClass:
+		return MCM_PROFILE_KIND_ABSTRACT;
+	case cmsSigNamedColorClass:
+		return MCM_PROFILE_KIND_NAMED_COLOR;
+	default:
+		return MCM_PROFILE_KIND_UNKNOWN;
+	}
+}
+
+/**
+ * mcm_profile_lcms2_color_space_to_colorspace:
+ **/
+static McmColorspace
+mcm_profile_lcms2_color_space_to_colorspace (cmsColorSpaceSignature color_space)
+{
+	switch (color_space) {
+	case cmsSigXYZData:
+		return MCM_COLORSPACE_XYZ;
+	case cmsSigLabData:
+		return MCM_COLORSPACE_LAB;
+	case cmsSigLuvData:
+		return MCM_COLORSPACE_LUV;
+	case cmsSigYCbCrData:
+		return MCM_COLORSPACE_YCBCR;
+	case cmsSigYxyData:
+		return MCM_COLORSPACE_YXY;
+	case cmsSigRgbData:
+		return MCM_COLORSPACE_RGB;
+	case cmsSigGrayData:
+		return MCM_COLORSPACE_GRAY;
+	case cmsSigHsvData:
+		return MCM_COLORSPACE_HSV;
+	case cmsSigCmykData:
+		return MCM_COLORSPACE_CMYK;
+	case cmsSigCmyData:
+		return MCM_COLORSPACE_CMY;
+	default:
+		return MCM_COLORSPACE_UNKNOWN;
+	}
+}
+
+/**
+ * mcm_profile_lcms2_get_info:
+ *
+ * Return value: the text for the tag, or %NULL. Free with g_free()
+ **/
+static gchar *
+mcm_profile_lcms2_get_info (McmProfileLcms2 *profile_lcms2, cmsInfoType info)
+{
+	gchar *text;
+	cmsUInt32Number size;
+	cmsHPROFILE lcms_profile = profile_lcms2->priv->lcms_profile;
+
+	size = cmsGetProfileInfoASCII (lcms_profile, info, "en", "US", NULL, 0);
+	if (size == 0)
+		return NULL;
+	text = g_new0 (gchar, size + 1);
+	cmsGetProfileInfoASCII (lcms_profile, info, "en", "US", text, size);
+	mcm_utils_ensure_printable (text);
+	return text;
+}
+
+/**
+ * mcm_profile_lcms2_load_mlut:
+ **/
+static gboolean
+mcm_profile_lcms2_load_mlut (McmProfileLcms2 *profile_lcms2)
+{
+	guint i;
+	guint8 *data;
+	cmsUInt32Number size;
+	McmProfileLcms2Private *priv = profile_lcms2->priv;
+
+	/* lcms2 does not know about this tag, so decode it ourselves */
+	data = g_new0 (guint8, MCM_MLUT_SIZE);
+	size = cmsReadRawTag (priv->lcms_profile, cmsSigMachineLookUpTableTag, data, MCM_MLUT_SIZE);
+	if (size < MCM_MLUT_SIZE) {
+		egg_warning ("mlut tag too small: %u bytes", size);
+		g_free (data);
+		return FALSE;
+	}
+
+	/* planar 256 entries for each channel */
+	priv->mlut_data = g_new0 (guint16, 256 * 3);
+	for (i=0; i<256 * 3; i++)
+		priv->mlut_data[i] = (data[i*2] << 8) | data[i*2 + 1];
+	g_free (data);
+	return TRUE;
+}
+
+/**
+ * mcm_profile_lcms2_load_matrix_shaper:
+ *
+ * Decodes the TRC and colorant tags of a matrix/TRC RGB profile, so
+ * curves can be generated without creating a transform.
+ **/
+static void
+mcm_profile_lcms2_load_matrix_shaper (McmProfileLcms2 *profile_lcms2)
+{
+	guint i;
+	guint8 *data;
+	cmsUInt32Number size;
+	cmsCIEXYZ *colorant;
+	GError *error = NULL;
+	McmProfileLcms2Private *priv = profile_lcms2->priv;
+	const cmsTagSignature trc_tags[] = { cmsSigRedTRCTag, cmsSigGreenTRCTag, cmsSigBlueTRCTag };
+	const cmsTagSignature colorant_tags[] = { cmsSigRedColorantTag, cmsSigGreenColorantTag, cmsSigBlueColorantTag };
+
+	/* lcms would use the LUT rather than the matrix */
+	if (cmsIsTag (priv->lcms_profile, cmsSigAToB0Tag))
+		return;
+
+	for (i=0; i<3; i++) {
+		colorant = cmsReadTag (priv->lcms_profile, colorant_tags[i]);
+		if (colorant == NULL)
+			goto out;
+		priv->colorants[i*3 + 0] = colorant->X;
+		priv->colorants[i*3 + 1] = colorant->Y;
+		priv->colorants[i*3 + 2] = colorant->Z;
+
+		/* get the tag as stored, as we decode it ourselves */
+		size = cmsReadRawTag (priv->lcms_profile, trc_tags[i], NULL, 0);
+		if (size == 0)
+			goto out;
+		data = g_new (guint8, size);
+		cmsReadRawTag (priv->lcms_profile, trc_tags[i], data, size);
+		priv->trc[i] = mcm_trc_new_from_data (data, size, &error);
+		g_free (data);
+		if (priv->trc[i] == NULL) {
+			egg_debug ("failed to load TRC: %s", error->message);
+			g_error_free (error);
+			goto out;
+		}
+	}
+	return;
+out:
+	/* we need all three or nothing */
+	for (i=0; i<3; i++) {
+		mcm_trc_free (priv->trc[i]);
+		priv->trc[i] = NULL;
+	}
+}
+
+/**
+ * mcm_profile_lcms2_parse_data:
+ *
+ * In lightweight mode the lcms profile is closed again as soon as the
+ * metadata and the VCGT have been read, and is reopened from the file
+ * if the colorimetry or a curve is requested.
+ **/
+static gboolean
+mcm_profile_lcms2_parse_data (McmProfile *profile, const guint8 *data, gsize length, GError **error)
+{
+	gboolean ret = FALSE;
+	struct tm created;
+	gchar *text;
+	guint i;
+	cmsToneCurve **vcgt;
+	McmProfileLcms2 *profile_lcms2 = MCM_PROFILE_LCMS2 (profile);
+	McmProfileLcms2Private *priv = profile_lcms2->priv;
+
+	g_return_val_if_fail (MCM_IS_PROFILE_LCMS2 (profile_lcms2), FALSE);
+	g_return_val_if_fail (data != NULL, FALSE);
+	g_return_val_if_fail (priv->loaded == FALSE, FALSE);
+
+	priv->loaded = TRUE;
+
+	/* lcms2 only reads the tags when they are asked for */
+	priv->lcms_profile = cmsOpenProfileFromMemTHR (priv->context, data, length);
+	if (priv->lcms_profile == NULL) {
+		g_set_error (error, 1, 0, "failed to load: %s",
+			     priv->error_text != NULL ? priv->error_text : "not an ICC profile");
+		goto out;
+	}
+
+	/* get the profile kind and colorspace */
+	mcm_profile_set_kind (profile, mcm_profile_lcms2_class_to_kind (cmsGetDeviceClass (priv->lcms_profile)));
+	mcm_profile_set_colorspace (profile, mcm_profile_lcms2_color_space_to_colorspace (cmsGetColorSpace (priv->lcms_profile)));
+
+	/* get the profile created time and date */
+	if (cmsGetHeaderCreationDateTime (priv->lcms_profile, &created)) {
+		text = mcm_utils_format_date_time (&created);
+		mcm_profile_set_datetime (profile, text);
+		g_free (text);
+	}
+
+	/* get the metadata */
+	text = mcm_profile_lcms2_get_info (profile_lcms2, cmsInfoDescription);
+	mcm_profile_set_description (profile, text);
+	g_free (text);
+	text = mcm_profile_lcms2_get_info (profile_lcms2, cmsInfoCopyright);
+	mcm_profile_set_copyright (profile, text);
+	g_free (text);
+	text = mcm_profile_lcms2_get_info (profile_lcms2, cmsInfoManufacturer);
+	mcm_profile_set_manufacturer (profile, text);
+	g_free (text);
+	text = mcm_profile_lcms2_get_info (profile_lcms2, cmsInfoModel);
+	mcm_profile_set_model (profile, text);
+	g_free (text);
+
+	/* get the gamma tables */
+	if (cmsIsTag (priv->lcms_profile, cmsSigMachineLookUpTableTag)) {
+		ret = mcm_profile_lcms2_load_mlut (profile_lcms2);
+		if (!ret) {
+			g_set_error_literal (error, 1, 0, "failed to load mlut");
+			goto out;
+		}
+	}
+	if (cmsIsTag (priv->lcms_profile, cmsSigVcgtTag)) {
+		vcgt = cmsReadTag (priv->lcms_profile, cmsSigVcgtTag);
+		if (vcgt == NULL || vcgt[0] == NULL) {
+			g_set_error_literal (error, 1, 0, "failed to load vcgt");
+			ret = FALSE;
+			goto out;
+		}
+
+		/* the tag data is owned by the lcms profile, which we might close */
+		for (i=0; i<3; i++)
+			priv->vcgt[i] = cmsDupToneCurve (vcgt[i]);
+	}
+
+	/* get the curves for a matrix/TRC profile */
+	if (mcm_profile_get_colorspace (profile) == MCM_COLORSPACE_RGB)
+		mcm_profile_lcms2_load_matrix_shaper (profile_lcms2);
+
+	/* get the white point, black point and primaries now */
+	if (!mcm_profile_get_lightweight (profile))
+		mcm_profile_lcms2_load_colorimetry (profile);
+
+	/* success */
+	ret = TRUE;
+
+	/* set properties */
+	mcm_profile_set_has_vcgt (profile, priv->vcgt[0] != NULL);
+out:
+	/* don't keep the copy of the data that lcms2 made */
+	if (mcm_profile_get_lightweight (profile) && priv->lcms_profile != NULL) {
+		cmsCloseProfile (priv->lcms_profile);
+		priv->lcms_profile = NULL;
+	}
+	return ret;
+}
+
+/**
+ * mcm_profile_lcms2_generate_vcgt:
+ *
+ * Free with g_object_unref();
+ **/
+static McmClut *
+mcm_profile_lcms2_generate_vcgt (McmProfile *profile, guint size)
+{
+	guint i;
+	guint16 in;
+	guint16 *ramps;
+	McmClut *clut = NULL;
+	McmProfileLcms2 *profile_lcms2 = MCM_PROFILE_LCMS2 (profile);
+	McmProfileLcms2Private *priv = profile_lcms2->priv;
+
+	g_return_val_if_fail (MCM_IS_PROFILE_LCMS2 (profile_lcms2), NULL);
+	g_return_val_if_fail (size != 0, FALSE);
+
+	if (priv->vcgt[0] != NULL) {
+
+		/* lcms2 interpolates both the formula and the table types */
+		clut = mcm_clut_new ();
+		ramps = mcm_clut_get_source_buffer (clut, size);
+		for (i=0; i<size; i++) {
+			in = (size > 1) ? (guint16) ((i * 0xffff) / (size - 1)) : 0;
+			ramps[i] = cmsEvalToneCurve16 (priv->vcgt[0], in);
+			ramps[size + i] = cmsEvalToneCurve16 (priv->vcgt[1], in);
+			ramps[size * 2 + i] = cmsEvalToneCurve16 (priv->vcgt[2], in);
+		}
+		goto out;
+	}
+
+	if (priv->mlut_data != NULL) {
+
+		/* resample each channel to the size of the device LUT */
+		clut = mcm_clut_new ();
+		ramps = mcm_clut_get_source_buffer (clut, size);
+		mcm_resample_ramp (MCM_RESAMPLE_KIND_CUBIC, priv->mlut_data + (MCM_MLUT_RED / 2), 256, ramps, size);
+		mcm_resample_ramp (MCM_RESAMPLE_KIND_CUBIC, priv->mlut_data + (MCM_MLUT_GREEN / 2), 256, ramps + size, size);
+		mcm_resample_ramp (MCM_RESAMPLE_KIND_CUBIC, priv->mlut_data + (MCM_MLUT_BLUE / 2), 256, ramps + size * 2, size);
+		goto out;
+	}
+
+	/* bugger */
+	egg_debug ("no LUT to generate");
+out:
+	return clut;
+}
+
+/**
+ * mcm_profile_lcms2_open_cb:
+ *
+ * Lends our own lcms profile to the transform cache.
+ **/
+static gpointer
+mcm_profile_lcms2_open_cb (McmProfileLcms2 *profile_lcms2, gboolean *borrowed)
+{
+	if (!mcm_profile_lcms2_ensure_lcms_profile (profile_lcms2))
+		return NULL;
+	*borrowed = TRUE;
+	return profile_lcms2->priv->lcms_profile;
+}
+
+/**
+ * mcm_profile_lcms2_generate_curve:
+ *
+ * Free with g_object_unref();
+ **/
+static McmClut *
+mcm_profile_lcms2_generate_curve (McmProfile *profile, guint size)
+{
+	McmClut *clut = NULL;
+	gdouble *values_in = NULL;
+	gdouble *values_out = NULL;
+	guint i;
+	guint16 *ramps;
+	gdouble divadd;
+	McmTransform *transform = NULL;
+	McmProfileLcms2 *profile_lcms2 = MCM_PROFILE_LCMS2 (profile);
+
+	/* only RGB is supported */
+	if (mcm_profile_get_colorspace (profile) != MCM_COLORSPACE_RGB)
+		goto out;
+
+	/* matrix/TRC profiles do not need lcms at all */
+	if (profile_lcms2->priv->trc[0] != NULL && size > 1) {
+		clut = mcm_trc_generate_curve (profile_lcms2->priv->trc, profile_lcms2->priv->colorants, size);
+		goto out;
+	}
+
+	/* create input array, with one pixel for each channel */
+	values_in = g_new0 (gdouble, size * 3 * 3);
+	for (i=0; i<size; i++) {
+		divadd = (size > 1) ? (gdouble) i / (gdouble) (size - 1) : 0.0;
+		values_in[(i * 9)+0] = divadd;
+		values_in[(i * 9)+4] = divadd;
+		values_in[(i * 9)+8] = divadd;
+	}
+
+	/* get a transform from profile to sRGB, which we only open lcms for if not cached */
+	transform = mcm_transform_cache_get (mcm_profile_get_id (profile),
+					     (McmTransformCacheOpenFunc) mcm_profile_lcms2_open_cb, profile_lcms2,
+					     MCM_TRANSFORM_CACHE_ID_SRGB, mcm_transform_cache_open_builtin, (gpointer) MCM_TRANSFORM_CACHE_ID_SRGB,
+					     TYPE_RGB_DBL, TYPE_RGB_DBL, INTENT_PERCEPTUAL, 0);
+	if (transform == NULL)
+		goto out;
+
+	/* do transform */
+	values_out = g_new0 (gdouble, size * 3 * 3);
+	mcm_transform_do_transform (transform, values_in, values_out, size * 3);
+
+	/* write straight into the planar ramps */
+	clut = mcm_clut_new ();
+	ramps = mcm_clut_get_source_buffer (clut, size);
+	for (i=0; i<size; i++) {
+		ramps[i] = CLAMP (values_out[(i * 9)+0], 0.0, 1.0) * (gfloat) 0xffff;
+		ramps[size + i] = CLAMP (values_out[(i * 9)+4], 0.0, 1.0) * (gfloat) 0xffff;
+		ramps[size * 2 + i] = CLAMP (values_out[(i * 9)+8], 0.0, 1.0) * (gfloat) 0xffff;
+	}
+out:
+	g_free (values_in);
+	g_free (values_out);
+	if (transform != NULL)
+		mcm_transform_unref (transform);
+	return clut;
+}
+
+/**
+ * mcm_profile_lcms2_lcms_error_cb:
+ *
+ * The context belongs to one object, so the error is always for that profile.
+ **/
+static void
+mcm_profile_lcms2_lcms_error_cb (cmsContext context_id, cmsUInt32Number error_code, const char *error_text)
+{
+	McmProfileLcms2 *profile_lcms2 = cmsGetContextUserData (context_id);
+
+	egg_warning ("LCMS error %u: %s", error_code, error_text);
+	if (profile_lcms2 == NULL)
+		return;
+	g_free (profile_lcms2->priv->error_text);
+	profile_lcms2->priv->error_text = g_strdup (error_text);
+}
+
+/**
+ * mcm_profile_lcms2_class_init:
+ **/
+static void
+mcm_profile_lcms2_class_init (McmProfileLcms2Class *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	McmProfileClass *parent_class = MCM_PROFILE_CLASS (klass);
+	object_class->finalize = mcm_profile_lcms2_finalize;
+
+	parent_class->parse_data = mcm_profile_lcms2_parse_data;
+	parent_class->save = mcm_profile_lcms2_save;
+	parent_class->generate_vcgt = mcm_profile_lcms2_generate_vcgt;
+	parent_class->generate_curve = mcm_profile_lcms2_generate_curve;
+	parent_class->load_colorimetry = mcm_profile_lcms2_load_colorimetry;
+
+	g_type_class_add_private (klass, sizeof (McmProfileLcms2Private));
+}
+
+/**
+ * mcm_profile_lcms2_init:
+ **/
+static void
+mcm_profile_lcms2_init (McmProfileLcms2 *profile_lcms2)
+{
+	profile_lcms2->priv = MCM_PROFILE_LCMS2_GET_PRIVATE (profile_lcms2);
+	profile_lcms2->priv->mlut_data = NULL;
+	profile_lcms2->priv->error_text = NULL;
+
+	/* setup LCMS */
+	profile_lcms2->priv->context = cmsCreateContext (NULL, profile_lcms2);
+	cmsSetLogErrorHandlerTHR (profile_lcms2->priv->context, mcm_profile_lcms2_lcms_error_cb);
+}
+
+/**
+ * mcm_profile_lcms2_finalize:
+ **/
+static void
+mcm_profile_lcms2_finalize (GObject *object)
+{
+	McmProfileLcms2 *profile_lcms2 = MCM_PROFILE_LCMS2 (object);
+	McmProfileLcms2Private *priv = profile_lcms2->priv;
+	guint i;
+
+	if (priv->lcms_profile != NULL)
+		cmsCloseProfile (priv->lcms_profile);
+	if (priv->vcgt[0] != NULL)
+		cmsFreeToneCurveTriple (priv->vcgt);
+	cmsDeleteContext (priv->context);
+
+	g_free (priv->mlut_data);
+	g_free (priv->error_text);
+	for (i=0; i<3; i++)
+		mcm_trc_free (priv->trc[i]);
+
+	G_OBJECT_CLASS (mcm_profile_lcms2_parent_class)->finalize (object);
+}
+
+/**
+ * mcm_profile_lcms2_new:
+ *
+ * Return value: a new McmProfileLcms2 object.
+ **/
+McmProfileLcms2 *
+mcm_profile_lcms2_new (void)
+{
+	McmProfileLcms2 *profile_lcms2;
+	profile_lcms2 = g_object_new (MCM_TYPE_PROFILE_LCMS2, NULL);
+	return MCM_PROFILE_LCMS2 (profile_lcms2);
+}
+
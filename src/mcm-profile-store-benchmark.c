@@ -0,0 +1,275 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "egg-debug.h"
+
+#include "mcm-profile.h"
+#include "mcm-profile-store.h"
+
+#define MCM_PROFILE_STORE_BENCHMARK_BATCHES	5
+#define MCM_PROFILE_STORE_BENCHMARK_BATCH_SIZE	1000
+#define MCM_PROFILE_STORE_BENCHMARK_RESERVED	100	/* unused header bytes */
+
+/**
+ * mcm_profile_store_benchmark_create:
+ *
+ * Writes copies of the profile that all have a different content id.
+ **/
+static gboolean
+mcm_profile_store_benchmark_create (const gchar *dirname, const gchar *filename)
+{
+	guint i;
+	guint j;
+	guint32 serial;
+	gboolean ret;
+	gchar *data = NULL;
+	gchar *path;
+	gchar *batch;
+	gchar *name;
+	gsize length;
+	GError *error = NULL;
+
+	ret = g_file_get_contents (filename, &data, &length, &error);
+	if (!ret) {
+		g_print ("failed to load %s: %s\n", filename, error->message);
+		g_error_free (error);
+		goto out;
+	}
+	for (i=0; i<MCM_PROFILE_STORE_BENCHMARK_BATCHES; i++) {
+		batch = g_strdup_printf ("%s/%02i", dirname, i);
+		g_mkdir_with_parents (batch, 0700);
+		for (j=0; j<MCM_PROFILE_STORE_BENCHMARK_BATCH_SIZE; j++) {
+			serial = i * MCM_PROFILE_STORE_BENCHMARK_BATCH_SIZE + j + 1;
+			memcpy (data + MCM_PROFILE_STORE_BENCHMARK_RESERVED, &serial, sizeof (serial));
+			name = g_strdup_printf ("profile-%05i.icc", serial);
+			path = g_build_filename (batch, name, NULL);
+			ret = g_file_set_contents (path, data, length, &error);
+			g_free (name);
+			g_free (path);
+			if (!ret) {
+				g_print ("failed to write profile: %s\n", error->message);
+				g_error_free (error);
+				g_free (batch);
+				goto out;
+			}
+		}
+		g_free (batch);
+	}
+out:
+	g_free (data);
+	return ret;
+}
+
+/**
+ * mcm_profile_store_benchmark_remove:
+ **/
+static void
+mcm_profile_store_benchmark_remove (const gchar *dirname)
+{
+	guint i;
+	guint j;
+	gchar *path;
+
+	for (i=0; i<MCM_PROFILE_STORE_BENCHMARK_BATCHES; i++) {
+		for (j=0; j<MCM_PROFILE_STORE_BENCHMARK_BATCH_SIZE; j++) {
+			path = g_strdup_printf ("%s/%02i/profile-%05i.icc", dirname, i,
+						i * MCM_PROFILE_STORE_BENCHMARK_BATCH_SIZE + j + 1);
+			g_unlink (path);
+			g_free (path);
+		}
+		path = g_strdup_printf ("%s/%02i", dirname, i);
+		g_rmdir (path);
+		g_free (path);
+	}
+	g_rmdir (dirname);
+}
+
+/**
+ * mcm_profile_store_benchmark_new_profiles:
+ *
+ * Creates profiles with the metadata of @template but their own id and
+ * filename, without reading or parsing anything.
+ **/
+static GPtrArray *
+mcm_profile_store_benchmark_new_profiles (McmProfile *template, const gchar *dirname, guint batch)
+{
+	guint j;
+	guint serial;
+	gchar *text;
+	GPtrArray *profiles;
+	McmProfile *profile;
+
+	profiles = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	for (j=0; j<MCM_PROFILE_STORE_BENCHMARK_BATCH_SIZE; j++) {
+		serial = batch * MCM_PROFILE_STORE_BENCHMARK_BATCH_SIZE + j + 1;
+		profile = mcm_profile_default_new ();
+		mcm_profile_set_lightweight (profile, TRUE);
+		mcm_profile_set_kind (profile, mcm_profile_get_kind (template));
+		mcm_profile_set_colorspace (profile, mcm_profile_get_colorspace (template));
+		mcm_profile_set_description (profile, mcm_profile_get_description (template));
+		text = g_strdup_printf ("benchmark-%05i", serial);
+		mcm_profile_set_id (profile, text);
+		g_free (text);
+		text = g_strdup_printf ("%s/%02i/profile-%05i.icc", dirname, batch, serial);
+		mcm_profile_set_filename (profile, text);
+		g_free (text);
+		g_ptr_array_add (profiles, profile);
+	}
+	return profiles;
+}
+
+/**
+ * mcm_profile_store_benchmark_bookkeeping:
+ *
+ * Times only what the store does with a profile that has already been
+ * parsed, as reading and parsing the files costs far more than that.
+ **/
+static gboolean
+mcm_profile_store_benchmark_bookkeeping (const gchar *dirname, const gchar *filename)
+{
+	guint i;
+	guint j;
+	gboolean ret;
+	gdouble elapsed;
+	GFile *file;
+	GError *error = NULL;
+	GPtrArray *profiles;
+	GPtrArray *array;
+	GTimer *timer;
+	McmProfile *profile;
+	McmProfile *template;
+	McmProfileStore *profile_store;
+
+	/* the metadata that is copied to every profile */
+	template = mcm_profile_default_new ();
+	file = g_file_new_for_path (filename);
+	ret = mcm_profile_parse (template, file, &error);
+	g_object_unref (file);
+	if (!ret) {
+		g_print ("failed to parse %s: %s\n", filename, error->message);
+		g_error_free (error);
+		goto out;
+	}
+
+	/* each batch should take the same time however many are already added */
+	g_print ("store bookkeeping only:\n");
+	profile_store = mcm_profile_store_new ();
+	timer = g_timer_new ();
+	for (i=0; i<MCM_PROFILE_STORE_BENCHMARK_BATCHES; i++) {
+		profiles = mcm_profile_store_benchmark_new_profiles (template, dirname, i);
+		g_timer_reset (timer);
+		mcm_profile_store_add_profiles (profile_store, profiles);
+		elapsed = g_timer_elapsed (timer, NULL);
+		array = mcm_profile_store_get_array (profile_store);
+		g_print ("%5i profiles: %7.2fus per profile added\n",
+			 array->len, elapsed * 1e6 / MCM_PROFILE_STORE_BENCHMARK_BATCH_SIZE);
+		g_ptr_array_unref (array);
+		g_ptr_array_unref (profiles);
+	}
+
+	/* look up every profile by filename and by id */
+	array = mcm_profile_store_get_array (profile_store);
+	g_timer_reset (timer);
+	for (j=0; j<array->len; j++) {
+		profile = mcm_profile_store_get_by_filename (profile_store,
+							     mcm_profile_get_filename (g_ptr_array_index (array, j)));
+		g_object_unref (profile);
+	}
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_print ("%5i profiles: %7.2fus per lookup by filename\n", array->len, elapsed * 1e6 / array->len);
+	g_timer_reset (timer);
+	for (j=0; j<array->len; j++) {
+		profile = mcm_profile_store_get_by_id (profile_store,
+						       mcm_profile_get_id (g_ptr_array_index (array, j)));
+		g_object_unref (profile);
+	}
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_print ("%5i profiles: %7.2fus per lookup by id\n", array->len, elapsed * 1e6 / array->len);
+	g_ptr_array_unref (array);
+
+	g_timer_destroy (timer);
+	g_object_unref (profile_store);
+out:
+	g_object_unref (template);
+	return ret;
+}
+
+/**
+ * main:
+ **/
+int
+main (int argc, char **argv)
+{
+	guint i;
+	gboolean ret;
+	gdouble elapsed;
+	gchar *batch;
+	gchar *dirname;
+	const gchar *filename = "../data/tests/bluish.icc";
+	GPtrArray *array;
+	GTimer *timer;
+	McmProfileStore *profile_store;
+
+	if (! g_thread_supported ())
+		g_thread_init (NULL);
+	g_type_init ();
+	egg_debug_init (&argc, &argv);
+	if (argc > 1)
+		filename = argv[1];
+
+	dirname = g_build_filename (g_get_tmp_dir (), "mcm-profile-store-benchmark", NULL);
+	ret = mcm_profile_store_benchmark_bookkeeping (dirname, filename);
+	if (!ret)
+		goto out;
+	ret = mcm_profile_store_benchmark_create (dirname, filename);
+	if (!ret)
+		goto out;
+
+	/* the same, but reading and parsing the files */
+	g_print ("reading and parsing:\n");
+	profile_store = mcm_profile_store_new ();
+	timer = g_timer_new ();
+	for (i=0; i<MCM_PROFILE_STORE_BENCHMARK_BATCHES; i++) {
+		batch = g_strdup_printf ("%s/%02i", dirname, i);
+		g_timer_reset (timer);
+		mcm_profile_store_search_by_path (profile_store, batch);
+		elapsed = g_timer_elapsed (timer, NULL);
+		array = mcm_profile_store_get_array (profile_store);
+		g_print ("%5i profiles: %7.2fus per profile added\n",
+			 array->len, elapsed * 1e6 / MCM_PROFILE_STORE_BENCHMARK_BATCH_SIZE);
+		g_ptr_array_unref (array);
+		g_free (batch);
+	}
+
+	g_timer_destroy (timer);
+	g_object_unref (profile_store);
+out:
+	mcm_profile_store_benchmark_remove (dirname);
+	g_free (dirname);
+	return ret ? 0 : 1;
+}
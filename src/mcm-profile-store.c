@@ -31,13 +31,30 @@
 
 #include <glib-object.h>
 #include <gio/gio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 #include "mcm-profile-store.h"
+#include "mcm-profile-index.h"
+#include "mcm-scan-budget.h"
 #include "mcm-utils.h"
+#include "mcm-volume-cache.h"
 
 #include "egg-debug.h"
 
 static void     mcm_profile_store_finalize	(GObject     *object);
+static void     mcm_profile_store_schedule_commit (McmProfileStore *profile_store);
+static void     mcm_profile_store_scan_volumes	(McmProfileStore *profile_store);
+static void     mcm_profile_store_session_get_changes (McmProfileStore *profile_store);
+
+#define MCM_PROFILE_STORE_COMMIT_TIMEOUT	500 /* ms */
+#define MCM_PROFILE_STORE_SCAN_BATCH_SIZE	32
+#define MCM_PROFILE_STORE_SCAN_MAX_DEPTH	16
+#define MCM_PROFILE_STORE_VOLUME_TIME_BUDGET	5.0f /* seconds */
+#define MCM_PROFILE_STORE_VOLUME_IO_BUDGET	1000 /* directory entries and files */
+#define MCM_PROFILE_STORE_VOLUME_WATCHDOG	(MCM_PROFILE_STORE_VOLUME_TIME_BUDGET + 1.0f) /* seconds */
 
 #define MCM_PROFILE_STORE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), MCM_TYPE_PROFILE_STORE, McmProfileStorePrivate))
 
@@ -50,15 +67,40 @@ struct _McmProfileStorePrivate
 {
 	GPtrArray			*profile_array;
 	GPtrArray			*monitor_array;
-	GPtrArray			*directory_array;
+	GHashTable			*directory_hash;
+	GHashTable			*hash_filename;
+	GHashTable			*hash_id;
+	GHashTable			*hash_kind;
+	GHashTable			*hash_profile;
 	GVolumeMonitor			*volume_monitor;
 	GSettings			*settings;
+	McmProfileIndex			*profile_index;
+	GHashTable			*pending;
+	guint				 pending_id;
+	gboolean			 in_batch;
+	gboolean			 batch_changed;
+	GHashTable			*volume_jobs;
+	GHashTable			*volume_cache;
+	GDBusConnection			*connection;
+	guint				 session_signal_id;
+	guint				 session_watch_id;
+	guint				 session_serial;
+	gboolean			 session_pending;
+	gboolean			 session_dirty;
 };
 
+/* what to do with a path when the pending changes are committed */
+typedef enum {
+	MCM_PROFILE_STORE_PENDING_ADD = 1,
+	MCM_PROFILE_STORE_PENDING_REMOVE
+} McmProfileStorePending;
+
 enum {
 	SIGNAL_ADDED,
 	SIGNAL_REMOVED,
 	SIGNAL_CHANGED,
+	SIGNAL_SCAN_PROGRESS,
+	SIGNAL_SCAN_COMPLETE,
 	SIGNAL_LAST
 };
 
@@ -82,23 +124,6 @@ mcm_profile_store_get_array (McmProfileStore *profile_store)
 	return g_ptr_array_ref (profile_store->priv->profile_array);
 }
 
-/**
- * mcm_profile_store_in_array:
- **/
-static gboolean
-mcm_profile_store_in_array (GPtrArray *array, const gchar *text)
-{
-	const gchar *tmp;
-	guint i;
-
-	for (i=0; i<array->len; i++) {
-		tmp = g_ptr_array_index (array, i);
-		if (g_strcmp0 (text, tmp) == 0)
-			return TRUE;
-	}
-	return FALSE;
-}
-
 /**
  * mcm_profile_store_get_by_filename:
  *
@@ -112,26 +137,16 @@ mcm_profile_store_in_array (GPtrArray *array, const gchar *text)
 McmProfile *
 mcm_profile_store_get_by_filename (McmProfileStore *profile_store, const gchar *filename)
 {
-	guint i;
-	McmProfile *profile = NULL;
-	McmProfile *profile_tmp;
-	const gchar *filename_tmp;
-	McmProfileStorePrivate *priv = profile_store->priv;
+	McmProfile *profile;
 
 	g_return_val_if_fail (MCM_IS_PROFILE_STORE (profile_store), NULL);
 	g_return_val_if_fail (filename != NULL, NULL);
 
-	/* find profile */
-	for (i=0; i<priv->profile_array->len; i++) {
-		profile_tmp = g_ptr_array_index (priv->profile_array, i);
-		filename_tmp = mcm_profile_get_filename (profile_tmp);
-		if (g_strcmp0 (filename, filename_tmp) == 0) {
-			profile = g_object_ref (profile_tmp);
-			goto out;
-		}
-	}
-out:
-	return profile;
+	/* the file may have been deleted since it was added */
+	profile = g_hash_table_lookup (profile_store->priv->hash_filename, filename);
+	if (profile == NULL || g_strcmp0 (mcm_profile_get_filename (profile), filename) != 0)
+		return NULL;
+	return g_object_ref (profile);
 }
 
 /**
@@ -140,7 +155,9 @@ out:
  * @profile_store: a valid %McmProfileStore instance
  * @checksum: the profile checksum
  *
- * Gets a profile.
+ * Gets a profile. The checksum is only worked out when it is first asked
+ * for, so this has to look at every profile; use
+ * mcm_profile_store_get_by_id() if possible.
  *
  * Return value: a valid %McmProfile or %NULL. Free with g_object_unref()
  **/
@@ -169,6 +186,178 @@ out:
 	return profile;
 }
 
+/**
+ * mcm_profile_store_get_by_id:
+ *
+ * @profile_store: a valid %McmProfileStore instance
+ * @id: the profile content identity, see mcm_profile_get_id()
+ *
+ * Gets a profile.
+ *
+ * Return value: a valid %McmProfile or %NULL. Free with g_object_unref()
+ **/
+McmProfile *
+mcm_profile_store_get_by_id (McmProfileStore *profile_store, const gchar *id)
+{
+	McmProfile *profile;
+
+	g_return_val_if_fail (MCM_IS_PROFILE_STORE (profile_store), NULL);
+	g_return_val_if_fail (id != NULL, NULL);
+
+	profile = g_hash_table_lookup (profile_store->priv->hash_id, id);
+	if (profile == NULL)
+		return NULL;
+	return g_object_ref (profile);
+}
+
+/**
+ * mcm_profile_store_get_kind_key:
+ **/
+static gpointer
+mcm_profile_store_get_kind_key (McmProfileKind kind, McmColorspace colorspace)
+{
+	/* MCM_COLORSPACE_UNKNOWN is used for any colorspace */
+	return GUINT_TO_POINTER (kind * (MCM_COLORSPACE_LAST + 1) + colorspace + 1);
+}
+
+/**
+ * mcm_profile_store_get_by_kind:
+ *
+ * @profile_store: a valid %McmProfileStore instance
+ * @kind: the profile kind, e.g. %MCM_PROFILE_KIND_DISPLAY_DEVICE
+ * @colorspace: the colorspace, or %MCM_COLORSPACE_UNKNOWN for any
+ *
+ * Gets all the profiles of a kind.
+ *
+ * Return value: an array of %McmProfiles, free with g_ptr_array_unref()
+ **/
+GPtrArray *
+mcm_profile_store_get_by_kind (McmProfileStore *profile_store, McmProfileKind kind, McmColorspace colorspace)
+{
+	guint i;
+	GPtrArray *array;
+	GPtrArray *array_tmp;
+
+	g_return_val_if_fail (MCM_IS_PROFILE_STORE (profile_store), NULL);
+
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	if (colorspace == MCM_COLORSPACE_UNKNOWN)
+		colorspace = MCM_COLORSPACE_LAST;
+	array_tmp = g_hash_table_lookup (profile_store->priv->hash_kind,
+					 mcm_profile_store_get_kind_key (kind, colorspace));
+	if (array_tmp == NULL)
+		goto out;
+	for (i=0; i<array_tmp->len; i++)
+		g_ptr_array_add (array, g_object_ref (g_ptr_array_index (array_tmp, i)));
+out:
+	return array;
+}
+
+/**
+ * mcm_profile_store_index_kind:
+ **/
+static void
+mcm_profile_store_index_kind (McmProfileStore *profile_store, McmProfile *profile, gpointer key, gboolean add)
+{
+	GPtrArray *array;
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	array = g_hash_table_lookup (priv->hash_kind, key);
+	if (!add) {
+		if (array != NULL)
+			g_ptr_array_remove (array, profile);
+		return;
+	}
+	if (array == NULL) {
+		array = g_ptr_array_new ();
+		g_hash_table_insert (priv->hash_kind, key, array);
+	}
+	g_ptr_array_add (array, profile);
+}
+
+/**
+ * mcm_profile_store_index_profile:
+ *
+ * Keeps the hash tables in step with the profile array. The profiles are
+ * not referenced, as the array already holds a reference.
+ **/
+static void
+mcm_profile_store_index_profile (McmProfileStore *profile_store, McmProfile *profile, gboolean add)
+{
+	const gchar *id;
+	gchar *filename;
+	McmProfileKind kind;
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	/* the filename has to be remembered, as it is cleared when the file is deleted */
+	if (add) {
+		filename = g_strdup (mcm_profile_get_filename (profile));
+		g_hash_table_insert (priv->hash_profile, profile, filename);
+		if (filename != NULL)
+			g_hash_table_replace (priv->hash_filename, filename, profile);
+	} else {
+		filename = g_hash_table_lookup (priv->hash_profile, profile);
+		if (filename != NULL && g_hash_table_lookup (priv->hash_filename, filename) == profile)
+			g_hash_table_remove (priv->hash_filename, filename);
+		g_hash_table_remove (priv->hash_profile, profile);
+	}
+
+	/* ids are unique in the store */
+	id = mcm_profile_get_id (profile);
+	if (id != NULL) {
+		if (add)
+			g_hash_table_insert (priv->hash_id, g_strdup (id), profile);
+		else if (g_hash_table_lookup (priv->hash_id, id) == profile)
+			g_hash_table_remove (priv->hash_id, id);
+	}
+
+	/* by kind, and by kind and colorspace */
+	kind = mcm_profile_get_kind (profile);
+	mcm_profile_store_index_kind (profile_store, profile,
+				      mcm_profile_store_get_kind_key (kind, MCM_COLORSPACE_LAST), add);
+	mcm_profile_store_index_kind (profile_store, profile,
+				      mcm_profile_store_get_kind_key (kind, mcm_profile_get_colorspace (profile)), add);
+}
+
+/**
+ * mcm_profile_store_emit_changed:
+ *
+ * While pending file changes are being committed only one "changed" signal
+ * is emitted, at the end of the batch.
+ **/
+static void
+mcm_profile_store_emit_changed (McmProfileStore *profile_store)
+{
+	if (profile_store->priv->in_batch) {
+		profile_store->priv->batch_changed = TRUE;
+		return;
+	}
+	g_signal_emit (profile_store, signals[SIGNAL_CHANGED], 0);
+}
+
+/**
+ * mcm_profile_store_begin_batch:
+ **/
+static void
+mcm_profile_store_begin_batch (McmProfileStore *profile_store)
+{
+	profile_store->priv->in_batch = TRUE;
+	profile_store->priv->batch_changed = FALSE;
+}
+
+/**
+ * mcm_profile_store_end_batch:
+ *
+ * Emits one "changed" signal for the whole batch.
+ **/
+static void
+mcm_profile_store_end_batch (McmProfileStore *profile_store)
+{
+	profile_store->priv->in_batch = FALSE;
+	if (profile_store->priv->batch_changed)
+		g_signal_emit (profile_store, signals[SIGNAL_CHANGED], 0);
+}
+
 /**
  * mcm_profile_store_remove_profile:
  **/
@@ -178,18 +367,21 @@ mcm_profile_store_remove_profile (McmProfileStore *profile_store, McmProfile *pr
 	gboolean ret;
 	McmProfileStorePrivate *priv = profile_store->priv;
 
-	/* remove from list */
+	/* remove from list, keeping a ref until the signal has been sent */
+	g_object_ref (profile);
 	ret = g_ptr_array_remove (priv->profile_array, profile);
 	if (!ret) {
 		egg_warning ("failed to remove %s", mcm_profile_get_filename (profile));
 		goto out;
 	}
+	mcm_profile_store_index_profile (profile_store, profile, FALSE);
 
 	/* emit a signal */
 	egg_debug ("emit removed (and changed): %s", mcm_profile_get_filename (profile));
 	g_signal_emit (profile_store, signals[SIGNAL_REMOVED], 0, profile);
-	g_signal_emit (profile_store, signals[SIGNAL_CHANGED], 0);
+	mcm_profile_store_emit_changed (profile_store);
 out:
+	g_object_unref (profile);
 	return ret;
 }
 
@@ -199,41 +391,32 @@ out:
 static void
 mcm_profile_store_notify_filename_cb (McmProfile *profile, GParamSpec *pspec, McmProfileStore *profile_store)
 {
+	/* the file was deleted, so remove it with the other pending changes */
+	if (mcm_profile_get_filename (profile) == NULL) {
+		mcm_profile_store_schedule_commit (profile_store);
+		return;
+	}
 	mcm_profile_store_remove_profile (profile_store, profile);
 }
 
 /**
- * mcm_profile_store_add_profile:
+ * mcm_profile_store_add_parsed_profile:
+ *
+ * Return value: if the profile was added to the store
  **/
 static gboolean
-mcm_profile_store_add_profile (McmProfileStore *profile_store, GFile *file)
+mcm_profile_store_add_parsed_profile (McmProfileStore *profile_store, McmProfile *profile)
 {
 	gboolean ret = FALSE;
-	McmProfile *profile = NULL;
 	McmProfile *profile_tmp = NULL;
-	GError *error = NULL;
-	gchar *filename = NULL;
-	const gchar *checksum;
+	const gchar *filename;
+	const gchar *id;
 	McmProfileStorePrivate *priv = profile_store->priv;
 
-	/* already added? */
-	filename = g_file_get_path (file);
-	profile = mcm_profile_store_get_by_filename (profile_store, filename);
-	if (profile != NULL)
-		goto out;
-
-	/* parse the profile name */
-	profile = mcm_profile_default_new ();
-	ret = mcm_profile_parse (profile, file, &error);
-	if (!ret) {
-		egg_warning ("failed to add profile '%s': %s", filename, error->message);
-		g_error_free (error);
-		goto out;		
-	}
-
 	/* check the profile has not been added already */
-	checksum = mcm_profile_get_checksum (profile);
-	profile_tmp = mcm_profile_store_get_by_checksum (profile_store, checksum);
+	filename = mcm_profile_get_filename (profile);
+	id = mcm_profile_get_id (profile);
+	profile_tmp = mcm_profile_store_get_by_id (profile_store, id);
 	if (profile_tmp != NULL) {
 
 		/* we value a local file higher than the shared file */
@@ -250,295 +433,1542 @@ mcm_profile_store_add_profile (McmProfileStore *profile_store, GFile *file)
 	/* add to array */
 	egg_debug ("parsed new profile '%s'", filename);
 	g_ptr_array_add (priv->profile_array, g_object_ref (profile));
+	mcm_profile_store_index_profile (profile_store, profile, TRUE);
 	g_signal_connect (profile, "notify::filename", G_CALLBACK(mcm_profile_store_notify_filename_cb), profile_store);
 
 	/* emit a signal */
 	egg_debug ("emit added (and changed): %s", filename);
 	g_signal_emit (profile_store, signals[SIGNAL_ADDED], 0, profile);
-	g_signal_emit (profile_store, signals[SIGNAL_CHANGED], 0);
+	mcm_profile_store_emit_changed (profile_store);
+	ret = TRUE;
 out:
-	g_free (filename);
 	if (profile_tmp != NULL)
 		g_object_unref (profile_tmp);
-	if (profile != NULL)
-		g_object_unref (profile);
 	return ret;
 }
 
 /**
- * mcm_profile_store_file_monitor_changed_cb:
+ * mcm_profile_store_add_profiles:
+ * @profile_store: a #McmProfileStore
+ * @profiles: an array of #McmProfile's that have already been parsed
+ *
+ * Adds profiles that were parsed or created elsewhere, with one "changed"
+ * signal for all of them. Profiles with a filename that is already in the
+ * store are skipped.
+ *
+ * Return value: %TRUE if any profile was added
  **/
-static void
-mcm_profile_store_file_monitor_changed_cb (GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, McmProfileStore *profile_store)
+gboolean
+mcm_profile_store_add_profiles (McmProfileStore *profile_store, GPtrArray *profiles)
 {
-	gchar *path = NULL;
+	guint i;
+	gboolean success = FALSE;
+	McmProfile *profile;
+	McmProfile *profile_tmp;
 
-	/* only care about created objects */
-	if (event_type != G_FILE_MONITOR_EVENT_CREATED)
-		goto out;
+	g_return_val_if_fail (MCM_IS_PROFILE_STORE (profile_store), FALSE);
+	g_return_val_if_fail (profiles != NULL, FALSE);
 
-	/* just rescan everything */
-	path = g_file_get_path (file);
-	if (g_strrstr (path, ".goutputstream") != NULL) {
-		egg_debug ("ignoring gvfs temporary file");
-		goto out;
+	mcm_profile_store_begin_batch (profile_store);
+	for (i=0; i<profiles->len; i++) {
+		profile = g_ptr_array_index (profiles, i);
+
+		/* the file monitor got there first */
+		profile_tmp = mcm_profile_store_get_by_filename (profile_store, mcm_profile_get_filename (profile));
+		if (profile_tmp != NULL) {
+			g_object_unref (profile_tmp);
+			continue;
+		}
+		if (mcm_profile_store_add_parsed_profile (profile_store, profile))
+			success = TRUE;
 	}
-	egg_debug ("%s was added, rescanning everything", path);
-	mcm_profile_store_search_default (profile_store);
-out:
-	g_free (path);
+
+	/* one signal for the whole batch */
+	mcm_profile_store_end_batch (profile_store);
+	return success;
 }
 
 /**
- * mcm_profile_store_search_by_path:
- *
- * Return value: if any profile were added
+ * mcm_profile_store_add_profile:
  **/
-gboolean
-mcm_profile_store_search_by_path (McmProfileStore *profile_store, const gchar *path)
+static gboolean
+mcm_profile_store_add_profile (McmProfileStore *profile_store, GFile *file)
 {
-	GDir *dir = NULL;
+	gboolean ret = FALSE;
+	McmProfile *profile = NULL;
 	GError *error = NULL;
-	gboolean ret;
-	gboolean success = FALSE;
-	const gchar *name;
-	gchar *full_path;
+	gchar *filename = NULL;
 	McmProfileStorePrivate *priv = profile_store->priv;
-	GFileMonitor *monitor = NULL;
-	GFile *file = NULL;
-
-	/* add if correct type */
-	if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
-
-		/* check the file actually is a profile */
-		file = g_file_new_for_path (path);
-		ret = mcm_utils_is_icc_profile (file);
-		if (ret) {
-			success = mcm_profile_store_add_profile (profile_store, file);
-			goto out;
-		}
-
-		/* invalid file */
-		egg_debug ("not recognized as ICC profile: %s", path);
-		goto out;
-	}
 
-	/* get contents */
-	dir = g_dir_open (path, 0, &error);
-	if (dir == NULL) {
-		egg_debug ("failed to open: %s", error->message);
-		g_error_free (error);
-		ret = FALSE;
+	/* already added? */
+	filename = g_file_get_path (file);
+	profile = mcm_profile_store_get_by_filename (profile_store, filename);
+	if (profile != NULL)
 		goto out;
-	}
 
-	/* add an inotify watch if not already added? */
-	ret = mcm_profile_store_in_array (priv->directory_array, path);
-	if (!ret) {
-		file = g_file_new_for_path (path);
-		monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, &error);
-		if (monitor == NULL) {
-			egg_debug ("failed to monitor path: %s", error->message);
+	/* unchanged since the last time we looked */
+	if (priv->profile_index != NULL && filename != NULL)
+		profile = mcm_profile_index_lookup (priv->profile_index, filename);
+	if (profile != NULL) {
+		ret = TRUE;
+		egg_debug ("got '%s' from the index", filename);
+	} else {
+		/* parse the profile name, leaving the colorimetry until it is needed */
+		profile = mcm_profile_default_new ();
+		mcm_profile_set_lightweight (profile, TRUE);
+		ret = mcm_profile_parse (profile, file, &error);
+		if (!ret) {
+			egg_warning ("failed to add profile '%s': %s", filename, error->message);
 			g_error_free (error);
 			goto out;
 		}
-
-		/* don't allow many files to cause re-scan after rescan */
-		g_file_monitor_set_rate_limit (monitor, 1000);
-		g_signal_connect (monitor, "changed", G_CALLBACK(mcm_profile_store_file_monitor_changed_cb), profile_store);
-		g_ptr_array_add (priv->monitor_array, g_object_ref (monitor));
-		g_ptr_array_add (priv->directory_array, g_strdup (path));
+		if (priv->profile_index != NULL)
+			mcm_profile_index_add (priv->profile_index, profile);
 	}
 
-	/* process entire tree */
-	do {
-		name = g_dir_read_name (dir);
-		if (name == NULL)
-			break;
-
-		/* make the compete path */
-		full_path = g_build_filename (path, name, NULL);
-		ret = mcm_profile_store_search_by_path (profile_store, full_path);
-		if (ret)
-			success = TRUE;
-		g_free (full_path);
-	} while (TRUE);
+	/* a duplicate of a local profile is not an error */
+	mcm_profile_store_add_parsed_profile (profile_store, profile);
 out:
-	if (monitor != NULL)
-		g_object_unref (monitor);
-	if (file != NULL)
-		g_object_unref (file);
-	if (dir != NULL)
-		g_dir_close (dir);
-	return success;
+	g_free (filename);
+	if (profile != NULL)
+		g_object_unref (profile);
+	return ret;
 }
 
 /**
- * mcm_profile_store_add_profiles_from_mounted_volume:
+ * mcm_profile_store_save_index:
  **/
-static gboolean
-mcm_profile_store_add_profiles_from_mounted_volume (McmProfileStore *profile_store, GMount *mount)
+static void
+mcm_profile_store_save_index (McmProfileStore *profile_store)
 {
-	GFile *root;
-	gchar *path;
-	gchar *path_root;
-	const gchar *type;
-	GFileInfo *info;
-	GError *error = NULL;
 	gboolean ret;
-	gboolean success = FALSE;
+	gchar *filename;
+	GError *error = NULL;
+	McmProfileStorePrivate *priv = profile_store->priv;
 
-	/* get the mount root */
-	root = g_mount_get_root (mount);
-	path_root = g_file_get_path (root);
-	if (path_root == NULL)
-		goto out;
+	/* not loaded yet */
+	if (priv->profile_index == NULL)
+		return;
 
-	/* get the filesystem type */
-	info = g_file_query_filesystem_info (root, G_FILE_ATTRIBUTE_FILESYSTEM_TYPE, NULL, &error);
-	if (info == NULL) {
-		egg_warning ("failed to get filesystem type: %s", error->message);
+	filename = mcm_profile_index_get_default_filename ();
+	ret = mcm_profile_index_save (priv->profile_index, filename, &error);
+	if (!ret) {
+		egg_warning ("failed to save profile index: %s", error->message);
 		g_error_free (error);
-		goto out;
 	}
-	type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_FILESYSTEM_TYPE);
-	egg_debug ("filesystem mounted on %s has type %s", path_root, type);
+	g_free (filename);
+}
 
-	/* only scan hfs volumes for OSX */
-	if (g_strcmp0 (type, "hfs") == 0) {
-		path = g_build_filename (path_root, "Library", "ColorSync", "Profiles", "Displays", NULL);
-		ret = mcm_profile_store_search_by_path (profile_store, path);
-		if (ret)
-			success = TRUE;
-		g_free (path);
+/**
+ * mcm_profile_store_is_below:
+ *
+ * Return value: if @filename is @path or inside it
+ **/
+static gboolean
+mcm_profile_store_is_below (const gchar *filename, const gchar *path)
+{
+	gsize len;
+
+	len = strlen (path);
+	if (strncmp (filename, path, len) != 0)
+		return FALSE;
+	return (filename[len] == '\0' || filename[len] == G_DIR_SEPARATOR);
+}
+
+/**
+ * mcm_profile_store_remove_path:
+ *
+ * Removes the profile with this filename, or all the profiles below it if
+ * it was a directory.
+ **/
+static void
+mcm_profile_store_remove_path (McmProfileStore *profile_store, const gchar *path)
+{
+	guint i;
+	const gchar *filename;
+	McmProfile *profile;
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	for (i=0; i<priv->profile_array->len;) {
+		profile = g_ptr_array_index (priv->profile_array, i);
+		filename = mcm_profile_get_filename (profile);
+		if (filename != NULL && mcm_profile_store_is_below (filename, path)) {
+			egg_debug ("%s was removed", filename);
+			mcm_profile_store_remove_profile (profile_store, profile);
+			continue;
+		}
+		i++;
+	}
+}
+
+/**
+ * mcm_profile_store_commit_cb:
+ **/
+static gboolean
+mcm_profile_store_commit_cb (McmProfileStore *profile_store)
+{
+	guint i;
+	GList *paths;
+	GList *l;
+	const gchar *path;
+	McmProfile *profile;
+	McmProfileStorePending action;
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	priv->pending_id = 0;
+	mcm_profile_store_begin_batch (profile_store);
+
+	/* profiles that noticed their own file was deleted */
+	for (i=0; i<priv->profile_array->len;) {
+		profile = g_ptr_array_index (priv->profile_array, i);
+		if (mcm_profile_get_filename (profile) == NULL) {
+			mcm_profile_store_remove_profile (profile_store, profile);
+			continue;
+		}
+		i++;
+	}
+
+	/* only the last event for each path matters */
+	paths = g_hash_table_get_keys (priv->pending);
+	for (l = paths; l != NULL; l = l->next) {
+		path = l->data;
+		action = GPOINTER_TO_UINT (g_hash_table_lookup (priv->pending, path));
+
+		/* a changed file is removed and parsed again */
+		mcm_profile_store_remove_path (profile_store, path);
+		if (action == MCM_PROFILE_STORE_PENDING_ADD)
+			mcm_profile_store_search_by_path (profile_store, path);
+	}
+	egg_debug ("committed %i file changes", g_hash_table_size (priv->pending));
+	g_list_free (paths);
+	g_hash_table_remove_all (priv->pending);
+
+	/* one signal for the whole batch */
+	mcm_profile_store_end_batch (profile_store);
+	mcm_profile_store_save_index (profile_store);
+	return FALSE;
+}
+
+/**
+ * mcm_profile_store_schedule_commit:
+ *
+ * Waits for the events to stop for a little while, so copying lots of
+ * profiles at once is handled in one go.
+ **/
+static void
+mcm_profile_store_schedule_commit (McmProfileStore *profile_store)
+{
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	if (priv->pending_id != 0)
+		g_source_remove (priv->pending_id);
+	priv->pending_id = g_timeout_add (MCM_PROFILE_STORE_COMMIT_TIMEOUT,
+					  (GSourceFunc) mcm_profile_store_commit_cb,
+					  profile_store);
+#if GLIB_CHECK_VERSION(2,25,8)
+	g_source_set_name_by_id (priv->pending_id, "[McmProfileStore] commit file changes");
+#endif
+}
+
+/**
+ * mcm_profile_store_add_pending:
+ **/
+static void
+mcm_profile_store_add_pending (McmProfileStore *profile_store, GFile *file, McmProfileStorePending action)
+{
+	gchar *path;
+
+	path = g_file_get_path (file);
+	if (path == NULL)
+		return;
+
+	/* the rename to the real name will be seen later */
+	if (g_strrstr (path, ".goutputstream") != NULL) {
+		egg_debug ("ignoring gvfs temporary file");
+		g_free (path);
+		return;
+	}
+	g_hash_table_insert (profile_store->priv->pending, path, GUINT_TO_POINTER (action));
+	mcm_profile_store_schedule_commit (profile_store);
+}
+
+/**
+ * mcm_profile_store_file_monitor_changed_cb:
+ **/
+static void
+mcm_profile_store_file_monitor_changed_cb (GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, McmProfileStore *profile_store)
+{
+	switch (event_type) {
+	case G_FILE_MONITOR_EVENT_CREATED:
+	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+		mcm_profile_store_add_pending (profile_store, file, MCM_PROFILE_STORE_PENDING_ADD);
+		break;
+	case G_FILE_MONITOR_EVENT_DELETED:
+		mcm_profile_store_add_pending (profile_store, file, MCM_PROFILE_STORE_PENDING_REMOVE);
+		break;
+	case G_FILE_MONITOR_EVENT_MOVED:
+		mcm_profile_store_add_pending (profile_store, file, MCM_PROFILE_STORE_PENDING_REMOVE);
+		if (other_file != NULL)
+			mcm_profile_store_add_pending (profile_store, other_file, MCM_PROFILE_STORE_PENDING_ADD);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * mcm_profile_store_add_monitor:
+ *
+ * Return value: if the directory is being watched for changes
+ **/
+static gboolean
+mcm_profile_store_add_monitor (McmProfileStore *profile_store, const gchar *path)
+{
+	GFile *file;
+	GFileMonitor *monitor;
+	GError *error = NULL;
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	/* already added */
+	if (g_hash_table_lookup (priv->directory_hash, path) != NULL)
+		return TRUE;
+
+	file = g_file_new_for_path (path);
+	monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, &error);
+	g_object_unref (file);
+	if (monitor == NULL) {
+		egg_debug ("failed to monitor path: %s", error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	/* don't allow many files to cause re-scan after rescan */
+	g_file_monitor_set_rate_limit (monitor, 1000);
+	g_signal_connect (monitor, "changed", G_CALLBACK(mcm_profile_store_file_monitor_changed_cb), profile_store);
+	g_ptr_array_add (priv->monitor_array, monitor);
+	g_hash_table_insert (priv->directory_hash, g_strdup (path), monitor);
+	return TRUE;
+}
+
+/**
+ * mcm_profile_store_remove_monitors:
+ *
+ * Stops watching @path and all the directories below it.
+ **/
+static void
+mcm_profile_store_remove_monitors (McmProfileStore *profile_store, const gchar *path)
+{
+	GHashTableIter iter;
+	gpointer key;
+	GFileMonitor *monitor;
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	g_hash_table_iter_init (&iter, priv->directory_hash);
+	while (g_hash_table_iter_next (&iter, &key, (gpointer *) &monitor)) {
+		if (!mcm_profile_store_is_below (key, path))
+			continue;
+		egg_debug ("no longer watching %s", (const gchar *) key);
+		g_file_monitor_cancel (monitor);
+		g_hash_table_iter_remove (&iter);
+		g_ptr_array_remove (priv->monitor_array, monitor);
+	}
+}
+
+/**
+ * mcm_profile_store_search_by_path:
+ *
+ * Return value: if any profile were added
+ **/
+gboolean
+mcm_profile_store_search_by_path (McmProfileStore *profile_store, const gchar *path)
+{
+	GDir *dir = NULL;
+	GError *error = NULL;
+	gboolean ret;
+	gboolean success = FALSE;
+	const gchar *name;
+	gchar *full_path;
+	GFile *file = NULL;
+
+	/* add if correct type */
+	if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+
+		/* check the file actually is a profile */
+		ret = mcm_utils_is_icc_profile_filename (path);
+		if (ret) {
+			file = g_file_new_for_path (path);
+			success = mcm_profile_store_add_profile (profile_store, file);
+			goto out;
+		}
+
+		/* invalid file */
+		egg_debug ("not recognized as ICC profile: %s", path);
+		goto out;
+	}
+
+	/* get contents */
+	dir = g_dir_open (path, 0, &error);
+	if (dir == NULL) {
+		egg_debug ("failed to open: %s", error->message);
+		g_error_free (error);
+		ret = FALSE;
+		goto out;
+	}
+
+	/* add an inotify watch if not already added? */
+	ret = mcm_profile_store_add_monitor (profile_store, path);
+	if (!ret)
+		goto out;
+
+	/* process entire tree */
+	do {
+		name = g_dir_read_name (dir);
+		if (name == NULL)
+			break;
+
+		/* make the compete path */
+		full_path = g_build_filename (path, name, NULL);
+		ret = mcm_profile_store_search_by_path (profile_store, full_path);
+		if (ret)
+			success = TRUE;
+		g_free (full_path);
+	} while (TRUE);
+out:
+	if (file != NULL)
+		g_object_unref (file);
+	if (dir != NULL)
+		g_dir_close (dir);
+	return success;
+}
+
+/**
+ * mcm_profile_store_get_volume_paths:
+ *
+ * This does blocking I/O on the volume, so can be called from a thread.
+ *
+ * Return value: the directories on the volume that may hold profiles,
+ * free with g_ptr_array_unref()
+ **/
+static GPtrArray *
+mcm_profile_store_get_volume_paths (GFile *root)
+{
+	gchar *path_root;
+	const gchar *type;
+	GFileInfo *info = NULL;
+	GError *error = NULL;
+	GPtrArray *array;
+
+	array = g_ptr_array_new_with_free_func (g_free);
+
+	/* get the mount root */
+	path_root = g_file_get_path (root);
+	if (path_root == NULL)
+		goto out;
+
+	/* get the filesystem type */
+	info = g_file_query_filesystem_info (root, G_FILE_ATTRIBUTE_FILESYSTEM_TYPE, NULL, &error);
+	if (info == NULL) {
+		egg_warning ("failed to get filesystem type: %s", error->message);
+		g_error_free (error);
+		goto out;
+	}
+	type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_FILESYSTEM_TYPE);
+	egg_debug ("filesystem mounted on %s has type %s", path_root, type);
+
+	/* only scan hfs volumes for OSX */
+	if (g_strcmp0 (type, "hfs") == 0) {
+		g_ptr_array_add (array, g_build_filename (path_root, "Library", "ColorSync", "Profiles", "Displays", NULL));
 
 		/* no more matching */
 		goto out;
 	}
 
-	/* and fat32 and ntfs for windows */
-	if (g_strcmp0 (type, "ntfs") == 0 || g_strcmp0 (type, "msdos") == 0) {
+	/* and fat32 and ntfs for windows */
+	if (g_strcmp0 (type, "ntfs") == 0 || g_strcmp0 (type, "msdos") == 0) {
+
+		/* Windows XP */
+		g_ptr_array_add (array, g_build_filename (path_root, "Windows", "system32", "spool", "drivers", "color", NULL));
+
+		/* Windows 2000 */
+		g_ptr_array_add (array, g_build_filename (path_root, "Winnt", "system32", "spool", "drivers", "color", NULL));
+
+		/* Windows 98 and ME */
+		g_ptr_array_add (array, g_build_filename (path_root, "Windows", "System", "Color", NULL));
+
+		/* no more matching */
+		goto out;
+	}
+out:
+	if (info != NULL)
+		g_object_unref (info);
+	g_free (path_root);
+	return array;
+}
+
+/**
+ * mcm_profile_store_load_index:
+ **/
+static void
+mcm_profile_store_load_index (McmProfileStore *profile_store)
+{
+	gboolean ret;
+	gchar *filename;
+	GError *error = NULL;
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	/* already loaded */
+	if (priv->profile_index != NULL)
+		return;
+
+	/* use the metadata from last time for files that are unchanged */
+	filename = mcm_profile_index_get_default_filename ();
+	priv->profile_index = mcm_profile_index_new ();
+	ret = mcm_profile_index_load (priv->profile_index, filename, &error);
+	if (!ret) {
+		egg_debug ("not using profile index: %s", error->message);
+		g_error_free (error);
+	}
+	g_free (filename);
+}
+
+/**
+ * mcm_profile_store_get_default_paths:
+ *
+ * Return value: the directories searched by default, free with g_ptr_array_unref()
+ **/
+static GPtrArray *
+mcm_profile_store_get_default_paths (void)
+{
+	gchar *path;
+	gboolean ret;
+	GError *error = NULL;
+	GPtrArray *array;
+
+	array = g_ptr_array_new_with_free_func (g_free);
+
+	/* get OSX and Linux system-wide profiles */
+	g_ptr_array_add (array, g_strdup ("/usr/share/color/icc"));
+	g_ptr_array_add (array, g_strdup ("/usr/local/share/color/icc"));
+	g_ptr_array_add (array, g_strdup ("/Library/ColorSync/Profiles/Displays"));
+
+	/* get Linux per-user profiles */
+	path = g_build_filename (g_get_user_data_dir (), "icc", NULL);
+	ret = mcm_utils_mkdir_with_parents (path, &error);
+	if (!ret) {
+		egg_error ("failed to create directory on startup: %s", error->message);
+		g_error_free (error);
+		g_free (path);
+	} else {
+		g_ptr_array_add (array, path);
+	}
+
+	/* get per-user profiles from obsolete location */
+	g_ptr_array_add (array, g_build_filename (g_get_home_dir (), ".color", "icc", NULL));
+
+	/* get OSX per-user profiles */
+	g_ptr_array_add (array, g_build_filename (g_get_home_dir (), "Library", "ColorSync", "Profiles", NULL));
+
+	/* get machine specific profiles */
+	g_ptr_array_add (array, g_strdup ("/var/lib/color/icc"));
+	return array;
+}
+
+/**
+ * mcm_profile_store_search_default:
+ *
+ * The profiles on mounted volumes are added later, in the background.
+ *
+ * Return value: if any profile were added
+ **/
+gboolean
+mcm_profile_store_search_default (McmProfileStore *profile_store)
+{
+	guint i;
+	gboolean ret;
+	gboolean success = FALSE;
+	guint hits;
+	guint misses;
+	GPtrArray *paths;
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	/* use the metadata from last time for files that are unchanged */
+	mcm_profile_store_load_index (profile_store);
+
+	/* get system-wide and per-user profiles */
+	paths = mcm_profile_store_get_default_paths ();
+	for (i=0; i<paths->len; i++) {
+		ret = mcm_profile_store_search_by_path (profile_store, g_ptr_array_index (paths, i));
+		if (ret)
+			success = TRUE;
+	}
+	g_ptr_array_unref (paths);
+
+	/* get OSX and Windows system-wide profiles when using Linux */
+	mcm_profile_store_scan_volumes (profile_store);
+
+	/* save for next time */
+	mcm_profile_index_get_stats (priv->profile_index, &hits, &misses);
+	egg_debug ("%i profiles from the index, %i parsed", hits, misses);
+	mcm_profile_store_save_index (profile_store);
+	return success;
+}
+
+/* state for one search of the default locations, or of one volume */
+typedef struct {
+	McmProfileStore		*profile_store;
+	GCancellable		*cancellable;
+	GSimpleAsyncResult	*res;
+	GPtrArray		*roots;
+	GPtrArray		*directories;
+	GArray			*mtimes;
+	GPtrArray		*missing;
+	GPtrArray		*filenames;
+	McmProfileIndex		*profile_index;
+	GPtrArray		*indexed;
+	GPtrArray		*unindexed;
+	GPtrArray		*batch;
+	guint			 total;
+	guint			 done;
+	gboolean		 success;
+	gboolean		 busy;
+	gboolean		 completed;
+	GFile			*volume;
+	gchar			*volume_root;
+	gchar			*uuid;
+	McmVolumeCache		*cache;
+	McmScanBudget		*budget;
+	guint			 watchdog_id;
+} McmProfileStoreScan;
+
+static gboolean mcm_profile_store_scan_walk_cb (McmProfileStoreScan *scan);
+
+/**
+ * mcm_profile_store_scan_over_budget:
+ *
+ * Volume scans are limited in time and in the number of reads, so a slow
+ * disk or network share cannot keep a thread busy for ever.
+ **/
+static gboolean
+mcm_profile_store_scan_over_budget (McmProfileStoreScan *scan)
+{
+	/* no limits for the local directories */
+	if (scan->budget == NULL)
+		return FALSE;
+	return !mcm_scan_budget_spend (scan->budget);
+}
+
+/**
+ * mcm_profile_store_scan_walk_path:
+ *
+ * Called in a thread, so must not touch the store.
+ **/
+static void
+mcm_profile_store_scan_walk_path (McmProfileStoreScan *scan, const gchar *path, guint depth)
+{
+	DIR *dir;
+	struct dirent *entry;
+	struct stat buf;
+	gchar *full_path;
+	guint type;
+	guint64 mtime = 0;
+
+	/* stop walking */
+	if (g_cancellable_is_cancelled (scan->cancellable))
+		return;
+	if (mcm_profile_store_scan_over_budget (scan))
+		return;
+
+	/* a symlink loop */
+	if (depth > MCM_PROFILE_STORE_SCAN_MAX_DEPTH) {
+		egg_warning ("not descending into %s", path);
+		return;
+	}
+
+	dir = opendir (path);
+	if (dir == NULL) {
+		egg_debug ("failed to open %s: %s", path, g_strerror (errno));
+
+		/* so the cache notices if it is created */
+		if (depth == 0 && errno == ENOENT)
+			g_ptr_array_add (scan->missing, g_strdup (path));
+		return;
+	}
+	if (fstat (dirfd (dir), &buf) == 0)
+		mtime = buf.st_mtime;
+	g_ptr_array_add (scan->directories, g_strdup (path));
+	g_array_append_val (scan->mtimes, mtime);
+
+	/* process entire tree */
+	while ((entry = readdir (dir)) != NULL) {
+		if (g_strcmp0 (entry->d_name, ".") == 0 || g_strcmp0 (entry->d_name, "..") == 0)
+			continue;
+		if (mcm_profile_store_scan_over_budget (scan))
+			break;
+		full_path = g_build_filename (path, entry->d_name, NULL);
+
+		/* most filesystems tell us the type for free */
+		type = DT_UNKNOWN;
+#ifdef _DIRENT_HAVE_D_TYPE
+		type = entry->d_type;
+#endif
+		if ((type == DT_LNK || type == DT_UNKNOWN) && stat (full_path, &buf) == 0) {
+			if (S_ISDIR (buf.st_mode))
+				type = DT_DIR;
+			else if (S_ISREG (buf.st_mode))
+				type = DT_REG;
+		}
+
+		if (type == DT_DIR) {
+			mcm_profile_store_scan_walk_path (scan, full_path, depth + 1);
+		} else if (type == DT_REG) {
+
+			/* check the file actually is a profile */
+			if (mcm_utils_is_icc_profile_filename (full_path)) {
+				g_ptr_array_add (scan->filenames, full_path);
+				full_path = NULL;
+			} else {
+				egg_debug ("not recognized as ICC profile: %s", full_path);
+			}
+		}
+		g_free (full_path);
+	}
+	closedir (dir);
+}
+
+/**
+ * mcm_profile_store_scan_find_files:
+ **/
+static void
+mcm_profile_store_scan_find_files (McmProfileStoreScan *scan)
+{
+	guint i;
+	GPtrArray *paths;
+	McmVolumeCache *cache;
+
+	for (i=0; i<scan->roots->len; i++)
+		mcm_profile_store_scan_walk_path (scan, g_ptr_array_index (scan->roots, i), 0);
+	if (scan->volume == NULL)
+		return;
+
+	/* nothing has been added or removed since the last time */
+	cache = scan->cache;
+	if (cache != NULL && mcm_volume_cache_is_valid (cache, scan->volume_root)) {
+		egg_debug ("using cached results for %s", scan->volume_root);
+		for (i=0; i<cache->directories->len; i++) {
+			g_ptr_array_add (scan->directories, g_strdup (g_ptr_array_index (cache->directories, i)));
+			g_array_append_val (scan->mtimes, g_array_index (cache->mtimes, guint64, i));
+		}
+		for (i=0; i<cache->missing->len; i++)
+			g_ptr_array_add (scan->missing, g_strdup (g_ptr_array_index (cache->missing, i)));
+		for (i=0; i<cache->filenames->len; i++)
+			g_ptr_array_add (scan->filenames, g_strdup (g_ptr_array_index (cache->filenames, i)));
+		return;
+	}
+
+	/* querying the filesystem type can block on a slow volume */
+	paths = mcm_profile_store_get_volume_paths (scan->volume);
+	for (i=0; i<paths->len; i++)
+		mcm_profile_store_scan_walk_path (scan, g_ptr_array_index (paths, i), 0);
+	g_ptr_array_unref (paths);
+}
+
+/**
+ * mcm_profile_store_scan_walk_thread:
+ *
+ * Finds the profiles, and checks each one against the index here so the
+ * stat and the metadata lookup do not block the main context.
+ *
+ * This is a thread of its own rather than a GIO worker, as a read on a
+ * dead network mount can block for ever.
+ **/
+static gpointer
+mcm_profile_store_scan_walk_thread (McmProfileStoreScan *scan)
+{
+	guint i;
+	const gchar *filename;
+	McmProfile *profile;
+
+	mcm_profile_store_scan_find_files (scan);
+
+	/* only the changed files need parsing */
+	for (i=0; i<scan->filenames->len; i++) {
+		if (g_cancellable_is_cancelled (scan->cancellable))
+			break;
+		filename = g_ptr_array_index (scan->filenames, i);
+		profile = mcm_profile_index_lookup (scan->profile_index, filename);
+		if (profile != NULL)
+			g_ptr_array_add (scan->indexed, profile);
+		else
+			g_ptr_array_add (scan->unindexed, g_strdup (filename));
+	}
+
+	/* the scan is only touched from the main context from now on */
+	g_idle_add ((GSourceFunc) mcm_profile_store_scan_walk_cb, scan);
+	return NULL;
+}
+
+/**
+ * mcm_profile_store_scan_commit:
+ *
+ * Adds the profiles parsed since the last commit with one "changed" signal.
+ **/
+static void
+mcm_profile_store_scan_commit (McmProfileStoreScan *scan)
+{
+	guint percentage;
+	McmProfileStore *profile_store = scan->profile_store;
+
+	/* the volume has gone away */
+	if (scan->volume != NULL && g_cancellable_is_cancelled (scan->cancellable)) {
+		g_ptr_array_set_size (scan->batch, 0);
+		return;
+	}
+
+	if (mcm_profile_store_add_profiles (profile_store, scan->batch))
+		scan->success = TRUE;
+	egg_debug ("committed %i scanned profiles", scan->batch->len);
+	g_ptr_array_set_size (scan->batch, 0);
+
+	/* volumes are scanned in the background */
+	if (scan->volume != NULL)
+		return;
+
+	/* tell the UI how far we've got */
+	percentage = scan->total > 0 ? scan->done * 100 / scan->total : 100;
+	g_signal_emit (profile_store, signals[SIGNAL_SCAN_PROGRESS], 0, percentage);
+}
+
+/**
+ * mcm_profile_store_scan_volume_done:
+ **/
+static void
+mcm_profile_store_scan_volume_done (McmProfileStoreScan *scan, const GError *error)
+{
+	McmVolumeCache *cache;
+	McmProfileStorePrivate *priv = scan->profile_store->priv;
+
+	if (mcm_scan_budget_is_expired (scan->budget)) {
+		egg_warning ("giving up on %s after %i reads in %.1fs", scan->volume_root,
+			     mcm_scan_budget_get_reads (scan->budget),
+			     mcm_scan_budget_get_elapsed (scan->budget));
+	}
+	if (scan->uuid == NULL)
+		return;
+
+	/* an incomplete scan cannot be reused, but the old results are
+	 * given back when the scan is freed, as the thread may still be
+	 * reading them */
+	if (error != NULL || mcm_scan_budget_is_expired (scan->budget))
+		return;
+	mcm_volume_cache_free (scan->cache);
+	scan->cache = NULL;
+
+	/* remember what was found */
+	cache = mcm_volume_cache_new (scan->volume_root, scan->directories, scan->mtimes,
+				      scan->missing, scan->filenames);
+	g_hash_table_insert (priv->volume_cache, g_strdup (scan->uuid), cache);
+}
+
+/**
+ * mcm_profile_store_scan_free:
+ **/
+static void
+mcm_profile_store_scan_free (McmProfileStoreScan *scan)
+{
+	McmProfileStorePrivate *priv = scan->profile_store->priv;
+
+	/* a new job may have been started if the volume was remounted */
+	if (scan->volume != NULL &&
+	    g_hash_table_lookup (priv->volume_jobs, scan->volume_root) == scan->cancellable)
+		g_hash_table_remove (priv->volume_jobs, scan->volume_root);
+
+	/* the scan did not finish, so keep the old results */
+	if (scan->cache != NULL && scan->uuid != NULL) {
+		g_hash_table_insert (priv->volume_cache, g_strdup (scan->uuid), scan->cache);
+		scan->cache = NULL;
+	}
+
+	g_ptr_array_unref (scan->roots);
+	g_ptr_array_unref (scan->directories);
+	g_array_unref (scan->mtimes);
+	g_ptr_array_unref (scan->missing);
+	g_ptr_array_unref (scan->filenames);
+	g_ptr_array_unref (scan->indexed);
+	g_ptr_array_unref (scan->unindexed);
+	g_ptr_array_unref (scan->batch);
+	if (scan->volume != NULL)
+		g_object_unref (scan->volume);
+	g_free (scan->volume_root);
+	g_free (scan->uuid);
+	mcm_volume_cache_free (scan->cache);
+	mcm_scan_budget_free (scan->budget);
+	if (scan->cancellable != NULL)
+		g_object_unref (scan->cancellable);
+	g_object_unref (scan->res);
+	g_free (scan);
+}
+
+/**
+ * mcm_profile_store_scan_complete:
+ *
+ * If a thread is still walking or parsing, the scan is freed when it
+ * returns.
+ **/
+static void
+mcm_profile_store_scan_complete (McmProfileStoreScan *scan, const GError *error)
+{
+	guint hits;
+	guint misses;
+	McmProfileStore *profile_store = scan->profile_store;
+
+	if (scan->watchdog_id != 0) {
+		g_source_remove (scan->watchdog_id);
+		scan->watchdog_id = 0;
+	}
+
+	/* anything parsed before we were cancelled is still valid */
+	if (scan->batch->len > 0 || error == NULL)
+		mcm_profile_store_scan_commit (scan);
+
+	/* save for next time */
+	mcm_profile_index_get_stats (profile_store->priv->profile_index, &hits, &misses);
+	egg_debug ("%i profiles from the index, %i parsed", hits, misses);
+	mcm_profile_store_save_index (profile_store);
+
+	if (error != NULL)
+		g_simple_async_result_set_from_error (scan->res, error);
+	else
+		g_simple_async_result_set_op_res_gboolean (scan->res, scan->success);
+	if (scan->volume != NULL)
+		mcm_profile_store_scan_volume_done (scan, error);
+	else
+		g_signal_emit (profile_store, signals[SIGNAL_SCAN_COMPLETE], 0);
+	g_simple_async_result_complete (scan->res);
+
+	scan->completed = TRUE;
+	if (!scan->busy)
+		mcm_profile_store_scan_free (scan);
+}
+
+/**
+ * mcm_profile_store_scan_watchdog_cb:
+ *
+ * The budget is only checked between reads, so this gives up on a volume
+ * where a single read has blocked, without waiting for the thread.
+ **/
+static gboolean
+mcm_profile_store_scan_watchdog_cb (McmProfileStoreScan *scan)
+{
+	GError *error;
+
+	scan->watchdog_id = 0;
+	mcm_scan_budget_expire (scan->budget);
+	g_cancellable_cancel (scan->cancellable);
+	error = g_error_new (1, 0, "timed out scanning %s", scan->volume_root);
+	mcm_profile_store_scan_complete (scan, error);
+	g_error_free (error);
+	return FALSE;
+}
+
+/**
+ * mcm_profile_store_scan_parsed_cb:
+ *
+ * Called in the main context as each file is parsed.
+ **/
+static void
+mcm_profile_store_scan_parsed_cb (GFile *file, McmProfile *profile, const GError *error, McmProfileStoreScan *scan)
+{
+	/* we have given up on this volume */
+	if (scan->completed)
+		return;
+	scan->done++;
+
+	/* the error has already been printed */
+	if (profile == NULL)
+		return;
+	mcm_profile_index_add (scan->profile_store->priv->profile_index, profile);
+	g_ptr_array_add (scan->batch, g_object_ref (profile));
+	if (scan->batch->len >= MCM_PROFILE_STORE_SCAN_BATCH_SIZE)
+		mcm_profile_store_scan_commit (scan);
+}
+
+/**
+ * mcm_profile_store_scan_parse_cb:
+ **/
+static void
+mcm_profile_store_scan_parse_cb (GObject *source_object, GAsyncResult *res, McmProfileStoreScan *scan)
+{
+	GPtrArray *array;
+	GError *error = NULL;
+
+	/* the profiles have already been added as they were parsed */
+	scan->busy = FALSE;
+	array = mcm_profile_parse_many_finish (res, &error);
+	if (scan->completed) {
+		mcm_profile_store_scan_free (scan);
+		goto out;
+	}
+	if (array == NULL) {
+		mcm_profile_store_scan_complete (scan, error);
+		goto out;
+	}
+	mcm_profile_store_scan_complete (scan, NULL);
+out:
+	if (error != NULL)
+		g_error_free (error);
+	if (array != NULL)
+		g_ptr_array_unref (array);
+}
+
+/**
+ * mcm_profile_store_scan_walk_cb:
+ *
+ * Called in the main context when the walk thread has finished.
+ **/
+static gboolean
+mcm_profile_store_scan_walk_cb (McmProfileStoreScan *scan)
+{
+	guint i;
+	const gchar *filename;
+	GPtrArray *files;
+	McmProfile *profile;
+	McmProfile *profile_tmp;
+	GError *error = NULL;
+	McmProfileStore *profile_store = scan->profile_store;
 
-		/* Windows XP */
-		path = g_build_filename (path_root, "Windows", "system32", "spool", "drivers", "color", NULL);
-		ret = mcm_profile_store_search_by_path (profile_store, path);
-		if (ret)
-			success = TRUE;
-		g_free (path);
+	/* we have already given up on this volume */
+	scan->busy = FALSE;
+	if (scan->completed) {
+		mcm_profile_store_scan_free (scan);
+		return FALSE;
+	}
 
-		/* Windows 2000 */
-		path = g_build_filename (path_root, "Winnt", "system32", "spool", "drivers", "color", NULL);
-		ret = mcm_profile_store_search_by_path (profile_store, path);
-		if (ret)
-			success = TRUE;
-		g_free (path);
+	/* cancelled before or while walking */
+	if (g_cancellable_set_error_if_cancelled (scan->cancellable, &error)) {
+		mcm_profile_store_scan_complete (scan, error);
+		g_error_free (error);
+		return FALSE;
+	}
 
-		/* Windows 98 and ME */
-		path = g_build_filename (path_root, "Windows", "System", "Color", NULL);
-		ret = mcm_profile_store_search_by_path (profile_store, path);
-		if (ret)
-			success = TRUE;
-		g_free (path);
+	/* monitors have to be created in the main context */
+	for (i=0; i<scan->directories->len; i++)
+		mcm_profile_store_add_monitor (profile_store, g_ptr_array_index (scan->directories, i));
+
+	/* the unchanged files were created from the index in the thread */
+	for (i=0; i<scan->indexed->len; i++) {
+		profile = g_ptr_array_index (scan->indexed, i);
+		profile_tmp = mcm_profile_store_get_by_filename (profile_store, mcm_profile_get_filename (profile));
+		if (profile_tmp != NULL) {
+			g_object_unref (profile_tmp);
+			continue;
+		}
+		g_ptr_array_add (scan->batch, g_object_ref (profile));
+	}
 
-		/* no more matching */
+	/* only parse the files we've not seen before */
+	files = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	for (i=0; i<scan->unindexed->len; i++) {
+		filename = g_ptr_array_index (scan->unindexed, i);
+		profile_tmp = mcm_profile_store_get_by_filename (profile_store, filename);
+		if (profile_tmp != NULL) {
+			g_object_unref (profile_tmp);
+			continue;
+		}
+		g_ptr_array_add (files, g_file_new_for_path (filename));
+	}
+	egg_debug ("found %i profiles in %i directories, %i need parsing",
+		   scan->filenames->len, scan->directories->len, files->len);
+
+	/* add the unchanged profiles straight away */
+	scan->total = scan->batch->len + files->len;
+	scan->done = scan->batch->len;
+	mcm_profile_store_scan_commit (scan);
+
+	/* parse the rest */
+	scan->busy = TRUE;
+	mcm_profile_parse_many_async (files, TRUE, scan->cancellable,
+				      (McmProfileParseFunc) mcm_profile_store_scan_parsed_cb, scan,
+				      (GAsyncReadyCallback) mcm_profile_store_scan_parse_cb, scan);
+	g_ptr_array_unref (files);
+	return FALSE;
+}
+
+/**
+ * mcm_profile_store_scan_new:
+ **/
+static McmProfileStoreScan *
+mcm_profile_store_scan_new (McmProfileStore *profile_store, GCancellable *cancellable,
+			    GAsyncReadyCallback callback, gpointer user_data)
+{
+	McmProfileStoreScan *scan;
+
+	scan = g_new0 (McmProfileStoreScan, 1);
+	scan->profile_store = profile_store;
+	if (cancellable != NULL)
+		scan->cancellable = g_object_ref (cancellable);
+	scan->res = g_simple_async_result_new (G_OBJECT (profile_store), callback, user_data,
+					       mcm_profile_store_search_default_async);
+	scan->roots = g_ptr_array_new_with_free_func (g_free);
+	scan->directories = g_ptr_array_new_with_free_func (g_free);
+	scan->mtimes = g_array_new (FALSE, FALSE, sizeof (guint64));
+	scan->missing = g_ptr_array_new_with_free_func (g_free);
+	scan->filenames = g_ptr_array_new_with_free_func (g_free);
+	scan->indexed = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	scan->unindexed = g_ptr_array_new_with_free_func (g_free);
+	scan->batch = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	return scan;
+}
+
+/**
+ * mcm_profile_store_scan_start:
+ **/
+static void
+mcm_profile_store_scan_start (McmProfileStoreScan *scan)
+{
+	GThread *thread;
+	GError *error = NULL;
+
+	/* use the metadata from last time for files that are unchanged */
+	mcm_profile_store_load_index (scan->profile_store);
+	scan->profile_index = scan->profile_store->priv->profile_index;
+
+	/* walk the directories in a thread */
+	scan->busy = TRUE;
+	thread = g_thread_create ((GThreadFunc) mcm_profile_store_scan_walk_thread, scan, FALSE, &error);
+	if (thread == NULL) {
+		egg_warning ("failed to start scan: %s", error->message);
+		g_error_free (error);
+		g_idle_add ((GSourceFunc) mcm_profile_store_scan_walk_cb, scan);
+		return;
+	}
+
+	/* do not wait for ever on a volume */
+	if (scan->volume != NULL) {
+		scan->watchdog_id = g_timeout_add ((guint) (MCM_PROFILE_STORE_VOLUME_WATCHDOG * 1000),
+						   (GSourceFunc) mcm_profile_store_scan_watchdog_cb, scan);
+	}
+}
+
+/**
+ * mcm_profile_store_get_mount_uuid:
+ *
+ * Return value: the filesystem UUID, or %NULL if it is not known
+ **/
+static gchar *
+mcm_profile_store_get_mount_uuid (GMount *mount)
+{
+	gchar *uuid;
+	GVolume *volume;
+
+	uuid = g_mount_get_uuid (mount);
+	if (uuid != NULL)
+		return uuid;
+
+	/* the volume may know even if the mount does not */
+	volume = g_mount_get_volume (mount);
+	if (volume == NULL)
+		return NULL;
+	uuid = g_volume_get_identifier (volume, G_VOLUME_IDENTIFIER_KIND_UUID);
+	g_object_unref (volume);
+	return uuid;
+}
+
+/**
+ * mcm_profile_store_scan_volume:
+ *
+ * Volumes can be slow or on the network, so each one is scanned in the
+ * background, and the results are cached using the filesystem UUID.
+ **/
+static void
+mcm_profile_store_scan_volume (McmProfileStore *profile_store, GMount *mount)
+{
+	GFile *root;
+	gchar *path;
+	gpointer key;
+	gpointer value;
+	GCancellable *cancellable;
+	McmProfileStoreScan *scan;
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	/* only local mounts */
+	root = g_mount_get_root (mount);
+	path = g_file_get_path (root);
+	if (path == NULL)
+		goto out;
+
+	/* already being scanned */
+	if (g_hash_table_lookup (priv->volume_jobs, path) != NULL) {
+		egg_debug ("already scanning %s", path);
 		goto out;
 	}
+
+	/* cancelled if the mount is removed */
+	cancellable = g_cancellable_new ();
+	scan = mcm_profile_store_scan_new (profile_store, cancellable, NULL, NULL);
+	scan->volume = g_object_ref (root);
+	scan->volume_root = g_strdup (path);
+	scan->uuid = mcm_profile_store_get_mount_uuid (mount);
+	scan->budget = mcm_scan_budget_new (MCM_PROFILE_STORE_VOLUME_TIME_BUDGET, MCM_PROFILE_STORE_VOLUME_IO_BUDGET);
+	g_hash_table_insert (priv->volume_jobs, g_strdup (path), cancellable);
+
+	/* the scan owns the old results until it finishes */
+	if (scan->uuid != NULL &&
+	    g_hash_table_lookup_extended (priv->volume_cache, scan->uuid, &key, &value)) {
+		g_hash_table_steal (priv->volume_cache, scan->uuid);
+		g_free (key);
+		scan->cache = value;
+	}
+	egg_debug ("scanning %s in the background", path);
+	mcm_profile_store_scan_start (scan);
 out:
-	g_free (path_root);
+	g_free (path);
 	g_object_unref (root);
-	return success;
 }
 
 /**
- * mcm_profile_store_add_profiles_from_mounted_volumes:
+ * mcm_profile_store_scan_volumes:
  **/
-static gboolean
-mcm_profile_store_add_profiles_from_mounted_volumes (McmProfileStore *profile_store)
+static void
+mcm_profile_store_scan_volumes (McmProfileStore *profile_store)
 {
 	gboolean ret;
-	gboolean success = FALSE;
 	GList *mounts, *l;
-	GMount *mount;
 	McmProfileStorePrivate *priv = profile_store->priv;
 
-	/* get all current mounts */
+	/* get OSX and Windows system-wide profiles when using Linux */
+	ret = g_settings_get_boolean (priv->settings, MCM_SETTINGS_USE_PROFILES_FROM_VOLUMES);
+	if (!ret)
+		return;
 	mounts = g_volume_monitor_get_mounts (priv->volume_monitor);
 	for (l = mounts; l != NULL; l = l->next) {
-		mount = l->data;
-		ret = mcm_profile_store_add_profiles_from_mounted_volume (profile_store, mount);
-		if (ret)
-			success = TRUE;
-		g_object_unref (mount);
+		mcm_profile_store_scan_volume (profile_store, l->data);
+		g_object_unref (l->data);
 	}
 	g_list_free (mounts);
-	return success;
 }
 
 /**
- * mcm_profile_store_add_profiles:
+ * mcm_profile_store_search_default_async:
+ * @profile_store: a valid %McmProfileStore instance
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Searches the same locations as mcm_profile_store_search_default() without
+ * blocking. The directories are walked in a thread, new profiles are parsed
+ * on a pool of workers, and they are added to the store in batches.
+ * "scan-progress" is emitted after each batch, and "scan-complete" when
+ * the search has finished. Mounted volumes are scanned separately.
+ **/
+void
+mcm_profile_store_search_default_async (McmProfileStore *profile_store, GCancellable *cancellable,
+					GAsyncReadyCallback callback, gpointer user_data)
+{
+	McmProfileStoreScan *scan;
+
+	g_return_if_fail (MCM_IS_PROFILE_STORE (profile_store));
+
+	scan = mcm_profile_store_scan_new (profile_store, cancellable, callback, user_data);
+	g_ptr_array_unref (scan->roots);
+	scan->roots = mcm_profile_store_get_default_paths ();
+	mcm_profile_store_scan_start (scan);
+
+	/* get OSX and Windows system-wide profiles when using Linux */
+	mcm_profile_store_scan_volumes (profile_store);
+}
+
+/**
+ * mcm_profile_store_search_default_finish:
  *
  * Return value: if any profile were added
  **/
 gboolean
-mcm_profile_store_search_default (McmProfileStore *profile_store)
+mcm_profile_store_search_default_finish (McmProfileStore *profile_store, GAsyncResult *res, GError **error)
+{
+	GSimpleAsyncResult *simple;
+
+	g_return_val_if_fail (MCM_IS_PROFILE_STORE (profile_store), FALSE);
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), FALSE);
+	simple = G_SIMPLE_ASYNC_RESULT (res);
+	g_return_val_if_fail (g_simple_async_result_get_source_tag (simple) == mcm_profile_store_search_default_async, FALSE);
+
+	if (g_simple_async_result_propagate_error (simple, error))
+		return FALSE;
+	return g_simple_async_result_get_op_res_gboolean (simple);
+}
+
+/**
+ * mcm_profile_store_session_add:
+ **/
+static void
+mcm_profile_store_session_add (McmProfileStore *profile_store, GVariant *value)
 {
-	gchar *path;
 	gboolean ret;
-	gboolean success = FALSE;
-	GError *error;
+	McmProfile *profile;
+	McmProfile *profile_tmp;
+	const gchar *filename;
+	const gchar *id;
+
+	profile = mcm_profile_default_new ();
+	ret = mcm_profile_set_from_variant (profile, value);
+	if (!ret)
+		goto out;
+	filename = mcm_profile_get_filename (profile);
+	id = mcm_profile_get_id (profile);
+	if (filename == NULL || id == NULL) {
+		egg_warning ("ignoring incomplete profile from session");
+		goto out;
+	}
+
+	/* the session has already chosen between duplicates */
+	profile_tmp = mcm_profile_store_get_by_id (profile_store, id);
+	if (profile_tmp != NULL) {
+		mcm_profile_store_remove_profile (profile_store, profile_tmp);
+		g_object_unref (profile_tmp);
+	}
+	profile_tmp = mcm_profile_store_get_by_filename (profile_store, filename);
+	if (profile_tmp != NULL) {
+		mcm_profile_store_remove_profile (profile_store, profile_tmp);
+		g_object_unref (profile_tmp);
+	}
+	mcm_profile_store_add_parsed_profile (profile_store, profile);
+out:
+	g_object_unref (profile);
+}
+
+/**
+ * mcm_profile_store_session_apply:
+ *
+ * Applies the changes from mcm-session as one batch.
+ **/
+static void
+mcm_profile_store_session_apply (McmProfileStore *profile_store, gboolean reset, GVariant *removed, GVariant *added)
+{
+	guint i;
+	guint len;
+	const gchar *id;
+	GVariant *value;
+	McmProfile *profile;
 	McmProfileStorePrivate *priv = profile_store->priv;
 
-	/* get OSX and Linux system-wide profiles */
-	ret = mcm_profile_store_search_by_path (profile_store, "/usr/share/color/icc");
-	if (ret)
-		success = TRUE;
-	ret = mcm_profile_store_search_by_path (profile_store, "/usr/local/share/color/icc");
-	if (ret)
-		success = TRUE;
-	ret = mcm_profile_store_search_by_path (profile_store, "/Library/ColorSync/Profiles/Displays");
-	if (ret)
-		success = TRUE;
+	mcm_profile_store_begin_batch (profile_store);
 
-	/* get OSX and Windows system-wide profiles when using Linux */
-	ret = g_settings_get_boolean (priv->settings, MCM_SETTINGS_USE_PROFILES_FROM_VOLUMES);
-	if (ret) {
-		ret = mcm_profile_store_add_profiles_from_mounted_volumes (profile_store);
-		if (ret)
-			success = TRUE;
+	/* start again with what the session has */
+	if (reset) {
+		while (priv->profile_array->len > 0) {
+			profile = g_ptr_array_index (priv->profile_array, priv->profile_array->len - 1);
+			mcm_profile_store_remove_profile (profile_store, profile);
+		}
 	}
 
-	/* get Linux per-user profiles */
-	path = g_build_filename (g_get_user_data_dir (), "icc", NULL);
-	ret = mcm_utils_mkdir_with_parents (path, &error);
-	if (!ret) {
-		egg_error ("failed to create directory on startup: %s", error->message);
+	/* remove the old profiles */
+	len = removed != NULL ? g_variant_n_children (removed) : 0;
+	for (i=0; i<len; i++) {
+		g_variant_get_child (removed, i, "&s", &id);
+		profile = mcm_profile_store_get_by_id (profile_store, id);
+		if (profile == NULL)
+			continue;
+		mcm_profile_store_remove_profile (profile_store, profile);
+		g_object_unref (profile);
+	}
+
+	/* add the new ones */
+	len = g_variant_n_children (added);
+	for (i=0; i<len; i++) {
+		value = g_variant_get_child_value (added, i);
+		mcm_profile_store_session_add (profile_store, value);
+		g_variant_unref (value);
+	}
+	egg_debug ("applied %i profiles from session, serial now %u", len, priv->session_serial);
+
+	mcm_profile_store_end_batch (profile_store);
+}
+
+/**
+ * mcm_profile_store_session_get_changes_cb:
+ **/
+static void
+mcm_profile_store_session_get_changes_cb (GObject *source_object, GAsyncResult *res, McmProfileStore *profile_store)
+{
+	gboolean reset;
+	GError *error = NULL;
+	GVariant *response;
+	GVariant *removed = NULL;
+	GVariant *added = NULL;
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	priv->session_pending = FALSE;
+	response = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), res, &error);
+	if (response == NULL) {
+		egg_warning ("failed to get profile changes: %s", error->message);
 		g_error_free (error);
-	} else {
-		ret = mcm_profile_store_search_by_path (profile_store, path);
-		if (ret)
-			success = TRUE;
+		goto out;
 	}
-	g_free (path);
 
-	/* get per-user profiles from obsolete location */
-	path = g_build_filename (g_get_home_dir (), ".color", "icc", NULL);
-	ret = mcm_profile_store_search_by_path (profile_store, path);
-	if (ret)
-		success = TRUE;
-	g_free (path);
+	/* mcm-session went away while we were waiting */
+	if (priv->session_signal_id == 0)
+		goto out;
 
-	/* get OSX per-user profiles */
-	path = g_build_filename (g_get_home_dir (), "Library", "ColorSync", "Profiles", NULL);
-	ret = mcm_profile_store_search_by_path (profile_store, path);
-	if (ret)
-		success = TRUE;
-	g_free (path);
+	g_variant_get (response, "(ub@as@a" MCM_PROFILE_VARIANT_TYPE ")",
+		       &priv->session_serial, &reset, &removed, &added);
+	mcm_profile_store_session_apply (profile_store, reset, removed, added);
 
-	/* get machine specific profiles */
-	ret = mcm_profile_store_search_by_path (profile_store, "/var/lib/color/icc");
-	if (ret)
-		success = TRUE;
-	return success;
+	/* something else changed while we were asking */
+	if (priv->session_dirty)
+		mcm_profile_store_session_get_changes (profile_store);
+out:
+	if (removed != NULL)
+		g_variant_unref (removed);
+	if (added != NULL)
+		g_variant_unref (added);
+	if (response != NULL)
+		g_variant_unref (response);
+	g_object_unref (profile_store);
+}
+
+/**
+ * mcm_profile_store_session_get_changes:
+ *
+ * Only one request is made at a time; if the session changes again while
+ * it is running then another is made when it has finished.
+ **/
+static void
+mcm_profile_store_session_get_changes (McmProfileStore *profile_store)
+{
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	if (priv->session_pending) {
+		priv->session_dirty = TRUE;
+		return;
+	}
+	priv->session_pending = TRUE;
+	priv->session_dirty = FALSE;
+	g_dbus_connection_call (priv->connection,
+				MCM_DBUS_SERVICE,
+				MCM_DBUS_PATH,
+				MCM_DBUS_INTERFACE,
+				"GetProfileChanges",
+				g_variant_new ("(u)", priv->session_serial),
+				G_VARIANT_TYPE ("(ubasa" MCM_PROFILE_VARIANT_TYPE ")"),
+				G_DBUS_CALL_FLAGS_NO_AUTO_START,
+				-1, NULL,
+				(GAsyncReadyCallback) mcm_profile_store_session_get_changes_cb,
+				g_object_ref (profile_store));
+}
+
+/**
+ * mcm_profile_store_session_changed_cb:
+ **/
+static void
+mcm_profile_store_session_changed_cb (GDBusConnection *connection, const gchar *sender_name,
+				      const gchar *object_path, const gchar *interface_name,
+				      const gchar *signal_name, GVariant *parameters,
+				      McmProfileStore *profile_store)
+{
+	mcm_profile_store_session_get_changes (profile_store);
+}
+
+/**
+ * mcm_profile_store_session_vanished_cb:
+ *
+ * mcm-session has gone, for instance if it crashed, so nothing will tell
+ * us about new profiles. Look for them ourselves from now on.
+ **/
+static void
+mcm_profile_store_session_vanished_cb (GDBusConnection *connection, const gchar *name, McmProfileStore *profile_store)
+{
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	egg_warning ("%s has gone, searching for profiles locally", name);
+	g_bus_unwatch_name (priv->session_watch_id);
+	priv->session_watch_id = 0;
+	g_dbus_connection_signal_unsubscribe (priv->connection, priv->session_signal_id);
+	priv->session_signal_id = 0;
+
+	/* the profiles we already have are kept */
+	mcm_profile_store_search_default_async (profile_store, NULL, NULL, NULL);
+}
+
+/**
+ * mcm_profile_store_attach_session:
+ *
+ * @profile_store: a valid %McmProfileStore instance
+ * @cancellable: a #GCancellable or %NULL
+ * @error: a #GError or %NULL
+ *
+ * Gets all the profiles already found by mcm-session in one D-Bus call,
+ * rather than searching for and parsing them again. The store is then kept
+ * up to date with the changes the session sees, so there is no need to call
+ * mcm_profile_store_search_default() as well. If mcm-session goes away
+ * then the store searches for profiles itself.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+mcm_profile_store_attach_session (McmProfileStore *profile_store, GCancellable *cancellable, GError **error)
+{
+	gboolean ret = FALSE;
+	GVariant *response = NULL;
+	GVariant *added = NULL;
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	g_return_val_if_fail (MCM_IS_PROFILE_STORE (profile_store), FALSE);
+	g_return_val_if_fail (priv->session_signal_id == 0, FALSE);
+
+	/* get a session bus connection */
+	if (priv->connection == NULL) {
+		priv->connection = g_bus_get_sync (G_BUS_TYPE_SESSION, cancellable, error);
+		if (priv->connection == NULL)
+			goto out;
+	}
+
+	/* watch for changes first so that none are missed */
+	priv->session_signal_id =
+		g_dbus_connection_signal_subscribe (priv->connection,
+						    MCM_DBUS_SERVICE,
+						    MCM_DBUS_INTERFACE,
+						    "Changed",
+						    MCM_DBUS_PATH,
+						    NULL,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    (GDBusSignalCallback) mcm_profile_store_session_changed_cb,
+						    profile_store, NULL);
+
+	/* get everything the session already knows about */
+	response = g_dbus_connection_call_sync (priv->connection,
+						MCM_DBUS_SERVICE,
+						MCM_DBUS_PATH,
+						MCM_DBUS_INTERFACE,
+						"GetProfiles",
+						NULL,
+						G_VARIANT_TYPE ("(ua" MCM_PROFILE_VARIANT_TYPE ")"),
+						G_DBUS_CALL_FLAGS_NONE,
+						-1, cancellable, error);
+	if (response == NULL) {
+		g_dbus_connection_signal_unsubscribe (priv->connection, priv->session_signal_id);
+		priv->session_signal_id = 0;
+		goto out;
+	}
+	g_variant_get (response, "(u@a" MCM_PROFILE_VARIANT_TYPE ")", &priv->session_serial, &added);
+	mcm_profile_store_session_apply (profile_store, FALSE, NULL, added);
+
+	/* mcm-session stays running while we are connected */
+	priv->session_watch_id =
+		g_bus_watch_name_on_connection (priv->connection,
+						MCM_DBUS_SERVICE,
+						G_BUS_NAME_WATCHER_FLAGS_NONE,
+						NULL,
+						(GBusNameVanishedCallback) mcm_profile_store_session_vanished_cb,
+						profile_store, NULL);
+
+	/* success */
+	ret = TRUE;
+out:
+	if (added != NULL)
+		g_variant_unref (added);
+	if (response != NULL)
+		g_variant_unref (response);
+	return ret;
 }
 
 /**
@@ -547,7 +1977,45 @@ mcm_profile_store_search_default (McmProfileStore *profile_store)
 static void
 mcm_profile_store_volume_monitor_mount_added_cb (GVolumeMonitor *volume_monitor, GMount *mount, McmProfileStore *profile_store)
 {
-	mcm_profile_store_add_profiles_from_mounted_volume (profile_store, mount);
+	gboolean ret;
+
+	ret = g_settings_get_boolean (profile_store->priv->settings, MCM_SETTINGS_USE_PROFILES_FROM_VOLUMES);
+	if (ret)
+		mcm_profile_store_scan_volume (profile_store, mount);
+}
+
+/**
+ * mcm_profile_store_volume_monitor_mount_removed_cb:
+ **/
+static void
+mcm_profile_store_volume_monitor_mount_removed_cb (GVolumeMonitor *volume_monitor, GMount *mount, McmProfileStore *profile_store)
+{
+	GFile *root;
+	gchar *path;
+	GCancellable *cancellable;
+	McmProfileStorePrivate *priv = profile_store->priv;
+
+	root = g_mount_get_root (mount);
+	path = g_file_get_path (root);
+	if (path == NULL)
+		goto out;
+
+	/* stop any scan in progress */
+	cancellable = g_hash_table_lookup (priv->volume_jobs, path);
+	if (cancellable != NULL) {
+		egg_debug ("cancelling scan of %s", path);
+		g_cancellable_cancel (cancellable);
+		g_hash_table_remove (priv->volume_jobs, path);
+	}
+
+	/* the profiles on it have gone too */
+	mcm_profile_store_remove_monitors (profile_store, path);
+	mcm_profile_store_begin_batch (profile_store);
+	mcm_profile_store_remove_path (profile_store, path);
+	mcm_profile_store_end_batch (profile_store);
+out:
+	g_free (path);
+	g_object_unref (root);
 }
 
 /**
@@ -586,6 +2054,24 @@ mcm_profile_store_class_init (McmProfileStoreClass *klass)
 			      G_STRUCT_OFFSET (McmProfileStoreClass, changed),
 			      NULL, NULL, g_cclosure_marshal_VOID__VOID,
 			      G_TYPE_NONE, 0);
+	/**
+	 * McmProfileStore::scan-progress
+	 **/
+	signals[SIGNAL_SCAN_PROGRESS] =
+		g_signal_new ("scan-progress",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (McmProfileStoreClass, scan_progress),
+			      NULL, NULL, g_cclosure_marshal_VOID__UINT,
+			      G_TYPE_NONE, 1, G_TYPE_UINT);
+	/**
+	 * McmProfileStore::scan-complete
+	 **/
+	signals[SIGNAL_SCAN_COMPLETE] =
+		g_signal_new ("scan-complete",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (McmProfileStoreClass, scan_complete),
+			      NULL, NULL, g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
 
 	g_type_class_add_private (klass, sizeof (McmProfileStorePrivate));
 }
@@ -599,8 +2085,27 @@ mcm_profile_store_init (McmProfileStore *profile_store)
 	profile_store->priv = MCM_PROFILE_STORE_GET_PRIVATE (profile_store);
 	profile_store->priv->profile_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	profile_store->priv->monitor_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
-	profile_store->priv->directory_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
+	profile_store->priv->directory_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	profile_store->priv->hash_filename = g_hash_table_new (g_str_hash, g_str_equal);
+	profile_store->priv->hash_id = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	profile_store->priv->hash_kind = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+								NULL, (GDestroyNotify) g_ptr_array_unref);
+	profile_store->priv->hash_profile = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
 	profile_store->priv->settings = g_settings_new (MCM_SETTINGS_SCHEMA);
+	profile_store->priv->profile_index = NULL;
+	profile_store->priv->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	profile_store->priv->pending_id = 0;
+	profile_store->priv->in_batch = FALSE;
+	profile_store->priv->batch_changed = FALSE;
+	profile_store->priv->volume_jobs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_object_unref);
+	profile_store->priv->volume_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+								   (GDestroyNotify) mcm_volume_cache_free);
+	profile_store->priv->connection = NULL;
+	profile_store->priv->session_signal_id = 0;
+	profile_store->priv->session_watch_id = 0;
+	profile_store->priv->session_serial = 0;
+	profile_store->priv->session_pending = FALSE;
+	profile_store->priv->session_dirty = FALSE;
 
 	/* watch for volumes to be connected */
 	profile_store->priv->volume_monitor = g_volume_monitor_get ();
@@ -608,6 +2113,10 @@ mcm_profile_store_init (McmProfileStore *profile_store)
 			  "mount-added",
 			  G_CALLBACK(mcm_profile_store_volume_monitor_mount_added_cb),
 			  profile_store);
+	g_signal_connect (profile_store->priv->volume_monitor,
+			  "mount-removed",
+			  G_CALLBACK(mcm_profile_store_volume_monitor_mount_removed_cb),
+			  profile_store);
 }
 
 /**
@@ -619,11 +2128,29 @@ mcm_profile_store_finalize (GObject *object)
 	McmProfileStore *profile_store = MCM_PROFILE_STORE (object);
 	McmProfileStorePrivate *priv = profile_store->priv;
 
+	if (priv->pending_id != 0)
+		g_source_remove (priv->pending_id);
+	g_hash_table_destroy (priv->pending);
 	g_ptr_array_unref (priv->profile_array);
 	g_ptr_array_unref (priv->monitor_array);
-	g_ptr_array_unref (priv->directory_array);
+	g_hash_table_destroy (priv->directory_hash);
+	g_hash_table_destroy (priv->hash_filename);
+	g_hash_table_destroy (priv->hash_id);
+	g_hash_table_destroy (priv->hash_kind);
+	g_hash_table_destroy (priv->hash_profile);
+	g_hash_table_destroy (priv->volume_jobs);
+	g_hash_table_destroy (priv->volume_cache);
+	g_signal_handlers_disconnect_matched (priv->volume_monitor, G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL, profile_store);
 	g_object_unref (priv->volume_monitor);
 	g_object_unref (priv->settings);
+	if (priv->session_watch_id != 0)
+		g_bus_unwatch_name (priv->session_watch_id);
+	if (priv->session_signal_id != 0)
+		g_dbus_connection_signal_unsubscribe (priv->connection, priv->session_signal_id);
+	if (priv->connection != NULL)
+		g_object_unref (priv->connection);
+	mcm_profile_index_free (priv->profile_index);
 
 	G_OBJECT_CLASS (mcm_profile_store_parent_class)->finalize (object);
 }
@@ -23,6 +23,7 @@
 #define __MCM_PROFILE_STORE_H
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 #include "mcm-profile.h"
 
@@ -51,9 +52,9 @@ struct _McmProfileStoreClass
 	void		(* added)			(McmProfile		*profile);
 	void		(* removed)			(McmProfile		*profile);
 	void		(* changed)			(void);
+	void		(* scan_progress)		(guint			 percentage);
+	void		(* scan_complete)		(void);
 	/* padding for future expansion */
-	void (*_mcm_reserved1) (void);
-	void (*_mcm_reserved2) (void);
 	void (*_mcm_reserved3) (void);
 	void (*_mcm_reserved4) (void);
 	void (*_mcm_reserved5) (void);
@@ -66,10 +67,27 @@ McmProfile	*mcm_profile_store_get_by_filename	(McmProfileStore	*profile_store,
 							 const gchar		*filename);
 McmProfile	*mcm_profile_store_get_by_checksum	(McmProfileStore	*profile_store,
 							 const gchar		*checksum);
+McmProfile	*mcm_profile_store_get_by_id		(McmProfileStore	*profile_store,
+							 const gchar		*id);
+GPtrArray	*mcm_profile_store_get_by_kind		(McmProfileStore	*profile_store,
+							 McmProfileKind		 kind,
+							 McmColorspace		 colorspace);
 GPtrArray	*mcm_profile_store_get_array		(McmProfileStore	*profile_store);
 gboolean	 mcm_profile_store_search_default	(McmProfileStore	*profile_store);
+void		 mcm_profile_store_search_default_async	(McmProfileStore	*profile_store,
+							 GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+gboolean	 mcm_profile_store_search_default_finish (McmProfileStore	*profile_store,
+							 GAsyncResult		*res,
+							 GError			**error);
 gboolean	 mcm_profile_store_search_by_path	(McmProfileStore	*profile_store,
 							 const gchar		*path);
+gboolean	 mcm_profile_store_add_profiles		(McmProfileStore	*profile_store,
+							 GPtrArray		*profiles);
+gboolean	 mcm_profile_store_attach_session	(McmProfileStore	*profile_store,
+							 GCancellable		*cancellable,
+							 GError			**error);
 
 G_END_DECLS
 
@@ -32,16 +32,26 @@
 #include <glib-object.h>
 #include <glib/gi18n.h>
 #include <gio/gio.h>
+#include <unistd.h>
 
 #include "egg-debug.h"
 
 #include "mcm-profile.h"
 #include "mcm-utils.h"
 #include "mcm-xyz.h"
-#include "mcm-profile-lcms1.h"
+#ifdef MCM_USE_LCMS2
+ #include "mcm-profile-lcms2.h"
+#else
+ #include "mcm-profile-lcms1.h"
+#endif
 
 static void     mcm_profile_finalize	(GObject     *object);
 
+#define MCM_PROFILE_HEADER_ID		0x54
+#define MCM_PROFILE_HEADER_ID_SIZE	0x10
+
+#define MCM_PROFILE_PARSE_MAX_THREADS	8
+
 #define MCM_PROFILE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), MCM_TYPE_PROFILE, McmProfilePrivate))
 
 /**
@@ -56,6 +66,7 @@ struct _McmProfilePrivate
 	guint			 size;
 	gboolean		 has_vcgt;
 	gboolean		 can_delete;
+	gboolean		 lightweight;
 	gchar			*description;
 	gchar			*filename;
 	gchar			*copyright;
@@ -63,12 +74,14 @@ struct _McmProfilePrivate
 	gchar			*model;
 	gchar			*datetime;
 	gchar			*checksum;
+	gchar			*id;
 	McmXyz			*white;
 	McmXyz			*black;
 	McmXyz			*red;
 	McmXyz			*green;
 	McmXyz			*blue;
 	GFileMonitor		*monitor;
+	guint			 monitor_id;
 };
 
 enum {
@@ -78,6 +91,7 @@ enum {
 	PROP_MODEL,
 	PROP_DATETIME,
 	PROP_CHECKSUM,
+	PROP_ID,
 	PROP_DESCRIPTION,
 	PROP_FILENAME,
 	PROP_KIND,
@@ -85,6 +99,7 @@ enum {
 	PROP_SIZE,
 	PROP_HAS_VCGT,
 	PROP_CAN_DELETE,
+	PROP_LIGHTWEIGHT,
 	PROP_WHITE,
 	PROP_BLACK,
 	PROP_RED,
@@ -167,14 +182,47 @@ mcm_profile_has_colorspace_description (McmProfile *profile)
 	return FALSE;
 }
 
+/**
+ * mcm_profile_add_monitor:
+ **/
+static void
+mcm_profile_add_monitor (McmProfile *profile)
+{
+	GFile *file;
+	McmProfilePrivate *priv = profile->priv;
+
+	if (priv->filename == NULL || priv->monitor != NULL)
+		return;
+	file = g_file_new_for_path (priv->filename);
+	priv->monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
+	if (priv->monitor != NULL)
+		g_signal_connect (priv->monitor, "changed", G_CALLBACK(mcm_profile_file_monitor_changed_cb), profile);
+	g_object_unref (file);
+}
+
+/**
+ * mcm_profile_add_monitor_idle_cb:
+ **/
+static gboolean
+mcm_profile_add_monitor_idle_cb (McmProfile *profile)
+{
+	profile->priv->monitor_id = 0;
+	mcm_profile_add_monitor (profile);
+	return FALSE;
+}
+
 /**
  * mcm_profile_set_filename:
+ *
+ * Profiles are created in worker threads and in private contexts when
+ * parsing, so the file monitor is only created directly if nothing else
+ * is using the default main context, and otherwise from an idle there.
  **/
 void
 mcm_profile_set_filename (McmProfile *profile, const gchar *filename)
 {
 	McmProfilePrivate *priv = profile->priv;
-	GFile *file;
+	GMainContext *context;
 
 	g_return_if_fail (MCM_IS_PROFILE (profile));
 
@@ -188,12 +236,15 @@ mcm_profile_set_filename (McmProfile *profile, const gchar *filename)
 	}
 
 	/* setup watch on new profile */
+	context = g_main_context_default ();
 	if (priv->filename != NULL) {
-		file = g_file_new_for_path (priv->filename);
-		priv->monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
-		if (priv->monitor != NULL)
-			g_signal_connect (priv->monitor, "changed", G_CALLBACK(mcm_profile_file_monitor_changed_cb), profile);
-		g_object_unref (file);
+		if (g_main_context_get_thread_default () == NULL && g_main_context_acquire (context)) {
+			mcm_profile_add_monitor (profile);
+			g_main_context_release (context);
+		} else if (priv->monitor_id == 0) {
+			priv->monitor_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, (GSourceFunc) mcm_profile_add_monitor_idle_cb,
+							    g_object_ref (profile), (GDestroyNotify) g_object_unref);
+		}
 	}
 	g_object_notify (G_OBJECT (profile), "filename");
 }
@@ -304,16 +355,112 @@ mcm_profile_set_datetime (McmProfile *profile, const gchar *datetime)
 	g_object_notify (G_OBJECT (profile), "datetime");
 }
 
+/**
+ * mcm_profile_ensure_checksum:
+ **/
+static void
+mcm_profile_ensure_checksum (McmProfile *profile)
+{
+	GMappedFile *mapped_file;
+	GError *error = NULL;
+	McmProfilePrivate *priv = profile->priv;
+
+	/* already done, or nothing to do it from */
+	if (priv->checksum != NULL || priv->filename == NULL)
+		return;
+
+	/* map the file again, as we don't keep the data after parsing */
+	mapped_file = g_mapped_file_new (priv->filename, FALSE, &error);
+	if (mapped_file == NULL) {
+		egg_warning ("failed to checksum %s: %s", priv->filename, error->message);
+		g_error_free (error);
+		return;
+	}
+	priv->checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+						      (const guchar *) g_mapped_file_get_contents (mapped_file),
+						      g_mapped_file_get_length (mapped_file));
+	g_mapped_file_unref (mapped_file);
+}
+
 /**
  * mcm_profile_get_checksum:
+ *
+ * Gets the MD5 of the profile data. For profiles parsed from a file this is
+ * only computed the first time it is asked for, so use mcm_profile_get_id()
+ * if you just want to tell profiles apart.
  **/
 const gchar *
 mcm_profile_get_checksum (McmProfile *profile)
 {
 	g_return_val_if_fail (MCM_IS_PROFILE (profile), NULL);
+	mcm_profile_ensure_checksum (profile);
 	return profile->priv->checksum;
 }
 
+/**
+ * mcm_profile_get_id:
+ *
+ * Gets a string that identifies the profile contents. This is the ICC
+ * profile ID if the profile has one, and a fast hash of the data otherwise.
+ **/
+const gchar *
+mcm_profile_get_id (McmProfile *profile)
+{
+	g_return_val_if_fail (MCM_IS_PROFILE (profile), NULL);
+	return profile->priv->id;
+}
+
+/**
+ * mcm_profile_set_id:
+ *
+ * Sets the content identity, which is only needed if the profile has not
+ * been parsed, for instance when it was created from a #McmProfileIndex.
+ **/
+void
+mcm_profile_set_id (McmProfile *profile, const gchar *id)
+{
+	McmProfilePrivate *priv = profile->priv;
+
+	g_return_if_fail (MCM_IS_PROFILE (profile));
+
+	g_free (priv->id);
+	priv->id = g_strdup (id);
+	g_object_notify (G_OBJECT (profile), "id");
+}
+
+/**
+ * mcm_profile_compute_id:
+ **/
+static gchar *
+mcm_profile_compute_id (const guint8 *data, gsize length)
+{
+	guint i;
+	gboolean has_profile_id = FALSE;
+	GString *string;
+
+	/* the profile ID is optional, and all zeros when not set */
+	if (length >= MCM_PROFILE_HEADER_ID + MCM_PROFILE_HEADER_ID_SIZE) {
+		for (i=0; i<MCM_PROFILE_HEADER_ID_SIZE; i++) {
+			if (data[MCM_PROFILE_HEADER_ID + i] != 0) {
+				has_profile_id = TRUE;
+				break;
+			}
+		}
+	}
+
+	/* use the ICC profile ID */
+	if (has_profile_id) {
+		string = g_string_new ("icc-");
+		for (i=0; i<MCM_PROFILE_HEADER_ID_SIZE; i++)
+			g_string_append_printf (string, "%02x", data[MCM_PROFILE_HEADER_ID + i]);
+		return g_string_free (string, FALSE);
+	}
+
+	/* fall back to hashing the contents */
+	return g_strdup_printf ("hash-%016" G_GINT64_MODIFIER "x-%" G_GSIZE_FORMAT,
+				mcm_utils_hash_data (data, length), length);
+}
+
 /**
  * mcm_profile_set_checksum:
  **/
@@ -424,10 +571,154 @@ mcm_profile_get_can_delete (McmProfile *profile)
 }
 
 /**
- * mcm_profile_parse_data:
+ * mcm_profile_set_can_delete:
+ **/
+void
+mcm_profile_set_can_delete (McmProfile *profile, gboolean can_delete)
+{
+	g_return_if_fail (MCM_IS_PROFILE (profile));
+	profile->priv->can_delete = can_delete;
+	g_object_notify (G_OBJECT (profile), "can-delete");
+}
+
+/**
+ * mcm_profile_get_lightweight:
  **/
 gboolean
-mcm_profile_parse_data (McmProfile *profile, const guint8 *data, gsize length, GError **error)
+mcm_profile_get_lightweight (McmProfile *profile)
+{
+	g_return_val_if_fail (MCM_IS_PROFILE (profile), FALSE);
+	return profile->priv->lightweight;
+}
+
+/**
+ * mcm_profile_set_lightweight:
+ *
+ * In lightweight mode only the header and the metadata tags are parsed, and
+ * the white point, black point and primaries are loaded from the file when
+ * they are first requested. This has to be set before the profile is parsed.
+ **/
+void
+mcm_profile_set_lightweight (McmProfile *profile, gboolean lightweight)
+{
+	g_return_if_fail (MCM_IS_PROFILE (profile));
+	profile->priv->lightweight = lightweight;
+	g_object_notify (G_OBJECT (profile), "lightweight");
+}
+
+/**
+ * mcm_profile_variant_string:
+ **/
+static const gchar *
+mcm_profile_variant_string (const gchar *text)
+{
+	return text != NULL ? text : "";
+}
+
+/**
+ * mcm_profile_get_variant:
+ *
+ * Gets the metadata needed to recreate a lightweight copy of the profile
+ * in another process, without parsing the file.
+ *
+ * Return value: a floating #GVariant of type %MCM_PROFILE_VARIANT_TYPE
+ **/
+GVariant *
+mcm_profile_get_variant (McmProfile *profile)
+{
+	McmProfilePrivate *priv = profile->priv;
+
+	g_return_val_if_fail (MCM_IS_PROFILE (profile), NULL);
+
+	return g_variant_new (MCM_PROFILE_VARIANT_TYPE,
+			      mcm_profile_variant_string (priv->filename),
+			      mcm_profile_variant_string (priv->id),
+			      mcm_profile_variant_string (priv->description),
+			      mcm_profile_variant_string (priv->copyright),
+			      mcm_profile_variant_string (priv->model),
+			      mcm_profile_variant_string (priv->manufacturer),
+			      mcm_profile_variant_string (priv->datetime),
+			      mcm_profile_kind_to_string (priv->kind),
+			      mcm_colorspace_to_string (priv->colorspace),
+			      priv->size,
+			      priv->has_vcgt,
+			      priv->can_delete);
+}
+
+/**
+ * mcm_profile_set_from_variant:
+ *
+ * The colorimetry is loaded from the file if it is needed later.
+ *
+ * Return value: %FALSE if @value is not of type %MCM_PROFILE_VARIANT_TYPE
+ **/
+gboolean
+mcm_profile_set_from_variant (McmProfile *profile, GVariant *value)
+{
+	const gchar *filename;
+	const gchar *id;
+	const gchar *description;
+	const gchar *copyright;
+	const gchar *model;
+	const gchar *manufacturer;
+	const gchar *datetime;
+	const gchar *kind;
+	const gchar *colorspace;
+	guint size;
+	gboolean has_vcgt;
+	gboolean can_delete;
+
+	g_return_val_if_fail (MCM_IS_PROFILE (profile), FALSE);
+	g_return_val_if_fail (value != NULL, FALSE);
+
+	if (!g_variant_is_of_type (value, G_VARIANT_TYPE (MCM_PROFILE_VARIANT_TYPE))) {
+		egg_warning ("invalid profile variant type %s", g_variant_get_type_string (value));
+		return FALSE;
+	}
+	g_variant_get (value, "(&s&s&s&s&s&s&s&s&subb)",
+		       &filename, &id, &description, &copyright, &model, &manufacturer,
+		       &datetime, &kind, &colorspace, &size, &has_vcgt, &can_delete);
+
+	mcm_profile_set_lightweight (profile, TRUE);
+	mcm_profile_set_id (profile, id[0] != '\0' ? id : NULL);
+	mcm_profile_set_description (profile, description[0] != '\0' ? description : NULL);
+	mcm_profile_set_copyright (profile, copyright[0] != '\0' ? copyright : NULL);
+	mcm_profile_set_model (profile, model[0] != '\0' ? model : NULL);
+	mcm_profile_set_manufacturer (profile, manufacturer[0] != '\0' ? manufacturer : NULL);
+	mcm_profile_set_datetime (profile, datetime[0] != '\0' ? datetime : NULL);
+	mcm_profile_set_kind (profile, mcm_profile_kind_from_string (kind));
+	mcm_profile_set_colorspace (profile, mcm_colorspace_from_string (colorspace));
+	mcm_profile_set_size (profile, size);
+	mcm_profile_set_has_vcgt (profile, has_vcgt);
+	mcm_profile_set_can_delete (profile, can_delete);
+	mcm_profile_set_filename (profile, filename[0] != '\0' ? filename : NULL);
+	return TRUE;
+}
+
+/**
+ * mcm_profile_ensure_colorimetry:
+ **/
+static void
+mcm_profile_ensure_colorimetry (McmProfile *profile)
+{
+	McmProfileClass *klass = MCM_PROFILE_GET_CLASS (profile);
+
+	/* do we have support */
+	if (klass->load_colorimetry == NULL)
+		return;
+
+	/* proxy, which is a no-op if already loaded */
+	klass->load_colorimetry (profile);
+}
+
+/**
+ * mcm_profile_parse_data_internal:
+ *
+ * @compute_checksum: if the MD5 should be computed now, which is only needed
+ * if the profile cannot be read again later
+ **/
+static gboolean
+mcm_profile_parse_data_internal (McmProfile *profile, const guint8 *data, gsize length, gboolean compute_checksum, GError **error)
 {
 	gboolean ret = FALSE;
 	gchar *checksum = NULL;
@@ -448,26 +739,48 @@ mcm_profile_parse_data (McmProfile *profile, const guint8 *data, gsize length, G
 	if (!ret)
 		goto out;
 
+	/* set the content identity */
+	g_free (priv->id);
+	priv->id = mcm_profile_compute_id (data, length);
+
 	/* generate and set checksum */
-	checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5, (const guchar *) data, length);
-	mcm_profile_set_checksum (profile, checksum);
+	if (compute_checksum) {
+		checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5, (const guchar *) data, length);
+		mcm_profile_set_checksum (profile, checksum);
+	}
 out:
 	g_free (checksum);
 	return ret;
 }
 
+/**
+ * mcm_profile_parse_data:
+ **/
+gboolean
+mcm_profile_parse_data (McmProfile *profile, const guint8 *data, gsize length, GError **error)
+{
+	g_return_val_if_fail (MCM_IS_PROFILE (profile), FALSE);
+	return mcm_profile_parse_data_internal (profile, data, length, TRUE, error);
+}
+
 /**
  * mcm_profile_parse:
+ *
+ * Local files are mapped rather than read, so the parser and the checksum
+ * work directly on the page cache and no heap copy of the profile is made.
  **/
 gboolean
 mcm_profile_parse (McmProfile *profile, GFile *file, GError **error)
 {
-	gchar *data = NULL;
+	gchar *contents = NULL;
+	const guint8 *data;
 	gboolean ret = FALSE;
-	gsize length;
+	gsize length = 0;
+	gsize copied = 0;
 	gchar *filename = NULL;
 	GError *error_local = NULL;
 	GFileInfo *info;
+	GMappedFile *mapped_file = NULL;
 
 	g_return_val_if_fail (MCM_IS_PROFILE (profile), FALSE);
 	g_return_val_if_fail (file != NULL, FALSE);
@@ -479,30 +792,363 @@ mcm_profile_parse (McmProfile *profile, GFile *file, GError **error)
 		goto out;
 	profile->priv->can_delete = g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE);
 
-	/* load files */
-	ret = g_file_load_contents (file, NULL, &data, &length, NULL, &error_local);
-	if (!ret) {
-		g_set_error (error, 1, 0, "failed to load profile: %s", error_local->message);
-		g_error_free (error_local);
+	/* map local files, and only load remote files into memory */
+	filename = g_file_get_path (file);
+	if (filename != NULL) {
+		mapped_file = g_mapped_file_new (filename, FALSE, &error_local);
+		if (mapped_file == NULL) {
+			g_set_error (error, 1, 0, "failed to map profile: %s", error_local->message);
+			g_error_free (error_local);
+			goto out;
+		}
+		data = (const guint8 *) g_mapped_file_get_contents (mapped_file);
+		length = g_mapped_file_get_length (mapped_file);
+	} else {
+		ret = g_file_load_contents (file, NULL, &contents, &length, NULL, &error_local);
+		if (!ret) {
+			g_set_error (error, 1, 0, "failed to load profile: %s", error_local->message);
+			g_error_free (error_local);
+			goto out;
+		}
+		data = (const guint8 *) contents;
+		copied = length;
+	}
+
+	/* an empty file cannot be mapped into anything useful */
+	if (data == NULL || length == 0) {
+		ret = FALSE;
+		g_set_error_literal (error, 1, 0, "failed to load profile: file is empty");
 		goto out;
 	}
 
-	/* parse the data */
-	ret = mcm_profile_parse_data (profile, (const guint8*)data, length, error);
+	/* parse the data, leaving the checksum until it is needed if we can */
+	ret = mcm_profile_parse_data_internal (profile, data, length, (filename == NULL), error);
 	if (!ret)
 		goto out;
+	egg_debug ("parsed %" G_GSIZE_FORMAT " bytes (%s), %" G_GSIZE_FORMAT " bytes copied on load",
+		   length, mapped_file != NULL ? "mapped" : "loaded", copied);
 
 	/* save */
-	filename = g_file_get_path (file);
-	mcm_profile_set_filename (profile, filename);
+	if (filename != NULL)
+		mcm_profile_set_filename (profile, filename);
 out:
+	/* the parser does not keep any pointers into the mapping */
+	if (mapped_file != NULL)
+		g_mapped_file_unref (mapped_file);
 	if (info != NULL)
 		g_object_unref (info);
 	g_free (filename);
-	g_free (data);
+	g_free (contents);
 	return ret;
 }
 
+/* state shared by all the files in one mcm_profile_parse_many_async() call */
+typedef struct {
+	GPtrArray		*files;
+	McmProfile		**profiles;
+	gboolean		 lightweight;
+	GCancellable		*cancellable;
+	McmProfileParseFunc	 func;
+	gpointer		 func_data;
+	GSimpleAsyncResult	*res;
+	GThreadPool		*pool;
+	GMainContext		*context;
+	guint			 pending;
+} McmProfileParseHelper;
+
+typedef struct {
+	McmProfileParseHelper	*helper;
+	guint			 idx;
+	McmProfile		*profile;
+	GError			*error;
+} McmProfileParseItem;
+
+/**
+ * mcm_profile_parse_many_complete_cb:
+ **/
+static gboolean
+mcm_profile_parse_many_complete_cb (McmProfileParseHelper *helper)
+{
+	guint i;
+	GPtrArray *array;
+	GError *error = NULL;
+
+	/* all the workers have finished */
+	if (helper->pool != NULL)
+		g_thread_pool_free (helper->pool, FALSE, TRUE);
+
+	/* return the profiles in the order they were asked for */
+	if (g_cancellable_set_error_if_cancelled (helper->cancellable, &error)) {
+		g_simple_async_result_set_from_error (helper->res, error);
+		g_error_free (error);
+	} else {
+		array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+		for (i=0; i<helper->files->len; i++) {
+			if (helper->profiles[i] != NULL)
+				g_ptr_array_add (array, g_object_ref (helper->profiles[i]));
+		}
+		g_simple_async_result_set_op_res_gpointer (helper->res, array, (GDestroyNotify) g_ptr_array_unref);
+	}
+	g_simple_async_result_complete (helper->res);
+
+	/* free helper */
+	for (i=0; i<helper->files->len; i++) {
+		if (helper->profiles[i] != NULL)
+			g_object_unref (helper->profiles[i]);
+	}
+	g_free (helper->profiles);
+	g_ptr_array_unref (helper->files);
+	if (helper->cancellable != NULL)
+		g_object_unref (helper->cancellable);
+	g_object_unref (helper->res);
+	g_main_context_unref (helper->context);
+	g_free (helper);
+	return FALSE;
+}
+
+/**
+ * mcm_profile_parse_many_done_cb:
+ *
+ * Called in the callers main context for each file, in completion order.
+ **/
+static gboolean
+mcm_profile_parse_many_done_cb (McmProfileParseItem *item)
+{
+	gchar *uri;
+	GFile *file;
+	McmProfileParseHelper *helper = item->helper;
+
+	/* tell the caller */
+	file = g_ptr_array_index (helper->files, item->idx);
+	if (helper->func != NULL)
+		helper->func (file, item->profile, item->error, helper->func_data);
+
+	/* the error is always for this file, even if lcms failed on another thread */
+	if (item->error != NULL) {
+		if (!g_error_matches (item->error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			uri = g_file_get_uri (file);
+			egg_warning ("failed to parse %s: %s", uri, item->error->message);
+			g_free (uri);
+		}
+		g_error_free (item->error);
+	}
+
+	/* takes ownership */
+	helper->profiles[item->idx] = item->profile;
+	g_free (item);
+
+	/* last one */
+	if (--helper->pending == 0)
+		mcm_profile_parse_many_complete_cb (helper);
+	return FALSE;
+}
+
+/**
+ * mcm_profile_parse_many_item:
+ **/
+static void
+mcm_profile_parse_many_item (McmProfileParseItem *item)
+{
+	GFile *file;
+	McmProfileParseHelper *helper = item->helper;
+
+	/* don't start anything new */
+	if (g_cancellable_set_error_if_cancelled (helper->cancellable, &item->error))
+		return;
+
+	file = g_ptr_array_index (helper->files, item->idx);
+	item->profile = mcm_profile_default_new ();
+	mcm_profile_set_lightweight (item->profile, helper->lightweight);
+	if (!mcm_profile_parse (item->profile, file, &item->error)) {
+		g_object_unref (item->profile);
+		item->profile = NULL;
+	}
+}
+
+/**
+ * mcm_profile_parse_many_thread_cb:
+ **/
+static void
+mcm_profile_parse_many_thread_cb (McmProfileParseItem *item, McmProfileParseHelper *helper)
+{
+	GSource *source;
+
+	mcm_profile_parse_many_item (item);
+
+	/* hand the result back to the callers main context */
+	source = g_idle_source_new ();
+	g_source_set_callback (source, (GSourceFunc) mcm_profile_parse_many_done_cb, item, NULL);
+	g_source_attach (source, helper->context);
+	g_source_unref (source);
+}
+
+/**
+ * mcm_profile_parse_many_serial_cb:
+ **/
+static gboolean
+mcm_profile_parse_many_serial_cb (McmProfileParseItem *item)
+{
+	mcm_profile_parse_many_item (item);
+	return mcm_profile_parse_many_done_cb (item);
+}
+
+/**
+ * mcm_profile_parse_many_async:
+ * @files: an array of #GFile's
+ * @lightweight: if the profiles should be parsed in lightweight mode
+ * @cancellable: a #GCancellable, or %NULL
+ * @func: a function called for each file as it is parsed, or %NULL
+ * @func_data: data to pass to @func
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Parses the files on a pool of worker threads. @func is called in the
+ * thread-default main context of the caller as each file completes, with
+ * either the new profile or the error for that file.
+ **/
+void
+mcm_profile_parse_many_async (GPtrArray *files, gboolean lightweight, GCancellable *cancellable,
+			      McmProfileParseFunc func, gpointer func_data,
+			      GAsyncReadyCallback callback, gpointer user_data)
+{
+	guint i;
+	glong max_threads;
+	GSource *source;
+	GError *error = NULL;
+	McmProfileParseItem *item;
+	McmProfileParseHelper *helper;
+
+	g_return_if_fail (files != NULL);
+
+	helper = g_new0 (McmProfileParseHelper, 1);
+	helper->files = g_ptr_array_ref (files);
+	helper->profiles = g_new0 (McmProfile *, files->len);
+	helper->lightweight = lightweight;
+	if (cancellable != NULL)
+		helper->cancellable = g_object_ref (cancellable);
+	helper->func = func;
+	helper->func_data = func_data;
+	helper->res = g_simple_async_result_new (NULL, callback, user_data, mcm_profile_parse_many_async);
+	helper->pending = files->len;
+	helper->context = g_main_context_get_thread_default ();
+	if (helper->context == NULL)
+		helper->context = g_main_context_default ();
+	g_main_context_ref (helper->context);
+
+	/* nothing to do */
+	if (files->len == 0) {
+		source = g_idle_source_new ();
+		g_source_set_callback (source, (GSourceFunc) mcm_profile_parse_many_complete_cb, helper, NULL);
+		g_source_attach (source, helper->context);
+		g_source_unref (source);
+		return;
+	}
+
+	/* one worker per CPU */
+	if (g_thread_supported ()) {
+		max_threads = CLAMP (sysconf (_SC_NPROCESSORS_ONLN), 1, MCM_PROFILE_PARSE_MAX_THREADS);
+		helper->pool = g_thread_pool_new ((GFunc) mcm_profile_parse_many_thread_cb, helper,
+						  (gint) max_threads, FALSE, &error);
+		if (helper->pool == NULL) {
+			egg_warning ("failed to create thread pool, parsing serially: %s", error->message);
+			g_error_free (error);
+		}
+	}
+
+	/* queue each file */
+	for (i=0; i<files->len; i++) {
+		item = g_new0 (McmProfileParseItem, 1);
+		item->helper = helper;
+		item->idx = i;
+		if (helper->pool != NULL) {
+			g_thread_pool_push (helper->pool, item, NULL);
+			continue;
+		}
+
+		/* no threads, so just do each one in an idle */
+		source = g_idle_source_new ();
+		g_source_set_callback (source, (GSourceFunc) mcm_profile_parse_many_serial_cb, item, NULL);
+		g_source_attach (source, helper->context);
+		g_source_unref (source);
+	}
+}
+
+/**
+ * mcm_profile_parse_many_finish:
+ *
+ * Return value: the profiles that were parsed successfully, in the same
+ * order as the files. Free with g_ptr_array_unref()
+ **/
+GPtrArray *
+mcm_profile_parse_many_finish (GAsyncResult *res, GError **error)
+{
+	GSimpleAsyncResult *simple;
+
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), NULL);
+	simple = G_SIMPLE_ASYNC_RESULT (res);
+	g_return_val_if_fail (g_simple_async_result_get_source_tag (simple) == mcm_profile_parse_many_async, NULL);
+
+	if (g_simple_async_result_propagate_error (simple, error))
+		return NULL;
+	return g_ptr_array_ref (g_simple_async_result_get_op_res_gpointer (simple));
+}
+
+/* used to wait for mcm_profile_parse_many_async() */
+typedef struct {
+	GMainLoop		*loop;
+	GAsyncResult		*res;
+} McmProfileParseSyncHelper;
+
+/**
+ * mcm_profile_parse_many_sync_cb:
+ **/
+static void
+mcm_profile_parse_many_sync_cb (GObject *source_object, GAsyncResult *res, McmProfileParseSyncHelper *helper)
+{
+	helper->res = g_object_ref (res);
+	g_main_loop_quit (helper->loop);
+}
+
+/**
+ * mcm_profile_parse_many:
+ * @files: an array of #GFile's
+ * @lightweight: if the profiles should be parsed in lightweight mode
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Parses the files in parallel and waits for them all to complete. Files
+ * that fail to parse are skipped with a warning.
+ *
+ * Return value: the profiles in the same order as the files. Free with
+ * g_ptr_array_unref()
+ **/
+GPtrArray *
+mcm_profile_parse_many (GPtrArray *files, gboolean lightweight, GCancellable *cancellable, GError **error)
+{
+	GPtrArray *array;
+	GMainContext *context;
+	McmProfileParseSyncHelper helper;
+
+	g_return_val_if_fail (files != NULL, NULL);
+
+	/* use a private context so we don't dispatch anything else */
+	context = g_main_context_new ();
+	g_main_context_push_thread_default (context);
+	helper.loop = g_main_loop_new (context, FALSE);
+	helper.res = NULL;
+
+	mcm_profile_parse_many_async (files, lightweight, cancellable, NULL, NULL,
+				      (GAsyncReadyCallback) mcm_profile_parse_many_sync_cb, &helper);
+	g_main_loop_run (helper.loop);
+	g_main_context_pop_thread_default (context);
+
+	array = mcm_profile_parse_many_finish (helper.res, error);
+	g_object_unref (helper.res);
+	g_main_loop_unref (helper.loop);
+	g_main_context_unref (context);
+	return array;
+}
+
 /**
  * mcm_profile_save:
  **/
@@ -615,7 +1261,10 @@ mcm_profile_get_property (GObject *object, guint prop_id, GValue *value, GParamS
 		g_value_set_string (value, priv->datetime);
 		break;
 	case PROP_CHECKSUM:
-		g_value_set_string (value, priv->checksum);
+		g_value_set_string (value, mcm_profile_get_checksum (profile));
+		break;
+	case PROP_ID:
+		g_value_set_string (value, priv->id);
 		break;
 	case PROP_DESCRIPTION:
 		g_value_set_string (value, priv->description);
@@ -638,19 +1287,27 @@ mcm_profile_get_property (GObject *object, guint prop_id, GValue *value, GParamS
 	case PROP_CAN_DELETE:
 		g_value_set_boolean (value, priv->can_delete);
 		break;
+	case PROP_LIGHTWEIGHT:
+		g_value_set_boolean (value, priv->lightweight);
+		break;
 	case PROP_WHITE:
+		mcm_profile_ensure_colorimetry (profile);
 		g_value_set_object (value, priv->white);
 		break;
 	case PROP_BLACK:
+		mcm_profile_ensure_colorimetry (profile);
 		g_value_set_object (value, priv->black);
 		break;
 	case PROP_RED:
+		mcm_profile_ensure_colorimetry (profile);
 		g_value_set_object (value, priv->red);
 		break;
 	case PROP_GREEN:
+		mcm_profile_ensure_colorimetry (profile);
 		g_value_set_object (value, priv->green);
 		break;
 	case PROP_BLUE:
+		mcm_profile_ensure_colorimetry (profile);
 		g_value_set_object (value, priv->blue);
 		break;
 	default:
@@ -699,19 +1356,32 @@ mcm_profile_set_property (GObject *object, guint prop_id, const GValue *value, G
 	case PROP_HAS_VCGT:
 		mcm_profile_set_has_vcgt (profile, g_value_get_boolean (value));
 		break;
+	case PROP_LIGHTWEIGHT:
+		mcm_profile_set_lightweight (profile, g_value_get_boolean (value));
+		break;
 	case PROP_WHITE:
+		if (priv->white != NULL)
+			g_object_unref (priv->white);
 		priv->white = g_value_dup_object (value);
 		break;
 	case PROP_BLACK:
+		if (priv->black != NULL)
+			g_object_unref (priv->black);
 		priv->black = g_value_dup_object (value);
 		break;
 	case PROP_RED:
+		if (priv->red != NULL)
+			g_object_unref (priv->red);
 		priv->red = g_value_dup_object (value);
 		break;
 	case PROP_GREEN:
+		if (priv->green != NULL)
+			g_object_unref (priv->green);
 		priv->green = g_value_dup_object (value);
 		break;
 	case PROP_BLUE:
+		if (priv->blue != NULL)
+			g_object_unref (priv->blue);
 		priv->blue = g_value_dup_object (value);
 		break;
 	default:
@@ -772,6 +1442,14 @@ mcm_profile_class_init (McmProfileClass *klass)
 				     G_PARAM_READABLE);
 	g_object_class_install_property (object_class, PROP_CHECKSUM, pspec);
 
+	/**
+	 * McmProfile:id:
+	 */
+	pspec = g_param_spec_string ("id", NULL, NULL,
+				     NULL,
+				     G_PARAM_READABLE);
+	g_object_class_install_property (object_class, PROP_ID, pspec);
+
 	/**
 	 * McmProfile:description:
 	 */
@@ -828,6 +1506,14 @@ mcm_profile_class_init (McmProfileClass *klass)
 				      G_PARAM_READABLE);
 	g_object_class_install_property (object_class, PROP_CAN_DELETE, pspec);
 
+	/**
+	 * McmProfile:lightweight:
+	 */
+	pspec = g_param_spec_boolean ("lightweight", NULL, NULL,
+				      FALSE,
+				      G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_LIGHTWEIGHT, pspec);
+
 	/**
 	 * McmProfile:white:
 	 */
@@ -879,6 +1565,7 @@ mcm_profile_init (McmProfile *profile)
 {
 	profile->priv = MCM_PROFILE_GET_PRIVATE (profile);
 	profile->priv->can_delete = FALSE;
+	profile->priv->lightweight = FALSE;
 	profile->priv->monitor = NULL;
 	profile->priv->kind = MCM_PROFILE_KIND_UNKNOWN;
 	profile->priv->colorspace = MCM_COLORSPACE_UNKNOWN;
@@ -905,6 +1592,7 @@ mcm_profile_finalize (GObject *object)
 	g_free (priv->model);
 	g_free (priv->datetime);
 	g_free (priv->checksum);
+	g_free (priv->id);
 	g_object_unref (priv->white);
 	g_object_unref (priv->black);
 	g_object_unref (priv->red);
@@ -932,13 +1620,18 @@ mcm_profile_new (void)
 /**
  * mcm_profile_default_new:
  *
- * Return value: a new McmProfile object.
+ * Return value: a new McmProfile object using the lcms backend chosen at
+ * configure time.
  **/
 McmProfile *
 mcm_profile_default_new (void)
 {
 	McmProfile *profile = NULL;
+#ifdef MCM_USE_LCMS2
+	profile = MCM_PROFILE (mcm_profile_lcms2_new ());
+#else
 	profile = MCM_PROFILE (mcm_profile_lcms1_new ());
+#endif
 	return profile;
 }
 
@@ -61,21 +61,42 @@ struct _McmProfileClass
 						 guint		 size);
 	McmClut		*(*generate_curve)	(McmProfile	*profile,
 						 guint		 size);
+	gboolean	 (*load_colorimetry)	(McmProfile	*profile);
 
 	/* padding for future expansion */
-	void (*_mcm_reserved1) (void);
 	void (*_mcm_reserved2) (void);
 	void (*_mcm_reserved3) (void);
 	void (*_mcm_reserved4) (void);
 	void (*_mcm_reserved5) (void);
 };
 
+/* the metadata sent between processes, see mcm_profile_get_variant() */
+#define MCM_PROFILE_VARIANT_TYPE		"(sssssssssubb)"
+
+typedef void	 (*McmProfileParseFunc)		(GFile		*file,
+							 McmProfile	*profile,
+							 const GError	*error,
+							 gpointer	 user_data);
+
 GType		 mcm_profile_get_type		  	(void);
 McmProfile	*mcm_profile_new			(void);
 McmProfile	*mcm_profile_default_new		(void);
 gboolean	 mcm_profile_parse			(McmProfile	*profile,
 							 GFile		*file,
 							 GError		**error);
+GPtrArray	*mcm_profile_parse_many			(GPtrArray	*files,
+							 gboolean	 lightweight,
+							 GCancellable	*cancellable,
+							 GError		**error);
+void		 mcm_profile_parse_many_async		(GPtrArray	*files,
+							 gboolean	 lightweight,
+							 GCancellable	*cancellable,
+							 McmProfileParseFunc func,
+							 gpointer	 func_data,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+GPtrArray	*mcm_profile_parse_many_finish		(GAsyncResult	*res,
+							 GError		**error);
 gboolean	 mcm_profile_parse_data			(McmProfile	*profile,
 							 const guint8	*data,
 							 gsize		 length,
@@ -84,7 +105,12 @@ gboolean	 mcm_profile_save			(McmProfile	*profile,
 							 const gchar	*filename,
 							 GError		**error);
 const gchar	*mcm_profile_get_checksum		(McmProfile	*profile);
+const gchar	*mcm_profile_get_id			(McmProfile	*profile);
+void		 mcm_profile_set_id			(McmProfile	*profile,
+							 const gchar	*id);
 gboolean	 mcm_profile_get_can_delete		(McmProfile	*profile);
+void		 mcm_profile_set_can_delete		(McmProfile	*profile,
+							 gboolean	 can_delete);
 McmClut		*mcm_profile_generate_vcgt		(McmProfile	*profile,
 							 guint		 size);
 McmClut		*mcm_profile_generate_curve		(McmProfile	*profile,
@@ -119,7 +145,13 @@ void		 mcm_profile_set_colorspace		(McmProfile	*profile,
 gboolean	 mcm_profile_get_has_vcgt		(McmProfile	*profile);
 void		 mcm_profile_set_has_vcgt		(McmProfile	*profile,
 							 gboolean	 has_vcgt);
+gboolean	 mcm_profile_get_lightweight		(McmProfile	*profile);
+void		 mcm_profile_set_lightweight		(McmProfile	*profile,
+							 gboolean	 lightweight);
 gboolean	 mcm_profile_has_colorspace_description	(McmProfile	*profile);
+GVariant	*mcm_profile_get_variant		(McmProfile	*profile);
+gboolean	 mcm_profile_set_from_variant		(McmProfile	*profile,
+							 GVariant	*value);
 
 G_END_DECLS
 
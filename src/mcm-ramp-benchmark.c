@@ -0,0 +1,120 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "egg-debug.h"
+
+#include "mcm-ramp.h"
+
+#define MCM_RAMP_BENCHMARK_ENTRIES	(16 * 1024 * 1024)
+
+/**
+ * mcm_ramp_benchmark_reference:
+ *
+ * What McmClut did for each entry before the vectorized kernels.
+ **/
+static void
+mcm_ramp_benchmark_reference (const guint16 *in, guint16 *out, guint size, gdouble gamma, gdouble min, gdouble max)
+{
+	guint i;
+	guint value;
+
+	for (i=0; i<size; i++) {
+		value = 65536.0f * ((powf (((gdouble)in[i]/65536.0f), gamma) * (max - min)) + min);
+		out[i] = MIN (value, 0xffff);
+	}
+}
+
+/**
+ * mcm_ramp_benchmark_size:
+ **/
+static void
+mcm_ramp_benchmark_size (guint size)
+{
+	guint i;
+	guint loops;
+	guint error;
+	guint max_error = 0;
+	gdouble elapsed_ref;
+	gdouble elapsed_ramp;
+	guint16 *in;
+	guint16 *out_ref;
+	guint16 *out_ramp;
+	GTimer *timer;
+
+	in = g_new (guint16, size);
+	out_ref = g_new (guint16, size);
+	out_ramp = g_new (guint16, size);
+	for (i=0; i<size; i++)
+		in[i] = (i * 0xffff) / (size - 1);
+
+	/* do the same amount of work for each size */
+	loops = MAX (MCM_RAMP_BENCHMARK_ENTRIES / size, 1);
+	timer = g_timer_new ();
+	for (i=0; i<loops; i++)
+		mcm_ramp_benchmark_reference (in, out_ref, size, 2.2, 0.05, 0.95);
+	elapsed_ref = g_timer_elapsed (timer, NULL);
+
+	g_timer_reset (timer);
+	for (i=0; i<loops; i++)
+		mcm_ramp_adjust (in, out_ramp, size, 2.2f, 0.05f, 0.95f);
+	elapsed_ramp = g_timer_elapsed (timer, NULL);
+
+	for (i=0; i<size; i++) {
+		error = ABS ((gint) out_ref[i] - (gint) out_ramp[i]);
+		max_error = MAX (max_error, error);
+	}
+
+	g_print ("%6i entries: scalar %7.2fns, %s %7.2fns, %5.1fx, max error %i LSB\n",
+		 size,
+		 elapsed_ref * 1e9 / ((gdouble) loops * size),
+		 mcm_ramp_get_kernel_name (),
+		 elapsed_ramp * 1e9 / ((gdouble) loops * size),
+		 elapsed_ref / elapsed_ramp,
+		 max_error);
+
+	g_timer_destroy (timer);
+	g_free (in);
+	g_free (out_ref);
+	g_free (out_ramp);
+}
+
+/**
+ * main:
+ **/
+int
+main (int argc, char **argv)
+{
+	guint i;
+	const guint sizes[] = { 256, 1024, 4096, 65536 };
+
+	egg_debug_init (&argc, &argv);
+
+	/* run with MCM_RAMP_KERNEL=sse2 to compare a narrower kernel */
+	for (i=0; i<G_N_ELEMENTS (sizes); i++)
+		mcm_ramp_benchmark_size (sizes[i]);
+	return 0;
+}
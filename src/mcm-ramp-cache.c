@@ -0,0 +1,434 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * SECTION:mcm-ramp-cache
+ * @short_description: An on-disk cache of the final gamma ramps
+ *
+ * Setting the gamma at login normally means loading the config file,
+ * parsing the EDID of every output and building the ramps from the
+ * profiles with lcms. The final ramp sent to each CRTC is saved here, so
+ * the next login can send it straight to the X server.
+ *
+ * The file is mapped read only. Entries are looked up by a key that the
+ * caller builds from whatever the ramp depends on, and an entry that was
+ * built from a profile is only used if the profile on disk has not
+ * changed since.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "egg-debug.h"
+
+#include "mcm-ramp-cache.h"
+
+#define MCM_RAMP_CACHE_MAGIC		"MCMRAMP"
+#define MCM_RAMP_CACHE_VERSION		1
+#define MCM_RAMP_CACHE_KEY_SIZE		40
+#define MCM_RAMP_CACHE_MAX_SIZE		65536
+
+/* the file is only ever read on the machine that wrote it, so these
+ * are stored in host byte order */
+typedef struct {
+	gchar			 magic[8];
+	guint32			 version;
+	guint32			 n_entries;
+} McmRampCacheHeader;
+
+typedef struct {
+	gchar			 key[MCM_RAMP_CACHE_KEY_SIZE];
+	guint64			 profile_mtime;
+	guint64			 profile_size;
+	guint32			 size;
+	guint32			 filename_offset;	/* 0 if there is no profile */
+	guint32			 ramp_offset;		/* planar, red then green then blue */
+	guint32			 reserved;
+} McmRampCacheEntry;
+
+typedef struct {
+	McmRampCacheEntry	 entry;
+	gchar			*filename;
+	guint16			*ramp;
+} McmRampCacheItem;
+
+struct _McmRampCache {
+	GMappedFile		*mapped;
+	const gchar		*data;
+	gsize			 length;
+	guint			 n_entries;
+	GPtrArray		*added;
+};
+
+/**
+ * mcm_ramp_cache_item_free:
+ **/
+static void
+mcm_ramp_cache_item_free (McmRampCacheItem *item)
+{
+	g_free (item->filename);
+	g_free (item->ramp);
+	g_free (item);
+}
+
+/**
+ * mcm_ramp_cache_stat_profile:
+ **/
+static gboolean
+mcm_ramp_cache_stat_profile (const gchar *filename, guint64 *mtime, guint64 *size)
+{
+	struct stat buf;
+
+	if (g_stat (filename, &buf) != 0)
+		return FALSE;
+	*mtime = buf.st_mtime;
+	*size = buf.st_size;
+	return TRUE;
+}
+
+/**
+ * mcm_ramp_cache_entry_is_valid:
+ *
+ * Return value: %TRUE if everything the entry points to is inside the file
+ **/
+static gboolean
+mcm_ramp_cache_entry_is_valid (const McmRampCacheEntry *entry, const gchar *data, gsize length)
+{
+	if (entry->key[MCM_RAMP_CACHE_KEY_SIZE - 1] != '\0')
+		return FALSE;
+	if (entry->size == 0 || entry->size > MCM_RAMP_CACHE_MAX_SIZE)
+		return FALSE;
+	if ((entry->ramp_offset % sizeof (guint16)) != 0)
+		return FALSE;
+	if ((guint64) entry->ramp_offset + (guint64) entry->size * 3 * sizeof (guint16) > length)
+		return FALSE;
+	if (entry->filename_offset == 0)
+		return TRUE;
+	if (entry->filename_offset >= length)
+		return FALSE;
+	return (memchr (data + entry->filename_offset, '\0', length - entry->filename_offset) != NULL);
+}
+
+/**
+ * mcm_ramp_cache_get_entry:
+ **/
+static void
+mcm_ramp_cache_get_entry (McmRampCache *cache, guint idx, McmRampCacheEntry *entry)
+{
+	/* the mapping is not guaranteed to be aligned for 64 bit reads */
+	memcpy (entry, cache->data + sizeof (McmRampCacheHeader) + idx * sizeof (McmRampCacheEntry), sizeof (McmRampCacheEntry));
+}
+
+/**
+ * mcm_ramp_cache_load:
+ * @cache: a #McmRampCache
+ * @filename: the cache file
+ * @error: a %GError that is set in the result of an error, or %NULL
+ *
+ * Maps a cache file, replacing anything that was loaded before.
+ *
+ * Return value: %TRUE if the file exists and is a valid cache
+ **/
+gboolean
+mcm_ramp_cache_load (McmRampCache *cache, const gchar *filename, GError **error)
+{
+	gboolean ret = FALSE;
+	guint i;
+	const gchar *data;
+	gsize length;
+	GMappedFile *mapped;
+	McmRampCacheHeader header;
+	McmRampCacheEntry entry;
+
+	g_return_val_if_fail (cache != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	/* map the file */
+	mapped = g_mapped_file_new (filename, FALSE, error);
+	if (mapped == NULL)
+		goto out;
+	data = g_mapped_file_get_contents (mapped);
+	length = g_mapped_file_get_length (mapped);
+
+	/* check the header */
+	if (length < sizeof (McmRampCacheHeader)) {
+		g_set_error (error, 1, 0, "%s is too small to be a ramp cache", filename);
+		goto out;
+	}
+	memcpy (&header, data, sizeof (McmRampCacheHeader));
+	if (memcmp (header.magic, MCM_RAMP_CACHE_MAGIC, sizeof (header.magic)) != 0 ||
+	    header.version != MCM_RAMP_CACHE_VERSION) {
+		g_set_error (error, 1, 0, "%s is not a version %i ramp cache", filename, MCM_RAMP_CACHE_VERSION);
+		goto out;
+	}
+	if (header.n_entries > (length - sizeof (McmRampCacheHeader)) / sizeof (McmRampCacheEntry)) {
+		g_set_error (error, 1, 0, "%s is truncated", filename);
+		goto out;
+	}
+
+	/* check every entry before any of them are used */
+	for (i=0; i<header.n_entries; i++) {
+		memcpy (&entry, data + sizeof (McmRampCacheHeader) + i * sizeof (McmRampCacheEntry), sizeof (McmRampCacheEntry));
+		if (!mcm_ramp_cache_entry_is_valid (&entry, data, length)) {
+			g_set_error (error, 1, 0, "%s entry %i is corrupt", filename, i);
+			goto out;
+		}
+	}
+
+	/* replace anything already loaded */
+	if (cache->mapped != NULL)
+		g_mapped_file_unref (cache->mapped);
+	cache->mapped = mapped;
+	cache->data = data;
+	cache->length = length;
+	cache->n_entries = header.n_entries;
+	mapped = NULL;
+	egg_debug ("loaded %i ramps from %s", cache->n_entries, filename);
+	ret = TRUE;
+out:
+	if (mapped != NULL)
+		g_mapped_file_unref (mapped);
+	return ret;
+}
+
+/**
+ * mcm_ramp_cache_lookup:
+ * @cache: a #McmRampCache
+ * @key: the key the ramp was added with
+ * @size: the gamma size of the CRTC
+ * @profile_filename: the profile the ramp was built from, or %NULL if it
+ *	was not built from a profile
+ *
+ * Finds a ramp in the loaded file. An entry is only returned if it has the
+ * right size and its profile has not been changed or removed.
+ *
+ * Return value: the planar ramp, which is only valid while @cache is, or %NULL
+ **/
+const guint16 *
+mcm_ramp_cache_lookup (McmRampCache *cache, const gchar *key, guint size, const gchar **profile_filename)
+{
+	guint i;
+	guint64 mtime;
+	guint64 profile_size;
+	const gchar *filename = NULL;
+	McmRampCacheEntry entry;
+
+	g_return_val_if_fail (cache != NULL, NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+
+	for (i=0; i<cache->n_entries; i++) {
+		mcm_ramp_cache_get_entry (cache, i, &entry);
+		if (g_strcmp0 (entry.key, key) != 0)
+			continue;
+
+		/* the CRTC changed */
+		if (entry.size != size) {
+			egg_debug ("cached ramp for %s is %i, not %i", key, entry.size, size);
+			return NULL;
+		}
+
+		/* the profile was changed, replaced or removed */
+		if (entry.filename_offset != 0) {
+			filename = cache->data + entry.filename_offset;
+			if (!mcm_ramp_cache_stat_profile (filename, &mtime, &profile_size) ||
+			    mtime != entry.profile_mtime ||
+			    profile_size != entry.profile_size) {
+				egg_debug ("%s has changed since the ramp was cached", filename);
+				return NULL;
+			}
+		}
+
+		if (profile_filename != NULL)
+			*profile_filename = filename;
+		return (const guint16 *) (gconstpointer) (cache->data + entry.ramp_offset);
+	}
+	return NULL;
+}
+
+/**
+ * mcm_ramp_cache_add:
+ * @cache: a #McmRampCache
+ * @key: the key to use for lookups
+ * @size: the number of entries in each channel
+ * @profile_filename: the profile the ramp was built from, or %NULL
+ * @red: the red channel
+ * @green: the green channel
+ * @blue: the blue channel
+ *
+ * Adds a ramp that will be written by mcm_ramp_cache_save(). An existing
+ * ramp with the same key is replaced.
+ **/
+void
+mcm_ramp_cache_add (McmRampCache *cache, const gchar *key, guint size, const gchar *profile_filename,
+		    const guint16 *red, const guint16 *green, const guint16 *blue)
+{
+	guint i;
+	McmRampCacheItem *item;
+
+	g_return_if_fail (cache != NULL);
+	g_return_if_fail (key != NULL);
+	g_return_if_fail (strlen (key) < MCM_RAMP_CACHE_KEY_SIZE);
+	g_return_if_fail (size > 0 && size <= MCM_RAMP_CACHE_MAX_SIZE);
+
+	item = g_new0 (McmRampCacheItem, 1);
+
+	/* we need to know if the profile changes */
+	if (profile_filename != NULL) {
+		if (!mcm_ramp_cache_stat_profile (profile_filename, &item->entry.profile_mtime, &item->entry.profile_size)) {
+			egg_debug ("not caching ramp as %s does not exist", profile_filename);
+			g_free (item);
+			return;
+		}
+		item->filename = g_strdup (profile_filename);
+	}
+
+	g_strlcpy (item->entry.key, key, MCM_RAMP_CACHE_KEY_SIZE);
+	item->entry.size = size;
+	item->ramp = g_new (guint16, size * 3);
+	memcpy (item->ramp, red, size * sizeof (guint16));
+	memcpy (item->ramp + size, green, size * sizeof (guint16));
+	memcpy (item->ramp + size * 2, blue, size * sizeof (guint16));
+
+	/* replace the old one */
+	for (i=0; i<cache->added->len; i++) {
+		if (g_strcmp0 (((McmRampCacheItem *) g_ptr_array_index (cache->added, i))->entry.key, key) == 0) {
+			g_ptr_array_remove_index (cache->added, i);
+			break;
+		}
+	}
+	g_ptr_array_add (cache->added, item);
+}
+
+/**
+ * mcm_ramp_cache_save:
+ * @cache: a #McmRampCache
+ * @filename: the cache file
+ * @error: a %GError that is set in the result of an error, or %NULL
+ *
+ * Writes the ramps added with mcm_ramp_cache_add() to disk. Only those
+ * ramps are saved, so outputs that are no longer connected drop out of
+ * the cache. The file is replaced atomically.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+mcm_ramp_cache_save (McmRampCache *cache, const gchar *filename, GError **error)
+{
+	gboolean ret;
+	guint i;
+	gsize offset;
+	gchar *dirname;
+	GByteArray *buffer;
+	McmRampCacheItem *item;
+	McmRampCacheHeader header;
+
+	g_return_val_if_fail (cache != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	/* work out where everything goes, ramps first as they need aligning */
+	offset = sizeof (McmRampCacheHeader) + cache->added->len * sizeof (McmRampCacheEntry);
+	for (i=0; i<cache->added->len; i++) {
+		item = g_ptr_array_index (cache->added, i);
+		item->entry.ramp_offset = offset;
+		offset += item->entry.size * 3 * sizeof (guint16);
+	}
+	for (i=0; i<cache->added->len; i++) {
+		item = g_ptr_array_index (cache->added, i);
+		if (item->filename == NULL)
+			continue;
+		item->entry.filename_offset = offset;
+		offset += strlen (item->filename) + 1;
+	}
+
+	/* build the file */
+	buffer = g_byte_array_sized_new (offset);
+	memset (&header, 0, sizeof (McmRampCacheHeader));
+	memcpy (header.magic, MCM_RAMP_CACHE_MAGIC, sizeof (MCM_RAMP_CACHE_MAGIC));
+	header.version = MCM_RAMP_CACHE_VERSION;
+	header.n_entries = cache->added->len;
+	g_byte_array_append (buffer, (const guint8 *) &header, sizeof (McmRampCacheHeader));
+	for (i=0; i<cache->added->len; i++) {
+		item = g_ptr_array_index (cache->added, i);
+		g_byte_array_append (buffer, (const guint8 *) &item->entry, sizeof (McmRampCacheEntry));
+	}
+	for (i=0; i<cache->added->len; i++) {
+		item = g_ptr_array_index (cache->added, i);
+		g_byte_array_append (buffer, (const guint8 *) item->ramp, item->entry.size * 3 * sizeof (guint16));
+	}
+	for (i=0; i<cache->added->len; i++) {
+		item = g_ptr_array_index (cache->added, i);
+		if (item->filename != NULL)
+			g_byte_array_append (buffer, (const guint8 *) item->filename, strlen (item->filename) + 1);
+	}
+
+	/* write it */
+	dirname = g_path_get_dirname (filename);
+	g_mkdir_with_parents (dirname, 0700);
+	ret = g_file_set_contents (filename, (const gchar *) buffer->data, buffer->len, error);
+	if (ret)
+		egg_debug ("saved %i ramps to %s", cache->added->len, filename);
+	g_free (dirname);
+	g_byte_array_free (buffer, TRUE);
+	return ret;
+}
+
+/**
+ * mcm_ramp_cache_get_default_filename:
+ *
+ * Return value: the per-user cache file, free with g_free()
+ **/
+gchar *
+mcm_ramp_cache_get_default_filename (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "mate-color-manager", "gamma-ramps.cache", NULL);
+}
+
+/**
+ * mcm_ramp_cache_new:
+ *
+ * Return value: a new empty cache, free with mcm_ramp_cache_free()
+ **/
+McmRampCache *
+mcm_ramp_cache_new (void)
+{
+	McmRampCache *cache;
+	cache = g_new0 (McmRampCache, 1);
+	cache->added = g_ptr_array_new_with_free_func ((GDestroyNotify) mcm_ramp_cache_item_free);
+	return cache;
+}
+
+/**
+ * mcm_ramp_cache_free:
+ **/
+void
+mcm_ramp_cache_free (McmRampCache *cache)
+{
+	if (cache == NULL)
+		return;
+	if (cache->mapped != NULL)
+		g_mapped_file_unref (cache->mapped);
+	g_ptr_array_unref (cache->added);
+	g_free (cache);
+}
@@ -0,0 +1,54 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __MCM_RAMP_CACHE_H
+#define __MCM_RAMP_CACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _McmRampCache	McmRampCache;
+
+McmRampCache	*mcm_ramp_cache_new			(void);
+void		 mcm_ramp_cache_free			(McmRampCache		*cache);
+gboolean	 mcm_ramp_cache_load			(McmRampCache		*cache,
+							 const gchar		*filename,
+							 GError			**error);
+gboolean	 mcm_ramp_cache_save			(McmRampCache		*cache,
+							 const gchar		*filename,
+							 GError			**error);
+const guint16	*mcm_ramp_cache_lookup			(McmRampCache		*cache,
+							 const gchar		*key,
+							 guint			 size,
+							 const gchar		**profile_filename);
+void		 mcm_ramp_cache_add			(McmRampCache		*cache,
+							 const gchar		*key,
+							 guint			 size,
+							 const gchar		*profile_filename,
+							 const guint16		*red,
+							 const guint16		*green,
+							 const guint16		*blue);
+gchar		*mcm_ramp_cache_get_default_filename	(void);
+
+G_END_DECLS
+
+#endif /* __MCM_RAMP_CACHE_H */
@@ -0,0 +1,491 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * SECTION:mcm-ramp
+ * @short_description: Vectorized gamma ramp generation
+ *
+ * These functions apply a gamma, offset and scale to a 16 bit ramp. The
+ * power function is approximated with a polynomial evaluated four or
+ * eight entries at a time, which is accurate to one LSB of the output.
+ * The widest kernel the CPU supports is chosen the first time a ramp is
+ * generated, and can be overridden with MCM_RAMP_KERNEL for testing.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(__x86_64__)
+#define MCM_RAMP_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(MCM_RAMP_HAVE_SSE2) && defined(HAVE_AVX2_TARGET)
+#define MCM_RAMP_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+#include "egg-debug.h"
+
+#include "mcm-ramp.h"
+
+/* 2/ln(2) divided by 1, 3, 5 and 7, for the atanh series of log2 */
+#define MCM_RAMP_LOG2_C1		2.885390082f
+#define MCM_RAMP_LOG2_C3		0.961796694f
+#define MCM_RAMP_LOG2_C5		0.577078016f
+#define MCM_RAMP_LOG2_C7		0.412198583f
+#define MCM_RAMP_LN2			0.693147181f
+#define MCM_RAMP_SQRT2			1.414213562f
+#define MCM_RAMP_TINY			1e-30f
+#define MCM_RAMP_EXP_MIN		-126.0f
+
+typedef struct {
+	gfloat		 scale;
+	gfloat		 gamma;
+	gfloat		 min;
+	gfloat		 range;
+} McmRampParams;
+
+typedef void (*McmRampKernelFunc)	(const guint16		*in,
+					 guint16		*out,
+					 guint			 size,
+					 const McmRampParams	*params);
+
+typedef struct {
+	const gchar		*name;
+	McmRampKernelFunc	 func;
+} McmRampKernel;
+
+/**
+ * mcm_ramp_pow_approx:
+ *
+ * The scalar version of the vector power function, used for the entries
+ * left over at the end of a ramp. Only valid for 0 <= x <= 1 and gamma > 0.
+ **/
+static inline gfloat
+mcm_ramp_pow_approx (gfloat x, gfloat gamma)
+{
+	union { gfloat f; guint32 i; } v;
+	gint e;
+	gint n;
+	gfloat m;
+	gfloat t;
+	gfloat t2;
+	gfloat y;
+	gfloat f;
+	gfloat p;
+
+	if (x <= MCM_RAMP_TINY)
+		return 0.0f;
+
+	/* split into exponent and a mantissa in [sqrt(1/2), sqrt(2)) */
+	v.f = x;
+	e = (gint) ((v.i >> 23) & 0xff) - 127;
+	v.i = (v.i & 0x007fffff) | 0x3f800000;
+	m = v.f;
+	if (m > MCM_RAMP_SQRT2) {
+		m *= 0.5f;
+		e++;
+	}
+
+	/* log2 of the mantissa */
+	t = (m - 1.0f) / (m + 1.0f);
+	t2 = t * t;
+	y = gamma * ((gfloat) e + t * (MCM_RAMP_LOG2_C1 + t2 * (MCM_RAMP_LOG2_C3 + t2 * (MCM_RAMP_LOG2_C5 + t2 * MCM_RAMP_LOG2_C7))));
+	if (y < MCM_RAMP_EXP_MIN)
+		y = MCM_RAMP_EXP_MIN;
+
+	/* 2^y as 2^n * e^(f*ln2) with |f| <= 0.5 */
+	n = (gint) floorf (y + 0.5f);
+	f = (y - (gfloat) n) * MCM_RAMP_LN2;
+	p = 1.0f + f * (1.0f + f * (1.0f/2.0f + f * (1.0f/6.0f + f * (1.0f/24.0f + f * (1.0f/120.0f + f * (1.0f/720.0f))))));
+	v.i = (guint32) (n + 127) << 23;
+	return p * v.f;
+}
+
+/**
+ * mcm_ramp_pack:
+ **/
+static inline guint16
+mcm_ramp_pack (gfloat value, const McmRampParams *params)
+{
+	value = 65536.0f * (value * params->range + params->min);
+	return CLAMP (value, 0.0f, 65535.0f);
+}
+
+/**
+ * mcm_ramp_kernel_tail:
+ **/
+static void
+mcm_ramp_kernel_tail (const guint16 *in, guint16 *out, guint start, guint size, const McmRampParams *params)
+{
+	guint i;
+	gfloat x;
+
+	for (i=start; i<size; i++) {
+		x = (gfloat) (in != NULL ? in[i] : i) * params->scale;
+		out[i] = mcm_ramp_pack (mcm_ramp_pow_approx (x, params->gamma), params);
+	}
+}
+
+/**
+ * mcm_ramp_kernel_scalar:
+ *
+ * The reference implementation, using the C library.
+ **/
+static void
+mcm_ramp_kernel_scalar (const guint16 *in, guint16 *out, guint size, const McmRampParams *params)
+{
+	guint i;
+	gfloat x;
+
+	for (i=0; i<size; i++) {
+		x = (gfloat) (in != NULL ? in[i] : i) * params->scale;
+		out[i] = mcm_ramp_pack (powf (x, params->gamma), params);
+	}
+}
+
+#ifdef MCM_RAMP_HAVE_SSE2
+/**
+ * mcm_ramp_pow_sse2:
+ **/
+static inline __m128
+mcm_ramp_pow_sse2 (__m128 x, __m128 gamma)
+{
+	__m128i bits;
+	__m128i e;
+	__m128i n;
+	__m128 m;
+	__m128 big;
+	__m128 nonzero;
+	__m128 t;
+	__m128 t2;
+	__m128 y;
+	__m128 f;
+	__m128 p;
+	const __m128 one = _mm_set1_ps (1.0f);
+
+	nonzero = _mm_cmpgt_ps (x, _mm_set1_ps (MCM_RAMP_TINY));
+
+	/* split into exponent and a mantissa in [sqrt(1/2), sqrt(2)) */
+	bits = _mm_castps_si128 (x);
+	e = _mm_sub_epi32 (_mm_srli_epi32 (bits, 23), _mm_set1_epi32 (127));
+	m = _mm_castsi128_ps (_mm_or_si128 (_mm_and_si128 (bits, _mm_set1_epi32 (0x007fffff)),
+					    _mm_set1_epi32 (0x3f800000)));
+	big = _mm_cmpgt_ps (m, _mm_set1_ps (MCM_RAMP_SQRT2));
+	m = _mm_or_ps (_mm_and_ps (big, _mm_mul_ps (m, _mm_set1_ps (0.5f))), _mm_andnot_ps (big, m));
+	e = _mm_sub_epi32 (e, _mm_castps_si128 (big));
+
+	/* log2 of the mantissa */
+	t = _mm_div_ps (_mm_sub_ps (m, one), _mm_add_ps (m, one));
+	t2 = _mm_mul_ps (t, t);
+	p = _mm_add_ps (_mm_set1_ps (MCM_RAMP_LOG2_C5), _mm_mul_ps (t2, _mm_set1_ps (MCM_RAMP_LOG2_C7)));
+	p = _mm_add_ps (_mm_set1_ps (MCM_RAMP_LOG2_C3), _mm_mul_ps (t2, p));
+	p = _mm_add_ps (_mm_set1_ps (MCM_RAMP_LOG2_C1), _mm_mul_ps (t2, p));
+	y = _mm_mul_ps (gamma, _mm_add_ps (_mm_cvtepi32_ps (e), _mm_mul_ps (t, p)));
+	y = _mm_max_ps (y, _mm_set1_ps (MCM_RAMP_EXP_MIN));
+
+	/* 2^y as 2^n * e^(f*ln2) with |f| <= 0.5 */
+	n = _mm_cvtps_epi32 (y);
+	f = _mm_mul_ps (_mm_sub_ps (y, _mm_cvtepi32_ps (n)), _mm_set1_ps (MCM_RAMP_LN2));
+	p = _mm_add_ps (_mm_set1_ps (1.0f/120.0f), _mm_mul_ps (f, _mm_set1_ps (1.0f/720.0f)));
+	p = _mm_add_ps (_mm_set1_ps (1.0f/24.0f), _mm_mul_ps (f, p));
+	p = _mm_add_ps (_mm_set1_ps (1.0f/6.0f), _mm_mul_ps (f, p));
+	p = _mm_add_ps (_mm_set1_ps (1.0f/2.0f), _mm_mul_ps (f, p));
+	p = _mm_add_ps (one, _mm_mul_ps (f, p));
+	p = _mm_add_ps (one, _mm_mul_ps (f, p));
+	p = _mm_mul_ps (p, _mm_castsi128_ps (_mm_slli_epi32 (_mm_add_epi32 (n, _mm_set1_epi32 (127)), 23)));
+	return _mm_and_ps (p, nonzero);
+}
+
+/**
+ * mcm_ramp_pack_sse2:
+ *
+ * There is no unsigned saturating pack in SSE2, so bias into the signed range.
+ **/
+static inline __m128i
+mcm_ramp_pack_sse2 (__m128 value, const McmRampParams *params)
+{
+	__m128i tmp;
+
+	value = _mm_add_ps (_mm_mul_ps (value, _mm_set1_ps (params->range)), _mm_set1_ps (params->min));
+	value = _mm_mul_ps (value, _mm_set1_ps (65536.0f));
+	value = _mm_min_ps (_mm_max_ps (value, _mm_setzero_ps ()), _mm_set1_ps (65535.0f));
+	tmp = _mm_sub_epi32 (_mm_cvttps_epi32 (value), _mm_set1_epi32 (0x8000));
+	tmp = _mm_packs_epi32 (tmp, tmp);
+	return _mm_xor_si128 (tmp, _mm_set1_epi16 ((gint16) 0x8000));
+}
+
+/**
+ * mcm_ramp_kernel_sse2:
+ **/
+static void
+mcm_ramp_kernel_sse2 (const guint16 *in, guint16 *out, guint size, const McmRampParams *params)
+{
+	guint i;
+	__m128i xi;
+	__m128 x;
+	const __m128 gamma = _mm_set1_ps (params->gamma);
+	const __m128 scale = _mm_set1_ps (params->scale);
+	const __m128i lanes = _mm_set_epi32 (3, 2, 1, 0);
+
+	for (i=0; i+4 <= size; i+=4) {
+		if (in != NULL)
+			xi = _mm_unpacklo_epi16 (_mm_loadl_epi64 ((const __m128i *) (in + i)), _mm_setzero_si128 ());
+		else
+			xi = _mm_add_epi32 (_mm_set1_epi32 (i), lanes);
+		x = _mm_mul_ps (_mm_cvtepi32_ps (xi), scale);
+		_mm_storel_epi64 ((__m128i *) (out + i), mcm_ramp_pack_sse2 (mcm_ramp_pow_sse2 (x, gamma), params));
+	}
+	mcm_ramp_kernel_tail (in, out, i, size, params);
+}
+#endif
+
+#ifdef MCM_RAMP_HAVE_AVX2
+/**
+ * mcm_ramp_pow_avx2:
+ **/
+static inline __attribute__((target("avx2"))) __m256
+mcm_ramp_pow_avx2 (__m256 x, __m256 gamma)
+{
+	__m256i bits;
+	__m256i e;
+	__m256i n;
+	__m256 m;
+	__m256 big;
+	__m256 nonzero;
+	__m256 t;
+	__m256 t2;
+	__m256 y;
+	__m256 f;
+	__m256 p;
+	const __m256 one = _mm256_set1_ps (1.0f);
+
+	nonzero = _mm256_cmp_ps (x, _mm256_set1_ps (MCM_RAMP_TINY), _CMP_GT_OQ);
+
+	/* split into exponent and a mantissa in [sqrt(1/2), sqrt(2)) */
+	bits = _mm256_castps_si256 (x);
+	e = _mm256_sub_epi32 (_mm256_srli_epi32 (bits, 23), _mm256_set1_epi32 (127));
+	m = _mm256_castsi256_ps (_mm256_or_si256 (_mm256_and_si256 (bits, _mm256_set1_epi32 (0x007fffff)),
+						  _mm256_set1_epi32 (0x3f800000)));
+	big = _mm256_cmp_ps (m, _mm256_set1_ps (MCM_RAMP_SQRT2), _CMP_GT_OQ);
+	m = _mm256_blendv_ps (m, _mm256_mul_ps (m, _mm256_set1_ps (0.5f)), big);
+	e = _mm256_sub_epi32 (e, _mm256_castps_si256 (big));
+
+	/* log2 of the mantissa */
+	t = _mm256_div_ps (_mm256_sub_ps (m, one), _mm256_add_ps (m, one));
+	t2 = _mm256_mul_ps (t, t);
+	p = _mm256_add_ps (_mm256_set1_ps (MCM_RAMP_LOG2_C5), _mm256_mul_ps (t2, _mm256_set1_ps (MCM_RAMP_LOG2_C7)));
+	p = _mm256_add_ps (_mm256_set1_ps (MCM_RAMP_LOG2_C3), _mm256_mul_ps (t2, p));
+	p = _mm256_add_ps (_mm256_set1_ps (MCM_RAMP_LOG2_C1), _mm256_mul_ps (t2, p));
+	y = _mm256_mul_ps (gamma, _mm256_add_ps (_mm256_cvtepi32_ps (e), _mm256_mul_ps (t, p)));
+	y = _mm256_max_ps (y, _mm256_set1_ps (MCM_RAMP_EXP_MIN));
+
+	/* 2^y as 2^n * e^(f*ln2) with |f| <= 0.5 */
+	n = _mm256_cvtps_epi32 (y);
+	f = _mm256_mul_ps (_mm256_sub_ps (y, _mm256_cvtepi32_ps (n)), _mm256_set1_ps (MCM_RAMP_LN2));
+	p = _mm256_add_ps (_mm256_set1_ps (1.0f/120.0f), _mm256_mul_ps (f, _mm256_set1_ps (1.0f/720.0f)));
+	p = _mm256_add_ps (_mm256_set1_ps (1.0f/24.0f), _mm256_mul_ps (f, p));
+	p = _mm256_add_ps (_mm256_set1_ps (1.0f/6.0f), _mm256_mul_ps (f, p));
+	p = _mm256_add_ps (_mm256_set1_ps (1.0f/2.0f), _mm256_mul_ps (f, p));
+	p = _mm256_add_ps (one, _mm256_mul_ps (f, p));
+	p = _mm256_add_ps (one, _mm256_mul_ps (f, p));
+	p = _mm256_mul_ps (p, _mm256_castsi256_ps (_mm256_slli_epi32 (_mm256_add_epi32 (n, _mm256_set1_epi32 (127)), 23)));
+	return _mm256_and_ps (p, nonzero);
+}
+
+/**
+ * mcm_ramp_kernel_avx2:
+ **/
+static __attribute__((target("avx2"))) void
+mcm_ramp_kernel_avx2 (const guint16 *in, guint16 *out, guint size, const McmRampParams *params)
+{
+	guint i;
+	__m256i xi;
+	__m256i vi;
+	__m256 x;
+	__m256 value;
+	__m128i packed;
+	const __m256 gamma = _mm256_set1_ps (params->gamma);
+	const __m256 scale = _mm256_set1_ps (params->scale);
+	const __m256i lanes = _mm256_set_epi32 (7, 6, 5, 4, 3, 2, 1, 0);
+
+	for (i=0; i+8 <= size; i+=8) {
+		if (in != NULL)
+			xi = _mm256_cvtepu16_epi32 (_mm_loadu_si128 ((const __m128i *) (in + i)));
+		else
+			xi = _mm256_add_epi32 (_mm256_set1_epi32 (i), lanes);
+		x = _mm256_mul_ps (_mm256_cvtepi32_ps (xi), scale);
+		value = mcm_ramp_pow_avx2 (x, gamma);
+
+		/* scale, clamp and narrow to 16 bits */
+		value = _mm256_add_ps (_mm256_mul_ps (value, _mm256_set1_ps (params->range)), _mm256_set1_ps (params->min));
+		value = _mm256_mul_ps (value, _mm256_set1_ps (65536.0f));
+		value = _mm256_min_ps (_mm256_max_ps (value, _mm256_setzero_ps ()), _mm256_set1_ps (65535.0f));
+		vi = _mm256_cvttps_epi32 (value);
+		packed = _mm_packus_epi32 (_mm256_castsi256_si128 (vi), _mm256_extracti128_si256 (vi, 1));
+		_mm_storeu_si128 ((__m128i *) (out + i), packed);
+	}
+	mcm_ramp_kernel_tail (in, out, i, size, params);
+}
+#endif
+
+static const McmRampKernel mcm_ramp_kernels[] = {
+	{ "scalar",	mcm_ramp_kernel_scalar },
+#ifdef MCM_RAMP_HAVE_SSE2
+	{ "sse2",	mcm_ramp_kernel_sse2 },
+#endif
+#ifdef MCM_RAMP_HAVE_AVX2
+	{ "avx2",	mcm_ramp_kernel_avx2 },
+#endif
+};
+
+/**
+ * mcm_ramp_kernel_supported:
+ **/
+static gboolean
+mcm_ramp_kernel_supported (const McmRampKernel *kernel)
+{
+#ifdef MCM_RAMP_HAVE_AVX2
+	if (kernel->func == mcm_ramp_kernel_avx2)
+		return __builtin_cpu_supports ("avx2");
+#endif
+	return TRUE;
+}
+
+/**
+ * mcm_ramp_get_kernel:
+ *
+ * Chooses the widest kernel the CPU can run, only once.
+ **/
+static const McmRampKernel *
+mcm_ramp_get_kernel (void)
+{
+	guint i;
+	const gchar *override;
+	const McmRampKernel *kernel = NULL;
+	static gsize kernel_once = 0;
+
+	if (g_once_init_enter (&kernel_once)) {
+		override = g_getenv ("MCM_RAMP_KERNEL");
+		for (i=0; i<G_N_ELEMENTS (mcm_ramp_kernels); i++) {
+			if (!mcm_ramp_kernel_supported (&mcm_ramp_kernels[i]))
+				continue;
+			if (override != NULL && g_strcmp0 (override, mcm_ramp_kernels[i].name) != 0)
+				continue;
+			kernel = &mcm_ramp_kernels[i];
+		}
+		if (kernel == NULL) {
+			egg_warning ("ramp kernel %s not supported", override);
+			kernel = &mcm_ramp_kernels[0];
+		}
+		egg_debug ("using %s ramp kernel", kernel->name);
+		g_once_init_leave (&kernel_once, (gsize) kernel);
+	}
+	return (const McmRampKernel *) kernel_once;
+}
+
+/**
+ * mcm_ramp_get_kernel_name:
+ *
+ * Return value: the name of the kernel in use, e.g. "avx2"
+ **/
+const gchar *
+mcm_ramp_get_kernel_name (void)
+{
+	return mcm_ramp_get_kernel ()->name;
+}
+
+/**
+ * mcm_ramp_run:
+ **/
+static void
+mcm_ramp_run (const guint16 *in, guint16 *out, guint size, const McmRampParams *params)
+{
+	/* the approximation is only valid for a positive gamma */
+	if (params->gamma <= 0.0f) {
+		mcm_ramp_kernel_scalar (in, out, size, params);
+		return;
+	}
+	mcm_ramp_get_kernel ()->func (in, out, size, params);
+}
+
+/**
+ * mcm_ramp_adjust:
+ * @in: the source ramp
+ * @out: the ramp to write, which can be the same as @in
+ * @size: the number of entries
+ * @gamma: the gamma to apply
+ * @min: the output for a zero input
+ * @max: the output for a full scale input
+ *
+ * Applies 65536 * ((in / 65536)^gamma * (max - min) + min) to each entry.
+ **/
+void
+mcm_ramp_adjust (const guint16 *in, guint16 *out, guint size, gfloat gamma, gfloat min, gfloat max)
+{
+	McmRampParams params;
+
+	g_return_if_fail (in != NULL);
+	g_return_if_fail (out != NULL);
+
+	/* optimise for the common case */
+	if (min < 0.01f && max > 0.99f && gamma > 0.99f && gamma < 1.01f) {
+		if (in != out)
+			memcpy (out, in, size * sizeof (guint16));
+		return;
+	}
+
+	params.scale = 1.0f / 65536.0f;
+	params.gamma = gamma;
+	params.min = min;
+	params.range = max - min;
+	mcm_ramp_run (in, out, size, &params);
+}
+
+/**
+ * mcm_ramp_formula:
+ * @out: the ramp to write
+ * @size: the number of entries
+ * @gamma: the gamma to apply
+ * @min: the output for a zero input
+ * @max: the output for a full scale input
+ *
+ * Generates 65536 * ((i / size)^gamma * (max - min) + min) for each entry,
+ * as described by a VCGT formula.
+ **/
+void
+mcm_ramp_formula (guint16 *out, guint size, gfloat gamma, gfloat min, gfloat max)
+{
+	McmRampParams params;
+
+	g_return_if_fail (out != NULL);
+	g_return_if_fail (size != 0);
+
+	params.scale = 1.0f / (gfloat) size;
+	params.gamma = gamma;
+	params.min = min;
+	params.range = max - min;
+	mcm_ramp_run (NULL, out, size, &params);
+}
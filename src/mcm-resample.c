@@ -0,0 +1,319 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * SECTION:mcm-resample
+ * @short_description: Resamples gamma ramps to the size of the hardware LUT
+ *
+ * The source position and weights for each output entry only depend on
+ * the two sizes, so they are worked out once and shared by every output
+ * with the same gamma size. The end points of the source and destination
+ * ramps always line up.
+ *
+ * The cubic kind uses monotone Hermite splines, so a ramp that only ever
+ * increases never overshoots or goes backwards when resampled.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "egg-debug.h"
+
+#include "mcm-resample.h"
+
+#define MCM_RESAMPLE_CACHE_MAX_ENTRIES		16
+
+typedef struct {
+	gint			 refcount;
+	guint			 src_size;
+	guint			 dest_size;
+	guint32			*index;		/* always <= src_size - 2 */
+	gfloat			*weight;	/* position between index and index + 1 */
+	gfloat			*basis;		/* the four Hermite basis values per entry */
+} McmResampleTable;
+
+static GStaticMutex mcm_resample_cache_mutex = G_STATIC_MUTEX_INIT;
+static GHashTable *mcm_resample_cache_hash = NULL;	/* key:McmResampleTable */
+static guint mcm_resample_cache_hits = 0;
+static guint mcm_resample_cache_misses = 0;
+
+/**
+ * mcm_resample_table_unref_locked:
+ **/
+static void
+mcm_resample_table_unref_locked (McmResampleTable *table)
+{
+	if (--table->refcount > 0)
+		return;
+	g_free (table->index);
+	g_free (table->weight);
+	g_free (table->basis);
+	g_free (table);
+}
+
+/**
+ * mcm_resample_table_unref:
+ **/
+static void
+mcm_resample_table_unref (McmResampleTable *table)
+{
+	g_static_mutex_lock (&mcm_resample_cache_mutex);
+	mcm_resample_table_unref_locked (table);
+	g_static_mutex_unlock (&mcm_resample_cache_mutex);
+}
+
+/**
+ * mcm_resample_table_new:
+ **/
+static McmResampleTable *
+mcm_resample_table_new (guint src_size, guint dest_size)
+{
+	guint i;
+	gdouble step;
+	gdouble position;
+	gfloat t;
+	gfloat t2;
+	gfloat t3;
+	McmResampleTable *table;
+
+	table = g_new0 (McmResampleTable, 1);
+	table->refcount = 1;
+	table->src_size = src_size;
+	table->dest_size = dest_size;
+	table->index = g_new (guint32, dest_size);
+	table->weight = g_new (gfloat, dest_size);
+	table->basis = g_new (gfloat, dest_size * 4);
+
+	/* map the first and last entries onto each other */
+	step = (dest_size > 1) ? (gdouble) (src_size - 1) / (gdouble) (dest_size - 1) : 0.0;
+	for (i=0; i<dest_size; i++) {
+		position = i * step;
+		table->index[i] = MIN ((guint32) position, src_size - 2);
+		t = position - table->index[i];
+		table->weight[i] = t;
+
+		/* h00, h10, h01 and h11 */
+		t2 = t * t;
+		t3 = t2 * t;
+		table->basis[i*4 + 0] = 2.0f * t3 - 3.0f * t2 + 1.0f;
+		table->basis[i*4 + 1] = t3 - 2.0f * t2 + t;
+		table->basis[i*4 + 2] = -2.0f * t3 + 3.0f * t2;
+		table->basis[i*4 + 3] = t3 - t2;
+	}
+	return table;
+}
+
+/**
+ * mcm_resample_table_get:
+ *
+ * Return value: a table shared with other callers, release with mcm_resample_table_unref()
+ **/
+static McmResampleTable *
+mcm_resample_table_get (guint src_size, guint dest_size)
+{
+	gint64 key;
+	gint64 *key_copy;
+	McmResampleTable *table;
+
+	key = ((gint64) src_size << 32) | dest_size;
+
+	g_static_mutex_lock (&mcm_resample_cache_mutex);
+	if (mcm_resample_cache_hash == NULL)
+		mcm_resample_cache_hash = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free,
+								 (GDestroyNotify) mcm_resample_table_unref_locked);
+
+	/* already calculated */
+	table = g_hash_table_lookup (mcm_resample_cache_hash, &key);
+	if (table != NULL) {
+		mcm_resample_cache_hits++;
+		table->refcount++;
+		goto out;
+	}
+	mcm_resample_cache_misses++;
+
+	/* there are usually only a couple of gamma sizes, so just start again */
+	if (g_hash_table_size (mcm_resample_cache_hash) >= MCM_RESAMPLE_CACHE_MAX_ENTRIES) {
+		egg_debug ("resample cache full, clearing");
+		g_hash_table_remove_all (mcm_resample_cache_hash);
+	}
+
+	/* one reference for the cache and one for the caller */
+	table = mcm_resample_table_new (src_size, dest_size);
+	table->refcount++;
+	key_copy = g_new (gint64, 1);
+	*key_copy = key;
+	g_hash_table_insert (mcm_resample_cache_hash, key_copy, table);
+out:
+	g_static_mutex_unlock (&mcm_resample_cache_mutex);
+	return table;
+}
+
+/**
+ * mcm_resample_get_tangents:
+ *
+ * Fritsch-Carlson tangents, limited so each segment stays monotone.
+ **/
+static void
+mcm_resample_get_tangents (const guint16 *src, guint src_size, gfloat *tangents)
+{
+	guint i;
+	gfloat a;
+	gfloat b;
+	gfloat delta;
+	gfloat delta_prev;
+	gfloat length;
+
+	tangents[0] = (gfloat) src[1] - (gfloat) src[0];
+	tangents[src_size - 1] = (gfloat) src[src_size - 1] - (gfloat) src[src_size - 2];
+	for (i=1; i<src_size - 1; i++) {
+		delta_prev = (gfloat) src[i] - (gfloat) src[i - 1];
+		delta = (gfloat) src[i + 1] - (gfloat) src[i];
+		if (delta_prev * delta <= 0.0f)
+			tangents[i] = 0.0f;
+		else
+			tangents[i] = (delta_prev + delta) / 2.0f;
+	}
+
+	for (i=0; i<src_size - 1; i++) {
+		delta = (gfloat) src[i + 1] - (gfloat) src[i];
+		if (delta == 0.0f) {
+			tangents[i] = 0.0f;
+			tangents[i + 1] = 0.0f;
+			continue;
+		}
+		a = tangents[i] / delta;
+		b = tangents[i + 1] / delta;
+		length = a * a + b * b;
+		if (length > 9.0f) {
+			length = 3.0f / sqrtf (length);
+			tangents[i] = length * a * delta;
+			tangents[i + 1] = length * b * delta;
+		}
+	}
+}
+
+/**
+ * mcm_resample_ramp:
+ * @kind: the interpolation to use, e.g. %MCM_RESAMPLE_KIND_CUBIC
+ * @src: the source ramp
+ * @src_size: the number of entries in @src
+ * @dest: the ramp to write
+ * @dest_size: the number of entries in @dest
+ *
+ * Resamples one channel of a gamma ramp.
+ *
+ * Return value: %TRUE if @dest was written
+ **/
+gboolean
+mcm_resample_ramp (McmResampleKind kind, const guint16 *src, guint src_size, guint16 *dest, guint dest_size)
+{
+	guint i;
+	guint32 idx;
+	gfloat value;
+	gfloat *tangents = NULL;
+	const gfloat *basis;
+	McmResampleTable *table;
+
+	g_return_val_if_fail (kind < MCM_RESAMPLE_KIND_LAST, FALSE);
+	g_return_val_if_fail (src != NULL, FALSE);
+	g_return_val_if_fail (dest != NULL, FALSE);
+	g_return_val_if_fail (src_size != 0, FALSE);
+	g_return_val_if_fail (dest_size != 0, FALSE);
+
+	/* nothing to do */
+	if (src_size == dest_size) {
+		memcpy (dest, src, dest_size * sizeof (guint16));
+		return TRUE;
+	}
+
+	/* nothing to interpolate between */
+	if (src_size == 1) {
+		for (i=0; i<dest_size; i++)
+			dest[i] = src[0];
+		return TRUE;
+	}
+
+	table = mcm_resample_table_get (src_size, dest_size);
+	switch (kind) {
+	case MCM_RESAMPLE_KIND_NEAREST:
+		for (i=0; i<dest_size; i++)
+			dest[i] = src[table->index[i] + (table->weight[i] >= 0.5f ? 1 : 0)];
+		break;
+	case MCM_RESAMPLE_KIND_LINEAR:
+		for (i=0; i<dest_size; i++) {
+			idx = table->index[i];
+			value = src[idx] + table->weight[i] * ((gfloat) src[idx + 1] - (gfloat) src[idx]);
+			dest[i] = value + 0.5f;
+		}
+		break;
+	case MCM_RESAMPLE_KIND_CUBIC:
+		tangents = g_new (gfloat, src_size);
+		mcm_resample_get_tangents (src, src_size, tangents);
+		for (i=0; i<dest_size; i++) {
+			idx = table->index[i];
+			basis = &table->basis[i*4];
+			value = basis[0] * src[idx] + basis[1] * tangents[idx] +
+				basis[2] * src[idx + 1] + basis[3] * tangents[idx + 1];
+			dest[i] = CLAMP (value + 0.5f, 0.0f, 65535.0f);
+		}
+		g_free (tangents);
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+	mcm_resample_table_unref (table);
+	return TRUE;
+}
+
+/**
+ * mcm_resample_cache_clear:
+ *
+ * Frees all the cached tables that are not in use.
+ **/
+void
+mcm_resample_cache_clear (void)
+{
+	g_static_mutex_lock (&mcm_resample_cache_mutex);
+	if (mcm_resample_cache_hash != NULL)
+		g_hash_table_remove_all (mcm_resample_cache_hash);
+	mcm_resample_cache_hits = 0;
+	mcm_resample_cache_misses = 0;
+	g_static_mutex_unlock (&mcm_resample_cache_mutex);
+}
+
+/**
+ * mcm_resample_cache_get_stats:
+ * @hits: the number of times a table was reused, or %NULL
+ * @misses: the number of times a table was calculated, or %NULL
+ **/
+void
+mcm_resample_cache_get_stats (guint *hits, guint *misses)
+{
+	g_static_mutex_lock (&mcm_resample_cache_mutex);
+	if (hits != NULL)
+		*hits = mcm_resample_cache_hits;
+	if (misses != NULL)
+		*misses = mcm_resample_cache_misses;
+	g_static_mutex_unlock (&mcm_resample_cache_mutex);
+}
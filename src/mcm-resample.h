@@ -0,0 +1,47 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __MCM_RESAMPLE_H
+#define __MCM_RESAMPLE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+	MCM_RESAMPLE_KIND_NEAREST,
+	MCM_RESAMPLE_KIND_LINEAR,
+	MCM_RESAMPLE_KIND_CUBIC,
+	MCM_RESAMPLE_KIND_LAST
+} McmResampleKind;
+
+gboolean	 mcm_resample_ramp			(McmResampleKind	 kind,
+							 const guint16		*src,
+							 guint			 src_size,
+							 guint16		*dest,
+							 guint			 dest_size);
+void		 mcm_resample_cache_clear		(void);
+void		 mcm_resample_cache_get_stats		(guint			*hits,
+							 guint			*misses);
+
+G_END_DECLS
+
+#endif /* __MCM_RESAMPLE_H */
@@ -0,0 +1,150 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+/**
+ * SECTION:mcm-scan-budget
+ * @short_description: A limit on the time and reads used by a scan
+ *
+ * Volumes can be slow or on the network, so a scan of one is limited in
+ * the time it takes and in the number of reads it does. The scanning
+ * thread spends the budget between reads, and the main context can expire
+ * it when a single read has blocked for too long.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "mcm-scan-budget.h"
+
+struct _McmScanBudget {
+	gdouble			 seconds;
+	guint			 reads_max;
+	volatile gint		 reads;
+	volatile gint		 expired;
+	GTimer			*timer;
+};
+
+/**
+ * mcm_scan_budget_spend:
+ * @budget: a #McmScanBudget
+ *
+ * Uses one read. This can be called from any thread.
+ *
+ * Return value: %TRUE if the read can be done, %FALSE if the scan should stop
+ **/
+gboolean
+mcm_scan_budget_spend (McmScanBudget *budget)
+{
+	g_return_val_if_fail (budget != NULL, FALSE);
+
+	if (g_atomic_int_get (&budget->expired))
+		return FALSE;
+	if ((guint) g_atomic_int_exchange_and_add (&budget->reads, 1) < budget->reads_max &&
+	    g_timer_elapsed (budget->timer, NULL) < budget->seconds)
+		return TRUE;
+	g_atomic_int_set (&budget->expired, TRUE);
+	return FALSE;
+}
+
+/**
+ * mcm_scan_budget_expire:
+ * @budget: a #McmScanBudget
+ *
+ * Stops the scan at the next read, whatever is left.
+ **/
+void
+mcm_scan_budget_expire (McmScanBudget *budget)
+{
+	g_return_if_fail (budget != NULL);
+	g_atomic_int_set (&budget->expired, TRUE);
+}
+
+/**
+ * mcm_scan_budget_is_expired:
+ * @budget: a #McmScanBudget
+ *
+ * Return value: %TRUE if the scan was stopped before it finished
+ **/
+gboolean
+mcm_scan_budget_is_expired (McmScanBudget *budget)
+{
+	g_return_val_if_fail (budget != NULL, FALSE);
+	return g_atomic_int_get (&budget->expired);
+}
+
+/**
+ * mcm_scan_budget_get_reads:
+ * @budget: a #McmScanBudget
+ *
+ * Return value: the number of reads asked for so far
+ **/
+guint
+mcm_scan_budget_get_reads (McmScanBudget *budget)
+{
+	g_return_val_if_fail (budget != NULL, 0);
+	return g_atomic_int_get (&budget->reads);
+}
+
+/**
+ * mcm_scan_budget_get_elapsed:
+ * @budget: a #McmScanBudget
+ *
+ * Return value: the number of seconds since the budget was created
+ **/
+gdouble
+mcm_scan_budget_get_elapsed (McmScanBudget *budget)
+{
+	g_return_val_if_fail (budget != NULL, 0.0f);
+	return g_timer_elapsed (budget->timer, NULL);
+}
+
+/**
+ * mcm_scan_budget_free:
+ **/
+void
+mcm_scan_budget_free (McmScanBudget *budget)
+{
+	if (budget == NULL)
+		return;
+	g_timer_destroy (budget->timer);
+	g_free (budget);
+}
+
+/**
+ * mcm_scan_budget_new:
+ * @seconds: the time the scan can take, starting now
+ * @reads: the number of directory entries and files the scan can read
+ *
+ * Return value: a new #McmScanBudget, free with mcm_scan_budget_free()
+ **/
+McmScanBudget *
+mcm_scan_budget_new (gdouble seconds, guint reads)
+{
+	McmScanBudget *budget;
+	budget = g_new0 (McmScanBudget, 1);
+	budget->seconds = seconds;
+	budget->reads_max = reads;
+	budget->timer = g_timer_new ();
+	return budget;
+}
@@ -0,0 +1,43 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __MCM_SCAN_BUDGET_H
+#define __MCM_SCAN_BUDGET_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _McmScanBudget	McmScanBudget;
+
+McmScanBudget	*mcm_scan_budget_new			(gdouble		 seconds,
+							 guint			 reads);
+void		 mcm_scan_budget_free			(McmScanBudget		*budget);
+gboolean	 mcm_scan_budget_spend			(McmScanBudget		*budget);
+void		 mcm_scan_budget_expire			(McmScanBudget		*budget);
+gboolean	 mcm_scan_budget_is_expired		(McmScanBudget		*budget);
+guint		 mcm_scan_budget_get_reads		(McmScanBudget		*budget);
+gdouble		 mcm_scan_budget_get_elapsed		(McmScanBudget		*budget);
+
+G_END_DECLS
+
+#endif /* __MCM_SCAN_BUDGET_H */
@@ -19,9 +19,17 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
+
 #include <glib-object.h>
 #include <math.h>
+#include <string.h>
 #include <glib/gstdio.h>
+#ifdef MCM_USE_LCMS2
+ #include <lcms2.h>
+#else
+ #include <lcms.h>
+#endif
 
 #include "mcm-brightness.h"
 #include "mcm-calibrate.h"
@@ -41,10 +49,20 @@
 #include "mcm-print.h"
 #include "mcm-profile.h"
 #include "mcm-profile-store.h"
-#include "mcm-profile-lcms1.h"
 #include "mcm-tables.h"
+#include "mcm-tag-index.h"
+#include "mcm-ramp.h"
+#include "mcm-ramp-cache.h"
+#include "mcm-resample.h"
+#include "mcm-output-index.h"
+#include "mcm-output-state.h"
+#include "mcm-profile-index.h"
+#include "mcm-scan-budget.h"
+#include "mcm-transform-cache.h"
+#include "mcm-trc.h"
 #include "mcm-trc-widget.h"
 #include "mcm-utils.h"
+#include "mcm-volume-cache.h"
 #include "mcm-xyz.h"
 #include "mcm-profile.h"
 #include "mcm-xyz.h"
@@ -250,6 +268,11 @@ mcm_test_clut_func (void)
 	McmClut *clut;
 	GPtrArray *array;
 	const McmClutData *data;
+	const guint16 *data_const;
+	guint16 *ramps;
+	guint16 red[2];
+	guint16 green[2];
+	guint16 blue[2];
 
 	clut = mcm_clut_new ();
 	g_assert (clut != NULL);
@@ -329,9 +352,317 @@ mcm_test_clut_func (void)
 
 	g_ptr_array_unref (array);
 
+	/* write the planar source directly */
+	g_object_set (clut,
+		      "contrast", 100.0f,
+		      "brightness", 0.0f,
+		      "gamma", 1.0f,
+		      NULL);
+	ramps = mcm_clut_get_source_buffer (clut, 2);
+	ramps[0] = 0x1000;
+	ramps[1] = 0x2000;
+	ramps[2] = 0x3000;
+	ramps[3] = 0x4000;
+	ramps[4] = 0x5000;
+	ramps[5] = 0x6000;
+	g_assert_cmpint (mcm_clut_get_size (clut), ==, 2);
+
+	/* zero copy view */
+	data_const = mcm_clut_get_data (clut);
+	g_assert (data_const != NULL);
+	g_assert_cmpint (data_const[0], ==, 0x1000);
+	g_assert_cmpint (data_const[3], ==, 0x4000);
+	g_assert_cmpint (data_const[5], ==, 0x6000);
+
+	/* fill caller owned ramps */
+	g_assert (mcm_clut_fill_ramp (clut, red, green, blue, 2));
+	g_assert_cmpint (red[1], ==, 0x2000);
+	g_assert_cmpint (green[0], ==, 0x3000);
+	g_assert_cmpint (blue[1], ==, 0x6000);
+	g_assert (!mcm_clut_fill_ramp (clut, red, green, blue, 1));
+
+	/* compatibility view of the same data */
+	array = mcm_clut_get_array (clut);
+	g_assert_cmpint (array->len, ==, 2);
+	data = g_ptr_array_index (array, 1);
+	g_assert_cmpint (data->red, ==, 0x2000);
+	g_assert_cmpint (data->green, ==, 0x4000);
+	g_assert_cmpint (data->blue, ==, 0x6000);
+	g_ptr_array_unref (array);
+
+	/* setting the same value keeps the cached ramps */
+	g_object_set (clut, "gamma", 1.0f, NULL);
+	g_assert (mcm_clut_get_data (clut) == data_const);
+	g_assert_cmpint (data_const[1], ==, 0x2000);
+
+	/* but a new value does not */
+	g_object_set (clut, "brightness", 50.0f, NULL);
+	data_const = mcm_clut_get_data (clut);
+	g_assert_cmpint (data_const[0], >, 0x8000);
+
 	g_object_unref (clut);
 }
 
+static void
+mcm_test_ramp_func (void)
+{
+	guint i;
+	guint j;
+	gint expected;
+	gint error;
+	gint max_error = 0;
+	guint16 in[1027];
+	guint16 out[1027];
+	const gfloat gammas[] = { 0.45f, 0.8f, 1.2f, 2.2f, 3.0f };
+
+	/* an odd size covers the tail of each kernel */
+	for (i=0; i<G_N_ELEMENTS (in); i++)
+		in[i] = (i * 0xffff) / (G_N_ELEMENTS (in) - 1);
+
+	/* within one LSB of the exact value */
+	for (j=0; j<G_N_ELEMENTS (gammas); j++) {
+		mcm_ramp_adjust (in, out, G_N_ELEMENTS (in), gammas[j], 0.05f, 0.95f);
+		for (i=0; i<G_N_ELEMENTS (in); i++) {
+			expected = MIN (65536.0 * (pow (in[i] / 65536.0, gammas[j]) * 0.9 + 0.05), 0xffff);
+			error = ABS (expected - (gint) out[i]);
+			max_error = MAX (max_error, error);
+		}
+		mcm_ramp_formula (out, G_N_ELEMENTS (out), gammas[j], 0.0f, 1.0f);
+		for (i=0; i<G_N_ELEMENTS (out); i++) {
+			expected = MIN (65536.0 * pow ((gdouble) i / G_N_ELEMENTS (out), gammas[j]), 0xffff);
+			error = ABS (expected - (gint) out[i]);
+			max_error = MAX (max_error, error);
+		}
+	}
+	g_assert_cmpint (max_error, <=, 1);
+
+	/* zero stays zero */
+	g_assert_cmpint (out[0], ==, 0);
+
+	/* the common case is a copy */
+	mcm_ramp_adjust (in, out, G_N_ELEMENTS (in), 1.0f, 0.0f, 1.0f);
+	g_assert_cmpint (out[513], ==, in[513]);
+
+	/* in place */
+	memcpy (out, in, sizeof (in));
+	mcm_ramp_adjust (out, out, G_N_ELEMENTS (out), 2.2f, 0.0f, 1.0f);
+	g_assert_cmpint (out[1026], >, 0xff00);
+	g_assert_cmpint (out[513], <, 0x4000);
+}
+
+static void
+mcm_test_ramp_cache_func (void)
+{
+	guint i;
+	gboolean ret;
+	GError *error = NULL;
+	McmRampCache *cache;
+	const guint16 *ramp;
+	const gchar *filename = NULL;
+	guint16 red[256];
+	guint16 green[256];
+	guint16 blue[256];
+	const gchar *cache_filename = "/tmp/mcm-self-test-ramps.cache";
+	const gchar *profile_filename = "/tmp/mcm-self-test-ramps.icc";
+
+	for (i=0; i<256; i++) {
+		red[i] = i * 0x101;
+		green[i] = i * 0x100;
+		blue[i] = 0xffff - i;
+	}
+	ret = g_file_set_contents (profile_filename, "profile", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* save one ramp made from a profile, and one without */
+	cache = mcm_ramp_cache_new ();
+	mcm_ramp_cache_add (cache, "lvds", 256, profile_filename, red, green, blue);
+	mcm_ramp_cache_add (cache, "vga", 256, NULL, blue, green, red);
+	ret = mcm_ramp_cache_save (cache, cache_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	mcm_ramp_cache_free (cache);
+
+	/* get them back */
+	cache = mcm_ramp_cache_new ();
+	ret = mcm_ramp_cache_load (cache, cache_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ramp = mcm_ramp_cache_lookup (cache, "lvds", 256, &filename);
+	g_assert (ramp != NULL);
+	g_assert_cmpstr (filename, ==, profile_filename);
+	g_assert_cmpint (ramp[255], ==, 0xffff);
+	g_assert_cmpint (ramp[256 + 1], ==, 0x100);
+	g_assert_cmpint (ramp[512], ==, 0xffff);
+	ramp = mcm_ramp_cache_lookup (cache, "vga", 256, &filename);
+	g_assert (ramp != NULL);
+	g_assert (filename == NULL);
+	g_assert_cmpint (ramp[0], ==, 0xffff);
+
+	/* wrong size, or not there */
+	g_assert (mcm_ramp_cache_lookup (cache, "lvds", 1024, NULL) == NULL);
+	g_assert (mcm_ramp_cache_lookup (cache, "dvi", 256, NULL) == NULL);
+
+	/* the profile changed */
+	ret = g_file_set_contents (profile_filename, "new profile", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (mcm_ramp_cache_lookup (cache, "lvds", 256, NULL) == NULL);
+	mcm_ramp_cache_free (cache);
+
+	/* a truncated file is not used */
+	ret = g_file_set_contents (cache_filename, "MCMRAMP", 8, &error);
+	g_assert_no_error (error);
+	cache = mcm_ramp_cache_new ();
+	ret = mcm_ramp_cache_load (cache, cache_filename, &error);
+	g_assert (error != NULL);
+	g_assert (!ret);
+	g_clear_error (&error);
+	mcm_ramp_cache_free (cache);
+
+	g_unlink (cache_filename);
+	g_unlink (profile_filename);
+}
+
+static void
+mcm_test_output_index_func (void)
+{
+	McmOutputIndex *output_index;
+
+	output_index = mcm_output_index_new ();
+	g_assert (mcm_output_index_lookup (output_index, 0, 0, 100, 100) == NULL);
+
+	/* a laptop panel with a smaller monitor to the right */
+	mcm_output_index_add (output_index, 0, 0, 1920, 1200, GUINT_TO_POINTER (1));
+	mcm_output_index_add (output_index, 1920, 0, 1280, 1024, GUINT_TO_POINTER (2));
+	g_assert_cmpint (mcm_output_index_get_size (output_index), ==, 2);
+
+	/* all on one output */
+	g_assert (mcm_output_index_lookup (output_index, 100, 100, 400, 300) == GUINT_TO_POINTER (1));
+	g_assert (mcm_output_index_lookup (output_index, 2000, 100, 400, 300) == GUINT_TO_POINTER (2));
+
+	/* spanning both, so the one with most of the window */
+	g_assert (mcm_output_index_lookup (output_index, 1700, 100, 400, 300) == GUINT_TO_POINTER (1));
+	g_assert (mcm_output_index_lookup (output_index, 1800, 100, 400, 300) == GUINT_TO_POINTER (2));
+
+	/* off the desktop */
+	g_assert (mcm_output_index_lookup (output_index, 5000, 100, 400, 300) == NULL);
+
+	mcm_output_index_clear (output_index);
+	g_assert (mcm_output_index_lookup (output_index, 100, 100, 400, 300) == NULL);
+	mcm_output_index_free (output_index);
+}
+
+static void
+mcm_test_output_state_func (void)
+{
+	guint8 edid1[MCM_OUTPUT_STATE_EDID_SIZE];
+	guint8 edid2[MCM_OUTPUT_STATE_EDID_SIZE];
+	McmOutputState *state_old;
+	McmOutputState *state;
+
+	memset (edid1, 0x01, sizeof (edid1));
+	memset (edid2, 0x02, sizeof (edid2));
+
+	/* a new output */
+	state_old = mcm_output_state_new (TRUE, edid1, 1, 0, 0);
+	g_assert_cmpint (mcm_output_state_compare (NULL, state_old), ==, MCM_OUTPUT_STATE_CHANGE_REPLUGGED);
+
+	/* nothing changed */
+	state = mcm_output_state_new (TRUE, edid1, 1, 0, 0);
+	g_assert_cmpint (mcm_output_state_compare (state_old, state), ==, MCM_OUTPUT_STATE_CHANGE_NONE);
+	mcm_output_state_free (state);
+
+	/* a different crtc, or somewhere else on the desktop */
+	state = mcm_output_state_new (TRUE, edid1, 2, 0, 0);
+	g_assert_cmpint (mcm_output_state_compare (state_old, state), ==, MCM_OUTPUT_STATE_CHANGE_MOVED);
+	mcm_output_state_free (state);
+	state = mcm_output_state_new (TRUE, edid1, 1, 1920, 0);
+	g_assert_cmpint (mcm_output_state_compare (state_old, state), ==, MCM_OUTPUT_STATE_CHANGE_MOVED);
+	mcm_output_state_free (state);
+
+	/* a different monitor on the same output */
+	state = mcm_output_state_new (TRUE, edid2, 1, 0, 0);
+	g_assert_cmpint (mcm_output_state_compare (state_old, state), ==, MCM_OUTPUT_STATE_CHANGE_REPLUGGED);
+	mcm_output_state_free (state);
+	state = mcm_output_state_new (TRUE, NULL, 1, 0, 0);
+	g_assert_cmpint (mcm_output_state_compare (state_old, state), ==, MCM_OUTPUT_STATE_CHANGE_REPLUGGED);
+	mcm_output_state_free (state);
+
+	/* unplugged, and then plugged in again */
+	state = mcm_output_state_new (FALSE, edid1, 1, 0, 0);
+	g_assert_cmpint (mcm_output_state_compare (state_old, state), ==, MCM_OUTPUT_STATE_CHANGE_DISCONNECTED);
+	mcm_output_state_free (state_old);
+	state_old = state;
+	state = mcm_output_state_new (FALSE, NULL, 0, 0, 0);
+	g_assert_cmpint (mcm_output_state_compare (state_old, state), ==, MCM_OUTPUT_STATE_CHANGE_NONE);
+	mcm_output_state_free (state);
+	state = mcm_output_state_new (TRUE, edid1, 1, 0, 0);
+	g_assert_cmpint (mcm_output_state_compare (state_old, state), ==, MCM_OUTPUT_STATE_CHANGE_REPLUGGED);
+	mcm_output_state_free (state);
+	mcm_output_state_free (state_old);
+}
+
+static void
+mcm_test_resample_func (void)
+{
+	guint i;
+	guint hits;
+	guint misses;
+	gboolean ret;
+	guint16 src[256];
+	guint16 dest[1024];
+	guint16 back[256];
+	const guint16 step[] = { 0, 0, 0, 0xffff, 0xffff, 0xffff };
+	guint16 out[16];
+
+	mcm_resample_cache_clear ();
+	for (i=0; i<G_N_ELEMENTS (src); i++)
+		src[i] = i * 0x101;
+
+	/* the end points are kept and the ramp stays monotonic */
+	ret = mcm_resample_ramp (MCM_RESAMPLE_KIND_CUBIC, src, G_N_ELEMENTS (src), dest, G_N_ELEMENTS (dest));
+	g_assert (ret);
+	g_assert_cmpint (dest[0], ==, 0);
+	g_assert_cmpint (dest[1023], ==, 0xffff);
+	for (i=1; i<G_N_ELEMENTS (dest); i++)
+		g_assert_cmpint (dest[i], >=, dest[i-1]);
+
+	/* going back gives the same ramp */
+	ret = mcm_resample_ramp (MCM_RESAMPLE_KIND_CUBIC, dest, G_N_ELEMENTS (dest), back, G_N_ELEMENTS (back));
+	g_assert (ret);
+	for (i=0; i<G_N_ELEMENTS (back); i++)
+		g_assert_cmpint (ABS ((gint) back[i] - (gint) src[i]), <=, 1);
+
+	/* a step does not overshoot */
+	ret = mcm_resample_ramp (MCM_RESAMPLE_KIND_CUBIC, step, G_N_ELEMENTS (step), out, G_N_ELEMENTS (out));
+	g_assert (ret);
+	for (i=0; i<G_N_ELEMENTS (out); i++) {
+		if (i < 6)
+			g_assert_cmpint (out[i], ==, 0);
+		if (i > 9)
+			g_assert_cmpint (out[i], ==, 0xffff);
+	}
+
+	/* nearest and linear */
+	ret = mcm_resample_ramp (MCM_RESAMPLE_KIND_NEAREST, step, G_N_ELEMENTS (step), out, G_N_ELEMENTS (out));
+	g_assert (ret);
+	g_assert_cmpint (out[7], ==, 0);
+	g_assert_cmpint (out[8], ==, 0xffff);
+	ret = mcm_resample_ramp (MCM_RESAMPLE_KIND_LINEAR, step, G_N_ELEMENTS (step), out, G_N_ELEMENTS (out));
+	g_assert (ret);
+	g_assert_cmpint (out[6], ==, 0);
+	g_assert_cmpint (out[9], ==, 0xffff);
+	g_assert_cmpint (out[7], >, 0);
+	g_assert_cmpint (out[7], <, out[8]);
+
+	/* the tables are shared between calls of the same size */
+	mcm_resample_ramp (MCM_RESAMPLE_KIND_CUBIC, src, G_N_ELEMENTS (src), dest, G_N_ELEMENTS (dest));
+	mcm_resample_cache_get_stats (&hits, &misses);
+	g_assert_cmpint (misses, ==, 3);
+	g_assert_cmpint (hits, ==, 3);
+}
+
 static guint _changes = 0;
 static GMainLoop *_loop = NULL;
 
@@ -826,46 +1157,48 @@ typedef struct {
 } McmProfileTestData;
 
 static void
-mcm_test_profile_test_parse_file (const gchar *datafile, McmProfileTestData *test_data)
+mcm_test_profile_test_parse_file (const gchar *datafile, McmProfileTestData *test_data, gboolean lightweight)
 {
 	gchar *filename = NULL;
 	gboolean ret;
 	GError *error = NULL;
-	McmProfile *profile_lcms1;
+	McmProfile *profile;
 	McmXyz *xyz;
 	gfloat luminance;
 	GFile *file;
 
-	profile_lcms1 = MCM_PROFILE(mcm_profile_lcms1_new ());
-	g_assert (profile_lcms1 != NULL);
+	profile = mcm_profile_default_new ();
+	g_assert (profile != NULL);
+	mcm_profile_set_lightweight (profile, lightweight);
 
 	filename = mcm_test_get_data_file (datafile);
 	g_assert ((filename != NULL));
 
 	file = g_file_new_for_path (filename);
-	ret = mcm_profile_parse (profile_lcms1, file, &error);
+	ret = mcm_profile_parse (profile, file, &error);
 	g_assert_no_error (error);
 	g_assert (ret);
 	g_object_unref (file);
 
-	g_assert_cmpstr (mcm_profile_get_copyright (profile_lcms1), ==, test_data->copyright);
-	g_assert_cmpstr (mcm_profile_get_manufacturer (profile_lcms1), ==, test_data->manufacturer);
-	g_assert_cmpstr (mcm_profile_get_model (profile_lcms1), ==, test_data->model);
-	g_assert_cmpstr (mcm_profile_get_datetime (profile_lcms1), ==, test_data->datetime);
-	g_assert_cmpstr (mcm_profile_get_description (profile_lcms1), ==, test_data->description);
-	g_assert_cmpstr (mcm_profile_get_checksum (profile_lcms1), ==, test_data->checksum);
-	g_assert_cmpint (mcm_profile_get_kind (profile_lcms1), ==, test_data->kind);
-	g_assert_cmpint (mcm_profile_get_colorspace (profile_lcms1), ==, test_data->colorspace);
-	g_assert_cmpint (mcm_profile_get_has_vcgt (profile_lcms1), ==, test_data->has_vcgt);
-
-	g_object_get (profile_lcms1,
+	g_assert_cmpstr (mcm_profile_get_copyright (profile), ==, test_data->copyright);
+	g_assert_cmpstr (mcm_profile_get_manufacturer (profile), ==, test_data->manufacturer);
+	g_assert_cmpstr (mcm_profile_get_model (profile), ==, test_data->model);
+	g_assert_cmpstr (mcm_profile_get_datetime (profile), ==, test_data->datetime);
+	g_assert_cmpstr (mcm_profile_get_description (profile), ==, test_data->description);
+	g_assert_cmpstr (mcm_profile_get_checksum (profile), ==, test_data->checksum);
+	g_assert_cmpint (mcm_profile_get_kind (profile), ==, test_data->kind);
+	g_assert_cmpint (mcm_profile_get_colorspace (profile), ==, test_data->colorspace);
+	g_assert_cmpint (mcm_profile_get_has_vcgt (profile), ==, test_data->has_vcgt);
+
+	/* this is loaded on demand in lightweight mode */
+	g_object_get (profile,
 		      "red", &xyz,
 		      NULL);
 	luminance = mcm_xyz_get_x (xyz);
 	g_assert_cmpfloat (fabs (luminance - test_data->luminance), <, 0.001);
 
 	g_object_unref (xyz);
-	g_object_unref (profile_lcms1);
+	g_object_unref (profile);
 	g_free (filename);
 }
 
@@ -885,7 +1218,8 @@ mcm_test_profile_func (void)
 	test_data.datetime = "February  9 1998, 06:49:00 AM";
 	test_data.checksum = "8e2aed5dac6f8b5d8da75610a65b7f27";
 	test_data.has_vcgt = TRUE;
-	mcm_test_profile_test_parse_file ("bluish.icc", &test_data);
+	mcm_test_profile_test_parse_file ("bluish.icc", &test_data, FALSE);
+	mcm_test_profile_test_parse_file ("bluish.icc", &test_data, TRUE);
 
 	/* Adobe test */
 	test_data.copyright = "Copyright (c) 1998 Hewlett-Packard Company Modified using Adobe Gamma";
@@ -898,7 +1232,447 @@ mcm_test_profile_func (void)
 	test_data.datetime = "August 16 2005, 09:49:54 PM";
 	test_data.checksum = "bd847723f676e2b846daaf6759330624";
 	test_data.has_vcgt = TRUE;
-	mcm_test_profile_test_parse_file ("AdobeGammaTest.icm", &test_data);
+	mcm_test_profile_test_parse_file ("AdobeGammaTest.icm", &test_data, FALSE);
+	mcm_test_profile_test_parse_file ("AdobeGammaTest.icm", &test_data, TRUE);
+}
+
+static void
+mcm_test_profile_many_func (void)
+{
+	guint i;
+	gchar *filename;
+	GPtrArray *files;
+	GPtrArray *profiles;
+	GError *error = NULL;
+	McmProfile *profile;
+	const gchar *datafiles[] = { "bluish.icc", "does-not-exist.icc", "ibm-t61.icc", NULL };
+
+	files = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	for (i=0; datafiles[i] != NULL; i++) {
+		filename = mcm_test_get_data_file (datafiles[i]);
+		if (filename == NULL)
+			filename = g_build_filename ("..", "data", "tests", datafiles[i], NULL);
+		g_ptr_array_add (files, g_file_new_for_path (filename));
+		g_free (filename);
+	}
+
+	/* the missing file is skipped, the rest are in order */
+	profiles = mcm_profile_parse_many (files, TRUE, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (profiles != NULL);
+	g_assert_cmpint (profiles->len, ==, 2);
+	profile = g_ptr_array_index (profiles, 0);
+	g_assert_cmpstr (mcm_profile_get_description (profile), ==, "Blueish Test");
+	profile = g_ptr_array_index (profiles, 1);
+	g_assert_cmpstr (mcm_profile_get_id (profile), ==, "hash-78a90a8ee71d84ed-25120");
+	g_ptr_array_unref (profiles);
+
+	/* nothing to do */
+	g_ptr_array_set_size (files, 0);
+	profiles = mcm_profile_parse_many (files, TRUE, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (profiles->len, ==, 0);
+	g_ptr_array_unref (profiles);
+
+	g_ptr_array_unref (files);
+}
+
+static void
+mcm_test_profile_fuzz_file (const gchar *datafile)
+{
+	gchar *filename;
+	gchar *data = NULL;
+	guint8 *fuzzed;
+	gsize length;
+	gsize fuzzed_length;
+	gboolean lightweight;
+	gboolean ret;
+	guint i;
+	guint j;
+	GError *error = NULL;
+	McmClut *clut;
+	McmProfile *profile;
+
+	filename = mcm_test_get_data_file (datafile);
+	g_assert (filename != NULL);
+	ret = g_file_get_contents (filename, &data, &length, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* corrupt the header, the tag table and the tag data, then truncate */
+	for (i=0; i<1000; i++) {
+		fuzzed_length = (i % 4 == 0) ? (gsize) g_test_rand_int_range (1, length) : length;
+
+		/* copy exactly what is parsed so overreads hit the end of the block */
+		fuzzed = g_memdup (data, fuzzed_length);
+		for (j=0; j<8; j++) {
+			if (j % 2 == 0)
+				fuzzed[g_test_rand_int_range (0, MIN (fuzzed_length, 0x200))] = g_test_rand_int_range (0, 256);
+			else
+				fuzzed[g_test_rand_int_range (0, fuzzed_length)] = g_test_rand_int_range (0, 256);
+		}
+
+		/* it may fail, it just must not crash, with or without the colorimetry,
+		 * so both modes see both truncated and full length data */
+		lightweight = (i / 4) % 2 == 0;
+		profile = mcm_profile_default_new ();
+		mcm_profile_set_lightweight (profile, lightweight);
+		ret = mcm_profile_parse_data (profile, fuzzed, fuzzed_length, &error);
+		if (!ret) {
+			g_clear_error (&error);
+		} else if (!lightweight) {
+			clut = mcm_profile_generate_vcgt (profile, 256);
+			if (clut != NULL)
+				g_object_unref (clut);
+			clut = mcm_profile_generate_curve (profile, 256);
+			if (clut != NULL)
+				g_object_unref (clut);
+		}
+		g_object_unref (profile);
+		g_free (fuzzed);
+	}
+
+	g_free (data);
+	g_free (filename);
+}
+
+static void
+mcm_test_profile_fuzz_func (void)
+{
+	mcm_test_profile_fuzz_file ("bluish.icc");
+	mcm_test_profile_fuzz_file ("ibm-t61.icc");
+}
+
+static guint _store_added = 0;
+static guint _store_removed = 0;
+static guint _store_changed = 0;
+static GMainLoop *_store_loop = NULL;
+
+static void
+mcm_test_profile_store_added_cb (McmProfileStore *store, McmProfile *profile)
+{
+	_store_added++;
+}
+
+static void
+mcm_test_profile_store_removed_cb (McmProfileStore *store, McmProfile *profile)
+{
+	_store_removed++;
+}
+
+static void
+mcm_test_profile_store_changed_cb (McmProfileStore *store)
+{
+	_store_changed++;
+	g_main_loop_quit (_store_loop);
+}
+
+static gboolean
+mcm_test_profile_store_timeout_cb (gpointer user_data)
+{
+	g_main_loop_quit (_store_loop);
+	return FALSE;
+}
+
+static void
+mcm_test_profile_store_copy (const gchar *dirname, const gchar *filename)
+{
+	gboolean ret;
+	gchar *data;
+	gsize length;
+	gchar *src;
+	gchar *dest;
+	GError *error = NULL;
+
+	src = mcm_test_get_data_file (filename);
+	dest = g_build_filename (dirname, filename, NULL);
+	ret = g_file_get_contents (src, &data, &length, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = g_file_set_contents (dest, data, length, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_free (data);
+	g_free (src);
+	g_free (dest);
+}
+
+static void
+mcm_test_profile_store_batch_func (void)
+{
+	guint id;
+	gchar *filename;
+	McmProfileStore *store;
+	const gchar *dirname = "/tmp/mcm-self-test-store";
+
+	g_mkdir_with_parents (dirname, 0700);
+	store = mcm_profile_store_new ();
+	mcm_profile_store_search_by_path (store, dirname);
+	g_signal_connect (store, "added", G_CALLBACK (mcm_test_profile_store_added_cb), NULL);
+	g_signal_connect (store, "removed", G_CALLBACK (mcm_test_profile_store_removed_cb), NULL);
+	g_signal_connect (store, "changed", G_CALLBACK (mcm_test_profile_store_changed_cb), NULL);
+	_store_loop = g_main_loop_new (NULL, FALSE);
+
+	/* copying several profiles is only one change */
+	mcm_test_profile_store_copy (dirname, "bluish.icc");
+	mcm_test_profile_store_copy (dirname, "ibm-t61.icc");
+	id = g_timeout_add (5000, mcm_test_profile_store_timeout_cb, NULL);
+	g_main_loop_run (_store_loop);
+	g_source_remove (id);
+	g_assert_cmpint (_store_added, ==, 2);
+	g_assert_cmpint (_store_changed, ==, 1);
+
+	/* and only the deleted profile is removed */
+	filename = g_build_filename (dirname, "bluish.icc", NULL);
+	g_unlink (filename);
+	g_free (filename);
+	id = g_timeout_add (5000, mcm_test_profile_store_timeout_cb, NULL);
+	g_main_loop_run (_store_loop);
+	g_source_remove (id);
+	g_assert_cmpint (_store_removed, ==, 1);
+	g_assert_cmpint (_store_added, ==, 2);
+	g_assert_cmpint (_store_changed, ==, 2);
+
+	g_main_loop_unref (_store_loop);
+	g_object_unref (store);
+	filename = g_build_filename (dirname, "ibm-t61.icc", NULL);
+	g_unlink (filename);
+	g_free (filename);
+	g_rmdir (dirname);
+}
+
+static guint _store_progress = 0;
+static guint _store_complete = 0;
+
+static void
+mcm_test_profile_store_scan_progress_cb (McmProfileStore *store, guint percentage)
+{
+	g_assert_cmpint (percentage, >=, _store_progress);
+	_store_progress = percentage;
+}
+
+static void
+mcm_test_profile_store_scan_complete_cb (McmProfileStore *store)
+{
+	_store_complete++;
+}
+
+static void
+mcm_test_profile_store_search_cb (GObject *source_object, GAsyncResult *res, GError **error)
+{
+	mcm_profile_store_search_default_finish (MCM_PROFILE_STORE (source_object), res, error);
+	g_main_loop_quit (_store_loop);
+}
+
+static void
+mcm_test_profile_store_async_func (void)
+{
+	GError *error = NULL;
+	GCancellable *cancellable;
+	McmProfileStore *store;
+
+	store = mcm_profile_store_new ();
+	g_signal_connect (store, "scan-progress", G_CALLBACK (mcm_test_profile_store_scan_progress_cb), NULL);
+	g_signal_connect (store, "scan-complete", G_CALLBACK (mcm_test_profile_store_scan_complete_cb), NULL);
+	_store_loop = g_main_loop_new (NULL, FALSE);
+
+	/* a cancelled search still completes */
+	cancellable = g_cancellable_new ();
+	g_cancellable_cancel (cancellable);
+	mcm_profile_store_search_default_async (store, cancellable,
+						(GAsyncReadyCallback) mcm_test_profile_store_search_cb, &error);
+	g_main_loop_run (_store_loop);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+	g_assert_cmpint (_store_complete, ==, 1);
+	g_clear_error (&error);
+	g_object_unref (cancellable);
+
+	/* search the system */
+	mcm_profile_store_search_default_async (store, NULL,
+						(GAsyncReadyCallback) mcm_test_profile_store_search_cb, &error);
+	g_main_loop_run (_store_loop);
+	g_assert_no_error (error);
+	g_assert_cmpint (_store_complete, ==, 2);
+	g_assert_cmpint (_store_progress, ==, 100);
+
+	g_main_loop_unref (_store_loop);
+	g_object_unref (store);
+}
+
+static void
+mcm_test_profile_index_func (void)
+{
+	gboolean ret;
+	gchar *data;
+	gsize length;
+	gchar *filename;
+	GError *error = NULL;
+	GFile *file;
+	McmProfile *profile;
+	McmProfile *profile_tmp;
+	McmProfileIndex *profile_index;
+	GVariant *value;
+	const gchar *index_filename = "/tmp/mcm-self-test-profiles.index";
+	const gchar *profile_filename = "/tmp/mcm-self-test-profile.icc";
+
+	/* use a copy we can change */
+	filename = mcm_test_get_data_file ("bluish.icc");
+	ret = g_file_get_contents (filename, &data, &length, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = g_file_set_contents (profile_filename, data, length, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	profile = mcm_profile_default_new ();
+	file = g_file_new_for_path (profile_filename);
+	ret = mcm_profile_parse (profile, file, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (file);
+
+	/* save the metadata */
+	profile_index = mcm_profile_index_new ();
+	g_assert (mcm_profile_index_lookup (profile_index, profile_filename) == NULL);
+	mcm_profile_index_add (profile_index, profile);
+	ret = mcm_profile_index_save (profile_index, index_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	mcm_profile_index_free (profile_index);
+
+	/* get it back without parsing */
+	profile_index = mcm_profile_index_new ();
+	ret = mcm_profile_index_load (profile_index, index_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	profile_tmp = mcm_profile_index_lookup (profile_index, profile_filename);
+	g_assert (profile_tmp != NULL);
+	g_assert_cmpstr (mcm_profile_get_filename (profile_tmp), ==, profile_filename);
+	g_assert_cmpstr (mcm_profile_get_description (profile_tmp), ==, mcm_profile_get_description (profile));
+	g_assert_cmpstr (mcm_profile_get_copyright (profile_tmp), ==, mcm_profile_get_copyright (profile));
+	g_assert_cmpstr (mcm_profile_get_id (profile_tmp), ==, mcm_profile_get_id (profile));
+	g_assert_cmpint (mcm_profile_get_kind (profile_tmp), ==, mcm_profile_get_kind (profile));
+	g_assert_cmpint (mcm_profile_get_colorspace (profile_tmp), ==, mcm_profile_get_colorspace (profile));
+	g_assert_cmpint (mcm_profile_get_has_vcgt (profile_tmp), ==, mcm_profile_get_has_vcgt (profile));
+	g_assert_cmpint (mcm_profile_get_size (profile_tmp), ==, length);
+	g_object_unref (profile_tmp);
+
+	/* send it to another process */
+	value = g_variant_ref_sink (mcm_profile_get_variant (profile));
+	g_assert_cmpstr (g_variant_get_type_string (value), ==, MCM_PROFILE_VARIANT_TYPE);
+	profile_tmp = mcm_profile_default_new ();
+	ret = mcm_profile_set_from_variant (profile_tmp, value);
+	g_assert (ret);
+	g_assert (mcm_profile_get_lightweight (profile_tmp));
+	g_assert_cmpstr (mcm_profile_get_filename (profile_tmp), ==, profile_filename);
+	g_assert_cmpstr (mcm_profile_get_description (profile_tmp), ==, mcm_profile_get_description (profile));
+	g_assert_cmpstr (mcm_profile_get_id (profile_tmp), ==, mcm_profile_get_id (profile));
+	g_assert_cmpint (mcm_profile_get_kind (profile_tmp), ==, mcm_profile_get_kind (profile));
+	g_assert_cmpint (mcm_profile_get_colorspace (profile_tmp), ==, mcm_profile_get_colorspace (profile));
+	g_assert_cmpint (mcm_profile_get_has_vcgt (profile_tmp), ==, mcm_profile_get_has_vcgt (profile));
+	g_assert_cmpint (mcm_profile_get_size (profile_tmp), ==, length);
+	g_object_unref (profile_tmp);
+	g_variant_unref (value);
+
+	/* the file changed, so it has to be parsed again */
+	ret = g_file_set_contents (profile_filename, data, length - 1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (mcm_profile_index_lookup (profile_index, profile_filename) == NULL);
+	mcm_profile_index_free (profile_index);
+
+	g_object_unref (profile);
+	g_unlink (index_filename);
+	g_unlink (profile_filename);
+	g_free (filename);
+	g_free (data);
+}
+
+static void
+mcm_test_scan_budget_func (void)
+{
+	McmScanBudget *budget;
+
+	/* out of reads */
+	budget = mcm_scan_budget_new (10.0f, 3);
+	g_assert (mcm_scan_budget_spend (budget));
+	g_assert (mcm_scan_budget_spend (budget));
+	g_assert (mcm_scan_budget_spend (budget));
+	g_assert (!mcm_scan_budget_is_expired (budget));
+	g_assert (!mcm_scan_budget_spend (budget));
+	g_assert (mcm_scan_budget_is_expired (budget));
+	g_assert_cmpint (mcm_scan_budget_get_reads (budget), ==, 4);
+	mcm_scan_budget_free (budget);
+
+	/* out of time */
+	budget = mcm_scan_budget_new (0.01f, 1000);
+	g_usleep (20 * 1000);
+	g_assert (!mcm_scan_budget_spend (budget));
+	g_assert (mcm_scan_budget_is_expired (budget));
+	mcm_scan_budget_free (budget);
+
+	/* given up on by the watchdog */
+	budget = mcm_scan_budget_new (10.0f, 1000);
+	g_assert (mcm_scan_budget_spend (budget));
+	mcm_scan_budget_expire (budget);
+	g_assert (mcm_scan_budget_is_expired (budget));
+	g_assert (!mcm_scan_budget_spend (budget));
+	mcm_scan_budget_free (budget);
+}
+
+static void
+mcm_test_volume_cache_func (void)
+{
+	gint retval;
+	guint64 mtime;
+	struct stat buf;
+	GPtrArray *directories;
+	GArray *mtimes;
+	GPtrArray *missing;
+	GPtrArray *filenames;
+	McmVolumeCache *cache;
+	const gchar *root = "/tmp/mcm-self-test-volume";
+	const gchar *found = "/tmp/mcm-self-test-volume/Library";
+	const gchar *created = "/tmp/mcm-self-test-volume/Windows/System/Color";
+
+	/* one directory that was walked, and one that was not there */
+	g_mkdir_with_parents (found, 0700);
+	retval = g_stat (found, &buf);
+	g_assert_cmpint (retval, ==, 0);
+	mtime = buf.st_mtime;
+	directories = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (directories, g_strdup (found));
+	mtimes = g_array_new (FALSE, FALSE, sizeof (guint64));
+	g_array_append_val (mtimes, mtime);
+	missing = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (missing, g_strdup (created));
+	filenames = g_ptr_array_new_with_free_func (g_free);
+	cache = mcm_volume_cache_new (root, directories, mtimes, missing, filenames);
+	g_ptr_array_unref (directories);
+	g_array_unref (mtimes);
+	g_ptr_array_unref (missing);
+	g_ptr_array_unref (filenames);
+
+	/* nothing changed */
+	g_assert (mcm_volume_cache_is_valid (cache, root));
+
+	/* mounted somewhere else */
+	g_assert (!mcm_volume_cache_is_valid (cache, "/tmp"));
+
+	/* a profile directory was created that did not exist before */
+	g_mkdir_with_parents (created, 0700);
+	g_assert (!mcm_volume_cache_is_valid (cache, root));
+	g_rmdir (created);
+	g_rmdir ("/tmp/mcm-self-test-volume/Windows/System");
+	g_rmdir ("/tmp/mcm-self-test-volume/Windows");
+	g_assert (mcm_volume_cache_is_valid (cache, root));
+
+	/* a walked directory was removed */
+	g_rmdir (found);
+	g_assert (!mcm_volume_cache_is_valid (cache, root));
+
+	mcm_volume_cache_free (cache);
+	g_rmdir (root);
 }
 
 static void
@@ -909,6 +1683,8 @@ mcm_test_profile_store_func (void)
 	McmProfile *profile;
 	gboolean ret;
 	gchar *filename;
+	guint i;
+	guint displays = 0;
 
 	store = mcm_profile_store_new ();
 	g_assert (store != NULL);
@@ -929,10 +1705,29 @@ mcm_test_profile_store_func (void)
 	g_assert_cmpstr (mcm_profile_get_checksum (profile), ==, "8e2aed5dac6f8b5d8da75610a65b7f27");
 	g_object_unref (profile);
 
+	/* profile does exist by content identity */
+	profile = mcm_profile_store_get_by_id (store, "hash-479fbe97b5467046-3966");
+	g_assert (profile != NULL);
+	g_assert_cmpstr (mcm_profile_get_checksum (profile), ==, "8e2aed5dac6f8b5d8da75610a65b7f27");
+	g_object_unref (profile);
+
 	/* get array of profiles */
 	array = mcm_profile_store_get_array (store);
 	g_assert (array != NULL);
 	g_assert_cmpint (array->len, ==, 3);
+	for (i=0; i<array->len; i++) {
+		profile = g_ptr_array_index (array, i);
+		if (mcm_profile_get_kind (profile) == MCM_PROFILE_KIND_DISPLAY_DEVICE)
+			displays++;
+	}
+	g_ptr_array_unref (array);
+
+	/* the same profiles by kind */
+	array = mcm_profile_store_get_by_kind (store, MCM_PROFILE_KIND_DISPLAY_DEVICE, MCM_COLORSPACE_UNKNOWN);
+	g_assert_cmpint (array->len, ==, displays);
+	g_ptr_array_unref (array);
+	array = mcm_profile_store_get_by_kind (store, MCM_PROFILE_KIND_ABSTRACT, MCM_COLORSPACE_RGB);
+	g_assert_cmpint (array->len, ==, 0);
 	g_ptr_array_unref (array);
 
 	g_object_unref (store);
@@ -968,6 +1763,176 @@ mcm_test_tables_func (void)
 	g_object_unref (tables);
 }
 
+static void
+mcm_test_tag_index_func (void)
+{
+	gchar *filename;
+	gchar *data = NULL;
+	gsize length;
+	gboolean ret;
+	guint32 size;
+	const guint8 *tag_data;
+	GError *error = NULL;
+	McmTagIndex *tag_index;
+
+	filename = mcm_test_get_data_file ("bluish.icc");
+	ret = g_file_get_contents (filename, &data, &length, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	tag_index = mcm_tag_index_new ((const guint8 *) data, length, &error);
+	g_assert_no_error (error);
+	g_assert (tag_index != NULL);
+	g_assert_cmpint (mcm_tag_index_get_size (tag_index), >, 0);
+
+	/* 'desc' is present and inside the buffer */
+	tag_data = mcm_tag_index_get_data (tag_index, 0x64657363, &size);
+	g_assert (tag_data != NULL);
+	g_assert_cmpint ((tag_data - (const guint8 *) data) + size, <=, length);
+
+	/* not present */
+	tag_data = mcm_tag_index_get_data (tag_index, 0x12345678, NULL);
+	g_assert (tag_data == NULL);
+	mcm_tag_index_free (tag_index);
+
+	/* tag table does not fit */
+	tag_index = mcm_tag_index_new ((const guint8 *) data, 0x90, &error);
+	g_assert (error != NULL);
+	g_assert (tag_index == NULL);
+	g_clear_error (&error);
+
+	g_free (data);
+	g_free (filename);
+}
+
+static void
+mcm_test_transform_cache_func (void)
+{
+	guint hits;
+	guint misses;
+	gsize size;
+	guint8 rgb[3] = { 0xff, 0xff, 0xff };
+	gdouble xyz[3];
+	McmTransform *transform;
+	McmTransform *transform_tmp;
+
+	mcm_transform_cache_clear ();
+
+	/* create */
+	transform = mcm_transform_cache_get (MCM_TRANSFORM_CACHE_ID_SRGB, mcm_transform_cache_open_builtin, (gpointer) MCM_TRANSFORM_CACHE_ID_SRGB,
+					     MCM_TRANSFORM_CACHE_ID_XYZ, mcm_transform_cache_open_builtin, (gpointer) MCM_TRANSFORM_CACHE_ID_XYZ,
+					     TYPE_RGB_8, TYPE_XYZ_DBL, INTENT_PERCEPTUAL, 0);
+	g_assert (transform != NULL);
+	mcm_transform_do_transform (transform, rgb, xyz, 1);
+	g_assert_cmpfloat (fabs (xyz[1] - 1.0f), <, 0.01f);
+	mcm_transform_cache_get_stats (&hits, &misses, &size);
+	g_assert_cmpint (hits, ==, 0);
+	g_assert_cmpint (misses, ==, 1);
+	g_assert_cmpint (size, >, 0);
+
+	/* get the same one again */
+	transform_tmp = mcm_transform_cache_get (MCM_TRANSFORM_CACHE_ID_SRGB, mcm_transform_cache_open_builtin, (gpointer) MCM_TRANSFORM_CACHE_ID_SRGB,
+						 MCM_TRANSFORM_CACHE_ID_XYZ, mcm_transform_cache_open_builtin, (gpointer) MCM_TRANSFORM_CACHE_ID_XYZ,
+						 TYPE_RGB_8, TYPE_XYZ_DBL, INTENT_PERCEPTUAL, 0);
+	g_assert (transform_tmp == transform);
+	mcm_transform_cache_get_stats (&hits, &misses, NULL);
+	g_assert_cmpint (hits, ==, 1);
+	g_assert_cmpint (misses, ==, 1);
+	mcm_transform_unref (transform_tmp);
+
+	/* evict everything, but we can still use our reference */
+	mcm_transform_cache_set_max_size (0);
+	mcm_transform_cache_get_stats (NULL, NULL, &size);
+	g_assert_cmpint (size, ==, 0);
+	mcm_transform_do_transform (transform, rgb, xyz, 1);
+	mcm_transform_unref (transform);
+
+	/* has to be created again */
+	transform = mcm_transform_cache_get (MCM_TRANSFORM_CACHE_ID_SRGB, mcm_transform_cache_open_builtin, (gpointer) MCM_TRANSFORM_CACHE_ID_SRGB,
+					     MCM_TRANSFORM_CACHE_ID_XYZ, mcm_transform_cache_open_builtin, (gpointer) MCM_TRANSFORM_CACHE_ID_XYZ,
+					     TYPE_RGB_8, TYPE_XYZ_DBL, INTENT_PERCEPTUAL, 0);
+	g_assert (transform != NULL);
+	mcm_transform_cache_get_stats (&hits, &misses, NULL);
+	g_assert_cmpint (misses, ==, 2);
+	mcm_transform_unref (transform);
+
+	mcm_transform_cache_set_max_size (8 * 1024 * 1024);
+	mcm_transform_cache_clear ();
+}
+
+static void
+mcm_test_trc_func (void)
+{
+	gboolean ret;
+	gchar *filename;
+	GError *error = NULL;
+	GFile *file;
+	GPtrArray *array;
+	McmClut *clut;
+	McmClutData *data;
+	McmProfile *profile;
+	McmTrc *trc;
+	gfloat in[3] = { 0.0f, 0.5f, 1.0f };
+	gfloat out[3];
+	const guint8 curv_gamma[] = { 'c', 'u', 'r', 'v', 0x00, 0x00, 0x00, 0x00,
+				      0x00, 0x00, 0x00, 0x01, 0x02, 0x33 };
+	const guint8 para_srgb[] = { 'p', 'a', 'r', 'a', 0x00, 0x00, 0x00, 0x00,
+				     0x00, 0x03, 0x00, 0x00,
+				     0x00, 0x02, 0x66, 0x66, 0x00, 0x00, 0xf2, 0xa7,
+				     0x00, 0x00, 0x0d, 0x59, 0x00, 0x00, 0x13, 0xd0,
+				     0x00, 0x00, 0x0a, 0x5b };
+
+	/* simple gamma */
+	trc = mcm_trc_new_from_data (curv_gamma, sizeof (curv_gamma), &error);
+	g_assert_no_error (error);
+	g_assert (trc != NULL);
+	mcm_trc_evaluate (trc, in, out, 3);
+	g_assert_cmpfloat (out[0], <, 0.001f);
+	g_assert_cmpfloat (fabs (out[1] - 0.2177f), <, 0.001f);
+	g_assert_cmpfloat (fabs (out[2] - 1.0f), <, 0.001f);
+	mcm_trc_free (trc);
+
+	/* sRGB parametric curve */
+	trc = mcm_trc_new_from_data (para_srgb, sizeof (para_srgb), &error);
+	g_assert_no_error (error);
+	g_assert (trc != NULL);
+	mcm_trc_evaluate (trc, in, out, 3);
+	g_assert_cmpfloat (out[0], <, 0.001f);
+	g_assert_cmpfloat (fabs (out[1] - 0.2140f), <, 0.001f);
+	g_assert_cmpfloat (fabs (out[2] - 1.0f), <, 0.001f);
+	mcm_trc_free (trc);
+
+	/* truncated */
+	trc = mcm_trc_new_from_data (para_srgb, 20, &error);
+	g_assert (trc == NULL);
+	g_assert (error != NULL);
+	g_clear_error (&error);
+
+	/* a matrix/TRC profile close to sRGB gives a straight line */
+	filename = mcm_test_get_data_file ("bluish.icc");
+	file = g_file_new_for_path (filename);
+	profile = mcm_profile_default_new ();
+	ret = mcm_profile_parse (profile, file, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	clut = mcm_profile_generate_curve (profile, 1024);
+	g_assert (clut != NULL);
+	g_object_set (clut, "gamma", 1.0, NULL);
+	array = mcm_clut_get_array (clut);
+	g_assert_cmpint (array->len, ==, 1024);
+	data = g_ptr_array_index (array, 0);
+	g_assert_cmpint (data->red, <, 0x100);
+	data = g_ptr_array_index (array, 512);
+	g_assert_cmpint (ABS ((gint) data->green - 0x8020), <, 0x200);
+	data = g_ptr_array_index (array, 1023);
+	g_assert_cmpint (data->blue, >, 0xff00);
+	g_ptr_array_unref (array);
+	g_object_unref (clut);
+	g_object_unref (profile);
+	g_object_unref (file);
+	g_free (filename);
+}
+
 static void
 mcm_test_trc_widget_func (void)
 {
@@ -1053,6 +2018,20 @@ mcm_test_utils_func (void)
 	g_object_unref (file);
 	g_free (filename);
 
+	/* detected from the header, not the name */
+	filename = mcm_test_get_data_file ("bluish.icc");
+	ret = mcm_utils_is_icc_profile_filename (filename);
+	g_assert (ret);
+	g_free (filename);
+	filename = mcm_test_get_data_file ("test.png");
+	ret = mcm_utils_is_icc_profile_filename (filename);
+	g_assert (!ret);
+	g_free (filename);
+	filename = mcm_test_get_data_file (".");
+	ret = mcm_utils_is_icc_profile_filename (filename);
+	g_assert (!ret);
+	g_free (filename);
+
 	ret = mcm_utils_output_is_lcd_internal ("LVDS1");
 	g_assert (ret);
 
@@ -1131,6 +2110,9 @@ mcm_test_client_func (void)
 	gboolean ret;
 	GPtrArray *array;
 	McmDevice *device;
+	McmDevice *device_old;
+	McmDevice *device_new;
+	McmDevice *device_tmp;
 	gchar *contents;
 	gchar *filename;
 	gchar *icc_filename;
@@ -1219,6 +2201,39 @@ mcm_test_client_func (void)
 
 	g_assert_cmpstr (data, ==, "");
 
+	/* a monitor on VGA1 */
+	device_old = mcm_device_xrandr_new ();
+	g_object_set (device_old, "id", "xrandr_goldstar", "native-device", "VGA1", "connected", TRUE, NULL);
+	ret = mcm_client_add_device (client, device_old, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	device_tmp = mcm_client_get_device_by_output_name (client, "VGA1");
+	g_assert (device_tmp == device_old);
+	g_object_unref (device_tmp);
+
+	/* swapped for a different one, so the old one must not be used */
+	mcm_device_set_connected (device_old, FALSE);
+	g_assert (mcm_client_get_device_by_output_name (client, "VGA1") == NULL);
+	device_new = mcm_device_xrandr_new ();
+	g_object_set (device_new, "id", "xrandr_hitachi", "native-device", "VGA1", "connected", TRUE, NULL);
+	ret = mcm_client_add_device (client, device_new, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	device_tmp = mcm_client_get_device_by_output_name (client, "VGA1");
+	g_assert (device_tmp == device_new);
+	g_object_unref (device_tmp);
+
+	/* don't save these */
+	mcm_device_set_connected (device_new, FALSE);
+	ret = mcm_client_remove_device (client, device_old, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = mcm_client_remove_device (client, device_new, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (device_old);
+	g_object_unref (device_new);
+
 	g_object_unref (client);
 	g_object_unref (device);
 	g_unlink (filename);
@@ -1243,10 +2258,24 @@ main (int argc, char **argv)
 	g_test_add_func ("/color/edid", mcm_test_edid_func);
 	g_test_add_func ("/color/exif", mcm_test_exif_func);
 	g_test_add_func ("/color/tables", mcm_test_tables_func);
+	g_test_add_func ("/color/tag_index", mcm_test_tag_index_func);
+	g_test_add_func ("/color/transform_cache", mcm_test_transform_cache_func);
+	g_test_add_func ("/color/trc_curve", mcm_test_trc_func);
 	g_test_add_func ("/color/utils", mcm_test_utils_func);
 	g_test_add_func ("/color/device", mcm_test_device_func);
 	g_test_add_func ("/color/profile", mcm_test_profile_func);
+	g_test_add_func ("/color/profile_many", mcm_test_profile_many_func);
 	g_test_add_func ("/color/profile_store", mcm_test_profile_store_func);
+	g_test_add_func ("/color/profile_index", mcm_test_profile_index_func);
+	g_test_add_func ("/color/scan_budget", mcm_test_scan_budget_func);
+	g_test_add_func ("/color/volume_cache", mcm_test_volume_cache_func);
+	g_test_add_func ("/color/profile_store_batch", mcm_test_profile_store_batch_func);
+	g_test_add_func ("/color/profile_store_async", mcm_test_profile_store_async_func);
+	g_test_add_func ("/color/ramp", mcm_test_ramp_func);
+	g_test_add_func ("/color/resample", mcm_test_resample_func);
+	g_test_add_func ("/color/ramp-cache", mcm_test_ramp_cache_func);
+	g_test_add_func ("/color/output-index", mcm_test_output_index_func);
+	g_test_add_func ("/color/output-state", mcm_test_output_state_func);
 	g_test_add_func ("/color/clut", mcm_test_clut_func);
 	g_test_add_func ("/color/xyz", mcm_test_xyz_func);
 	g_test_add_func ("/color/calibrate_dialog", mcm_test_calibrate_dialog_func);
@@ -1256,6 +2285,7 @@ main (int argc, char **argv)
 		g_test_add_func ("/color/cie", mcm_test_cie_widget_func);
 		g_test_add_func ("/color/gamma_widget", mcm_test_gamma_widget_func);
 		g_test_add_func ("/color/image", mcm_test_image_func);
+		g_test_add_func ("/color/profile_fuzz", mcm_test_profile_fuzz_func);
 	}
 	if (g_test_slow ()) {
 		g_test_add_func ("/color/print", mcm_test_print_func);
@@ -42,9 +42,20 @@ static McmClient *client = NULL;
 static McmProfileStore *profile_store = NULL;
 static GTimer *timer = NULL;
 static GDBusConnection *connection = NULL;
+static GPtrArray *catalogue_changes = NULL;
+static guint catalogue_serial = 0;
+static GHashTable *catalogue_clients = NULL;
 
 #define MCM_SESSION_IDLE_EXIT		60 /* seconds */
 #define MCM_SESSION_NOTIFY_TIMEOUT	30000 /* ms */
+#define MCM_SESSION_CATALOGUE_MAX_CHANGES	256
+
+/* one profile being added to or removed from the catalogue */
+typedef struct {
+	guint		 serial;
+	gchar		*id;
+	McmProfile	*profile;	/* NULL if removed */
+} McmSessionChange;
 
 /**
  * mcm_session_check_idle_cb:
@@ -54,6 +65,13 @@ mcm_session_check_idle_cb (gpointer user_data)
 {
 	guint idle;
 
+	/* clients that have the profiles rely on us to tell them about changes */
+	if (g_hash_table_size (catalogue_clients) > 0) {
+		egg_debug ("not idle as %i clients are attached", g_hash_table_size (catalogue_clients));
+		g_timer_reset (timer);
+		return TRUE;
+	}
+
 	/* get the idle time */
 	idle = (guint) g_timer_elapsed (timer, NULL);
 	egg_debug ("we've been idle for %is", idle);
@@ -248,33 +266,13 @@ out:
 static GPtrArray *
 mcm_session_get_profiles_for_kind (McmDeviceKind kind, GError **error)
 {
-	guint i;
-	McmProfile *profile;
 	McmProfileKind profile_kind;
-	McmProfileKind kind_tmp;
-	GPtrArray *array;
-	GPtrArray *profile_array;
-
-	/* create a temp array */
-	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 
 	/* get the correct profile kind for the device kind */
 	profile_kind = mcm_utils_device_kind_to_profile_kind (kind);
 
-	/* get list */
-	profile_array = mcm_profile_store_get_array (profile_store);
-	for (i=0; i<profile_array->len; i++) {
-		profile = g_ptr_array_index (profile_array, i);
-
-		/* compare what we have against what we were given */
-		kind_tmp = mcm_profile_get_kind (profile);
-		if (kind_tmp == profile_kind)
-			g_ptr_array_add (array, g_object_ref (profile));
-	}
-
-	/* unref profile list */
-	g_ptr_array_unref (profile_array);
-	return array;
+	/* the store keeps these by kind already */
+	return mcm_profile_store_get_by_kind (profile_store, profile_kind, MCM_COLORSPACE_UNKNOWN);
 }
 
 /**
@@ -304,6 +302,207 @@ mcm_session_variant_from_profile_array (GPtrArray *array)
 	return value;
 }
 
+/**
+ * mcm_session_change_free:
+ **/
+static void
+mcm_session_change_free (McmSessionChange *change)
+{
+	g_free (change->id);
+	if (change->profile != NULL)
+		g_object_unref (change->profile);
+	g_free (change);
+}
+
+/**
+ * mcm_session_add_change:
+ *
+ * Records a change to the profile catalogue so that attached clients can
+ * ask for just the changes since the last time they looked.
+ **/
+static void
+mcm_session_add_change (McmProfile *profile, gboolean added)
+{
+	McmSessionChange *change;
+	const gchar *id;
+
+	id = mcm_profile_get_id (profile);
+	if (id == NULL)
+		return;
+
+	change = g_new0 (McmSessionChange, 1);
+	change->serial = ++catalogue_serial;
+	change->id = g_strdup (id);
+	if (added)
+		change->profile = g_object_ref (profile);
+	g_ptr_array_add (catalogue_changes, change);
+
+	/* clients further behind than this get the whole catalogue again */
+	if (catalogue_changes->len > MCM_SESSION_CATALOGUE_MAX_CHANGES)
+		g_ptr_array_remove_range (catalogue_changes, 0,
+					  catalogue_changes->len - MCM_SESSION_CATALOGUE_MAX_CHANGES);
+}
+
+/**
+ * mcm_session_profile_store_added_cb:
+ **/
+static void
+mcm_session_profile_store_added_cb (McmProfileStore *profile_store_, McmProfile *profile, gpointer user_data)
+{
+	mcm_session_add_change (profile, TRUE);
+}
+
+/**
+ * mcm_session_profile_store_removed_cb:
+ **/
+static void
+mcm_session_profile_store_removed_cb (McmProfileStore *profile_store_, McmProfile *profile, gpointer user_data)
+{
+	mcm_session_add_change (profile, FALSE);
+}
+
+/**
+ * mcm_session_add_catalogue_profile:
+ **/
+static void
+mcm_session_add_catalogue_profile (GVariantBuilder *builder, McmProfile *profile)
+{
+	/* deleted, but not yet removed from the store */
+	if (mcm_profile_get_filename (profile) == NULL)
+		return;
+	g_variant_builder_add_value (builder, mcm_profile_get_variant (profile));
+}
+
+/**
+ * mcm_session_get_catalogue:
+ *
+ * Return value: all the profiles in the store, as 'a(sssssssssubb)'
+ **/
+static GVariant *
+mcm_session_get_catalogue (void)
+{
+	guint i;
+	GPtrArray *array;
+	GVariantBuilder *builder;
+	GVariant *value;
+
+	builder = g_variant_builder_new (G_VARIANT_TYPE ("a" MCM_PROFILE_VARIANT_TYPE));
+	array = mcm_profile_store_get_array (profile_store);
+	for (i=0; i<array->len; i++)
+		mcm_session_add_catalogue_profile (builder, g_ptr_array_index (array, i));
+	g_ptr_array_unref (array);
+
+	value = g_variant_builder_end (builder);
+	g_variant_builder_unref (builder);
+	return value;
+}
+
+/**
+ * mcm_session_unwatch_client:
+ **/
+static void
+mcm_session_unwatch_client (gpointer data)
+{
+	g_bus_unwatch_name (GPOINTER_TO_UINT (data));
+}
+
+/**
+ * mcm_session_client_vanished_cb:
+ **/
+static void
+mcm_session_client_vanished_cb (GDBusConnection *connection_, const gchar *name, gpointer user_data)
+{
+	egg_debug ("client %s detached", name);
+	g_hash_table_remove (catalogue_clients, name);
+}
+
+/**
+ * mcm_session_attach_client:
+ *
+ * Stay running while the client is there to be sent changes.
+ **/
+static void
+mcm_session_attach_client (GDBusConnection *connection_, const gchar *sender)
+{
+	guint watch_id;
+
+	if (sender == NULL || g_hash_table_lookup (catalogue_clients, sender) != NULL)
+		return;
+	egg_debug ("client %s attached", sender);
+	watch_id = g_bus_watch_name_on_connection (connection_, sender,
+						   G_BUS_NAME_WATCHER_FLAGS_NONE,
+						   NULL, mcm_session_client_vanished_cb,
+						   NULL, NULL);
+	g_hash_table_insert (catalogue_clients, g_strdup (sender), GUINT_TO_POINTER (watch_id));
+}
+
+/**
+ * mcm_session_get_catalogue_changes:
+ *
+ * Return value: the changes since @since, as '(ubasa(sssssssssubb))'
+ **/
+static GVariant *
+mcm_session_get_catalogue_changes (guint since)
+{
+	guint i;
+	guint oldest;
+	gboolean reset;
+	GHashTable *hash;
+	GHashTableIter iter;
+	McmSessionChange *change;
+	GVariantBuilder *removed;
+	GVariantBuilder *added;
+	GVariant *value;
+
+	/* the oldest serial we can still work forwards from */
+	oldest = catalogue_serial;
+	if (catalogue_changes->len > 0) {
+		change = g_ptr_array_index (catalogue_changes, 0);
+		oldest = change->serial - 1;
+	}
+
+	/* the client is too far behind, or this daemon has been restarted */
+	reset = (since < oldest || since > catalogue_serial);
+	if (reset) {
+		egg_debug ("sending all profiles for serial %u", since);
+		removed = g_variant_builder_new (G_VARIANT_TYPE ("as"));
+		value = g_variant_new ("(ub@as@a" MCM_PROFILE_VARIANT_TYPE ")",
+				       catalogue_serial, TRUE,
+				       g_variant_builder_end (removed),
+				       mcm_session_get_catalogue ());
+		g_variant_builder_unref (removed);
+		return value;
+	}
+
+	/* only the last change for each profile matters */
+	hash = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i=0; i<catalogue_changes->len; i++) {
+		change = g_ptr_array_index (catalogue_changes, i);
+		if (change->serial > since)
+			g_hash_table_insert (hash, change->id, change);
+	}
+
+	removed = g_variant_builder_new (G_VARIANT_TYPE ("as"));
+	added = g_variant_builder_new (G_VARIANT_TYPE ("a" MCM_PROFILE_VARIANT_TYPE));
+	g_hash_table_iter_init (&iter, hash);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &change)) {
+		if (change->profile == NULL)
+			g_variant_builder_add (removed, "s", change->id);
+		else
+			mcm_session_add_catalogue_profile (added, change->profile);
+	}
+	egg_debug ("sending %i changes since serial %u", g_hash_table_size (hash), since);
+
+	value = g_variant_new ("(ub@as@a" MCM_PROFILE_VARIANT_TYPE ")",
+			       catalogue_serial, FALSE,
+			       g_variant_builder_end (removed),
+			       g_variant_builder_end (added));
+	g_variant_builder_unref (removed);
+	g_variant_builder_unref (added);
+	g_hash_table_destroy (hash);
+	return value;
+}
+
 /**
  * mcm_session_get_profiles_for_file:
  **/
@@ -429,6 +628,25 @@ mcm_session_handle_method_call (GDBusConnection *connection_, const gchar *sende
 	GError *error = NULL;
 	const gchar *profile_filename;
 	guint i;
+	guint since;
+
+	/* return '(ua(sssssssssubb))' */
+	if (g_strcmp0 (method_name, "GetProfiles") == 0) {
+		mcm_session_attach_client (connection_, sender);
+		g_dbus_method_invocation_return_value (invocation,
+						       g_variant_new ("(u@a" MCM_PROFILE_VARIANT_TYPE ")",
+								      catalogue_serial,
+								      mcm_session_get_catalogue ()));
+		goto out;
+	}
+
+	/* return '(ubasa(sssssssssubb))' */
+	if (g_strcmp0 (method_name, "GetProfileChanges") == 0) {
+		g_variant_get (parameters, "(u)", &since);
+		g_dbus_method_invocation_return_value (invocation,
+						       mcm_session_get_catalogue_changes (since));
+		goto out;
+	}
 
 	/* return 'as' */
 	if (g_strcmp0 (method_name, "GetDevices") == 0) {
@@ -664,6 +882,50 @@ mcm_session_client_changed_cb (McmClient *client_, McmDevice *device, gpointer u
 	mcm_session_emit_changed ();
 }
 
+/**
+ * mcm_session_profile_store_changed_cb:
+ **/
+static void
+mcm_session_profile_store_changed_cb (McmProfileStore *profile_store_, gpointer user_data)
+{
+	/* attached clients ask for the changes */
+	mcm_session_emit_changed ();
+}
+
+/**
+ * mcm_session_outputs_changed_cb:
+ **/
+static void
+mcm_session_outputs_changed_cb (McmClient *client_, GPtrArray *devices, gpointer user_data)
+{
+	gboolean ret;
+	GError *error = NULL;
+
+	/* the X server resets the gamma when a crtc changes */
+	ret = mcm_device_xrandr_apply_array (devices, NULL, &error);
+	if (!ret) {
+		egg_warning ("failed to reapply outputs: %s", error->message);
+		g_error_free (error);
+	}
+}
+
+/**
+ * mcm_session_search_default_cb:
+ **/
+static void
+mcm_session_search_default_cb (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+	gboolean ret;
+	GError *error = NULL;
+
+	/* clients are told about each batch of profiles as it is added */
+	ret = mcm_profile_store_search_default_finish (profile_store, res, &error);
+	if (!ret && error != NULL) {
+		egg_warning ("failed to search for profiles: %s", error->message);
+		g_error_free (error);
+	}
+}
+
 /**
  * main:
  **/
@@ -720,9 +982,17 @@ main (int argc, char *argv[])
 	g_signal_connect (client, "added", G_CALLBACK (mcm_session_client_changed_cb), NULL);
 	g_signal_connect (client, "removed", G_CALLBACK (mcm_session_client_changed_cb), NULL);
 	g_signal_connect (client, "changed", G_CALLBACK (mcm_session_client_changed_cb), NULL);
+	g_signal_connect (client, "outputs-changed", G_CALLBACK (mcm_session_outputs_changed_cb), NULL);
 
-	/* have access to all profiles */
+	/* have access to all profiles, and share them with other processes */
 	profile_store = mcm_profile_store_new ();
+	catalogue_changes = g_ptr_array_new_with_free_func ((GDestroyNotify) mcm_session_change_free);
+	catalogue_serial = g_random_int_range (1, G_MAXINT32);
+	catalogue_clients = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+						   mcm_session_unwatch_client);
+	g_signal_connect (profile_store, "added", G_CALLBACK (mcm_session_profile_store_added_cb), NULL);
+	g_signal_connect (profile_store, "removed", G_CALLBACK (mcm_session_profile_store_removed_cb), NULL);
+	g_signal_connect (profile_store, "changed", G_CALLBACK (mcm_session_profile_store_changed_cb), NULL);
 	timer = g_timer_new ();
 
 	/* get all connected devices */
@@ -761,6 +1031,9 @@ main (int argc, char *argv[])
 				   mcm_session_on_name_lost,
 				   NULL, NULL);
 
+	/* find the profiles without delaying the bus name */
+	mcm_profile_store_search_default_async (profile_store, NULL, mcm_session_search_default_cb, NULL);
+
 	/* only timeout if we have specified it on the command line */
 	if (!no_timed_exit) {
 		poll_id = g_timeout_add_seconds (5, (GSourceFunc) mcm_session_check_idle_cb, NULL);
@@ -784,6 +1057,10 @@ out:
 		g_bus_unown_name (owner_id);
 	if (profile_store != NULL)
 		g_object_unref (profile_store);
+	if (catalogue_changes != NULL)
+		g_ptr_array_unref (catalogue_changes);
+	if (catalogue_clients != NULL)
+		g_hash_table_destroy (catalogue_clients);
 	if (timer != NULL)
 		g_timer_destroy (timer);
 	if (connection != NULL)
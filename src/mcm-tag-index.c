@@ -0,0 +1,220 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * SECTION:mcm-tag-index
+ * @short_description: A validated index of the tags in an ICC profile
+ *
+ * This decodes the tag table of an ICC profile once, drops any tag that does
+ * not fit inside the buffer, and sorts the rest by signature so that tags can
+ * be looked up with a binary search. Every tag returned is guaranteed to be
+ * inside the buffer, so the tag readers only have to check their own fields
+ * against the tag size.
+ *
+ * The index does not copy the profile data, so the buffer has to outlive it.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdlib.h>
+
+#include "mcm-tag-index.h"
+
+#include "egg-debug.h"
+
+#define MCM_TAG_INDEX_NUMTAGS		0x80
+#define MCM_TAG_INDEX_BODY		0x84
+#define MCM_TAG_INDEX_WIDTH		0x0c
+
+struct _McmTagIndex
+{
+	const guint8		*data;
+	gsize			 length;
+	McmTagIndexEntry	*entries;
+	guint			 size;
+};
+
+/**
+ * mcm_tag_index_decode_32:
+ **/
+static guint32
+mcm_tag_index_decode_32 (const guint8 *data)
+{
+	return ((guint32) data[0] << 24) | ((guint32) data[1] << 16) | ((guint32) data[2] << 8) | (guint32) data[3];
+}
+
+/**
+ * mcm_tag_index_compare_entry:
+ **/
+static gint
+mcm_tag_index_compare_entry (const void *a, const void *b)
+{
+	const McmTagIndexEntry *entry_a = a;
+	const McmTagIndexEntry *entry_b = b;
+
+	if (entry_a->signature < entry_b->signature)
+		return -1;
+	if (entry_a->signature > entry_b->signature)
+		return 1;
+
+	/* keep the directory order for duplicate tags */
+	if (entry_a->offset < entry_b->offset)
+		return -1;
+	if (entry_a->offset > entry_b->offset)
+		return 1;
+	return 0;
+}
+
+/**
+ * mcm_tag_index_new:
+ * @data: the ICC profile data
+ * @length: the size of @data
+ * @error: a #GError, or %NULL
+ *
+ * Return value: a new index, or %NULL if the tag table does not fit in the
+ * buffer. Free with mcm_tag_index_free()
+ **/
+McmTagIndex *
+mcm_tag_index_new (const guint8 *data, gsize length, GError **error)
+{
+	guint i;
+	guint32 num_tags;
+	const guint8 *entry;
+	McmTagIndexEntry *tmp;
+	McmTagIndex *tag_index = NULL;
+
+	g_return_val_if_fail (data != NULL, NULL);
+
+	/* we need at least the header and the tag count */
+	if (length < MCM_TAG_INDEX_BODY) {
+		g_set_error (error, 1, 0, "profile too small: %" G_GSIZE_FORMAT " bytes", length);
+		goto out;
+	}
+
+	/* check the tag table itself fits */
+	num_tags = mcm_tag_index_decode_32 (data + MCM_TAG_INDEX_NUMTAGS);
+	if (num_tags > (length - MCM_TAG_INDEX_BODY) / MCM_TAG_INDEX_WIDTH) {
+		g_set_error (error, 1, 0, "tag table with %u entries does not fit in %" G_GSIZE_FORMAT " bytes", num_tags, length);
+		goto out;
+	}
+
+	tag_index = g_new0 (McmTagIndex, 1);
+	tag_index->data = data;
+	tag_index->length = length;
+	tag_index->entries = g_new0 (McmTagIndexEntry, num_tags);
+
+	/* copy out all the tags that are inside the buffer */
+	for (i=0; i<num_tags; i++) {
+		entry = data + MCM_TAG_INDEX_BODY + (i * MCM_TAG_INDEX_WIDTH);
+		tmp = &tag_index->entries[tag_index->size];
+		tmp->signature = mcm_tag_index_decode_32 (entry + 0x00);
+		tmp->offset = mcm_tag_index_decode_32 (entry + 0x04);
+		tmp->size = mcm_tag_index_decode_32 (entry + 0x08);
+		if ((guint64) tmp->offset + (guint64) tmp->size > length) {
+			egg_warning ("ignoring tag %x at 0x%x with size %u, profile is only %" G_GSIZE_FORMAT " bytes",
+				     tmp->signature, tmp->offset, tmp->size, length);
+			continue;
+		}
+		tag_index->size++;
+	}
+
+	/* sort so we can bsearch */
+	qsort (tag_index->entries, tag_index->size, sizeof (McmTagIndexEntry), mcm_tag_index_compare_entry);
+out:
+	return tag_index;
+}
+
+/**
+ * mcm_tag_index_free:
+ **/
+void
+mcm_tag_index_free (McmTagIndex *tag_index)
+{
+	if (tag_index == NULL)
+		return;
+	g_free (tag_index->entries);
+	g_free (tag_index);
+}
+
+/**
+ * mcm_tag_index_get_size:
+ *
+ * Return value: the number of valid tags in the index
+ **/
+guint
+mcm_tag_index_get_size (McmTagIndex *tag_index)
+{
+	g_return_val_if_fail (tag_index != NULL, 0);
+	return tag_index->size;
+}
+
+/**
+ * mcm_tag_index_get_entry:
+ *
+ * Return value: the entry for @signature, or %NULL if it is not present
+ **/
+const McmTagIndexEntry *
+mcm_tag_index_get_entry (McmTagIndex *tag_index, guint32 signature)
+{
+	guint low = 0;
+	guint high;
+	guint mid;
+	McmTagIndexEntry *entry;
+
+	g_return_val_if_fail (tag_index != NULL, NULL);
+
+	/* find the first entry with this signature */
+	high = tag_index->size;
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		entry = &tag_index->entries[mid];
+		if (entry->signature < signature)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (low < tag_index->size && tag_index->entries[low].signature == signature)
+		return &tag_index->entries[low];
+	return NULL;
+}
+
+/**
+ * mcm_tag_index_get_data:
+ * @tag_index: a #McmTagIndex
+ * @signature: the tag signature, e.g. icSigProfileDescriptionTag
+ * @size: the returned size of the tag data, or %NULL
+ *
+ * Return value: the tag data, which is guaranteed to be @size bytes long,
+ * or %NULL if the tag is not present
+ **/
+const guint8 *
+mcm_tag_index_get_data (McmTagIndex *tag_index, guint32 signature, guint32 *size)
+{
+	const McmTagIndexEntry *entry;
+
+	entry = mcm_tag_index_get_entry (tag_index, signature);
+	if (entry == NULL)
+		return NULL;
+	if (size != NULL)
+		*size = entry->size;
+	return tag_index->data + entry->offset;
+}
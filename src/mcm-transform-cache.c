@@ -0,0 +1,369 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * SECTION:mcm-transform-cache
+ * @short_description: A process-wide cache of lcms transforms
+ *
+ * Creating a lcms transform is expensive, as the whole pipeline is
+ * precalculated. Transforms are kept here keyed by the identity of both
+ * profiles, the formats, the intent and the flags, and the least recently
+ * used ones are freed when the cache gets too big.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#ifdef MCM_USE_LCMS2
+ #include <lcms2.h>
+#else
+ #include <lcms.h>
+#endif
+
+#include "egg-debug.h"
+
+#include "mcm-transform-cache.h"
+#include "mcm-utils.h"
+
+/* lcms does not tell us how much memory a transform uses, so estimate it
+ * from the default 33 point precalculated grid with 16 bit samples */
+#define MCM_TRANSFORM_CACHE_PRECALC_SIZE	(33 * 33 * 33 * 3 * 2)
+#define MCM_TRANSFORM_CACHE_NOPRECALC_SIZE	(4 * 1024)
+#define MCM_TRANSFORM_CACHE_MAX_SIZE_DEFAULT	(8 * 1024 * 1024)
+
+struct _McmTransform {
+	gint			 refcount;
+	gchar			*key;
+	gsize			 size;
+	cmsHTRANSFORM		 lcms_transform;
+};
+
+static GStaticMutex mcm_transform_cache_mutex = G_STATIC_MUTEX_INIT;
+static GHashTable *mcm_transform_cache_hash = NULL;	/* key:GList of McmTransform in lru */
+static GQueue mcm_transform_cache_lru = G_QUEUE_INIT;	/* most recently used first */
+static gsize mcm_transform_cache_size = 0;
+static gsize mcm_transform_cache_max_size = MCM_TRANSFORM_CACHE_MAX_SIZE_DEFAULT;
+static guint mcm_transform_cache_hits = 0;
+static guint mcm_transform_cache_misses = 0;
+
+/**
+ * mcm_transform_unref_locked:
+ *
+ * Called with the lcms lock and then the cache lock held.
+ **/
+static void
+mcm_transform_unref_locked (McmTransform *transform)
+{
+	if (--transform->refcount > 0)
+		return;
+	cmsDeleteTransform (transform->lcms_transform);
+	g_free (transform->key);
+	g_free (transform);
+}
+
+/**
+ * mcm_transform_unref:
+ * @transform: a #McmTransform
+ *
+ * Releases a transform returned by mcm_transform_cache_get(). The
+ * transform is only freed when it is also no longer in the cache.
+ **/
+void
+mcm_transform_unref (McmTransform *transform)
+{
+	g_return_if_fail (transform != NULL);
+	mcm_utils_lcms_lock ();
+	g_static_mutex_lock (&mcm_transform_cache_mutex);
+	mcm_transform_unref_locked (transform);
+	g_static_mutex_unlock (&mcm_transform_cache_mutex);
+	mcm_utils_lcms_unlock ();
+}
+
+/**
+ * mcm_transform_do_transform:
+ * @transform: a #McmTransform
+ * @input: the input pixels
+ * @output: the output pixels
+ * @size: the number of pixels
+ *
+ * A transform must not be used from two threads at the same time.
+ **/
+void
+mcm_transform_do_transform (McmTransform *transform, gconstpointer input, gpointer output, guint size)
+{
+	g_return_if_fail (transform != NULL);
+	mcm_utils_lcms_lock ();
+	cmsDoTransform (transform->lcms_transform, (gpointer) input, output, size);
+	mcm_utils_lcms_unlock ();
+}
+
+/**
+ * mcm_transform_cache_evict_locked:
+ *
+ * Removes the least recently used transforms until we are under @max_size.
+ **/
+static void
+mcm_transform_cache_evict_locked (gsize max_size)
+{
+	McmTransform *transform;
+
+	while (mcm_transform_cache_size > max_size) {
+		transform = g_queue_pop_tail (&mcm_transform_cache_lru);
+		if (transform == NULL)
+			break;
+		egg_debug ("evicting %s", transform->key);
+		g_hash_table_remove (mcm_transform_cache_hash, transform->key);
+		mcm_transform_cache_size -= transform->size;
+		mcm_transform_unref_locked (transform);
+	}
+}
+
+/**
+ * mcm_transform_cache_open:
+ **/
+static cmsHPROFILE
+mcm_transform_cache_open (McmTransformCacheOpenFunc func, gpointer user_data, gboolean *borrowed)
+{
+	*borrowed = FALSE;
+	return func (user_data, borrowed);
+}
+
+/**
+ * mcm_transform_cache_get:
+ * @input_id: a string that identifies the input profile, e.g. from mcm_profile_get_id()
+ * @input_func: a function that opens the input profile
+ * @input_data: data to pass to @input_func
+ * @output_id: a string that identifies the output profile
+ * @output_func: a function that opens the output profile
+ * @output_data: data to pass to @output_func
+ * @input_format: the lcms input format, e.g. %TYPE_RGB_8
+ * @output_format: the lcms output format
+ * @intent: the lcms rendering intent
+ * @flags: the lcms transform flags
+ *
+ * Gets a transform from the cache, or creates one. The profiles are only
+ * opened if the transform has to be created.
+ *
+ * Return value: a #McmTransform, or %NULL if it could not be created.
+ * Free with mcm_transform_unref()
+ **/
+McmTransform *
+mcm_transform_cache_get (const gchar *input_id, McmTransformCacheOpenFunc input_func, gpointer input_data,
+			 const gchar *output_id, McmTransformCacheOpenFunc output_func, gpointer output_data,
+			 guint32 input_format, guint32 output_format, guint intent, guint32 flags)
+{
+	gchar *key;
+	GList *link;
+	gboolean input_borrowed = FALSE;
+	gboolean output_borrowed = FALSE;
+	cmsHPROFILE input_profile = NULL;
+	cmsHPROFILE output_profile = NULL;
+	cmsHTRANSFORM lcms_transform;
+	McmTransform *transform = NULL;
+
+	g_return_val_if_fail (input_id != NULL, NULL);
+	g_return_val_if_fail (input_func != NULL, NULL);
+	g_return_val_if_fail (output_id != NULL, NULL);
+	g_return_val_if_fail (output_func != NULL, NULL);
+
+	key = g_strdup_printf ("%s|%s|%08x|%08x|%u|%08x",
+			       input_id, output_id, input_format, output_format, intent, flags);
+
+	/* always taken before the cache lock, as the open functions can lock */
+	mcm_utils_lcms_lock ();
+	g_static_mutex_lock (&mcm_transform_cache_mutex);
+	if (mcm_transform_cache_hash == NULL)
+		mcm_transform_cache_hash = g_hash_table_new (g_str_hash, g_str_equal);
+
+	/* move to the front of the list */
+	link = g_hash_table_lookup (mcm_transform_cache_hash, key);
+	if (link != NULL) {
+		mcm_transform_cache_hits++;
+		g_queue_unlink (&mcm_transform_cache_lru, link);
+		g_queue_push_head_link (&mcm_transform_cache_lru, link);
+		transform = link->data;
+		transform->refcount++;
+		goto out;
+	}
+	mcm_transform_cache_misses++;
+
+	/* open the profiles */
+	input_profile = mcm_transform_cache_open (input_func, input_data, &input_borrowed);
+	if (input_profile == NULL) {
+		egg_warning ("failed to open input profile %s", input_id);
+		goto out;
+	}
+	output_profile = mcm_transform_cache_open (output_func, output_data, &output_borrowed);
+	if (output_profile == NULL) {
+		egg_warning ("failed to open output profile %s", output_id);
+		goto out;
+	}
+
+	/* use the global context, as the profiles may have their own that go away */
+#ifdef MCM_USE_LCMS2
+	lcms_transform = cmsCreateTransformTHR (NULL, input_profile, input_format,
+						output_profile, output_format, intent, flags);
+#else
+	lcms_transform = cmsCreateTransform (input_profile, input_format,
+					     output_profile, output_format, intent, flags);
+#endif
+	if (lcms_transform == NULL) {
+		egg_warning ("failed to create transform %s", key);
+		goto out;
+	}
+
+	/* add to cache */
+	transform = g_new0 (McmTransform, 1);
+	transform->refcount = 2;
+	transform->key = key;
+	transform->lcms_transform = lcms_transform;
+	if ((flags & cmsFLAGS_NOTPRECALC) > 0 || T_BYTES (input_format) == 0 || T_BYTES (output_format) == 0)
+		transform->size = MCM_TRANSFORM_CACHE_NOPRECALC_SIZE;
+	else
+		transform->size = MCM_TRANSFORM_CACHE_PRECALC_SIZE;
+	g_queue_push_head (&mcm_transform_cache_lru, transform);
+	g_hash_table_insert (mcm_transform_cache_hash, transform->key, mcm_transform_cache_lru.head);
+	mcm_transform_cache_size += transform->size;
+	key = NULL;
+	egg_debug ("created %s, cache is now %" G_GSIZE_FORMAT " bytes", transform->key, mcm_transform_cache_size);
+
+	/* keep under the cap, but never evict what we just created */
+	if (mcm_transform_cache_size > mcm_transform_cache_max_size)
+		mcm_transform_cache_evict_locked (MAX (mcm_transform_cache_max_size, transform->size));
+out:
+	/* the transform does not need the profiles once created */
+	if (input_profile != NULL && !input_borrowed)
+		cmsCloseProfile (input_profile);
+	if (output_profile != NULL && !output_borrowed)
+		cmsCloseProfile (output_profile);
+	g_static_mutex_unlock (&mcm_transform_cache_mutex);
+	mcm_utils_lcms_unlock ();
+	g_free (key);
+	return transform;
+}
+
+/**
+ * mcm_transform_cache_set_max_size:
+ * @max_size: the estimated size in bytes of all the cached transforms
+ *
+ * Sets the memory cap, freeing transforms if required.
+ **/
+void
+mcm_transform_cache_set_max_size (gsize max_size)
+{
+	mcm_utils_lcms_lock ();
+	g_static_mutex_lock (&mcm_transform_cache_mutex);
+	mcm_transform_cache_max_size = max_size;
+	mcm_transform_cache_evict_locked (max_size);
+	g_static_mutex_unlock (&mcm_transform_cache_mutex);
+	mcm_utils_lcms_unlock ();
+}
+
+/**
+ * mcm_transform_cache_get_stats:
+ * @hits: the number of lookups that found a transform, or %NULL
+ * @misses: the number of lookups that had to create a transform, or %NULL
+ * @size: the estimated size of the cache in bytes, or %NULL
+ **/
+void
+mcm_transform_cache_get_stats (guint *hits, guint *misses, gsize *size)
+{
+	g_static_mutex_lock (&mcm_transform_cache_mutex);
+	if (hits != NULL)
+		*hits = mcm_transform_cache_hits;
+	if (misses != NULL)
+		*misses = mcm_transform_cache_misses;
+	if (size != NULL)
+		*size = mcm_transform_cache_size;
+	g_static_mutex_unlock (&mcm_transform_cache_mutex);
+}
+
+/**
+ * mcm_transform_cache_clear:
+ *
+ * Frees all the cached transforms and resets the counters.
+ **/
+void
+mcm_transform_cache_clear (void)
+{
+	mcm_utils_lcms_lock ();
+	g_static_mutex_lock (&mcm_transform_cache_mutex);
+	mcm_transform_cache_evict_locked (0);
+	mcm_transform_cache_hits = 0;
+	mcm_transform_cache_misses = 0;
+	g_static_mutex_unlock (&mcm_transform_cache_mutex);
+	mcm_utils_lcms_unlock ();
+}
+
+/**
+ * mcm_transform_cache_get_data_id:
+ *
+ * Return value: an identity for the profile data. Free with g_free()
+ **/
+gchar *
+mcm_transform_cache_get_data_id (const guint8 *data, gsize length)
+{
+	return g_strdup_printf ("hash-%016" G_GINT64_MODIFIER "x-%" G_GSIZE_FORMAT,
+				mcm_utils_hash_data (data, length), length);
+}
+
+/**
+ * mcm_transform_cache_get_file_id:
+ *
+ * Uses the modification time, so a changed file gets a new transform.
+ *
+ * Return value: an identity for the profile file. Free with g_free()
+ **/
+gchar *
+mcm_transform_cache_get_file_id (const gchar *filename)
+{
+	struct stat stat_buf;
+
+	if (g_stat (filename, &stat_buf) != 0)
+		return g_strdup_printf ("file:%s", filename);
+	return g_strdup_printf ("file:%s:%li:%li", filename,
+				(glong) stat_buf.st_mtime, (glong) stat_buf.st_size);
+}
+
+/**
+ * mcm_transform_cache_open_builtin:
+ * @user_data: one of %MCM_TRANSFORM_CACHE_ID_SRGB, %MCM_TRANSFORM_CACHE_ID_XYZ
+ * or %MCM_TRANSFORM_CACHE_ID_LAB
+ *
+ * A #McmTransformCacheOpenFunc for the profiles built into lcms.
+ **/
+gpointer
+mcm_transform_cache_open_builtin (gpointer user_data, gboolean *borrowed)
+{
+	const gchar *id = (const gchar *) user_data;
+
+	/* called with the lcms lock held */
+	if (g_strcmp0 (id, MCM_TRANSFORM_CACHE_ID_SRGB) == 0)
+		return cmsCreate_sRGBProfile ();
+	if (g_strcmp0 (id, MCM_TRANSFORM_CACHE_ID_XYZ) == 0)
+		return cmsCreateXYZProfile ();
+	if (g_strcmp0 (id, MCM_TRANSFORM_CACHE_ID_LAB) == 0)
+		return cmsCreateLabProfile (cmsD50_xyY ());
+	egg_warning ("no builtin profile %s", id);
+	return NULL;
+}
+
@@ -0,0 +1,71 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __MCM_TRANSFORM_CACHE_H
+#define __MCM_TRANSFORM_CACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define MCM_TRANSFORM_CACHE_ID_SRGB		"builtin-srgb"
+#define MCM_TRANSFORM_CACHE_ID_XYZ		"builtin-xyz"
+#define MCM_TRANSFORM_CACHE_ID_LAB		"builtin-lab-d50"
+
+typedef struct _McmTransform	McmTransform;
+
+/* returns a lcms profile handle, which is closed by the cache unless
+ * @borrowed is set to %TRUE */
+typedef gpointer (*McmTransformCacheOpenFunc)		(gpointer		 user_data,
+							 gboolean		*borrowed);
+
+McmTransform	*mcm_transform_cache_get		(const gchar		*input_id,
+							 McmTransformCacheOpenFunc input_func,
+							 gpointer		 input_data,
+							 const gchar		*output_id,
+							 McmTransformCacheOpenFunc output_func,
+							 gpointer		 output_data,
+							 guint32		 input_format,
+							 guint32		 output_format,
+							 guint			 intent,
+							 guint32		 flags);
+void		 mcm_transform_do_transform		(McmTransform		*transform,
+							 gconstpointer		 input,
+							 gpointer		 output,
+							 guint			 size);
+void		 mcm_transform_unref			(McmTransform		*transform);
+
+void		 mcm_transform_cache_set_max_size	(gsize			 max_size);
+void		 mcm_transform_cache_get_stats		(guint			*hits,
+							 guint			*misses,
+							 gsize			*size);
+void		 mcm_transform_cache_clear		(void);
+
+gchar		*mcm_transform_cache_get_data_id	(const guint8		*data,
+							 gsize			 length);
+gchar		*mcm_transform_cache_get_file_id	(const gchar		*filename);
+gpointer	 mcm_transform_cache_open_builtin	(gpointer		 user_data,
+							 gboolean		*borrowed);
+
+G_END_DECLS
+
+#endif /* __MCM_TRANSFORM_CACHE_H */
+
@@ -226,8 +226,8 @@ mcm_trc_widget_draw_line (McmTrcWidget *trc, cairo_t *cr)
 {
 	gdouble wx, wy;
 	McmTrcWidgetPrivate *priv = trc->priv;
-	GPtrArray *array;
-	McmClutData *tmp;
+	const guint16 *ramps;
+	guint len;
 	gfloat i;
 	gfloat value;
 	gfloat size;
@@ -241,8 +241,11 @@ mcm_trc_widget_draw_line (McmTrcWidget *trc, cairo_t *cr)
 	linewidth = priv->chart_width / 250.0f;
 
 	/* get data */
-	array = mcm_clut_get_array (priv->clut);
-	size = array->len;
+	ramps = mcm_clut_get_data (priv->clut);
+	if (ramps == NULL)
+		return;
+	len = mcm_clut_get_size (priv->clut);
+	size = len;
 
 	cairo_save (cr);
 
@@ -250,8 +253,7 @@ mcm_trc_widget_draw_line (McmTrcWidget *trc, cairo_t *cr)
 	cairo_set_line_width (cr, linewidth + 1.0f);
 	cairo_set_source_rgb (cr, 0.5f, 0.0f, 0.0f);
 	for (i=0; i<size; i++) {
-		tmp = g_ptr_array_index (array, (guint) i);
-		value = tmp->red/65536.0f;
+		value = ramps[(guint) i]/65536.0f;
 		mcm_trc_widget_map_to_display (trc, i/(size-1), value, &wx, &wy);
 		if (i == 0)
 			cairo_move_to (cr, wx, wy+1);
@@ -267,8 +269,7 @@ mcm_trc_widget_draw_line (McmTrcWidget *trc, cairo_t *cr)
 	cairo_set_line_width (cr, linewidth + 1.0f);
 	cairo_set_source_rgb (cr, 0.0f, 0.5f, 0.0f);
 	for (i=0; i<size; i++) {
-		tmp = g_ptr_array_index (array, (guint) i);
-		value = tmp->green/65536.0f;
+		value = ramps[len + (guint) i]/65536.0f;
 		mcm_trc_widget_map_to_display (trc, i/(size-1), value, &wx, &wy);
 		if (i == 0)
 			cairo_move_to (cr, wx, wy-1);
@@ -284,8 +285,7 @@ mcm_trc_widget_draw_line (McmTrcWidget *trc, cairo_t *cr)
 	cairo_set_line_width (cr, linewidth + 1.0f);
 	cairo_set_source_rgb (cr, 0.0f, 0.0f, 0.5f);
 	for (i=0; i<size; i++) {
-		tmp = g_ptr_array_index (array, (guint) i);
-		value = tmp->blue/65536.0f;
+		value = ramps[len * 2 + (guint) i]/65536.0f;
 		mcm_trc_widget_map_to_display (trc, i/(size-1), value, &wx, &wy);
 		if (i == 0)
 			cairo_move_to (cr, wx, wy);
@@ -297,8 +297,6 @@ mcm_trc_widget_draw_line (McmTrcWidget *trc, cairo_t *cr)
 	cairo_set_source_rgb (cr, 0.0f, 0.0f, 1.0f);
 	cairo_stroke (cr);
 
-	g_ptr_array_unref (array);
-
 	cairo_restore (cr);
 }
 
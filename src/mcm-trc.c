@@ -0,0 +1,392 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * SECTION:mcm-trc
+ * @short_description: Decodes and evaluates ICC tone reproduction curves
+ *
+ * For matrix/TRC RGB profiles the curves and the colorants are all that
+ * is needed to work out how each channel maps to sRGB, without creating
+ * a lcms transform.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "egg-debug.h"
+
+#include "mcm-trc.h"
+
+#define MCM_TRC_TYPE_CURV		0x63757276
+#define MCM_TRC_TYPE_PARA		0x70617261
+
+#define MCM_TRC_TYPE			0x00
+#define MCM_TRC_CURV_COUNT		0x08
+#define MCM_TRC_CURV_DATA		0x0c
+#define MCM_TRC_PARA_FUNCTION		0x08
+#define MCM_TRC_PARA_DATA		0x0c
+
+typedef enum {
+	MCM_TRC_KIND_IDENTITY,
+	MCM_TRC_KIND_GAMMA,
+	MCM_TRC_KIND_TABLE,
+	MCM_TRC_KIND_PARAMETRIC
+} McmTrcKind;
+
+struct _McmTrc {
+	McmTrcKind		 kind;
+	guint			 function;
+	gfloat			 params[7];
+	gfloat			*table;
+	guint			 table_size;
+};
+
+/* the lcms built-in sRGB colorants, adapted to D50 */
+static const gdouble mcm_trc_srgb_colorants[9] = {
+	0.4360747, 0.2225045, 0.0139322,
+	0.3850649, 0.7168786, 0.0971045,
+	0.1430804, 0.0606169, 0.7141733 };
+
+/**
+ * mcm_trc_decode_32:
+ **/
+static guint32
+mcm_trc_decode_32 (const guint8 *data)
+{
+	return ((guint32) data[0] << 24) | ((guint32) data[1] << 16) | ((guint32) data[2] << 8) | (guint32) data[3];
+}
+
+/**
+ * mcm_trc_decode_16:
+ **/
+static guint16
+mcm_trc_decode_16 (const guint8 *data)
+{
+	return (data[0] << 8) | data[1];
+}
+
+/**
+ * mcm_trc_new_from_data:
+ * @data: the tag data, starting with the type signature
+ * @size: the size of the tag
+ * @error: a #GError, or %NULL
+ *
+ * Decodes a curveType or parametricCurveType tag.
+ *
+ * Return value: a new #McmTrc, or %NULL. Free with mcm_trc_free()
+ **/
+McmTrc *
+mcm_trc_new_from_data (const guint8 *data, guint32 size, GError **error)
+{
+	guint i;
+	guint count;
+	guint32 type;
+	McmTrc *trc = NULL;
+	const guint param_count[] = { 1, 3, 4, 5, 7 };
+
+	g_return_val_if_fail (data != NULL, NULL);
+
+	if (size < MCM_TRC_CURV_DATA) {
+		g_set_error (error, 1, 0, "curve tag too small: %u bytes", size);
+		goto out;
+	}
+
+	type = mcm_trc_decode_32 (data + MCM_TRC_TYPE);
+	if (type == MCM_TRC_TYPE_CURV) {
+		count = mcm_trc_decode_32 (data + MCM_TRC_CURV_COUNT);
+		if (MCM_TRC_CURV_DATA + (count * 2) > size) {
+			g_set_error (error, 1, 0, "curve of %u entries does not fit in %u bytes", count, size);
+			goto out;
+		}
+		trc = g_new0 (McmTrc, 1);
+		if (count == 0) {
+			trc->kind = MCM_TRC_KIND_IDENTITY;
+		} else if (count == 1) {
+			/* u8Fixed8Number */
+			trc->kind = MCM_TRC_KIND_GAMMA;
+			trc->params[0] = mcm_trc_decode_16 (data + MCM_TRC_CURV_DATA) / 256.0f;
+		} else {
+			trc->kind = MCM_TRC_KIND_TABLE;
+			trc->table_size = count;
+			trc->table = g_new (gfloat, count);
+			for (i=0; i<count; i++)
+				trc->table[i] = mcm_trc_decode_16 (data + MCM_TRC_CURV_DATA + i*2) / 65535.0f;
+		}
+		goto out;
+	}
+
+	if (type == MCM_TRC_TYPE_PARA) {
+		if (size < MCM_TRC_PARA_DATA) {
+			g_set_error (error, 1, 0, "parametric curve too small: %u bytes", size);
+			goto out;
+		}
+		trc = g_new0 (McmTrc, 1);
+		trc->kind = MCM_TRC_KIND_PARAMETRIC;
+		trc->function = mcm_trc_decode_16 (data + MCM_TRC_PARA_FUNCTION);
+		if (trc->function >= G_N_ELEMENTS (param_count) ||
+		    MCM_TRC_PARA_DATA + (param_count[trc->function] * 4) > size) {
+			g_set_error (error, 1, 0, "invalid parametric curve function %u", trc->function);
+			mcm_trc_free (trc);
+			trc = NULL;
+			goto out;
+		}
+
+		/* s15Fixed16Number */
+		for (i=0; i<param_count[trc->function]; i++)
+			trc->params[i] = (gint32) mcm_trc_decode_32 (data + MCM_TRC_PARA_DATA + i*4) / 65536.0f;
+		goto out;
+	}
+
+	g_set_error (error, 1, 0, "unknown curve type 0x%08x", type);
+out:
+	return trc;
+}
+
+/**
+ * mcm_trc_free:
+ **/
+void
+mcm_trc_free (McmTrc *trc)
+{
+	if (trc == NULL)
+		return;
+	g_free (trc->table);
+	g_free (trc);
+}
+
+/**
+ * mcm_trc_evaluate_table:
+ *
+ * Linear interpolation, the same as lcms does for 16 bit tables.
+ **/
+static void
+mcm_trc_evaluate_table (const gfloat *table, guint table_size, const gfloat *in, gfloat *out, guint size)
+{
+	guint i;
+	guint idx;
+	gfloat pos;
+	gfloat frac;
+	const gfloat max = (gfloat) (table_size - 1);
+
+	for (i=0; i<size; i++) {
+		pos = CLAMP (in[i], 0.0f, 1.0f) * max;
+		idx = (guint) pos;
+		if (idx >= table_size - 1)
+			idx = table_size - 2;
+		frac = pos - (gfloat) idx;
+		out[i] = table[idx] + (table[idx + 1] - table[idx]) * frac;
+	}
+}
+
+/**
+ * mcm_trc_evaluate_parametric:
+ *
+ * The five function types from ICC.1:2004-10 section 10.15.
+ **/
+static void
+mcm_trc_evaluate_parametric (const McmTrc *trc, const gfloat *in, gfloat *out, guint size)
+{
+	guint i;
+	gfloat x;
+	gfloat base;
+	gfloat linear_max;
+	const gfloat g = trc->params[0];
+	const gfloat a = trc->params[1];
+	const gfloat b = trc->params[2];
+	const gfloat c = trc->params[3];
+	const gfloat d = trc->params[4];
+	const gfloat e = trc->params[5];
+	const gfloat f = trc->params[6];
+
+	switch (trc->function) {
+	case 0:
+		for (i=0; i<size; i++)
+			out[i] = powf (MAX (in[i], 0.0f), g);
+		break;
+	case 1:
+	case 2:
+		/* below -b/a the curve is flat */
+		for (i=0; i<size; i++) {
+			base = a * in[i] + b;
+			out[i] = (base > 0.0f) ? powf (base, g) : 0.0f;
+			if (trc->function == 2)
+				out[i] += c;
+		}
+		break;
+	case 3:
+	case 4:
+		linear_max = d;
+		for (i=0; i<size; i++) {
+			x = in[i];
+			if (x >= linear_max) {
+				base = a * x + b;
+				out[i] = (base > 0.0f) ? powf (base, g) : 0.0f;
+				if (trc->function == 4)
+					out[i] += e;
+			} else {
+				out[i] = c * x;
+				if (trc->function == 4)
+					out[i] += f;
+			}
+		}
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+/**
+ * mcm_trc_evaluate:
+ * @trc: a #McmTrc
+ * @in: input values from 0.0 to 1.0
+ * @out: output values, which can be the same as @in
+ * @size: the number of values
+ *
+ * Evaluates the curve for a whole array at once.
+ **/
+void
+mcm_trc_evaluate (const McmTrc *trc, const gfloat *in, gfloat *out, guint size)
+{
+	guint i;
+
+	g_return_if_fail (trc != NULL);
+
+	switch (trc->kind) {
+	case MCM_TRC_KIND_IDENTITY:
+		if (out != in)
+			memcpy (out, in, size * sizeof (gfloat));
+		break;
+	case MCM_TRC_KIND_GAMMA:
+		for (i=0; i<size; i++)
+			out[i] = powf (MAX (in[i], 0.0f), trc->params[0]);
+		break;
+	case MCM_TRC_KIND_TABLE:
+		mcm_trc_evaluate_table (trc->table, trc->table_size, in, out, size);
+		break;
+	case MCM_TRC_KIND_PARAMETRIC:
+		mcm_trc_evaluate_parametric (trc, in, out, size);
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+/**
+ * mcm_trc_invert_matrix:
+ *
+ * Inverts a row-major 3x3 matrix.
+ **/
+static gboolean
+mcm_trc_invert_matrix (const gdouble *src, gdouble *dest)
+{
+	gdouble det;
+
+	det = src[0] * (src[4] * src[8] - src[5] * src[7]) -
+	      src[1] * (src[3] * src[8] - src[5] * src[6]) +
+	      src[2] * (src[3] * src[7] - src[4] * src[6]);
+	if (fabs (det) < 1e-9)
+		return FALSE;
+
+	dest[0] = (src[4] * src[8] - src[5] * src[7]) / det;
+	dest[1] = (src[2] * src[7] - src[1] * src[8]) / det;
+	dest[2] = (src[1] * src[5] - src[2] * src[4]) / det;
+	dest[3] = (src[5] * src[6] - src[3] * src[8]) / det;
+	dest[4] = (src[0] * src[8] - src[2] * src[6]) / det;
+	dest[5] = (src[2] * src[3] - src[0] * src[5]) / det;
+	dest[6] = (src[3] * src[7] - src[4] * src[6]) / det;
+	dest[7] = (src[1] * src[6] - src[0] * src[7]) / det;
+	dest[8] = (src[0] * src[4] - src[1] * src[3]) / det;
+	return TRUE;
+}
+
+/**
+ * mcm_trc_generate_curve:
+ * @trc: the red, green and blue curves
+ * @colorants: the red, green and blue colorants as XYZ triplets
+ * @size: the number of points
+ *
+ * Works out the curve of each channel when converted to sRGB, which is
+ * what a profile to sRGB lcms transform would give for a matrix/TRC
+ * profile, with each channel ramped on its own.
+ *
+ * Return value: A new #McmClut, or %NULL. Free with g_object_unref()
+ **/
+McmClut *
+mcm_trc_generate_curve (McmTrc **trc, const gdouble *colorants, guint size)
+{
+	guint i;
+	guint j;
+	gdouble srgb_inverse[9];
+	gfloat scale;
+	gfloat *ramp = NULL;
+	gfloat *values[3] = { NULL, NULL, NULL };
+	guint16 *ramps;
+	McmClut *clut = NULL;
+
+	g_return_val_if_fail (trc != NULL, NULL);
+	g_return_val_if_fail (colorants != NULL, NULL);
+	g_return_val_if_fail (size > 1, NULL);
+
+	/* XYZ to linear sRGB, the transpose as the colorants are the columns */
+	if (!mcm_trc_invert_matrix (mcm_trc_srgb_colorants, srgb_inverse))
+		goto out;
+
+	/* the input ramp */
+	ramp = g_new (gfloat, size);
+	for (i=0; i<size; i++)
+		ramp[i] = (gfloat) i / (gfloat) (size - 1);
+
+	for (j=0; j<3; j++) {
+		values[j] = g_new (gfloat, size);
+		mcm_trc_evaluate (trc[j], ramp, values[j], size);
+
+		/* only this channel of the output is used, so it's just a scale */
+		scale = srgb_inverse[j + 0] * colorants[j * 3 + 0] +
+			srgb_inverse[j + 3] * colorants[j * 3 + 1] +
+			srgb_inverse[j + 6] * colorants[j * 3 + 2];
+
+		/* clip and encode with the sRGB curve */
+		for (i=0; i<size; i++) {
+			values[j][i] = CLAMP (values[j][i] * scale, 0.0f, 1.0f);
+			if (values[j][i] <= 0.0031308f)
+				values[j][i] = values[j][i] * 12.92f;
+			else
+				values[j][i] = 1.055f * powf (values[j][i], 1.0f / 2.4f) - 0.055f;
+		}
+	}
+
+	/* write straight into the planar ramps */
+	clut = mcm_clut_new ();
+	ramps = mcm_clut_get_source_buffer (clut, size);
+	for (j=0; j<3; j++) {
+		for (i=0; i<size; i++)
+			ramps[j * size + i] = values[j][i] * (gfloat) 0xffff;
+	}
+out:
+	g_free (ramp);
+	for (j=0; j<3; j++)
+		g_free (values[j]);
+	return clut;
+}
+
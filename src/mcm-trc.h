@@ -0,0 +1,48 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __MCM_TRC_H
+#define __MCM_TRC_H
+
+#include <glib.h>
+
+#include "mcm-clut.h"
+
+G_BEGIN_DECLS
+
+typedef struct _McmTrc	McmTrc;
+
+McmTrc		*mcm_trc_new_from_data			(const guint8		*data,
+							 guint32		 size,
+							 GError			**error);
+void		 mcm_trc_free				(McmTrc			*trc);
+void		 mcm_trc_evaluate			(const McmTrc		*trc,
+							 const gfloat		*in,
+							 gfloat			*out,
+							 guint			 size);
+McmClut		*mcm_trc_generate_curve			(McmTrc			**trc,
+							 const gdouble		*colorants,
+							 guint			 size);
+
+G_END_DECLS
+
+#endif /* __MCM_TRC_H */
+
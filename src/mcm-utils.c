@@ -21,6 +21,11 @@
 
 #include "config.h"
 
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
@@ -34,6 +39,40 @@
 #define PK_DBUS_INTERFACE_QUERY				"org.freedesktop.PackageKit.Query"
 #define PK_DBUS_INTERFACE_MODIFY			"org.freedesktop.PackageKit.Modify"
 
+#define MCM_UTILS_ICC_HEADER_SIZE			128
+#define MCM_UTILS_ICC_SIGNATURE_OFFSET			36
+
+#ifndef MCM_USE_LCMS2
+/* lcms1 has global state, so only one thread can be using it at a time */
+static GStaticRecMutex mcm_utils_lcms_mutex = G_STATIC_REC_MUTEX_INIT;
+#endif
+
+/**
+ * mcm_utils_lcms_lock:
+ *
+ * Has to be held around every call into lcms1, including creating, using
+ * and deleting transforms. lcms2 is thread safe, so this does nothing.
+ * The lock is recursive.
+ **/
+void
+mcm_utils_lcms_lock (void)
+{
+#ifndef MCM_USE_LCMS2
+	g_static_rec_mutex_lock (&mcm_utils_lcms_mutex);
+#endif
+}
+
+/**
+ * mcm_utils_lcms_unlock:
+ **/
+void
+mcm_utils_lcms_unlock (void)
+{
+#ifndef MCM_USE_LCMS2
+	g_static_rec_mutex_unlock (&mcm_utils_lcms_mutex);
+#endif
+}
+
 /**
  * mcm_utils_linkify:
  **/
@@ -82,6 +121,57 @@ mcm_utils_linkify (const gchar *hostile_text)
 	return g_string_free (string, FALSE);
 }
 
+/**
+ * mcm_utils_is_icc_profile_filename:
+ * @filename: a local filename
+ *
+ * Checks the ICC header signature rather than asking for the content type,
+ * which is much quicker when scanning lots of files.
+ *
+ * Return value: %TRUE if the file has a valid ICC profile header
+ **/
+gboolean
+mcm_utils_is_icc_profile_filename (const gchar *filename)
+{
+	gint fd;
+	gssize len;
+	guint32 size;
+	struct stat buf;
+	guint8 header[MCM_UTILS_ICC_HEADER_SIZE];
+	gboolean ret = FALSE;
+
+	/* don't block on a fifo */
+	fd = open (filename, O_RDONLY | O_NONBLOCK);
+	if (fd < 0) {
+		egg_debug ("failed to open %s: %s", filename, g_strerror (errno));
+		goto out;
+	}
+
+	/* only regular files can be profiles */
+	if (fstat (fd, &buf) < 0 || !S_ISREG (buf.st_mode))
+		goto out;
+	len = pread (fd, header, sizeof (header), 0);
+	if (len != sizeof (header))
+		goto out;
+
+	/* 'acsp' file signature */
+	if (memcmp (&header[MCM_UTILS_ICC_SIGNATURE_OFFSET], "acsp", 4) != 0)
+		goto out;
+
+	/* the declared size has to fit in the file */
+	memcpy (&size, header, sizeof (size));
+	size = GUINT32_FROM_BE (size);
+	if (size < sizeof (header) || size > (guint64) buf.st_size) {
+		egg_debug ("%s has invalid profile size %u", filename, size);
+		goto out;
+	}
+	ret = TRUE;
+out:
+	if (fd >= 0)
+		close (fd);
+	return ret;
+}
+
 /**
  * mcm_utils_is_icc_profile:
  **/
@@ -94,10 +184,16 @@ mcm_utils_is_icc_profile (GFile *file)
 	gboolean ret = FALSE;
 	gchar *filename = NULL;
 
+	/* local files can just be sniffed */
+	filename = g_file_get_path (file);
+	if (filename != NULL) {
+		ret = mcm_utils_is_icc_profile_filename (filename);
+		g_free (filename);
+		return ret;
+	}
+
 	/* get content type for file */
 	filename = g_file_get_uri (file);
-	if (filename == NULL)
-		filename = g_file_get_path (file);
 	info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE, G_FILE_QUERY_INFO_NONE, NULL, &error);
 	if (info != NULL) {
 		type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE);
@@ -324,6 +420,54 @@ mcm_utils_ensure_printable (gchar *text)
 	g_strdelimit (text, "_", ' ');
 }
 
+/**
+ * mcm_utils_hash_data:
+ *
+ * A fast non-cryptographic 64 bit hash (MurmurHash64A) for telling blobs
+ * apart. Do not use this where the data could be chosen by an attacker.
+ **/
+guint64
+mcm_utils_hash_data (const guint8 *data, gsize length)
+{
+	const guint64 m = G_GUINT64_CONSTANT (0xc6a4a7935bd1e995);
+	const guint r = 47;
+	const guint8 *tail;
+	guint64 h;
+	guint64 k;
+	gsize i;
+
+	h = G_GUINT64_CONSTANT (0x9e3779b97f4a7c15) ^ ((guint64) length * m);
+
+	/* mix in eight bytes at a time */
+	for (i=0; i+8 <= length; i+=8) {
+		memcpy (&k, data + i, sizeof (guint64));
+		k = GUINT64_FROM_LE (k);
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+
+	/* and then whatever is left over */
+	tail = data + i;
+	switch (length & 7) {
+	case 7: h ^= (guint64) tail[6] << 48;
+	case 6: h ^= (guint64) tail[5] << 40;
+	case 5: h ^= (guint64) tail[4] << 32;
+	case 4: h ^= (guint64) tail[3] << 24;
+	case 3: h ^= (guint64) tail[2] << 16;
+	case 2: h ^= (guint64) tail[1] << 8;
+	case 1: h ^= (guint64) tail[0];
+		h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
+}
+
 /**
  * mcm_utils_mkdir_with_parents:
  **/
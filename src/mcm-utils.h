@@ -83,8 +83,13 @@ gboolean	 mcm_utils_install_package		(const gchar		*package_name,
 							 GtkWindow		*window);
 gboolean 	 mcm_utils_is_package_installed		(const gchar 		*package_name);
 void		 mcm_utils_ensure_printable		(gchar			*text);
+guint64		 mcm_utils_hash_data			(const guint8		*data,
+							 gsize			 length);
 gboolean	 mcm_utils_is_icc_profile		(GFile			*file);
+gboolean	 mcm_utils_is_icc_profile_filename	(const gchar		*filename);
 gchar		*mcm_utils_linkify			(const gchar		*text);
+void		 mcm_utils_lcms_lock			(void);
+void		 mcm_utils_lcms_unlock			(void);
 const gchar	*mcm_intent_to_localized_text		(McmIntent	 	intent);
 const gchar	*mcm_intent_to_localized_description	(McmIntent	 intent);
 
@@ -0,0 +1,126 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2010 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+/**
+ * SECTION:mcm-volume-cache
+ * @short_description: What was found on a volume the last time it was scanned
+ *
+ * Adding or removing a file changes the directory mtime, and changed files
+ * are found using the profile index, so only the directories are checked.
+ * The places that were searched but did not exist are kept too, so a
+ * profile directory created since the last scan is noticed.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <sys/stat.h>
+
+#include "egg-debug.h"
+
+#include "mcm-volume-cache.h"
+
+/**
+ * mcm_volume_cache_is_valid:
+ * @cache: a #McmVolumeCache
+ * @root: where the volume is mounted now
+ *
+ * This does blocking I/O on the volume, so can be called from a thread.
+ *
+ * Return value: %TRUE if nothing has been added or removed since the scan
+ **/
+gboolean
+mcm_volume_cache_is_valid (McmVolumeCache *cache, const gchar *root)
+{
+	guint i;
+	const gchar *path;
+	struct stat buf;
+
+	g_return_val_if_fail (cache != NULL, FALSE);
+
+	/* mounted somewhere else */
+	if (g_strcmp0 (cache->root, root) != 0)
+		return FALSE;
+	for (i=0; i<cache->directories->len; i++) {
+		path = g_ptr_array_index (cache->directories, i);
+		if (stat (path, &buf) != 0)
+			return FALSE;
+		if ((guint64) buf.st_mtime != g_array_index (cache->mtimes, guint64, i))
+			return FALSE;
+	}
+
+	/* created since the last time */
+	for (i=0; i<cache->missing->len; i++) {
+		path = g_ptr_array_index (cache->missing, i);
+		if (stat (path, &buf) == 0) {
+			egg_debug ("%s has been created", path);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * mcm_volume_cache_free:
+ **/
+void
+mcm_volume_cache_free (McmVolumeCache *cache)
+{
+	if (cache == NULL)
+		return;
+	g_free (cache->root);
+	g_ptr_array_unref (cache->directories);
+	g_array_unref (cache->mtimes);
+	g_ptr_array_unref (cache->missing);
+	g_ptr_array_unref (cache->filenames);
+	g_free (cache);
+}
+
+/**
+ * mcm_volume_cache_new:
+ * @root: where the volume was mounted
+ * @directories: the directories that were walked
+ * @mtimes: the modification time of each directory, as #guint64's
+ * @missing: the directories that were searched for but did not exist
+ * @filenames: the profiles that were found
+ *
+ * The arrays are referenced, not copied.
+ *
+ * Return value: a new #McmVolumeCache, free with mcm_volume_cache_free()
+ **/
+McmVolumeCache *
+mcm_volume_cache_new (const gchar *root, GPtrArray *directories, GArray *mtimes,
+		      GPtrArray *missing, GPtrArray *filenames)
+{
+	McmVolumeCache *cache;
+
+	g_return_val_if_fail (directories->len == mtimes->len, NULL);
+
+	cache = g_new0 (McmVolumeCache, 1);
+	cache->root = g_strdup (root);
+	cache->directories = g_ptr_array_ref (directories);
+	cache->mtimes = g_array_ref (mtimes);
+	cache->missing = g_ptr_array_ref (missing);
+	cache->filenames = g_ptr_array_ref (filenames);
+	return cache;
+}
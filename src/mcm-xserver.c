@@ -35,10 +35,13 @@
 #include <stdlib.h>
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
 #include <X11/Xatom.h>
 #include <X11/extensions/Xrandr.h>
 
 #include "mcm-xserver.h"
+#include "mcm-utils.h"
 
 #include "egg-debug.h"
 
@@ -58,6 +61,15 @@ struct _McmXserverPrivate
 	GdkWindow			*window_gdk;
 	Display				*display;
 	Window				 window;
+	guint				 atoms_written;
+	guint				 atoms_skipped;
+	gsize				 chunk_size;
+	gchar				*read_data;
+	gchar				*profile_filename;
+	gchar				*profile_data;
+	gsize				 profile_length;
+	gchar				*profile_checksum;
+	time_t				 profile_mtime;
 };
 
 enum {
@@ -70,11 +82,304 @@ static gpointer mcm_xserver_object = NULL;
 
 G_DEFINE_TYPE (McmXserver, mcm_xserver, G_TYPE_OBJECT)
 
+/* a hash of the profile, set next to every _ICC_PROFILE atom we write */
+#define MCM_XSERVER_HASH_ATOM_NAME	"_MCM_ICC_PROFILE_HASH"
+
+/* the profile header, which also has the profile ID */
+#define MCM_XSERVER_HEADER_SIZE		128
+
+/* even with BIG-REQUESTS, don't block the server for too long at once */
+#define MCM_XSERVER_CHUNK_SIZE_MAX	(256 * 1024)
+
+/**
+ * mcm_xserver_get_stats:
+ *
+ * @xserver: a valid %McmXserver instance
+ * @written: the number of profile atoms that were uploaded, or %NULL
+ * @skipped: the number of profile atoms that already had the same contents, or %NULL
+ *
+ * Gets how many profile atoms were written and skipped by this process.
+ **/
+void
+mcm_xserver_get_stats (McmXserver *xserver, guint *written, guint *skipped)
+{
+	g_return_if_fail (MCM_IS_XSERVER (xserver));
+	if (written != NULL)
+		*written = xserver->priv->atoms_written;
+	if (skipped != NULL)
+		*skipped = xserver->priv->atoms_skipped;
+}
+
+/**
+ * mcm_xserver_get_checksum:
+ *
+ * Return value: the value of the hash atom for the profile, free with g_free()
+ **/
+static gchar *
+mcm_xserver_get_checksum (const guint8 *data, gsize length)
+{
+	return g_strdup_printf ("%016" G_GINT64_MODIFIER "x", mcm_utils_hash_data (data, length));
+}
+
+/**
+ * mcm_xserver_hash_matches:
+ *
+ * Return value: %TRUE if the hash atom holds @checksum
+ **/
+static gboolean
+mcm_xserver_hash_matches (const gchar *hash, gulong hash_length, const gchar *checksum)
+{
+	if (hash == NULL)
+		return FALSE;
+	if (hash_length != strlen (checksum))
+		return FALSE;
+	return (memcmp (hash, checksum, hash_length) == 0);
+}
+
+/**
+ * mcm_xserver_header_matches:
+ *
+ * The hash atom is only written by us, so another client could have
+ * replaced the profile without changing it. Checking the header, which
+ * has the profile ID, catches that.
+ *
+ * Return value: %TRUE if the start of the profile atom is the same as @data
+ **/
+static gboolean
+mcm_xserver_header_matches (const gchar *header, gulong header_length, const guint8 *data, gsize length)
+{
+	if (header == NULL)
+		return FALSE;
+	if (header_length != MIN (length, MCM_XSERVER_HEADER_SIZE))
+		return FALSE;
+	return (memcmp (header, data, header_length) == 0);
+}
+
+/**
+ * mcm_xserver_root_window_profile_matches:
+ *
+ * Only the header of the profile atom is read, so this is much cheaper
+ * than reading back the whole profile.
+ *
+ * Return value: %TRUE if the root window already has this profile
+ **/
+static gboolean
+mcm_xserver_root_window_profile_matches (McmXserver *xserver, const guint8 *data, gsize length, const gchar *checksum)
+{
+	gboolean ret = FALSE;
+	gchar *data_tmp = NULL;
+	gint format;
+	gint rc;
+	gulong bytes_after = 0;
+	gulong nitems = 0;
+	gulong profile_length;
+	Atom type;
+	McmXserverPrivate *priv = xserver->priv;
+
+	gdk_error_trap_push ();
+	rc = XGetWindowProperty (priv->display, priv->window,
+				 gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, "_ICC_PROFILE"),
+				 0, MCM_XSERVER_HEADER_SIZE / 4, False, XA_CARDINAL,
+				 &type, &format, &nitems, &bytes_after, (void*) &data_tmp);
+	profile_length = nitems + bytes_after;
+	if (rc == Success && profile_length == length)
+		ret = mcm_xserver_header_matches (data_tmp, nitems, data, length);
+	if (data_tmp != NULL) {
+		XFree (data_tmp);
+		data_tmp = NULL;
+	}
+	if (ret) {
+		rc = XGetWindowProperty (priv->display, priv->window,
+					 gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, MCM_XSERVER_HASH_ATOM_NAME),
+					 0, G_MAXLONG, False, XA_STRING,
+					 &type, &format, &nitems, &bytes_after, (void*) &data_tmp);
+		ret = (rc == Success && mcm_xserver_hash_matches (data_tmp, nitems, checksum));
+	}
+	gdk_error_trap_pop ();
+
+	if (data_tmp != NULL)
+		XFree (data_tmp);
+	return ret;
+}
+
+/**
+ * mcm_xserver_output_profile_matches:
+ *
+ * Return value: %TRUE if the output already has this profile
+ **/
+static gboolean
+mcm_xserver_output_profile_matches (McmXserver *xserver, RROutput output, const guint8 *data, gsize length, const gchar *checksum)
+{
+	gboolean ret = FALSE;
+	gchar *data_tmp = NULL;
+	gint format;
+	gint rc;
+	gulong bytes_after = 0;
+	gulong nitems = 0;
+	gulong profile_length;
+	Atom type;
+	McmXserverPrivate *priv = xserver->priv;
+
+	gdk_error_trap_push ();
+	rc = XRRGetOutputProperty (priv->display, output,
+				   gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, "_ICC_PROFILE"),
+				   0, MCM_XSERVER_HEADER_SIZE / 4, False, False, AnyPropertyType,
+				   &type, &format, &nitems, &bytes_after, (unsigned char **) &data_tmp);
+	profile_length = nitems + bytes_after;
+	if (rc == Success && profile_length == length)
+		ret = mcm_xserver_header_matches (data_tmp, nitems, data, length);
+	if (data_tmp != NULL) {
+		XFree (data_tmp);
+		data_tmp = NULL;
+	}
+	if (ret) {
+		rc = XRRGetOutputProperty (priv->display, output,
+					   gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, MCM_XSERVER_HASH_ATOM_NAME),
+					   0, ~0, False, False, AnyPropertyType,
+					   &type, &format, &nitems, &bytes_after, (unsigned char **) &data_tmp);
+		ret = (rc == Success && mcm_xserver_hash_matches (data_tmp, nitems, checksum));
+	}
+	gdk_error_trap_pop ();
+
+	if (data_tmp != NULL)
+		XFree (data_tmp);
+	return ret;
+}
+
+/**
+ * mcm_xserver_get_output_id:
+ *
+ * Return value: the XRandR output for @output_name, or %None
+ **/
+static RROutput
+mcm_xserver_get_output_id (McmXserver *xserver, const gchar *output_name)
+{
+	gint i;
+	RROutput id = None;
+	XRROutputInfo *output;
+	XRRScreenResources *resources;
+	McmXserverPrivate *priv = xserver->priv;
+
+	gdk_error_trap_push ();
+	resources = XRRGetScreenResources (priv->display, priv->window);
+	for (i = 0; resources != NULL && i < resources->noutput; i++) {
+		output = XRRGetOutputInfo (priv->display, resources, resources->outputs[i]);
+		if (g_strcmp0 (output->name, output_name) == 0)
+			id = resources->outputs[i];
+		XRRFreeOutputInfo (output);
+		if (id != None)
+			break;
+	}
+	gdk_error_trap_pop ();
+
+	if (resources != NULL)
+		XRRFreeScreenResources (resources);
+	return id;
+}
+
+/**
+ * mcm_xserver_get_chunk_size:
+ *
+ * Return value: the largest number of bytes that can be sent in one property request
+ **/
+static gsize
+mcm_xserver_get_chunk_size (McmXserver *xserver)
+{
+	glong max_request;
+	McmXserverPrivate *priv = xserver->priv;
+
+	/* use cached value */
+	if (priv->chunk_size > 0)
+		return priv->chunk_size;
+
+	/* this is in 4 byte units, and includes the request header */
+	max_request = XExtendedMaxRequestSize (priv->display);
+	if (max_request == 0)
+		max_request = XMaxRequestSize (priv->display);
+	priv->chunk_size = (max_request - 64) * 4;
+	priv->chunk_size = MIN (priv->chunk_size, MCM_XSERVER_CHUNK_SIZE_MAX);
+	egg_debug ("uploading profiles in chunks of %" G_GSIZE_FORMAT " bytes", priv->chunk_size);
+	return priv->chunk_size;
+}
+
+/**
+ * mcm_xserver_free_read_data:
+ **/
+static void
+mcm_xserver_free_read_data (McmXserver *xserver)
+{
+	if (xserver->priv->read_data != NULL) {
+		XFree (xserver->priv->read_data);
+		xserver->priv->read_data = NULL;
+	}
+}
+
+/**
+ * mcm_xserver_load_profile:
+ *
+ * Loads the profile and works out its checksum. The last profile is kept,
+ * as the same one is normally set on an output and on the root window.
+ * This is a copy rather than a mapping, as the file could be truncated
+ * while this long-lived object still has it.
+ *
+ * Return value: %TRUE for success.
+ **/
+static gboolean
+mcm_xserver_load_profile (McmXserver *xserver, const gchar *filename,
+			  const guint8 **data, gsize *length, const gchar **checksum,
+			  GError **error)
+{
+	gboolean ret = FALSE;
+	struct stat buf;
+	McmXserverPrivate *priv = xserver->priv;
+
+	/* the file has to exist */
+	if (g_stat (filename, &buf) != 0) {
+		g_set_error (error, 1, 0, "failed to get details of %s", filename);
+		goto out;
+	}
+
+	/* not the one we have */
+	if (priv->profile_data == NULL ||
+	    g_strcmp0 (filename, priv->profile_filename) != 0 ||
+	    buf.st_mtime != priv->profile_mtime ||
+	    (gsize) buf.st_size != priv->profile_length) {
+		g_free (priv->profile_data);
+		g_free (priv->profile_filename);
+		g_free (priv->profile_checksum);
+		priv->profile_data = NULL;
+		priv->profile_filename = NULL;
+		priv->profile_checksum = NULL;
+		ret = g_file_get_contents (filename, &priv->profile_data, &priv->profile_length, error);
+		if (!ret)
+			goto out;
+		if (priv->profile_length == 0) {
+			g_set_error (error, 1, 0, "%s is empty", filename);
+			g_free (priv->profile_data);
+			priv->profile_data = NULL;
+			ret = FALSE;
+			goto out;
+		}
+		priv->profile_filename = g_strdup (filename);
+		priv->profile_mtime = buf.st_mtime;
+		priv->profile_checksum = mcm_xserver_get_checksum ((const guint8 *) priv->profile_data,
+								   priv->profile_length);
+	}
+
+	*data = (const guint8 *) priv->profile_data;
+	*length = priv->profile_length;
+	*checksum = priv->profile_checksum;
+	ret = TRUE;
+out:
+	return ret;
+}
+
 /**
  * mcm_xserver_get_root_window_profile_data:
  *
  * @xserver: a valid %McmXserver instance
- * @data: the data that is returned from the XServer. Free with g_free()
+ * @data: the data that is returned from the XServer. This is owned by
+ *	@xserver and is valid until the next call to a _get_ function
  * @length: the size of the returned data, or %NULL if you don't care
  * @error: a %GError that is set in the result of an error, or %NULL
  * Return value: %TRUE for success.
@@ -82,11 +387,10 @@ G_DEFINE_TYPE (McmXserver, mcm_xserver, G_TYPE_OBJECT)
  * Gets the ICC profile data from the XServer.
  **/
 gboolean
-mcm_xserver_get_root_window_profile_data (McmXserver *xserver, guint8 **data, gsize *length, GError **error)
+mcm_xserver_get_root_window_profile_data (McmXserver *xserver, const guint8 **data, gsize *length, GError **error)
 {
 	gboolean ret = FALSE;
 	const gchar *atom_name;
-	gchar *data_tmp = NULL;
 	gint format;
 	gint rc;
 	gulong bytes_after;
@@ -102,10 +406,11 @@ mcm_xserver_get_root_window_profile_data (McmXserver *xserver, guint8 **data, gs
 	atom_name = "_ICC_PROFILE";
 
 	/* get the value */
+	mcm_xserver_free_read_data (xserver);
 	gdk_error_trap_push ();
 	atom = gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, atom_name);
 	rc = XGetWindowProperty (priv->display, priv->window, atom, 0, G_MAXLONG, False, XA_CARDINAL,
-				 &type, &format, &nitems, &bytes_after, (void*) &data_tmp);
+				 &type, &format, &nitems, &bytes_after, (void*) &priv->read_data);
 	gdk_error_trap_pop ();
 
 	/* did the call fail */
@@ -120,9 +425,8 @@ mcm_xserver_get_root_window_profile_data (McmXserver *xserver, guint8 **data, gs
 		goto out;
 	}
 
-	/* allocate the data using Glib, rather than asking the user to use XFree */
-	*data = g_new0 (guint8, nitems);
-	memcpy (*data, data_tmp, nitems);
+	/* let the caller use the X copy directly */
+	*data = (const guint8 *) priv->read_data;
 
 	/* copy the length */
 	if (length != NULL)
@@ -131,43 +435,71 @@ mcm_xserver_get_root_window_profile_data (McmXserver *xserver, guint8 **data, gs
 	/* success */
 	ret = TRUE;
 out:
-	if (data_tmp != NULL)
-		XFree (data_tmp);
 	return ret;
 }
 
 /**
- * mcm_xserver_set_root_window_profile:
- * @xserver: a valid %McmXserver instance
- * @filename: the filename of the ICC profile
- * @error: a %GError that is set in the result of an error, or %NULL
- * Return value: %TRUE for success.
- *
- * Sets the ICC profile data to the XServer.
+ * mcm_xserver_set_root_window_profile_internal:
  **/
-gboolean
-mcm_xserver_set_root_window_profile (McmXserver *xserver, const gchar *filename, GError **error)
+static gboolean
+mcm_xserver_set_root_window_profile_internal (McmXserver *xserver, const guint8 *data, gsize length,
+					      const gchar *checksum, GError **error)
 {
-	gboolean ret;
-	gchar *data = NULL;
-	gsize length;
-
-	g_return_val_if_fail (MCM_IS_XSERVER (xserver), FALSE);
-	g_return_val_if_fail (filename != NULL, FALSE);
+	gboolean ret = FALSE;
+	const gchar *atom_name;
+	gint rc = Success;
+	gsize offset;
+	gsize chunk;
+	gsize chunk_size;
+	gint mode = PropModeReplace;
+	Atom atom = None;
+	McmXserverPrivate *priv = xserver->priv;
 
-	egg_debug ("setting root window ICC profile atom from %s", filename);
+	/* get the atom name */
+	atom_name = "_ICC_PROFILE";
 
-	/* get contents of file */
-	ret = g_file_get_contents (filename, &data, &length, error);
-	if (!ret)
+	/* already set, so don't send the whole profile again */
+	if (mcm_xserver_root_window_profile_matches (xserver, data, length, checksum)) {
+		egg_debug ("root window %s atom unchanged", atom_name);
+		priv->atoms_skipped++;
+		ret = TRUE;
 		goto out;
+	}
 
-	/* send to the XServer */
-	ret = mcm_xserver_set_root_window_profile_data (xserver, (const guint8 *) data, length, error);
-	if (!ret)
+	/* get the value, in pieces that fit in a request */
+	chunk_size = mcm_xserver_get_chunk_size (xserver);
+	gdk_error_trap_push ();
+	atom = gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, atom_name);
+
+	/* other clients must not see half a profile */
+	if (length > chunk_size)
+		XGrabServer (priv->display);
+	for (offset = 0; offset < length; offset += chunk) {
+		chunk = MIN (chunk_size, length - offset);
+		rc = XChangeProperty (priv->display, priv->window, atom, XA_CARDINAL, 8, mode, (unsigned char*) data + offset, chunk);
+		mode = PropModeAppend;
+	}
+	XChangeProperty (priv->display, priv->window,
+			 gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, MCM_XSERVER_HASH_ATOM_NAME),
+			 XA_STRING, 8, PropModeReplace, (unsigned char*) checksum, strlen (checksum));
+	if (length > chunk_size)
+		XUngrabServer (priv->display);
+	gdk_error_trap_pop ();
+
+	/* for some reason this fails with BadRequest, but actually sets the value */
+	if (rc == BadRequest)
+		rc = Success;
+
+	/* did the call fail */
+	if (rc != Success) {
+		g_set_error (error, 1, 0, "failed to set %s atom with rc %i", atom_name, rc);
 		goto out;
+	}
+
+	/* success */
+	priv->atoms_written++;
+	ret = TRUE;
 out:
-	g_free (data);
 	return ret;
 }
 
@@ -184,37 +516,50 @@ out:
 gboolean
 mcm_xserver_set_root_window_profile_data (McmXserver *xserver, const guint8 *data, gsize length, GError **error)
 {
-	gboolean ret = FALSE;
-	const gchar *atom_name;
-	gint rc;
-	Atom atom = None;
-	McmXserverPrivate *priv = xserver->priv;
+	gboolean ret;
+	gchar *checksum;
 
 	g_return_val_if_fail (MCM_IS_XSERVER (xserver), FALSE);
 	g_return_val_if_fail (data != NULL, FALSE);
 	g_return_val_if_fail (length != 0, FALSE);
 
-	/* get the atom name */
-	atom_name = "_ICC_PROFILE";
+	checksum = mcm_xserver_get_checksum (data, length);
+	ret = mcm_xserver_set_root_window_profile_internal (xserver, data, length, checksum, error);
+	g_free (checksum);
+	return ret;
+}
 
-	/* get the value */
-	gdk_error_trap_push ();
-	atom = gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, atom_name);
-	rc = XChangeProperty (priv->display, priv->window, atom, XA_CARDINAL, 8, PropModeReplace, (unsigned char*) data, length);
-	gdk_error_trap_pop ();
+/**
+ * mcm_xserver_set_root_window_profile:
+ * @xserver: a valid %McmXserver instance
+ * @filename: the filename of the ICC profile
+ * @error: a %GError that is set in the result of an error, or %NULL
+ * Return value: %TRUE for success.
+ *
+ * Sets the ICC profile data to the XServer.
+ **/
+gboolean
+mcm_xserver_set_root_window_profile (McmXserver *xserver, const gchar *filename, GError **error)
+{
+	gboolean ret;
+	const guint8 *data;
+	const gchar *checksum;
+	gsize length;
 
-	/* for some reason this fails with BadRequest, but actually sets the value */
-	if (rc == BadRequest)
-		rc = Success;
+	g_return_val_if_fail (MCM_IS_XSERVER (xserver), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
 
-	/* did the call fail */
-	if (rc != Success) {
-		g_set_error (error, 1, 0, "failed to set %s atom with rc %i", atom_name, rc);
+	egg_debug ("setting root window ICC profile atom from %s", filename);
+
+	/* get contents of file */
+	ret = mcm_xserver_load_profile (xserver, filename, &data, &length, &checksum, error);
+	if (!ret)
 		goto out;
-	}
 
-	/* success */
-	ret = TRUE;
+	/* send to the XServer */
+	ret = mcm_xserver_set_root_window_profile_internal (xserver, data, length, checksum, error);
+	if (!ret)
+		goto out;
 out:
 	return ret;
 }
@@ -402,6 +747,8 @@ mcm_xserver_remove_root_window_profile (McmXserver *xserver, GError **error)
 	gdk_error_trap_push ();
 	atom = gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, atom_name);
 	rc = XDeleteProperty(priv->display, priv->window, atom);
+	XDeleteProperty (priv->display, priv->window,
+			 gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, MCM_XSERVER_HASH_ATOM_NAME));
 	gdk_error_trap_pop ();
 
 	/* this fails with BadRequest if the atom was not set */
@@ -423,7 +770,8 @@ out:
  *
  * @xserver: a valid %McmXserver instance
  * @output_name: the output name, e.g. "LVDS1"
- * @data: the data that is returned from the XServer. Free with g_free()
+ * @data: the data that is returned from the XServer. This is owned by
+ *	@xserver and is valid until the next call to a _get_ function
  * @length: the size of the returned data, or %NULL if you don't care
  * @error: a %GError that is set in the result of an error, or %NULL
  * Return value: %TRUE for success.
@@ -431,20 +779,17 @@ out:
  * Gets the ICC profile data from the specified output.
  **/
 gboolean
-mcm_xserver_get_output_profile_data (McmXserver *xserver, const gchar *output_name, guint8 **data, gsize *length, GError **error)
+mcm_xserver_get_output_profile_data (McmXserver *xserver, const gchar *output_name, const guint8 **data, gsize *length, GError **error)
 {
 	gboolean ret = FALSE;
 	const gchar *atom_name;
-	gchar *data_tmp = NULL;
 	gint format;
-	gint rc = -1;
+	gint rc;
 	gulong bytes_after;
 	gulong nitems = 0;
 	Atom atom = None;
 	Atom type;
-	gint i;
-	XRROutputInfo *output;
-	XRRScreenResources *resources = NULL;
+	RROutput output;
 	McmXserverPrivate *priv = xserver->priv;
 
 	g_return_val_if_fail (MCM_IS_XSERVER (xserver), FALSE);
@@ -453,27 +798,22 @@ mcm_xserver_get_output_profile_data (McmXserver *xserver, const gchar *output_na
 	/* get the atom name */
 	atom_name = "_ICC_PROFILE";
 
+	/* find the output */
+	output = mcm_xserver_get_output_id (xserver, output_name);
+	if (output == None) {
+		g_set_error (error, 1, 0, "failed to match adaptor %s", output_name);
+		goto out;
+	}
+
 	/* get the value */
+	mcm_xserver_free_read_data (xserver);
 	gdk_error_trap_push ();
 	atom = gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, atom_name);
-	resources = XRRGetScreenResources (priv->display, priv->window);
-	for (i = 0; i < resources->noutput; i++) {
-		output = XRRGetOutputInfo (priv->display, resources, resources->outputs[i]);
-		if (g_strcmp0 (output->name, output_name) == 0) {
-			rc = XRRGetOutputProperty (priv->display, resources->outputs[i],
-						   atom, 0, ~0, False, False, AnyPropertyType, &type, &format, &nitems, &bytes_after, (unsigned char **) &data_tmp);
-			egg_debug ("found %s, got %i bytes", output_name, (guint) nitems);
-		}
-		XRRFreeOutputInfo (output);
-	}
+	rc = XRRGetOutputProperty (priv->display, output,
+				   atom, 0, ~0, False, False, AnyPropertyType, &type, &format, &nitems, &bytes_after, (unsigned char **) &priv->read_data);
+	egg_debug ("found %s, got %i bytes", output_name, (guint) nitems);
 	gdk_error_trap_pop ();
 
-	/* we failed to match any outputs */
-	if (rc == -1) {
-		g_set_error (error, 1, 0, "failed to match adaptor %s", output_name);
-		goto out;
-	}
-
 	/* did the call fail */
 	if (rc != Success) {
 		g_set_error (error, 1, 0, "failed to get %s atom with rc %i", atom_name, rc);
@@ -486,9 +826,8 @@ mcm_xserver_get_output_profile_data (McmXserver *xserver, const gchar *output_na
 		goto out;
 	}
 
-	/* allocate the data using Glib, rather than asking the user to use XFree */
-	*data = g_new0 (guint8, nitems);
-	memcpy (*data, data_tmp, nitems);
+	/* let the caller use the X copy directly */
+	*data = (const guint8 *) priv->read_data;
 
 	/* copy the length */
 	if (length != NULL)
@@ -497,10 +836,77 @@ mcm_xserver_get_output_profile_data (McmXserver *xserver, const gchar *output_na
 	/* success */
 	ret = TRUE;
 out:
-	if (resources != NULL)
-		XRRFreeScreenResources (resources);
-	if (data_tmp != NULL)
-		XFree (data_tmp);
+	return ret;
+}
+
+/**
+ * mcm_xserver_set_output_profile_internal:
+ **/
+static gboolean
+mcm_xserver_set_output_profile_internal (McmXserver *xserver, const gchar *output_name, const guint8 *data, gsize length,
+					 const gchar *checksum, GError **error)
+{
+	gboolean ret = FALSE;
+	const gchar *atom_name;
+	gint rc;
+	gsize offset;
+	gsize chunk;
+	gsize chunk_size;
+	gint mode = PropModeReplace;
+	Atom atom = None;
+	RROutput output;
+	McmXserverPrivate *priv = xserver->priv;
+
+	/* get the atom name */
+	atom_name = "_ICC_PROFILE";
+
+	/* nothing to do if the output is not known */
+	output = mcm_xserver_get_output_id (xserver, output_name);
+	if (output == None) {
+		egg_debug ("no output %s", output_name);
+		ret = TRUE;
+		goto out;
+	}
+
+	/* already set, so don't send the whole profile again */
+	if (mcm_xserver_output_profile_matches (xserver, output, data, length, checksum)) {
+		egg_debug ("output %s %s atom unchanged", output_name, atom_name);
+		priv->atoms_skipped++;
+		ret = TRUE;
+		goto out;
+	}
+
+	/* set the value, in pieces that fit in a request */
+	egg_debug ("found %s, setting %i bytes", output_name, (guint) length);
+	chunk_size = mcm_xserver_get_chunk_size (xserver);
+	gdk_error_trap_push ();
+	atom = gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, atom_name);
+
+	/* other clients must not see half a profile */
+	if (length > chunk_size)
+		XGrabServer (priv->display);
+	for (offset = 0; offset < length; offset += chunk) {
+		chunk = MIN (chunk_size, length - offset);
+		XRRChangeOutputProperty (priv->display, output, atom, XA_CARDINAL, 8, mode, (unsigned char*) data + offset, (gint) chunk);
+		mode = PropModeAppend;
+	}
+	XRRChangeOutputProperty (priv->display, output,
+				 gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, MCM_XSERVER_HASH_ATOM_NAME),
+				 XA_STRING, 8, PropModeReplace, (unsigned char*) checksum, strlen (checksum));
+	if (length > chunk_size)
+		XUngrabServer (priv->display);
+	rc = gdk_error_trap_pop ();
+
+	/* did the call fail */
+	if (rc != Success) {
+		g_set_error (error, 1, 0, "failed to set output %s atom with rc %i", atom_name, rc);
+		goto out;
+	}
+
+	/* success */
+	priv->atoms_written++;
+	ret = TRUE;
+out:
 	return ret;
 }
 
@@ -518,7 +924,8 @@ gboolean
 mcm_xserver_set_output_profile (McmXserver *xserver, const gchar *output_name, const gchar *filename, GError **error)
 {
 	gboolean ret;
-	gchar *data = NULL;
+	const guint8 *data;
+	const gchar *checksum;
 	gsize length;
 
 	g_return_val_if_fail (MCM_IS_XSERVER (xserver), FALSE);
@@ -527,16 +934,15 @@ mcm_xserver_set_output_profile (McmXserver *xserver, const gchar *output_name, c
 	egg_debug ("setting output '%s' ICC profile atom from %s", output_name, filename);
 
 	/* get contents of file */
-	ret = g_file_get_contents (filename, &data, &length, error);
+	ret = mcm_xserver_load_profile (xserver, filename, &data, &length, &checksum, error);
 	if (!ret)
 		goto out;
 
 	/* send to the XServer */
-	ret = mcm_xserver_set_output_profile_data (xserver, output_name, (const guint8 *) data, length, error);
+	ret = mcm_xserver_set_output_profile_internal (xserver, output_name, data, length, checksum, error);
 	if (!ret)
 		goto out;
 out:
-	g_free (data);
 	return ret;
 }
 
@@ -554,47 +960,16 @@ out:
 gboolean
 mcm_xserver_set_output_profile_data (McmXserver *xserver, const gchar *output_name, const guint8 *data, gsize length, GError **error)
 {
-	gboolean ret = FALSE;
-	const gchar *atom_name;
-	gint rc;
-	gint i;
-	Atom atom = None;
-	XRROutputInfo *output;
-	XRRScreenResources *resources = NULL;
-	McmXserverPrivate *priv = xserver->priv;
+	gboolean ret;
+	gchar *checksum;
 
 	g_return_val_if_fail (MCM_IS_XSERVER (xserver), FALSE);
 	g_return_val_if_fail (data != NULL, FALSE);
 	g_return_val_if_fail (length != 0, FALSE);
 
-	/* get the atom name */
-	atom_name = "_ICC_PROFILE";
-
-	/* get the value */
-	gdk_error_trap_push ();
-	atom = gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, atom_name);
-	resources = XRRGetScreenResources (priv->display, priv->window);
-	for (i = 0; i < resources->noutput; ++i) {
-		output = XRRGetOutputInfo (priv->display, resources, resources->outputs[i]);
-		if (g_strcmp0 (output->name, output_name) == 0) {
-			egg_debug ("found %s, setting %i bytes", output_name, (guint) length);
-			XRRChangeOutputProperty (priv->display, resources->outputs[i], atom, XA_CARDINAL, 8, PropModeReplace, (unsigned char*) data, (gint)length);
-		}
-		XRRFreeOutputInfo (output);
-	}
-	rc = gdk_error_trap_pop ();
-
-	/* did the call fail */
-	if (rc != Success) {
-		g_set_error (error, 1, 0, "failed to set output %s atom with rc %i", atom_name, rc);
-		goto out;
-	}
-
-	/* success */
-	ret = TRUE;
-out:
-	if (resources != NULL)
-		XRRFreeScreenResources (resources);
+	checksum = mcm_xserver_get_checksum (data, length);
+	ret = mcm_xserver_set_output_profile_internal (xserver, output_name, data, length, checksum, error);
+	g_free (checksum);
 	return ret;
 }
 
@@ -613,10 +988,8 @@ mcm_xserver_remove_output_profile (McmXserver *xserver, const gchar *output_name
 	gboolean ret = FALSE;
 	const gchar *atom_name;
 	gint rc;
-	gint i;
 	Atom atom = None;
-	XRROutputInfo *output;
-	XRRScreenResources *resources = NULL;
+	RROutput output;
 	McmXserverPrivate *priv = xserver->priv;
 
 	g_return_val_if_fail (MCM_IS_XSERVER (xserver), FALSE);
@@ -624,18 +997,21 @@ mcm_xserver_remove_output_profile (McmXserver *xserver, const gchar *output_name
 	/* get the atom name */
 	atom_name = "_ICC_PROFILE";
 
+	/* nothing to do if the output is not known */
+	output = mcm_xserver_get_output_id (xserver, output_name);
+	if (output == None) {
+		egg_debug ("no output %s", output_name);
+		ret = TRUE;
+		goto out;
+	}
+
 	/* get the value */
+	egg_debug ("found %s, removing atom", output_name);
 	gdk_error_trap_push ();
 	atom = gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, atom_name);
-	resources = XRRGetScreenResources (priv->display, priv->window);
-	for (i = 0; i < resources->noutput; ++i) {
-		output = XRRGetOutputInfo (priv->display, resources, resources->outputs[i]);
-		if (g_strcmp0 (output->name, output_name) == 0) {
-			egg_debug ("found %s, removing atom", output_name);
-			XRRDeleteOutputProperty (priv->display, resources->outputs[i], atom);
-		}
-		XRRFreeOutputInfo (output);
-	}
+	XRRDeleteOutputProperty (priv->display, output, atom);
+	XRRDeleteOutputProperty (priv->display, output,
+				 gdk_x11_get_xatom_by_name_for_display (priv->display_gdk, MCM_XSERVER_HASH_ATOM_NAME));
 	rc = gdk_error_trap_pop ();
 
 	/* did the call fail */
@@ -647,8 +1023,6 @@ mcm_xserver_remove_output_profile (McmXserver *xserver, const gchar *output_name
 	/* success */
 	ret = TRUE;
 out:
-	if (resources != NULL)
-		XRRFreeScreenResources (resources);
 	return ret;
 }
 
@@ -722,6 +1096,15 @@ mcm_xserver_init (McmXserver *xserver)
 {
 	xserver->priv = MCM_XSERVER_GET_PRIVATE (xserver);
 	xserver->priv->display_name = NULL;
+	xserver->priv->atoms_written = 0;
+	xserver->priv->atoms_skipped = 0;
+	xserver->priv->chunk_size = 0;
+	xserver->priv->read_data = NULL;
+	xserver->priv->profile_filename = NULL;
+	xserver->priv->profile_data = NULL;
+	xserver->priv->profile_length = 0;
+	xserver->priv->profile_checksum = NULL;
+	xserver->priv->profile_mtime = 0;
 
 	/* get defaults for single screen */
 	xserver->priv->display_gdk = gdk_display_get_default ();
@@ -740,6 +1123,10 @@ mcm_xserver_finalize (GObject *object)
 	McmXserverPrivate *priv = xserver->priv;
 
 	g_free (priv->display_name);
+	g_free (priv->profile_filename);
+	g_free (priv->profile_checksum);
+	g_free (priv->profile_data);
+	mcm_xserver_free_read_data (xserver);
 
 	G_OBJECT_CLASS (mcm_xserver_parent_class)->finalize (object);
 }
@@ -56,10 +56,13 @@ struct _McmXserverClass
 
 GType		 mcm_xserver_get_type		  		(void);
 McmXserver	*mcm_xserver_new				(void);
+void		 mcm_xserver_get_stats				(McmXserver		*xserver,
+								 guint			*written,
+								 guint			*skipped);
 
 /* per screen */
 gboolean	 mcm_xserver_get_root_window_profile_data	(McmXserver		*xserver,
-								 guint8			**data,
+								 const guint8		**data,
 								 gsize			*length,
 								 GError			**error);
 gboolean	 mcm_xserver_set_root_window_profile_data	(McmXserver		*xserver,
@@ -85,7 +88,7 @@ gboolean	 mcm_xserver_get_protocol_version		(McmXserver		*xserver,
 /* per output */
 gboolean	 mcm_xserver_get_output_profile_data		(McmXserver		*xserver,
 								 const gchar		*output_name,
-								 guint8			**data,
+								 const guint8		**data,
 								 gsize			*length,
 								 GError			**error);
 gboolean	 mcm_xserver_set_output_profile_data		(McmXserver		*xserver,